@@ -63,6 +63,7 @@ void PointerWrap::SetError(Error error_) {
 }
 
 bool PointerWrap::ExpectVoid(void *data, int size) {
+	CheckWriteSpace(size);
 	switch (mode) {
 	case MODE_READ:	if (memcmp(data, *ptr, size) != 0) return false; break;
 	case MODE_WRITE: memcpy(*ptr, data, size); break;
@@ -78,6 +79,7 @@ bool PointerWrap::ExpectVoid(void *data, int size) {
 }
 
 void PointerWrap::DoVoid(void *data, int size) {
+	CheckWriteSpace(size);
 	switch (mode) {
 	case MODE_READ:	memcpy(data, *ptr, size); break;
 	case MODE_WRITE: memcpy(*ptr, data, size); break;
@@ -95,6 +97,7 @@ void PointerWrap::Do(std::string &x) {
 	int stringLen = (int)x.length() + 1;
 	Do(stringLen);
 
+	CheckWriteSpace(stringLen);
 	switch (mode) {
 	case MODE_READ:		x = (char*)*ptr; break;
 	case MODE_WRITE:	memcpy(*ptr, x.c_str(), stringLen); break;
@@ -108,6 +111,7 @@ void PointerWrap::Do(std::wstring &x) {
 	int stringLen = sizeof(wchar_t)*((int)x.length() + 1);
 	Do(stringLen);
 
+	CheckWriteSpace(stringLen);
 	switch (mode) {
 	case MODE_READ:		x = (wchar_t*)*ptr; break;
 	case MODE_WRITE:	memcpy(*ptr, x.c_str(), stringLen); break;
@@ -133,10 +133,27 @@ class PointerWrap
 	Mode mode;
 	Error error;
 
+private:
+	// Only used in MODE_WRITE, see SetWriteLimit().
+	u8 *writeEnd_ = nullptr;
+	bool writeOverflowed_ = false;
+
+	inline void CheckWriteSpace(int size) {
+		if (writeEnd_ && mode == MODE_WRITE && *ptr + size > writeEnd_) {
+			// Keep going to find out the full size, but stop writing.
+			writeOverflowed_ = true;
+			mode = MODE_MEASURE;
+		}
+	}
+
 public:
 	PointerWrap(u8 **ptr_, Mode mode_) : ptr(ptr_), mode(mode_), error(ERROR_NONE) {}
 	PointerWrap(unsigned char **ptr_, int mode_) : ptr((u8**)ptr_), mode((Mode)mode_), error(ERROR_NONE) {}
 
+	// When writing into a fixed size buffer.  If it doesn't fit, the rest is only measured.
+	void SetWriteLimit(u8 *end) { writeEnd_ = end; }
+	bool WriteOverflowed() const { return writeOverflowed_; }
+
 	PointerWrapSection Section(const char *title, int ver);
 
 	// The returned object can be compared against the version that was loaded.
@@ -617,6 +634,26 @@ class CChunkFileReader
 		}
 	}
 
+	// Saves without measuring first, into at most size bytes at ptr.  Sets *used to the full size either way.
+	// Returns ERROR_BAD_ALLOC if it didn't fit, in which case the contents are garbage.
+	template<class T>
+	static Error SavePtr(u8 *ptr, T &_class, size_t size, size_t *used)
+	{
+		u8 *const start = ptr;
+		PointerWrap p(&ptr, PointerWrap::MODE_WRITE);
+		p.SetWriteLimit(start + size);
+		_class.DoState(p);
+		*used = ptr - start;
+
+		if (p.error == p.ERROR_FAILURE) {
+			return ERROR_BROKEN_STATE;
+		} else if (p.WriteOverflowed()) {
+			return ERROR_BAD_ALLOC;
+		} else {
+			return ERROR_NONE;
+		}
+	}
+
 	// Load file template
 	template<class T>
 	static Error Load(const std::string &filename, const char *gitVersion, T& _class, std::string *failureReason)
@@ -0,0 +1,175 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <thread>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Spins, then yields, then sleeps, for waiting on something another thread will do soon.
+class SpinBackoff {
+public:
+	void Wait() {
+		if (count_ < SPIN_COUNT) {
+			for (int i = 0; i < (1 << count_); ++i)
+				Pause();
+		} else if (count_ < SPIN_COUNT + YIELD_COUNT) {
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+		if (count_ < SPIN_COUNT + YIELD_COUNT)
+			count_++;
+	}
+
+	// Once spinning and yielding haven't helped, it's time to block on something instead.
+	bool Exhausted() const {
+		return count_ >= SPIN_COUNT + YIELD_COUNT;
+	}
+
+	void Reset() {
+		count_ = 0;
+	}
+
+private:
+	enum { SPIN_COUNT = 7, YIELD_COUNT = 16 };
+
+	static void Pause() {
+#if defined(_M_IX86) || defined(_M_X64)
+		_mm_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH_7A__)))
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	int count_ = 0;
+};
+
+// Bounded multiple producer, single consumer queue.
+// Any number of threads may push, and exactly one thread may pop, no locks are taken.
+// Each slot has a sequence number saying whose turn it is, so producers only contend on claiming
+// an index, and the consumer never touches the index producers fight over.
+// N must be a power of two.  T needn't be default constructible.
+template <typename T, size_t N>
+class MPSCQueue {
+public:
+	MPSCQueue() : head_(0), tail_(0) {
+		static_assert((N & (N - 1)) == 0, "MPSCQueue size must be a power of two");
+		for (size_t i = 0; i < N; ++i)
+			slots_[i].seq.store(i, std::memory_order_relaxed);
+	}
+	~MPSCQueue() {
+		clear();
+	}
+
+	// Any thread.  Returns false if full.
+	bool push(const T &v) {
+		size_t pos = tail_.load(std::memory_order_relaxed);
+		Slot *slot;
+		for (;;) {
+			slot = &slots_[pos & (N - 1)];
+			const size_t seq = slot->seq.load(std::memory_order_acquire);
+			const ptrdiff_t diff = (ptrdiff_t)(seq - pos);
+			if (diff == 0) {
+				// Our turn for this slot, if nobody else claims it first.
+				if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				// Still holds a value from the last lap, which the consumer hasn't taken.
+				return false;
+			} else {
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+
+		new (slot->Value()) T(v);
+		slot->seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Any thread.  Waits (without locking) for the consumer to make room.
+	void push_wait(const T &v) {
+		SpinBackoff backoff;
+		while (!push(v))
+			backoff.Wait();
+	}
+
+	// Consumer only.  Returns false if empty, or if the next value is still being written.
+	bool pop(T &v) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+		Slot &slot = slots_[head & (N - 1)];
+		if (slot.seq.load(std::memory_order_acquire) != head + 1)
+			return false;
+		T *value = slot.Value();
+		v = *value;
+		value->~T();
+		// Free for the producer one lap ahead.
+		slot.seq.store(head + N, std::memory_order_release);
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Either side may call these, but the answer may be stale by the time it's used.
+	// A push that has claimed a slot but not finished counts, even though pop() can't get it yet.
+	bool empty() const {
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+	size_t size() const {
+		const size_t head = head_.load(std::memory_order_acquire);
+		const size_t tail = tail_.load(std::memory_order_acquire);
+		return tail - head;
+	}
+	static constexpr size_t capacity() {
+		return N;
+	}
+
+	// Only safe when no thread is pushing or popping.
+	void clear() {
+		size_t head = head_.load(std::memory_order_relaxed);
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		for (; head != tail; ++head)
+			slots_[head & (N - 1)].Value()->~T();
+		for (size_t i = 0; i < N; ++i)
+			slots_[i].seq.store(i, std::memory_order_relaxed);
+		head_.store(0, std::memory_order_relaxed);
+		tail_.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	enum { CACHE_LINE = 64 };
+
+	struct Slot {
+		std::atomic<size_t> seq;
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		T *Value() {
+			return reinterpret_cast<T *>(storage);
+		}
+	};
+
+	// Keep the indices on separate cache lines so producers don't slow down the consumer.
+	alignas(CACHE_LINE) std::atomic<size_t> head_;
+	alignas(CACHE_LINE) std::atomic<size_t> tail_;
+	alignas(CACHE_LINE) Slot slots_[N];
+};
@@ -45,7 +45,14 @@ class MemArena {
 	u8 *Find4GBBase();
 	bool NeedsProbing();
 
+	// Asks for the arena to be backed by (transparent) huge pages, before GrabLowMemSpace.
+	// Only Linux does anything with it for now.
+	void SetHugePages(bool enable) {
+		hugePages = enable;
+	}
+
 private:
+	bool hugePages = false;
 #ifdef _WIN32
 	HANDLE hMemoryMapping;
 	SYSTEM_INFO sysInfo;
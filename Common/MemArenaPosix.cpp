@@ -29,23 +29,79 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <cerrno>
+#include <cstdio>
 #include <cstring>
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(SYS_memfd_create) && defined(MADV_HUGEPAGE)
+#define HAVE_SHMEM_HUGE_PAGES
+#endif
+
 static const std::string tmpfs_location = "/dev/shm";
 static const std::string tmpfs_ram_temp_file = "/dev/shm/gc_mem.tmp";
 
 // do not make this "static"
 std::string ram_temp_file = "/tmp/gc_mem.tmp";
 
+// PMD sized, on x86-64 and on arm64 with 4 KB pages anyway.
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
 size_t MemArena::roundup(size_t x) {
+	// Keeps file offsets lined up with the (aligned) view addresses, which huge pages need.
+	if (hugePages)
+		return (x + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
 	return x;
 }
 
+#ifdef HAVE_SHMEM_HUGE_PAGES
+static const char *const memfd_name = "ppsspp_mem";
+
+static int OpenHugePageMemory() {
+	// A file in /dev/shm only gets huge pages if that tmpfs was mounted with huge=.  A memfd lives on the
+	// kernel's internal mount instead, which follows shmem_enabled, and honors madvise there when it's "advise".
+	char policy[64] = "unknown";
+	FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/shmem_enabled", "r");
+	if (fp) {
+		if (!fgets(policy, sizeof(policy), fp))
+			strcpy(policy, "unknown");
+		fclose(fp);
+		policy[strcspn(policy, "\n")] = '\0';
+	}
+	if (strstr(policy, "[never]") || strstr(policy, "[deny]")) {
+		WARN_LOG(MEMMAP, "Huge pages requested, but shmem huge pages are disabled: %s", policy);
+		return -1;
+	}
+
+	int fd = (int)syscall(SYS_memfd_create, memfd_name, 0);
+	if (fd < 0) {
+		WARN_LOG(MEMMAP, "memfd_create failed (errno: %d), not using huge pages", (int)errno);
+		return -1;
+	}
+	INFO_LOG(MEMMAP, "Backing memory with huge pages where possible, shmem_enabled: %s", policy);
+	return fd;
+}
+#endif
+
 bool MemArena::NeedsProbing() {
 	return false;
 }
 
 void MemArena::GrabLowMemSpace(size_t size) {
+#ifdef HAVE_SHMEM_HUGE_PAGES
+	if (hugePages) {
+		fd = OpenHugePageMemory();
+		if (fd >= 0) {
+			if (ftruncate(fd, size) != 0) {
+				ERROR_LOG(MEMMAP, "Failed to ftruncate %d (memfd:%s) to size %08x", (int)fd, memfd_name, (int)size);
+			}
+			return;
+		}
+	}
+#endif
+
 	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 
 	// Some platforms (like Raspberry Pi) end up flushing to disk.
@@ -93,6 +149,12 @@ void *MemArena::CreateView(s64 offset, size_t size, void *base)
 		NOTICE_LOG(MEMMAP, "mmap on %s (fd: %d) failed", ram_temp_file.c_str(), (int)fd);
 		return 0;
 	}
+#ifdef HAVE_SHMEM_HUGE_PAGES
+	// The parts of the view that aren't 2 MB aligned (like the scratchpad) just stay small pages.
+	if (hugePages && madvise(retval, size, MADV_HUGEPAGE) != 0) {
+		DEBUG_LOG(MEMMAP, "madvise(MADV_HUGEPAGE) on view at %p failed (errno: %d)", retval, (int)errno);
+	}
+#endif
 	return retval;
 }
 
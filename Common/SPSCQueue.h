@@ -0,0 +1,77 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded single producer, single consumer queue.
+// Exactly one thread may push and exactly one thread may pop, no locks are taken.
+// N must be a power of two.
+template <typename T, size_t N>
+class SPSCQueue {
+public:
+	SPSCQueue() : head_(0), tail_(0) {
+		static_assert((N & (N - 1)) == 0, "SPSCQueue size must be a power of two");
+	}
+
+	// Producer only.  Returns false if full.
+	bool push(const T &v) {
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_.load(std::memory_order_acquire) >= N)
+			return false;
+		storage_[tail & (N - 1)] = v;
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only.  Returns false if empty.
+	bool pop(T &v) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+		v = storage_[head & (N - 1)];
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Either side may call these, but the answer may be stale by the time it's used.
+	bool empty() const {
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+	size_t size() const {
+		return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+	}
+	static constexpr size_t capacity() {
+		return N;
+	}
+
+	// Only safe when neither side is active.
+	void clear() {
+		head_.store(0, std::memory_order_relaxed);
+		tail_.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	enum { CACHE_LINE = 64 };
+
+	// Keep the indices on separate cache lines so producer and consumer don't fight over them.
+	alignas(CACHE_LINE) std::atomic<size_t> head_;
+	alignas(CACHE_LINE) std::atomic<size_t> tail_;
+	alignas(CACHE_LINE) T storage_[N];
+};
@@ -129,9 +129,14 @@ struct Config {
 	bool bFuncReplacements;
 	bool bHideSlowWarnings;
 	bool bPreloadFunctions;
+	bool bJitWriteProtect;
+	// Back PSP memory with huge pages where the OS allows (Linux only), for fewer TLB misses.
+	bool bHugePageMemory;
 
 	bool bSeparateSASThread;
+	bool bParallelSASVoices;
 	bool bSeparateIOThread;
+	int iIOThreadCount;
 	int iIOTimingMethod;
 	int iLockedCPUSpeed;
 	bool bAutoSaveSymbolMap;
@@ -171,6 +176,9 @@ struct Config {
 	int iFrameSkip;
 	bool bAutoFrameSkip;
 	bool bFrameSkipUnthrottle;
+	// Unthrottled, only draws one frame in iTurboRenderInterval, and skips audio mixing.
+	bool bTurboUnthrottle;
+	int iTurboRenderInterval;
 
 	bool bEnableCardboard; // Cardboard Master Switch
 	int iCardboardScreenSize; // Screen Size (in %)
@@ -185,6 +193,7 @@ struct Config {
 	bool bVertexCache;
 	bool bTextureBackoffCache;
 	bool bTextureSecondaryCache;
+	bool bDisplayListBlockCache;
 	bool bVertexDecoderJit;
 	bool bFullScreen;
 	bool bFullScreenMulti;
@@ -202,6 +211,7 @@ struct Config {
 	int iMaxRecent;
 	int iCurrentStateSlot;
 	int iRewindFlipFrequency;
+	int iRunAheadFrames;
 	bool bEnableStateUndo;
 	bool bEnableAutoLoad;
 	bool bEnableCheats;
@@ -267,6 +277,7 @@ struct Config {
 	bool bShowDebugStats;
 	bool bShowAudioDebug;
 	bool bAudioResampler;
+	bool bSincResampler;
 
 	//Analog stick tilting
 	//the base x and y tilt. this inclination is treated as (0,0) and the tilt input
@@ -454,6 +465,8 @@ struct Config {
 	// Double edged sword: much easier debugging, but not accurate.
 	bool bSkipDeadbeefFilling;
 	bool bFuncHashMap;
+	// How many frames a GE dump records, from the debugger or the dev menu.
+	int iGEDumpFrames;
 
 	// Volatile development settings
 	bool bShowFrameProfiler;
@@ -43,7 +43,7 @@ enum class CPUCore;
 
 // PSP_CoreParameter()
 struct CoreParameter {
-	CoreParameter() : thin3d(nullptr), collectEmuLog(0), unthrottle(false), fpsLimit(0), updateRecent(true), freezeNext(false), frozen(false), mountIsoLoader(nullptr) {}
+	CoreParameter() : thin3d(nullptr), collectEmuLog(0), unthrottle(false), fpsLimit(0), updateRecent(true), freezeNext(false), frozen(false), keepCachesOnLoad(false), mountIsoLoader(nullptr) {}
 
 	CPUCore cpuCore;
 	GPUCore gpuCore;
@@ -80,6 +80,9 @@ struct CoreParameter {
 	bool freezeNext;
 	bool frozen;
 
+	// While restoring a snapshot from moments ago (run-ahead), so the jit and GPU caches are kept.
+	bool keepCachesOnLoad;
+
 	FileLoader *mountIsoLoader;
 
 	Compatibility compat;
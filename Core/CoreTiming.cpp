@@ -18,13 +18,12 @@
 
 #include <vector>
 #include <cstdio>
-#include <mutex>
 
 #include "base/logging.h"
 #include "profiler/profiler.h"
 
 #include "Common/MsgHandler.h"
-#include "Common/Atomics.h"
+#include "Common/MPSCQueue.h"
 #include "Core/CoreTiming.h"
 #include "Core/Core.h"
 #include "Core/Config.h"
@@ -67,15 +66,11 @@ struct BaseEvent
 typedef LinkedListItem<BaseEvent> Event;
 
 Event *first;
-Event *tsFirst;
-Event *tsLast;
+// Scheduled from other threads, moved into the main list (in order) on the CPU thread.
+static MPSCQueue<BaseEvent, 256> tsEvents;
 
 // event pools
 Event *eventPool = 0;
-Event *eventTsPool = 0;
-int allocatedTsEvents = 0;
-// Optimization to skip MoveEvents when possible.
-volatile u32 hasTsEvents = 0;
 
 // Downcount has been moved to currentMIPS, to save a couple of clocks in every ARM JIT block
 // as we can already reach that structure through a register.
@@ -86,8 +81,6 @@ s64 idledCycles;
 s64 lastGlobalTimeTicks;
 s64 lastGlobalTimeUs;
 
-static std::mutex externalEventLock;
-
 std::vector<MHzChangeCallback> mhzChangeCallbacks;
 
 void FireMhzChange() {
@@ -148,31 +141,12 @@ Event* GetNewEvent()
 	return ev;
 }
 
-Event* GetNewTsEvent()
-{
-	allocatedTsEvents++;
-
-	if(!eventTsPool)
-		return new Event;
-
-	Event* ev = eventTsPool;
-	eventTsPool = ev->next;
-	return ev;
-}
-
 void FreeEvent(Event* ev)
 {
 	ev->next = eventPool;
 	eventPool = ev;
 }
 
-void FreeTsEvent(Event* ev)
-{
-	ev->next = eventTsPool;
-	eventTsPool = ev;
-	allocatedTsEvents--;
-}
-
 int RegisterEvent(const char *name, TimedCallback callback)
 {
 	event_types.push_back(EventType(callback, name));
@@ -209,7 +183,6 @@ void Init()
 	idledCycles = 0;
 	lastGlobalTimeTicks = 0;
 	lastGlobalTimeUs = 0;
-	hasTsEvents = 0;
 	mhzChangeCallbacks.clear();
 }
 
@@ -225,14 +198,6 @@ void Shutdown()
 		eventPool = ev->next;
 		delete ev;
 	}
-
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	while(eventTsPool)
-	{
-		Event *ev = eventTsPool;
-		eventTsPool = ev->next;
-		delete ev;
-	}
 }
 
 u64 GetTicks()
@@ -250,19 +215,12 @@ u64 GetIdleTicks()
 // schedule things to be executed on the main thread.
 void ScheduleEvent_Threadsafe(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	Event *ne = GetNewTsEvent();
-	ne->time = GetTicks() + cyclesIntoFuture;
-	ne->type = event_type;
-	ne->next = 0;
-	ne->userdata = userdata;
-	if(!tsFirst)
-		tsFirst = ne;
-	if(tsLast)
-		tsLast->next = ne;
-	tsLast = ne;
-
-	Common::AtomicStoreRelease(hasTsEvents, 1);
+	BaseEvent ev;
+	ev.time = GetTicks() + cyclesIntoFuture;
+	ev.type = event_type;
+	ev.userdata = userdata;
+	// Only waits if the CPU thread has a lot of catching up to do.
+	tsEvents.push_wait(ev);
 }
 
 // Same as ScheduleEvent_Threadsafe(0, ...) EXCEPT if we are already on the CPU thread
@@ -271,7 +229,6 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 {
 	if(false) //Core::IsCPUThread())
 	{
-		std::lock_guard<std::mutex> lk(externalEventLock);
 		event_types[event_type].callback(userdata, 0);
 	}
 	else
@@ -365,53 +322,9 @@ s64 UnscheduleEvent(int event_type, u64 userdata)
 
 s64 UnscheduleThreadsafeEvent(int event_type, u64 userdata)
 {
-	s64 result = 0;
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	if (!tsFirst)
-		return result;
-	while(tsFirst)
-	{
-		if (tsFirst->type == event_type && tsFirst->userdata == userdata)
-		{
-			result = tsFirst->time - GetTicks();
-
-			Event *next = tsFirst->next;
-			FreeTsEvent(tsFirst);
-			tsFirst = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!tsFirst)
-	{
-		tsLast = NULL;
-		return result;
-	}
-
-	Event *prev = tsFirst;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type && ptr->userdata == userdata)
-		{
-			result = ptr->time - GetTicks();
-
-			prev->next = ptr->next;
-			if (ptr == tsLast)
-				tsLast = prev;
-			FreeTsEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
-
-	return result;
+	// They can't be picked out of the queue, but once moved they're just regular events.
+	MoveEvents();
+	return UnscheduleEvent(event_type, userdata);
 }
 
 void RegisterMHzChangeCallback(MHzChangeCallback callback) {
@@ -470,47 +383,8 @@ void RemoveEvent(int event_type)
 
 void RemoveThreadsafeEvent(int event_type)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	if (!tsFirst)
-	{
-		return;
-	}
-	while(tsFirst)
-	{
-		if (tsFirst->type == event_type)
-		{
-			Event *next = tsFirst->next;
-			FreeTsEvent(tsFirst);
-			tsFirst = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!tsFirst)
-	{
-		tsLast = NULL;
-		return;
-	}
-	Event *prev = tsFirst;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			if (ptr == tsLast)
-				tsLast = prev;
-			FreeTsEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+	MoveEvents();
+	RemoveEvent(event_type);
 }
 
 void RemoveAllEvents(int event_type)
@@ -542,26 +416,15 @@ void ProcessFifoWaitEvents()
 
 void MoveEvents()
 {
-	Common::AtomicStoreRelease(hasTsEvents, 0);
-
-	std::lock_guard<std::mutex> lk(externalEventLock);
 	// Move events from async queue into main queue
-	while (tsFirst)
-	{
-		Event *next = tsFirst->next;
-		AddEventToQueue(tsFirst);
-		tsFirst = next;
-	}
-	tsLast = NULL;
-
-	// Move free events to threadsafe pool
-	while(allocatedTsEvents > 0 && eventPool)
+	BaseEvent ev;
+	while (tsEvents.pop(ev))
 	{
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		ev->next = eventTsPool;
-		eventTsPool = ev;
-		allocatedTsEvents--;
+		Event *ne = GetNewEvent();
+		ne->time = ev.time;
+		ne->type = ev.type;
+		ne->userdata = ev.userdata;
+		AddEventToQueue(ne);
 	}
 }
 
@@ -586,9 +449,10 @@ void Advance()
 	globalTimer += cyclesExecuted;
 	currentMIPS->downcount = slicelength;
 
-	if (Common::AtomicLoadAcquire(hasTsEvents))
+	if (!tsEvents.empty())
 		MoveEvents();
 	ProcessFifoWaitEvents();
+	currentMIPS->InvalidateWrittenCode();
 
 	if (!first)
 	{
@@ -686,7 +550,17 @@ void Event_DoStateOld(PointerWrap &p, BaseEvent *ev)
 
 void DoState(PointerWrap &p)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
+	// Anything another thread scheduled either goes in with the rest, or is replaced by the state's.
+	if (p.mode == p.MODE_READ) {
+		BaseEvent ev;
+		while (tsEvents.pop(ev))
+			continue;
+	} else {
+		MoveEvents();
+	}
+	// Always empty when saving, but older states may have some.
+	Event *tsFirst = nullptr;
+	Event *tsLast = nullptr;
 
 	auto s = p.Section("CoreTiming", 1, 3);
 	if (!s)
@@ -699,10 +573,15 @@ void DoState(PointerWrap &p)
 
 	if (s >= 3) {
 		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(first, (Event **) NULL);
-		p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoState>(tsFirst, &tsLast);
+		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(tsFirst, &tsLast);
 	} else {
 		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoStateOld>(first, (Event **) NULL);
-		p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoStateOld>(tsFirst, &tsLast);
+		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoStateOld>(tsFirst, &tsLast);
+	}
+	while (tsFirst) {
+		Event *next = tsFirst->next;
+		AddEventToQueue(tsFirst);
+		tsFirst = next;
 	}
 
 	p.Do(CPU_HZ);
@@ -31,6 +31,7 @@
 #include "Core/HW/MemoryStick.h"
 #include "Core/CoreTiming.h"
 #include "Core/Host.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 #include "Core/Replay.h"
 #include "Core/Reporting.h"
 
@@ -330,11 +331,15 @@ size_t DirectoryFileHandle::Read(u8* pointer, s64 size)
 			size = needsTrunc_ - off;
 		}
 	}
+	{
+		// The pointer is usually PSP RAM, which may hold write protected code.
+		JitPageProtect::HostWriteScope hostWrite(pointer, (size_t)size);
 #ifdef _WIN32
-	::ReadFile(hFile, (LPVOID)pointer, (DWORD)size, (LPDWORD)&bytesRead, 0);
+		::ReadFile(hFile, (LPVOID)pointer, (DWORD)size, (LPDWORD)&bytesRead, 0);
 #else
-	bytesRead = read(hFile, pointer, size);
+		bytesRead = read(hFile, pointer, size);
 #endif
+	}
 	return replay_ ? ReplayApplyDiskRead(pointer, (uint32_t)bytesRead, (uint32_t)size, CoreTiming::GetGlobalTimeUs()) : bytesRead;
 }
 
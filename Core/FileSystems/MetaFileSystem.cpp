@@ -22,6 +22,7 @@
 #include "Common/StringUtils.h"
 #include "Core/FileSystems/MetaFileSystem.h"
 #include "Core/HLE/sceKernelThread.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
 
@@ -164,6 +165,15 @@ static bool RealPath(const std::string &currentDirectory, const std::string &inP
 	return true;
 }
 
+std::recursive_mutex &MetaFileSystem::SystemLock(IFileSystem *system)
+{
+	// Caller holds lock.  Map nodes don't move, so the reference stays valid.
+	std::unique_ptr<std::recursive_mutex> &sysLock = systemLocks[system];
+	if (!sysLock)
+		sysLock.reset(new std::recursive_mutex());
+	return *sysLock;
+}
+
 IFileSystem *MetaFileSystem::GetHandleOwner(u32 handle)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
@@ -328,6 +338,7 @@ void MetaFileSystem::Shutdown()
 	}
 
 	fileSystems.clear();
+	systemLocks.clear();
 	currentDir.clear();
 	startingDirectory = "";
 }
@@ -348,6 +359,7 @@ u32 MetaFileSystem::OpenFile(std::string filename, FileAccess access, const char
 	MountPoint *mount;
 	if (MapFilePath(filename, of, &mount))
 	{
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(mount->system));
 		s32 res = mount->system->OpenFile(of, access, mount->prefix.c_str());
 		if (res < 0)
 		{
@@ -369,6 +381,7 @@ PSPFileInfo MetaFileSystem::GetFileInfo(std::string filename)
 	IFileSystem *system;
 	if (MapFilePath(filename, of, &system))
 	{
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(system));
 		return system->GetFileInfo(of);
 	}
 	else
@@ -384,6 +397,7 @@ bool MetaFileSystem::GetHostPath(const std::string &inpath, std::string &outpath
 	std::string of;
 	IFileSystem *system;
 	if (MapFilePath(inpath, of, &system)) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(system));
 		return system->GetHostPath(of, outpath);
 	} else {
 		return false;
@@ -397,6 +411,7 @@ std::vector<PSPFileInfo> MetaFileSystem::GetDirListing(std::string path)
 	IFileSystem *system;
 	if (MapFilePath(path, of, &system))
 	{
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(system));
 		return system->GetDirListing(of);
 	}
 	else
@@ -454,6 +469,7 @@ bool MetaFileSystem::MkDir(const std::string &dirname)
 	IFileSystem *system;
 	if (MapFilePath(dirname, of, &system))
 	{
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(system));
 		return system->MkDir(of);
 	}
 	else
@@ -469,6 +485,7 @@ bool MetaFileSystem::RmDir(const std::string &dirname)
 	IFileSystem *system;
 	if (MapFilePath(dirname, of, &system))
 	{
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(system));
 		return system->RmDir(of);
 	}
 	else
@@ -501,6 +518,7 @@ int MetaFileSystem::RenameFile(const std::string &from, const std::string &to)
 		if (osystem != rsystem)
 			return SCE_KERNEL_ERROR_XDEV;
 
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(osystem));
 		return osystem->RenameFile(of, rf);
 	}
 	else
@@ -516,6 +534,7 @@ bool MetaFileSystem::RemoveFile(const std::string &filename)
 	IFileSystem *system;
 	if (MapFilePath(filename, of, &system))
 	{
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(system));
 		return system->RemoveFile(of);
 	}
 	else
@@ -528,8 +547,10 @@ int MetaFileSystem::Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 out
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(sys));
 		return sys->Ioctl(handle, cmd, indataPtr, inlen, outdataPtr, outlen, usec);
+	}
 	return SCE_KERNEL_ERROR_ERROR;
 }
 
@@ -537,8 +558,10 @@ int MetaFileSystem::DevType(u32 handle)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(sys));
 		return sys->DevType(handle);
+	}
 	return SCE_KERNEL_ERROR_ERROR;
 }
 
@@ -546,58 +569,81 @@ void MetaFileSystem::CloseFile(u32 handle)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(sys));
 		sys->CloseFile(handle);
+	}
 }
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(sys));
+		// Reads from disc images may also go straight from the host file into PSP RAM.
+		JitPageProtect::HostWriteScope hostWrite(pointer, (size_t)size);
 		return sys->ReadFile(handle, pointer, size);
-	else
+	} else {
 		return 0;
+	}
 }
 
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(sys));
 		return sys->WriteFile(handle, pointer, size);
-	else
+	} else {
 		return 0;
+	}
 }
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
+	std::unique_lock<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		// This is the path the IO threads use.  Only hold this file system's lock while
+		// transferring, so operations on other file systems don't wait behind us.
+		std::recursive_mutex &sysLock = SystemLock(sys);
+		guard.unlock();
+		std::lock_guard<std::recursive_mutex> sysGuard(sysLock);
+		JitPageProtect::HostWriteScope hostWrite(pointer, (size_t)size);
 		return sys->ReadFile(handle, pointer, size, usec);
-	else
+	} else {
 		return 0;
+	}
 }
 
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
+	std::unique_lock<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		// This is the path the IO threads use.  Only hold this file system's lock while
+		// transferring, so operations on other file systems don't wait behind us.
+		std::recursive_mutex &sysLock = SystemLock(sys);
+		guard.unlock();
+		std::lock_guard<std::recursive_mutex> sysGuard(sysLock);
 		return sys->WriteFile(handle, pointer, size, usec);
-	else
+	} else {
 		return 0;
+	}
 }
 
 size_t MetaFileSystem::SeekFile(u32 handle, s32 position, FileMove type)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
+	if (sys) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(sys));
 		return sys->SeekFile(handle,position,type);
-	else
+	} else {
 		return 0;
+	}
 }
 
 int MetaFileSystem::ReadEntireFile(const std::string &filename, std::vector<u8> &data) {
@@ -622,10 +668,12 @@ u64 MetaFileSystem::FreeSpace(const std::string &path)
 	std::lock_guard<std::recursive_mutex> guard(lock);
 	std::string of;
 	IFileSystem *system;
-	if (MapFilePath(path, of, &system))
+	if (MapFilePath(path, of, &system)) {
+		std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(system));
 		return system->FreeSpace(of);
-	else
+	} else {
 		return 0;
+	}
 }
 
 void MetaFileSystem::DoState(PointerWrap &p)
@@ -657,6 +705,7 @@ void MetaFileSystem::DoState(PointerWrap &p)
 
 	for (u32 i = 0; i < n; ++i) {
 		if (!skipPfat0 || fileSystems[i].prefix != "pfat0:") {
+			std::lock_guard<std::recursive_mutex> sysGuard(SystemLock(fileSystems[i].system));
 			fileSystems[i].system->DoState(p);
 		}
 	}
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <mutex>
@@ -43,6 +45,11 @@ class MetaFileSystem : public IHandleAllocator, public IFileSystem {
 	std::string startingDirectory;
 	int lastOpenError;
 	std::recursive_mutex lock;  // must be recursive
+	// Taken after lock, and held while calling into each IFileSystem, which aren't thread safe.
+	// Separate so that async IO on one file system can overlap with others.
+	std::map<IFileSystem *, std::unique_ptr<std::recursive_mutex>> systemLocks;
+
+	std::recursive_mutex &SystemLock(IFileSystem *system);
 
 public:
 	MetaFileSystem() {
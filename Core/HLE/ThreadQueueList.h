@@ -17,154 +17,137 @@
 
 #pragma once
 
+#include <vector>
+
 #include "Core/HLE/sceKernel.h"
+#include "Common/BitSet.h"
 #include "Common/ChunkFile.h"
 
+// Ready queue for the thread scheduler.
+// A bitmap of non-empty priorities finds the best thread with a bit scan, and each thread
+// links to its neighbours by id, so every operation is O(1).
 struct ThreadQueueList {
 	// Number of queues (number of priority levels starting at 0.)
 	static const int NUM_QUEUES = 128;
-	// Initial number of threads a single queue can handle.
+	// Only used for savestates now, which store a capacity per priority.
 	static const int INITIAL_CAPACITY = 32;
 
 	struct Queue {
-		// Next ever-been-used queue (worse priority.)
-		Queue *next;
-		// First valid item in data.
-		int first;
-		// One after last valid item in data.
-		int end;
-		// A too-large array with room on the front and end.
-		SceUID *data;
-		// Size of data array.
-		int capacity;
+		// First and last thread in this priority, 0 if none.
+		SceUID head;
+		SceUID tail;
+		int count;
+		// Whether prepare() was called, for savestates.
+		bool prepared;
 
 		inline int size() const {
-			return end - first;
+			return count;
 		}
 		inline bool empty() const {
-			return first == end;
-		}
-		inline int full() const {
-			return end == capacity;
+			return count == 0;
 		}
 	};
 
 	ThreadQueueList() {
-		memset(queues, 0, sizeof(queues));
-		first = invalid();
-	}
-
-	~ThreadQueueList() {
 		clear();
 	}
 
 	// Only for debugging, returns priority level.
 	int contains(const SceUID uid) {
-		for (int i = 0; i < NUM_QUEUES; ++i) {
-			if (queues[i].data == nullptr)
-				continue;
-
-			Queue *cur = &queues[i];
-			for (int j = cur->first; j < cur->end; ++j) {
-				if (cur->data[j] == uid)
-					return i;
-			}
-		}
-
-		return -1;
+		if (uid <= 0 || uid >= (SceUID)nodes.size())
+			return -1;
+		return nodes[uid].priority;
 	}
 
 	inline SceUID pop_first() {
-		Queue *cur = first;
-		while (cur != invalid()) {
-			if (cur->size() > 0)
-				return cur->data[cur->first++];
-			cur = cur->next;
-		}
+		int priority = first_priority();
+		if (priority >= 0)
+			return pop_head(priority);
 
 		_dbg_assert_msg_(SCEKERNEL, false, "ThreadQueueList should not be empty.");
 		return 0;
 	}
 
 	inline SceUID pop_first_better(u32 priority) {
-		Queue *cur = first;
-		// Don't bother looking past (worse than) this priority.
-		Queue *stop = &queues[priority];
-		while (cur < stop) {
-			if (cur->size() > 0)
-				return cur->data[cur->first++];
-			cur = cur->next;
-		}
-
+		int best = first_priority();
+		// Don't bother with anything worse than (or equal to) this priority.
+		if (best >= 0 && best < (int)priority)
+			return pop_head(best);
 		return 0;
 	}
 
 	inline SceUID peek_first() {
-		Queue *cur = first;
-		while (cur != invalid()) {
-			if (cur->size() > 0)
-				return cur->data[cur->first];
-			cur = cur->next;
-		}
-
+		int priority = first_priority();
+		if (priority >= 0)
+			return queues[priority].head;
 		return 0;
 	}
 
 	inline void push_front(u32 priority, const SceUID threadID) {
 		Queue *cur = &queues[priority];
-		cur->data[--cur->first] = threadID;
-		// If we ran out of room toward the front, add more room for next time.
-		if (cur->first == 0)
-			rebalance(priority);
+		Node &node = node_for(threadID);
+		_dbg_assert_msg_(SCEKERNEL, node.priority == -1, "ThreadQueueList: thread already queued.");
+
+		node.priority = (s16)priority;
+		node.prev = 0;
+		node.next = cur->head;
+		if (cur->head != 0)
+			nodes[cur->head].prev = threadID;
+		else
+			cur->tail = threadID;
+		cur->head = threadID;
+		if (cur->count++ == 0)
+			set_ready(priority);
 	}
 
 	inline void push_back(u32 priority, const SceUID threadID) {
 		Queue *cur = &queues[priority];
-		cur->data[cur->end++] = threadID;
-		if (cur->full())
-			rebalance(priority);
+		Node &node = node_for(threadID);
+		_dbg_assert_msg_(SCEKERNEL, node.priority == -1, "ThreadQueueList: thread already queued.");
+
+		node.priority = (s16)priority;
+		node.next = 0;
+		node.prev = cur->tail;
+		if (cur->tail != 0)
+			nodes[cur->tail].next = threadID;
+		else
+			cur->head = threadID;
+		cur->tail = threadID;
+		if (cur->count++ == 0)
+			set_ready(priority);
 	}
 
 	inline void remove(u32 priority, const SceUID threadID) {
-		Queue *cur = &queues[priority];
-		_dbg_assert_msg_(SCEKERNEL, cur->next != nullptr, "ThreadQueueList::Queue should already be linked up.");
-
-		for (int i = cur->first; i < cur->end; ++i) {
-			if (cur->data[i] == threadID) {
-				// How many more after this one?
-				int remaining = cur->end - i;
-				// If there are more, move them into place.
-				if (remaining > 0)
-					memmove(&cur->data[i], &cur->data[i + 1], remaining * sizeof(SceUID));
-
-				// Now we're one shorter.
-				--cur->end;
-				return;
-			}
-		}
+		_dbg_assert_msg_(SCEKERNEL, queues[priority].prepared, "ThreadQueueList::Queue should already be prepared.");
 
 		// Wasn't there.
+		if (contains(threadID) != (int)priority)
+			return;
+		unlink(priority, threadID);
 	}
 
 	inline void rotate(u32 priority) {
 		Queue *cur = &queues[priority];
-		_dbg_assert_msg_(SCEKERNEL, cur->next != nullptr, "ThreadQueueList::Queue should already be linked up.");
+		_dbg_assert_msg_(SCEKERNEL, cur->prepared, "ThreadQueueList::Queue should already be prepared.");
 
-		if (cur->size() > 1) {
+		if (cur->count > 1) {
 			// Grab the front and push it on the end.
-			cur->data[cur->end++] = cur->data[cur->first++];
-			if (cur->full())
-				rebalance(priority);
+			SceUID front = cur->head;
+			unlink(priority, front);
+			push_back(priority, front);
 		}
 	}
 
 	inline void clear() {
 		for (int i = 0; i < NUM_QUEUES; ++i) {
-			if (queues[i].data != nullptr)
-				free(queues[i].data);
+			queues[i].head = 0;
+			queues[i].tail = 0;
+			queues[i].count = 0;
+			queues[i].prepared = false;
 		}
-		memset(queues, 0, sizeof(queues));
-		first = invalid();
+		for (int i = 0; i < BITMAP_WORDS; ++i)
+			bitmap[i] = 0;
+		nodes.clear();
 	}
 
 	inline bool empty(u32 priority) const {
@@ -173,9 +156,7 @@ struct ThreadQueueList {
 	}
 
 	inline void prepare(u32 priority) {
-		Queue *cur = &queues[priority];
-		if (cur->next == nullptr)
-			link(priority, INITIAL_CAPACITY);
+		queues[priority].prepared = true;
 	}
 
 	void DoState(PointerWrap &p) {
@@ -194,96 +175,110 @@ struct ThreadQueueList {
 		if (p.mode == p.MODE_READ)
 			clear();
 
+		std::vector<SceUID> ids;
 		for (int i = 0; i < NUM_QUEUES; ++i) {
 			Queue *cur = &queues[i];
 			int size = cur->size();
 			p.Do(size);
-			int capacity = cur->capacity;
+			// Same layout as the old array based queues: enough room to center the items.
+			int capacity = 0;
+			if (cur->prepared || size != 0) {
+				capacity = INITIAL_CAPACITY;
+				while (capacity < size + 2)
+					capacity *= 2;
+			}
 			p.Do(capacity);
 
 			if (capacity == 0)
 				continue;
 
-			if (p.mode == p.MODE_READ) {
-				link(i, capacity);
-				cur->first = (cur->capacity - size) / 2;
-				cur->end = cur->first + size;
+			if (p.mode == p.MODE_READ)
+				cur->prepared = true;
+
+			if (size != 0) {
+				ids.resize(size);
+				if (p.mode != p.MODE_READ) {
+					SceUID id = cur->head;
+					for (int j = 0; j < size; ++j, id = nodes[id].next)
+						ids[j] = id;
+				}
+				p.DoArray(&ids[0], size);
+				if (p.mode == p.MODE_READ) {
+					for (int j = 0; j < size; ++j)
+						push_back(i, ids[j]);
+				}
 			}
-
-			if (size != 0)
-				p.DoArray(&cur->data[cur->first], size);
 		}
 	}
 
 private:
-	Queue *invalid() const {
-		return (Queue *)-1;
-	}
+	enum { BITMAP_WORDS = NUM_QUEUES / 32 };
 
-	// Initialize a priority level and link to other queues.
-	void link(u32 priority, int size) {
-		_dbg_assert_msg_(SCEKERNEL, queues[priority].data == nullptr, "ThreadQueueList::Queue should only be initialized once.");
-
-		// Make sure we stay a multiple of INITIAL_CAPACITY.
-		if (size <= INITIAL_CAPACITY)
-			size = INITIAL_CAPACITY;
-		else {
-			int goal = size;
-			size = INITIAL_CAPACITY;
-			while (size < goal)
-				size *= 2;
-		}
+	struct Node {
+		SceUID prev;
+		SceUID next;
+		// -1 when not queued.
+		s16 priority;
+	};
 
-		// Allocate the queue.
-		Queue *cur = &queues[priority];
-		cur->data = (SceUID *)malloc(sizeof(SceUID) * size);
-		cur->capacity = size;
-		// Start smack in the middle so it can move both directions.
-		cur->first = size / 2;
-		cur->end = size / 2;
-
-		for (int i = (int)priority - 1; i >= 0; --i) {
-			// This queue is before ours, and points past us.
-			// We'll have it point to our new queue, inserting into the chain.
-			if (queues[i].next != nullptr) {
-				cur->next = queues[i].next;
-				queues[i].next = cur;
-				return;
-			}
+	inline int first_priority() const {
+		for (int i = 0; i < BITMAP_WORDS; ++i) {
+			if (bitmap[i] != 0)
+				return i * 32 + LeastSignificantSetBit(bitmap[i]);
 		}
+		return -1;
+	}
 
-		// Never found above - that means there's no better queue yet.
-		// The new one is now first, and whoever was first is after it.
-		cur->next = first;
-		first = cur;
+	inline void set_ready(u32 priority) {
+		bitmap[priority / 32] |= 1U << (priority & 31);
 	}
 
-	// Move or allocate as necessary to maintain free space on both sides.
-	void rebalance(u32 priority) {
-		Queue *cur = &queues[priority];
-		int size = cur->size();
-		// Basically full.  Time for a larger queue?
-		if (size >= cur->capacity - 2) {
-			int new_capacity = cur->capacity * 2;
-			SceUID *new_data = (SceUID *)realloc(cur->data, new_capacity * sizeof(SceUID));
-			if (new_data != nullptr) {
-				// Success, it's bigger now.
-				cur->capacity = new_capacity;
-				cur->data = new_data;
-			}
-		}
+	inline void clear_ready(u32 priority) {
+		bitmap[priority / 32] &= ~(1U << (priority & 31));
+	}
 
-		// If we center all the items, it should start here.
-		int newFirst = (cur->capacity - size) / 2;
-		if (newFirst != cur->first) {
-			memmove(&cur->data[newFirst], &cur->data[cur->first], size * sizeof(SceUID));
-			cur->first = newFirst;
-			cur->end = newFirst + size;
+	// Thread ids are small (kernel object handles), so they index the nodes directly.
+	Node &node_for(SceUID threadID) {
+		_dbg_assert_msg_(SCEKERNEL, threadID > 0, "ThreadQueueList: invalid thread id.");
+		if (threadID >= (SceUID)nodes.size()) {
+			size_t newSize = nodes.empty() ? 512 : nodes.size();
+			while (newSize <= (size_t)threadID)
+				newSize *= 2;
+			Node unused = { 0, 0, -1 };
+			nodes.resize(newSize, unused);
 		}
+		return nodes[threadID];
+	}
+
+	inline SceUID pop_head(int priority) {
+		SceUID threadID = queues[priority].head;
+		unlink(priority, threadID);
+		return threadID;
+	}
+
+	void unlink(u32 priority, SceUID threadID) {
+		Queue *cur = &queues[priority];
+		Node &node = nodes[threadID];
+		if (node.prev != 0)
+			nodes[node.prev].next = node.next;
+		else
+			cur->head = node.next;
+		if (node.next != 0)
+			nodes[node.next].prev = node.prev;
+		else
+			cur->tail = node.prev;
+
+		node.prev = 0;
+		node.next = 0;
+		node.priority = -1;
+		if (--cur->count == 0)
+			clear_ready(priority);
 	}
 
-	// The first queue that's ever been used.
-	Queue *first;
 	// The priority level queues of thread ids.
 	Queue queues[NUM_QUEUES];
+	// Bit set for each priority with threads waiting, best priority in the lowest bit.
+	u32 bitmap[BITMAP_WORDS];
+	// Links between queued threads, indexed by thread id.
+	std::vector<Node> nodes;
 };
@@ -41,6 +41,7 @@
 #endif
 #include "Core/HLE/__sceAudio.h"
 #include "Core/HLE/sceAudio.h"
+#include "Core/HLE/sceDisplay.h"
 #include "Core/HLE/sceKernel.h"
 #include "Core/HLE/sceKernelThread.h"
 #include "Core/HW/StereoResampler.h"
@@ -76,6 +77,8 @@ static s16 *clampedMixBuffer;
 #ifndef MOBILE_DEVICE
 WaveFileWriter g_wave_writer;
 static bool m_logAudio;
+// Frames run ahead are thrown away, so their audio shouldn't reach the host.
+static bool speculativeFrames = false;
 #endif
 
 // High and low watermarks, basically.  For perfect emulation, the correct values are 0 and 1, respectively.
@@ -336,6 +339,8 @@ void __AudioUpdate(bool resetRecording) {
 	// to the CPU. Much better to throttle the frame rate on frame display and just throw away audio
 	// if the buffer somehow gets full.
 	bool firstChannel = true;
+	// Still drain the channels when nothing will be heard, so the game's timing stays the same.
+	const bool audible = g_Config.bEnableSound && !speculativeFrames && !__DisplayIsTurbo();
 
 	for (u32 i = 0; i < PSP_AUDIO_CHANNEL_MAX + 1; i++)	{
 		if (!chans[i].reserved)
@@ -355,6 +360,8 @@ void __AudioUpdate(bool resetRecording) {
 		size_t sz1, sz2;
 
 		chans[i].sampleQueue.popPointers(hwBlockSize * 2, &buf1, &sz1, &buf2, &sz2);
+		if (!audible)
+			continue;
 
 		if (firstChannel) {
 			for (size_t s = 0; s < sz1; s++)
@@ -381,7 +388,7 @@ void __AudioUpdate(bool resetRecording) {
 		memset(mixBuffer, 0, hwBlockSize * 2 * sizeof(s32));
 	}
 
-	if (g_Config.bEnableSound) {
+	if (audible) {
 		resampler.PushSamples(mixBuffer, hwBlockSize);
 #ifndef MOBILE_DEVICE
 		if (g_Config.bSaveLoadResetsAVdumping && resetRecording) {
@@ -426,6 +433,10 @@ int __AudioMix(short *outstereo, int numFrames, int sampleRate) {
 	return resampler.Mix(outstereo, numFrames, false, sampleRate);
 }
 
+void __AudioSetSpeculative(bool speculative) {
+	speculativeFrames = speculative;
+}
+
 const AudioDebugStats *__AudioGetDebugStats() {
 	resampler.GetAudioDebugStats(&g_AudioDebugStats);
 	return &g_AudioDebugStats;
@@ -21,9 +21,12 @@
 
 struct AudioDebugStats {
 	int buffered;
+	int minBuffered;
+	int maxBuffered;
 	int watermark;
 	int bufsize;
 	int underrunCount;
+	int underrunFrames;
 	int overrunCount;
 	int instantSampleRate;
 	int lastPushSize;
@@ -43,6 +46,8 @@ void __AudioWakeThreads(AudioChannel &chan, int result, int step);
 void __AudioWakeThreads(AudioChannel &chan, int result);
 
 int __AudioMix(short *outstereo, int numSamples, int sampleRate);
+// While running ahead, the channels are still drained but nothing is output or recorded.
+void __AudioSetSpeculative(bool speculative);
 const AudioDebugStats *__AudioGetDebugStats();
 void __PushExternalAudio(const s32 *audio, int numSamples);  // Should not be used in-game, only at the menu!
 
@@ -21,6 +21,7 @@
 // This is a direct port of Coldbird's code from http://code.google.com/p/aemu/
 // All credit goes to him!
 
+#include <algorithm>
 #include <cstring>
 #include "util/text/parsers.h"
 #include "Core/Core.h"
@@ -43,6 +44,8 @@ int threadStatus                      = ADHOCCTL_STATE_DISCONNECTED;
 
 bool IsAdhocctlInCB = false;
 int actionAfterMatchingMipsCall;
+int actionAfterAdhocctlMipsCall;
+AdhocReactor adhocReactor;
 
 // Broadcast MAC
 uint8_t broadcastMAC[ETHER_ADDR_LEN] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
@@ -229,6 +232,7 @@ void deleteAllPDP(void) {
 		// Active Socket
 		if (pdp[i] != NULL) {
 			// Close Socket
+			adhocReactor.UnwatchSocket(ADHOC_REACTOR_PDP, i + 1);
 			closesocket(pdp[i]->id);
 
 			// Free Memory
@@ -246,6 +250,7 @@ void deleteAllPTP(void) {
 		// Active Socket
 		if (ptp[i] != NULL) {
 			// Close Socket
+			adhocReactor.UnwatchSocket(ADHOC_REACTOR_PTP, i + 1);
 			closesocket(ptp[i]->id);
 
 			// Free Memory
@@ -928,11 +933,260 @@ void AfterMatchingMipsCall::SetContextID(u32 ContextID, u32 eventId) {
 	peerlock.unlock();
 }
 
-// Make sure MIPS calls have been fully executed before the next notifyAdhocctlHandlers
-void notifyAdhocctlHandlers(u32 flag, u32 error) {
-	__UpdateAdhocctlHandlers(flag, error);
-	// TODO: We should use after action instead of guessing the time like this
-	sleep_ms(20); // Ugly workaround to give time for the mips callback to fully executed, usually only need <16ms
+void AfterAdhocctlMipsCall::run(MipsCall &call) {
+	DEBUG_LOG(SCENET, "Leaving AfterAdhocctlMipsCall::run [Seq=%u]", sequence);
+	adhocReactor.AdhocctlDelivered(sequence);
+}
+
+// The friend finder holds back further packets until AfterAdhocctlMipsCall reports the callbacks have fully executed
+void notifyAdhocctlHandlers(u32 flag, u32 error, u64 arrivalUs) {
+	adhocReactor.NotifyAdhocctl(flag, error, arrivalUs);
+}
+
+u64 adhocNowUs() {
+	// Never 0, that means "nothing yet" for the reactor
+	return std::max((u64)(real_time_now() * 1000000.0), (u64)1);
+}
+
+void AdhocLatencyHistogram::Add(u64 usec) {
+	int bucket = 0;
+	while (bucket < BUCKETS - 1 && (1ULL << bucket) <= usec)
+		bucket++;
+	buckets_[bucket]++;
+
+	u64 prev = max_.load();
+	while (usec > prev && !max_.compare_exchange_weak(prev, usec)) {
+	}
+}
+
+void AdhocLatencyHistogram::Reset() {
+	for (int i = 0; i < BUCKETS; i++)
+		buckets_[i] = 0;
+	max_ = 0;
+}
+
+u64 AdhocLatencyHistogram::Count() const {
+	u64 count = 0;
+	for (int i = 0; i < BUCKETS; i++)
+		count += buckets_[i].load();
+	return count;
+}
+
+u64 AdhocLatencyHistogram::Percentile(double fraction) const {
+	u64 target = (u64)(Count() * fraction);
+	u64 seen = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		seen += buckets_[i].load();
+		if (seen > target)
+			return i == 0 ? 0 : std::min(1ULL << i, max_.load());
+	}
+	return max_.load();
+}
+
+void AdhocLatencyHistogram::Log(const char *name) const {
+	u64 count = Count();
+	if (count == 0)
+		return;
+	INFO_LOG(SCENET, "Adhoc %s latency: %llu samples, p50 <= %llu us, p95 <= %llu us, p99 <= %llu us, max %llu us", name, count, Percentile(0.50), Percentile(0.95), Percentile(0.99), max_.load());
+}
+
+AdhocReactor::AdhocReactor() : running_(false), wakeSocket_((int)INVALID_SOCKET), notifySequence_(0), notifyDeadline_(0), warnedSequence_(0), deliveredSequence_(0) {
+	memset(&wakeAddr_, 0, sizeof(wakeAddr_));
+	for (int type = 0; type < ADHOC_REACTOR_SOCKET_TYPES; type++) {
+		for (int i = 0; i < 255; i++) {
+			sockets_[type][i].fd = (int)INVALID_SOCKET;
+			sockets_[type][i].readySince = 0;
+			sockets_[type][i].measuredSince = 0;
+		}
+	}
+}
+
+void AdhocReactor::Init() {
+	// A loopback datagram socket that sends to itself, so other threads can interrupt poll() on any platform.
+	wakeSocket_ = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (wakeSocket_ != (int)INVALID_SOCKET) {
+		wakeAddr_.sin_family = AF_INET;
+		wakeAddr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		wakeAddr_.sin_port = 0;
+		socklen_t len = sizeof(wakeAddr_);
+		if (bind(wakeSocket_, (sockaddr *)&wakeAddr_, sizeof(wakeAddr_)) == SOCKET_ERROR || getsockname(wakeSocket_, (sockaddr *)&wakeAddr_, &len) == SOCKET_ERROR) {
+			closesocket(wakeSocket_);
+			wakeSocket_ = (int)INVALID_SOCKET;
+		} else {
+			changeBlockingMode(wakeSocket_, 1);
+		}
+	}
+	if (wakeSocket_ == (int)INVALID_SOCKET) {
+		// Still works, just slower to notice sockets coming back or shutdown.
+		WARN_LOG(SCENET, "AdhocReactor: Unable to create wakeup socket (%i)", errno);
+	}
+
+	std::lock_guard<std::mutex> guard(notifyLock_);
+	adhocctlQueue_.clear();
+	notifySequence_ = 0;
+	warnedSequence_ = 0;
+	deliveredSequence_ = 0;
+	adhocctlLatency.Reset();
+	pdpLatency.Reset();
+	ptpLatency.Reset();
+	running_ = true;
+}
+
+void AdhocReactor::Shutdown() {
+	running_ = false;
+	if (wakeSocket_ != (int)INVALID_SOCKET) {
+		closesocket(wakeSocket_);
+		wakeSocket_ = (int)INVALID_SOCKET;
+	}
+}
+
+void AdhocReactor::Wake() {
+	if (wakeSocket_ != (int)INVALID_SOCKET) {
+		uint8_t dummy = 0;
+		sendto(wakeSocket_, (const char *)&dummy, 1, 0, (sockaddr *)&wakeAddr_, sizeof(wakeAddr_));
+	}
+}
+
+bool AdhocReactor::Wait(int timeoutMs, bool watchMetasocket) {
+	pollfds_.clear();
+	pollSlots_.clear();
+
+	pollfd pfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (wakeSocket_ != (int)INVALID_SOCKET) {
+		pfd.fd = wakeSocket_;
+		pollfds_.push_back(pfd);
+		pollSlots_.push_back(nullptr);
+	}
+	const size_t metaIndex = pollfds_.size();
+	if (watchMetasocket) {
+		pfd.fd = metasocket;
+		pollfds_.push_back(pfd);
+		pollSlots_.push_back(nullptr);
+	}
+	// Sockets already flagged stay out until consumed, otherwise poll() would return right away.
+	for (int type = 0; type < ADHOC_REACTOR_SOCKET_TYPES; type++) {
+		for (int i = 0; i < 255; i++) {
+			WatchedSocket &slot = sockets_[type][i];
+			int fd = slot.fd;
+			if (fd != (int)INVALID_SOCKET && slot.readySince == 0) {
+				pfd.fd = fd;
+				pollfds_.push_back(pfd);
+				pollSlots_.push_back(&slot);
+			}
+		}
+	}
+
+	if (pollfds_.empty()) {
+		sleep_ms(timeoutMs);
+		return false;
+	}
+
+#ifdef _WIN32
+	int count = WSAPoll(&pollfds_[0], (ULONG)pollfds_.size(), timeoutMs);
+#else
+	int count = poll(&pollfds_[0], (nfds_t)pollfds_.size(), timeoutMs);
+#endif
+	if (count <= 0)
+		return false;
+
+	const u64 now = adhocNowUs();
+	bool metaReady = false;
+	for (size_t i = 0; i < pollfds_.size(); i++) {
+		if (pollfds_[i].revents == 0)
+			continue;
+
+		if (pollSlots_[i] != nullptr) {
+			// Errors and hangups count too, the recv will report them.
+			WatchedSocket &slot = *pollSlots_[i];
+			if (slot.fd == pollfds_[i].fd)
+				slot.readySince = now;
+		} else if (watchMetasocket && i == metaIndex) {
+			metaReady = true;
+		} else {
+			uint8_t dummy[16];
+			while (recv(wakeSocket_, (char *)dummy, sizeof(dummy), 0) > 0) {
+			}
+		}
+	}
+	return metaReady;
+}
+
+void AdhocReactor::WatchSocket(AdhocReactorSocketType type, int id, int fd) {
+	WatchedSocket &slot = Slot(type, id);
+	slot.readySince = 0;
+	slot.measuredSince = 0;
+	slot.fd = fd;
+	Wake();
+}
+
+void AdhocReactor::UnwatchSocket(AdhocReactorSocketType type, int id) {
+	WatchedSocket &slot = Slot(type, id);
+	slot.fd = (int)INVALID_SOCKET;
+	slot.readySince = 0;
+	Wake();
+}
+
+bool AdhocReactor::MayHaveData(AdhocReactorSocketType type, int id) {
+	WatchedSocket &slot = Slot(type, id);
+	return !running_ || slot.fd == (int)INVALID_SOCKET || slot.readySince != 0;
+}
+
+void AdhocReactor::Consumed(AdhocReactorSocketType type, int id, bool received, bool wouldBlock) {
+	WatchedSocket &slot = Slot(type, id);
+	u64 since = slot.readySince;
+	// Only the first receive after poll() saw data counts, the rest were already waiting.
+	if (received && since != 0 && since != slot.measuredSince) {
+		slot.measuredSince = since;
+		(type == ADHOC_REACTOR_PDP ? pdpLatency : ptpLatency).Add(adhocNowUs() - since);
+	}
+	if (wouldBlock && slot.readySince.exchange(0) != 0)
+		Wake();
+}
+
+void AdhocReactor::NotifyAdhocctl(u32 flag, u32 error, u64 arrivalUs) {
+	std::lock_guard<std::mutex> guard(notifyLock_);
+	AdhocctlReactorEvent ev;
+	ev.flag = flag;
+	ev.error = error;
+	ev.sequence = ++notifySequence_;
+	ev.arrivalUs = arrivalUs;
+	notifyDeadline_ = adhocNowUs() + ADHOCCTL_CALLBACK_TIMEOUT;
+	if (!adhocctlQueue_.push(ev)) {
+		ERROR_LOG(SCENET, "AdhocReactor: Event queue full, dropping adhocctl event %d", flag);
+		deliveredSequence_ = ev.sequence;
+	}
+}
+
+bool AdhocReactor::AdhocctlIdle(u64 nowUs) {
+	std::lock_guard<std::mutex> guard(notifyLock_);
+	if ((s32)(deliveredSequence_.load() - notifySequence_) >= 0)
+		return true;
+	if (nowUs < notifyDeadline_)
+		return false;
+	if (warnedSequence_ != notifySequence_) {
+		warnedSequence_ = notifySequence_;
+		ERROR_LOG(SCENET, "AdhocReactor: Adhocctl callback failed to return within %dms", ADHOCCTL_CALLBACK_TIMEOUT / 1000);
+	}
+	return true;
+}
+
+bool AdhocReactor::PopAdhocctl(AdhocctlReactorEvent &ev) {
+	return adhocctlQueue_.pop(ev);
+}
+
+void AdhocReactor::AdhocctlDelivered(u32 seq) {
+	u32 prev = deliveredSequence_.load();
+	while ((s32)(seq - prev) > 0 && !deliveredSequence_.compare_exchange_weak(prev, seq)) {
+	}
+	Wake();
+}
+
+void AdhocReactor::LogStats() {
+	adhocctlLatency.Log("adhocctl event");
+	pdpLatency.Log("PDP receive");
+	ptpLatency.Log("PTP receive");
 }
 
 // Matching callback is void function: typedef void(*SceNetAdhocMatchingHandler)(int id, int event, SceNetEtherAddr * peer, int optlen, void * opt);
@@ -996,6 +1250,12 @@ int friendFinder(){
 	// Last Time Reception got updated
 	uint64_t lastreceptionupdate = 0;
 
+	// When the data still in rx arrived, for the latency stats
+	uint64_t rxarrival = 0;
+
+	// Server closed the connection, stop waiting on it
+	bool metaclosed = false;
+
 	uint64_t now;
 
 	// Log Startup
@@ -1003,8 +1263,11 @@ int friendFinder(){
 
 	// Finder Loop
 	while (friendFinderRunning) {
-		// Acquire Network Lock
-		//_acquireNetworkLock();
+		// Don't do anything if it's paused, otherwise the log will be flooded
+		if (Core_IsStepping()) {
+			adhocReactor.Wait(100, false);
+			continue;
+		}
 
 		// Ping Server
 		now = real_time_now()*1000000.0; // should be in microseconds, but it seems real_time_now() returns in seconds
@@ -1031,24 +1294,10 @@ int friendFinder(){
 		//  sceNetInetSend(metasocket, (const char *)&chat, sizeof(chat), 0);
 		//}
 
-		// Wait for Incoming Data
-		int received = recv(metasocket, (char *)(rx + rxpos), sizeof(rx) - rxpos, 0);
-
-		// Free Network Lock
-		//_freeNetworkLock();
-
-		// Received Data
-		if (received > 0) {
-			// Fix Position
-			rxpos += received;
-
-			// Log Incoming Traffic
-			//printf("Received %d Bytes of Data from Server\n", received);
-			INFO_LOG(SCENET, "Received %d Bytes of Data from Adhoc Server", received);
-		}
+		// Handle Packets, but hold them back while the game is still inside an adhocctl callback
+		while (rxpos > 0 && adhocReactor.AdhocctlIdle(adhocNowUs())) {
+			int packetsize = 0;
 
-		// Handle Packets
-		if (rxpos > 0) {
 			// BSSID Packet
 			if (rx[0] == OPCODE_CONNECT_BSSID) {
 				INFO_LOG(SCENET, "FriendFinder: Incoming OPCODE_CONNECT_BSSID");
@@ -1061,13 +1310,9 @@ int friendFinder(){
 					// Change State
 					threadStatus = ADHOCCTL_STATE_CONNECTED;
 					// Notify Event Handlers
-					notifyAdhocctlHandlers(ADHOCCTL_EVENT_CONNECT, 0);
-
-					// Move RX Buffer
-					memmove(rx, rx + sizeof(SceNetAdhocctlConnectBSSIDPacketS2C), sizeof(rx) - sizeof(SceNetAdhocctlConnectBSSIDPacketS2C));
+					notifyAdhocctlHandlers(ADHOCCTL_EVENT_CONNECT, 0, rxarrival);
 
-					// Fix RX Buffer Length
-					rxpos -= sizeof(SceNetAdhocctlConnectBSSIDPacketS2C);
+					packetsize = sizeof(SceNetAdhocctlConnectBSSIDPacketS2C);
 				}
 			}
 
@@ -1086,11 +1331,7 @@ int friendFinder(){
 					//printf("Receive chat message %s", packet->base.message);
 					DEBUG_LOG(SCENET, "Received chat message %s", packet->base.message);
 
-					// Move RX Buffer
-					memmove(rx, rx + sizeof(SceNetAdhocctlChatPacketS2C), sizeof(rx) - sizeof(SceNetAdhocctlChatPacketS2C));
-
-					// Fix RX Buffer Length
-					rxpos -= sizeof(SceNetAdhocctlChatPacketS2C);
+					packetsize = sizeof(SceNetAdhocctlChatPacketS2C);
 				}
 			}
 
@@ -1115,11 +1356,7 @@ int friendFinder(){
 					// setUserCount(getActivePeerCount()+1);
 #endif
 
-					// Move RX Buffer
-					memmove(rx, rx + sizeof(SceNetAdhocctlConnectPacketS2C), sizeof(rx) - sizeof(SceNetAdhocctlConnectPacketS2C));
-
-					// Fix RX Buffer Length
-					rxpos -= sizeof(SceNetAdhocctlConnectPacketS2C);
+					packetsize = sizeof(SceNetAdhocctlConnectPacketS2C);
 				}
 			}
 
@@ -1144,11 +1381,7 @@ int friendFinder(){
 					//setUserCount(_getActivePeerCount()+1);
 #endif
 
-					// Move RX Buffer
-					memmove(rx, rx + sizeof(SceNetAdhocctlDisconnectPacketS2C), sizeof(rx) - sizeof(SceNetAdhocctlDisconnectPacketS2C));
-
-					// Fix RX Buffer Length
-					rxpos -= sizeof(SceNetAdhocctlDisconnectPacketS2C);
+					packetsize = sizeof(SceNetAdhocctlDisconnectPacketS2C);
 				}
 			}
 
@@ -1203,11 +1436,7 @@ int friendFinder(){
 					// Multithreading Unlock
 					peerlock.unlock();
 
-					// Move RX Buffer
-					memmove(rx, rx + sizeof(SceNetAdhocctlScanPacketS2C), sizeof(rx) - sizeof(SceNetAdhocctlScanPacketS2C));
-
-					// Fix RX Buffer Length
-					rxpos -= sizeof(SceNetAdhocctlScanPacketS2C);
+					packetsize = sizeof(SceNetAdhocctlScanPacketS2C);
 				}
 			}
 
@@ -1228,25 +1457,59 @@ int friendFinder(){
 				threadStatus = ADHOCCTL_STATE_DISCONNECTED;
 
 				// Notify Event Handlers
-				notifyAdhocctlHandlers(ADHOCCTL_EVENT_SCAN, 0);
+				notifyAdhocctlHandlers(ADHOCCTL_EVENT_SCAN, 0, rxarrival);
 				//int i = 0; for(; i < ADHOCCTL_MAX_HANDLER; i++)
 				//{
 				//        // Active Handler
 				//        if(_event_handler[i] != NULL) _event_handler[i](ADHOCCTL_EVENT_SCAN, 0, _event_args[i]);
 				//}
 
-				// Move RX Buffer
-				memmove(rx, rx + 1, sizeof(rx) - 1);
+				packetsize = 1;
+			}
 
-				// Fix RX Buffer Length
-				rxpos -= 1;
+			// Unknown Packet, skip a byte so we don't stall forever
+			else {
+				WARN_LOG(SCENET, "FriendFinder: Unknown opcode %d from Adhoc Server", rx[0]);
+				packetsize = 1;
 			}
+
+			// Need more data
+			if (packetsize == 0)
+				break;
+
+			// Move RX Buffer
+			memmove(rx, rx + packetsize, rxpos - packetsize);
+
+			// Fix RX Buffer Length
+			rxpos -= packetsize;
 		}
-		// Original value was 10 ms, I think 100 is just fine
-		sleep_ms(1); // Using 1ms for faster response just like AdhocServer
 
-		// Don't do anything if it's paused, otherwise the log will be flooded
-		while (Core_IsStepping() && friendFinderRunning) sleep_ms(1);
+		// Wait for Incoming Data or the next ping, leaving the server alone while packets are held back
+		now = real_time_now()*1000000.0;
+		uint64_t wait = lastping + PSP_ADHOCCTL_PING_TIMEOUT > now ? lastping + PSP_ADHOCCTL_PING_TIMEOUT - now : 0;
+		bool holding = rxpos > 0 && !adhocReactor.AdhocctlIdle(adhocNowUs());
+		if (holding) wait = std::min(wait, (uint64_t)ADHOCCTL_CALLBACK_TIMEOUT);
+		bool watchMeta = !holding && !metaclosed && rxpos < (int)sizeof(rx);
+		if (!adhocReactor.Wait((int)(wait / 1000) + 1, watchMeta))
+			continue;
+
+		// Receive Data
+		int received = recv(metasocket, (char *)(rx + rxpos), sizeof(rx) - rxpos, 0);
+
+		// Received Data
+		if (received > 0) {
+			// Fix Position
+			rxpos += received;
+			rxarrival = adhocNowUs();
+
+			// Log Incoming Traffic
+			//printf("Received %d Bytes of Data from Server\n", received);
+			INFO_LOG(SCENET, "Received %d Bytes of Data from Adhoc Server", received);
+		} else if (received == 0 || errno != EAGAIN) {
+			// Connection lost, pings will keep failing until Term
+			ERROR_LOG(SCENET, "FriendFinder: Lost connection to Adhoc Server (%i)", received == 0 ? 0 : errno);
+			metaclosed = true;
+		}
 	}
 
 	// Groups/Networks should be deallocated isn't?
@@ -17,12 +17,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 #include "base/timeutil.h"
 #include "net/resolve.h"
 #include "Common/ChunkFile.h"
+#include "Common/SPSCQueue.h"
 
 #include "Core/Config.h"
 #include "Core/CoreTiming.h"
@@ -49,6 +52,7 @@ class PointerWrap;
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 #endif
 
 #ifdef _MSC_VER
@@ -176,6 +180,8 @@ inline bool connectInProgress(int errcode){ return (errcode == EINPROGRESS || er
 // Timeouts
 #define PSP_ADHOCCTL_RECV_TIMEOUT	100000
 #define PSP_ADHOCCTL_PING_TIMEOUT	2000000
+// How long the friend finder holds further packets back while the game handles an adhocctl event
+#define ADHOCCTL_CALLBACK_TIMEOUT	250000
 
 #ifdef _MSC_VER 
 #pragma pack(push, 1)
@@ -789,7 +795,129 @@ class AfterMatchingMipsCall : public Action {
 	SceNetAdhocMatchingContext *context;
 };
 
+// Tells the friend finder the game is done with an adhocctl event.
+class AfterAdhocctlMipsCall : public Action {
+public:
+	AfterAdhocctlMipsCall() : sequence(0) {}
+	static Action *Create() { return new AfterAdhocctlMipsCall(); }
+	void DoState(PointerWrap &p) override {
+		auto s = p.Section("AfterAdhocctlMipsCall", 1);
+		if (!s)
+			return;
+
+		p.Do(sequence);
+	}
+	void run(MipsCall &call) override;
+	void SetSequence(u32 seq) { sequence = seq; }
+
+private:
+	u32 sequence;
+};
+
+// Packet arrival to game-visible delivery times, in power of two microsecond buckets.
+class AdhocLatencyHistogram {
+public:
+	AdhocLatencyHistogram() { Reset(); }
+
+	void Add(u64 usec);
+	void Reset();
+	u64 Count() const;
+	// Upper bound of the bucket holding the given fraction of samples.
+	u64 Percentile(double fraction) const;
+	void Log(const char *name) const;
+
+private:
+	enum { BUCKETS = 32 };
+	std::atomic<u64> buckets_[BUCKETS];
+	std::atomic<u64> max_;
+};
+
+struct AdhocctlReactorEvent {
+	u32 flag;
+	u32 error;
+	u32 sequence;
+	u64 arrivalUs;
+};
+
+enum AdhocReactorSocketType {
+	ADHOC_REACTOR_PDP,
+	ADHOC_REACTOR_PTP,
+	ADHOC_REACTOR_SOCKET_TYPES,
+};
+
+// The friend finder thread waits here on the metasocket and every PDP/PTP socket at once.
+// PDP/PTP readiness is published per socket id so nonblocking receives can skip the syscalls,
+// and adhocctl events go to the emulator thread through a lock-free queue.
+class AdhocReactor {
+public:
+	AdhocReactor();
+
+	void Init();
+	void Shutdown();
+	bool IsRunning() const { return running_; }
+	// Any thread.  Interrupts Wait().
+	void Wake();
+
+	// Friend finder thread only.  Returns true if the metasocket has data.
+	bool Wait(int timeoutMs, bool watchMetasocket);
+
+	// Socket ids are 1-255, like pdp[] and ptp[].
+	void WatchSocket(AdhocReactorSocketType type, int id, int fd);
+	void UnwatchSocket(AdhocReactorSocketType type, int id);
+	// False only if the reactor is sure nothing has arrived yet.
+	bool MayHaveData(AdhocReactorSocketType type, int id);
+	// Call after each recv on a watched socket.  More may be queued, so it's only watched again once a recv would block.
+	void Consumed(AdhocReactorSocketType type, int id, bool received, bool wouldBlock);
+
+	// Any thread, events reach the emulator thread in the order they were notified.
+	void NotifyAdhocctl(u32 flag, u32 error, u64 arrivalUs);
+	// Friend finder thread only.
+	// Whether the game has handled the last event (or taken too long to.)
+	bool AdhocctlIdle(u64 nowUs);
+
+	// Emulator thread only.
+	bool PopAdhocctl(AdhocctlReactorEvent &ev);
+	void AdhocctlDelivered(u32 seq);
+
+	void LogStats();
+
+	AdhocLatencyHistogram adhocctlLatency;
+	AdhocLatencyHistogram pdpLatency;
+	AdhocLatencyHistogram ptpLatency;
+
+private:
+	struct WatchedSocket {
+		std::atomic<int> fd;
+		// Microseconds when data was seen, 0 while still waiting.
+		std::atomic<u64> readySince;
+		// Emulator thread only, the readySince already counted in the latency stats.
+		u64 measuredSince;
+	};
+
+	WatchedSocket &Slot(AdhocReactorSocketType type, int id) {
+		return sockets_[type][id - 1];
+	}
+
+	std::atomic<bool> running_;
+	int wakeSocket_;
+	sockaddr_in wakeAddr_;
+	WatchedSocket sockets_[ADHOC_REACTOR_SOCKET_TYPES][255];
+
+	std::vector<pollfd> pollfds_;
+	std::vector<WatchedSocket *> pollSlots_;
+
+	// Serializes producers, so the queue only ever sees one at a time.
+	std::mutex notifyLock_;
+	SPSCQueue<AdhocctlReactorEvent, 64> adhocctlQueue_;
+	u32 notifySequence_;
+	u64 notifyDeadline_;
+	u32 warnedSequence_;
+	std::atomic<u32> deliveredSequence_;
+};
+
 extern int actionAfterMatchingMipsCall;
+extern int actionAfterAdhocctlMipsCall;
+extern AdhocReactor adhocReactor;
 extern bool IsAdhocctlInCB;
 
 // Aux vars
@@ -902,7 +1030,7 @@ void deleteFriendByIP(uint32_t ip);
 void freeFriendsRecursive(SceNetAdhocctlPeerInfo * node);
 
 /**
- * Friend Finder Thread (Receives Peer Information)
+ * Friend Finder Thread (Receives Peer Information, services the AdhocReactor)
  * @param args Length of argp in Bytes (Unused)
  * @param argp Argument (Unused)
  * @return Unused Value - Return 0
@@ -927,7 +1055,10 @@ SceNetAdhocMatchingContext * findMatchingContext(int id);
 */
 void notifyMatchingHandler(SceNetAdhocMatchingContext * context, ThreadMessage * msg, void * opt, u32 &bufAddr, u32 &bufLen, u32_le * args);
 // Notifiy Adhocctl Handlers
-void notifyAdhocctlHandlers(u32 flag, u32 error);
+void notifyAdhocctlHandlers(u32 flag, u32 error, u64 arrivalUs);
+
+// Current time in microseconds, as used for the adhoc latency stats
+u64 adhocNowUs();
 
 /*
  * Packet Handler
@@ -25,6 +25,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <signal.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #if !defined(__APPLE__)
 #include <stdlib.h>
@@ -37,6 +40,12 @@
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define ADHOCSERVER_USE_EPOLL
+#else
+#include <poll.h>
+#endif
 #endif
 
 #include <fcntl.h>
@@ -56,6 +65,40 @@ SceNetAdhocctlUserNode * _db_user = NULL;
 // Game Database
 SceNetAdhocctlGameNode * _db_game = NULL;
 
+// Indexes into the lists above, so lookups don't have to walk every node.
+static std::unordered_map<uint32_t, SceNetAdhocctlUserNode *> _db_user_by_ip;
+static std::unordered_map<int, SceNetAdhocctlUserNode *> _db_user_by_stream;
+static std::unordered_map<std::string, SceNetAdhocctlGameNode *> _db_game_by_product;
+// Keyed by product code + group name, see group_key().
+static std::unordered_map<std::string, SceNetAdhocctlGroupNode *> _db_group_by_name;
+
+// Status file is rewritten from server_loop, at most every SERVER_STATUS_INTERVAL seconds.
+static bool status_dirty = false;
+static double status_last_write = 0.0;
+
+// Waits for activity on the listening socket and every user stream.
+// Uses epoll where available, so an idle user costs nothing per wakeup.
+class AdhocServerPoller {
+public:
+	bool Init();
+	void Shutdown();
+	void Add(int fd);
+	void Remove(int fd);
+	// Fills ready with sockets that can be read (or have errored.)
+	void Wait(int timeoutMs, std::vector<int> &ready);
+
+private:
+#ifdef ADHOCSERVER_USE_EPOLL
+	int epfd_ = -1;
+	std::vector<epoll_event> events_;
+#else
+	std::vector<pollfd> fds_;
+	std::unordered_map<int, size_t> indexes_;
+#endif
+};
+
+static AdhocServerPoller server_poller;
+
 // Server Status
 //int _status = 0;
 bool adhocServerRunning = false;
@@ -482,6 +525,116 @@ void __AdhocServerInit() {
 	crosslinks = std::vector<db_crosslink>(default_crosslinks, default_crosslinks + ARRAY_SIZE(default_crosslinks));
 }
 
+#ifdef ADHOCSERVER_USE_EPOLL
+bool AdhocServerPoller::Init() {
+	epfd_ = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd_ == -1) {
+		ERROR_LOG(SCENET, "AdhocServer: epoll_create1 failed (error %d)", errno);
+		return false;
+	}
+	events_.resize(256);
+	return true;
+}
+
+void AdhocServerPoller::Shutdown() {
+	if (epfd_ != -1)
+		close(epfd_);
+	epfd_ = -1;
+}
+
+void AdhocServerPoller::Add(int fd) {
+	epoll_event ev{};
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == -1)
+		ERROR_LOG(SCENET, "AdhocServer: epoll_ctl add failed (error %d)", errno);
+}
+
+void AdhocServerPoller::Remove(int fd) {
+	epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void AdhocServerPoller::Wait(int timeoutMs, std::vector<int> &ready) {
+	ready.clear();
+	int count = epoll_wait(epfd_, &events_[0], (int)events_.size(), timeoutMs);
+	for (int i = 0; i < count; i++)
+		ready.push_back(events_[i].data.fd);
+	// Busy, so grab more at once next time.
+	if (count == (int)events_.size())
+		events_.resize(events_.size() * 2);
+}
+#else
+#ifdef _WIN32
+#define poll WSAPoll
+#endif
+
+bool AdhocServerPoller::Init() {
+	fds_.clear();
+	indexes_.clear();
+	return true;
+}
+
+void AdhocServerPoller::Shutdown() {
+	fds_.clear();
+	indexes_.clear();
+}
+
+void AdhocServerPoller::Add(int fd) {
+	pollfd pfd{};
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	indexes_[fd] = fds_.size();
+	fds_.push_back(pfd);
+}
+
+void AdhocServerPoller::Remove(int fd) {
+	auto it = indexes_.find(fd);
+	if (it == indexes_.end())
+		return;
+	// Swap with the last so removal stays cheap.
+	size_t index = it->second;
+	indexes_.erase(it);
+	if (index != fds_.size() - 1) {
+		fds_[index] = fds_.back();
+		indexes_[(int)fds_[index].fd] = index;
+	}
+	fds_.pop_back();
+}
+
+void AdhocServerPoller::Wait(int timeoutMs, std::vector<int> &ready) {
+	ready.clear();
+	if (fds_.empty()) {
+		sleep_ms(timeoutMs);
+		return;
+	}
+	int count = poll(&fds_[0], (unsigned long)fds_.size(), timeoutMs);
+	for (size_t i = 0; i < fds_.size() && count > 0; i++) {
+		if (fds_[i].revents != 0) {
+			ready.push_back((int)fds_[i].fd);
+			count--;
+		}
+	}
+}
+#endif
+
+static std::string product_key(const SceNetAdhocctlProductCode &product)
+{
+	// Matches the strncmp() semantics the lists were searched with.
+	size_t len = 0;
+	while (len < PRODUCT_CODE_LENGTH && product.data[len] != 0) len++;
+	return std::string(product.data, len);
+}
+
+static std::string group_key(const SceNetAdhocctlGameNode * game, const SceNetAdhocctlGroupName * group)
+{
+	size_t len = 0;
+	while (len < ADHOCCTL_GROUPNAME_LEN && group->data[len] != 0) len++;
+	// Product codes are fixed size, so this can't collide.
+	std::string key(game->game.data, PRODUCT_CODE_LENGTH);
+	key.append((const char *)group->data, len);
+	return key;
+}
+
 /**
  * Login User into Database (Stream)
  * @param fd Socket
@@ -493,8 +646,8 @@ void login_user_stream(int fd, uint32_t ip)
 	if(_db_user_count < SERVER_USER_MAXIMUM)
 	{
 		// Check IP Duplication
-		SceNetAdhocctlUserNode * u = _db_user;
-		while(u != NULL && u->resolver.ip != ip) u = u->next;
+		auto existing = _db_user_by_ip.find(ip);
+		SceNetAdhocctlUserNode * u = existing != _db_user_by_ip.end() ? existing->second : NULL;
 
 		if (u != NULL) { // IP Already existed
 			uint8_t * ip4 = (uint8_t *)&u->resolver.ip;
@@ -523,6 +676,11 @@ void login_user_stream(int fd, uint32_t ip)
 				user->next = _db_user;
 				if(_db_user != NULL) _db_user->prev = user;
 				_db_user = user;
+				_db_user_by_ip[ip] = user;
+				_db_user_by_stream[fd] = user;
+
+				// Wake up for this stream's data
+				server_poller.Add(fd);
 
 				// Initialize Death Clock
 				user->last_recv = time(NULL);
@@ -571,8 +729,8 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 		game_product_override(&data->game);
 
 		// Find existing Game
-		SceNetAdhocctlGameNode * game = _db_game;
-		while(game != NULL && strncmp(game->game.data, data->game.data, PRODUCT_CODE_LENGTH) != 0) game = game->next;
+		auto existing = _db_game_by_product.find(product_key(data->game));
+		SceNetAdhocctlGameNode * game = existing != _db_game_by_product.end() ? existing->second : NULL;
 
 		// Game not found
 		if(game == NULL)
@@ -593,6 +751,7 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 				game->next = _db_game;
 				if(_db_game != NULL) _db_game->prev = game;
 				_db_game = game;
+				_db_game_by_product[product_key(game->game)] = game;
 			}
 		}
 
@@ -656,7 +815,13 @@ void logout_user(SceNetAdhocctlUserNode * user)
 	// Unlink Rightside
 	if(user->next != NULL) user->next->prev = user->prev;
 
+	// Remove from Indexes
+	auto ipEntry = _db_user_by_ip.find(user->resolver.ip);
+	if(ipEntry != _db_user_by_ip.end() && ipEntry->second == user) _db_user_by_ip.erase(ipEntry);
+	_db_user_by_stream.erase(user->stream);
+
 	// Close Stream
+	server_poller.Remove(user->stream);
 	closesocket(user->stream);
 
 	// Playing User
@@ -684,6 +849,9 @@ void logout_user(SceNetAdhocctlUserNode * user)
 			// Unlink Rightside
 			if(user->game->next != NULL) user->game->next->prev = user->game->prev;
 
+			// Remove from Index
+			_db_game_by_product.erase(product_key(user->game->game));
+
 			// Free Game Node Memory
 			free(user->game);
 		}
@@ -771,8 +939,8 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 		if(user->group == NULL)
 		{
 			// Find Group in Game Node
-			SceNetAdhocctlGroupNode * g = user->game->group;
-			while(g != NULL && strncmp((char *)g->group.data, (char *)group->data, ADHOCCTL_GROUPNAME_LEN) != 0) g = g->next;
+			auto existing = _db_group_by_name.find(group_key(user->game, group));
+			SceNetAdhocctlGroupNode * g = existing != _db_group_by_name.end() ? existing->second : NULL;
 
 			// BSSID Packet
 			SceNetAdhocctlConnectBSSIDPacketS2C bssid;
@@ -805,6 +973,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 
 					// Copy Group Name
 					g->group = *group;
+					_db_group_by_name[group_key(g->game, group)] = g;
 
 					// Increase Group Counter for Game
 					g->game->groupcount++;
@@ -996,6 +1165,9 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 			// Unlink Rightside
 			if(user->group->next != NULL) user->group->next->prev = user->group->prev;
 
+			// Remove from Index
+			_db_group_by_name.erase(group_key(user->group->game, &user->group->group));
+
 			// Free Group Memory
 			free(user->group);
 
@@ -1410,6 +1582,19 @@ void game_product_override(SceNetAdhocctlProductCode * product)
  */
 void update_status(void)
 {
+	// Written in batches from server_loop, a busy server changes state constantly.
+	status_dirty = true;
+}
+
+/**
+ * Write Status Logfile
+ */
+static void write_status(void)
+{
+	// Snapshot taken
+	status_dirty = false;
+	status_last_write = real_time_now();
+
 	// Open Logfile
 	FILE * log = File::OpenCFile(SERVER_STATUS_XMLOUT, "w");
 
@@ -1814,215 +1999,294 @@ int create_listen_socket(uint16_t port)
 }
 
 /**
- * Server Main Loop
+ * Accept pending Logins
  * @param server Server Listening Socket
- * @return OS Error Code
  */
-int server_loop(int server)
+static void accept_logins(int server)
 {
-	// Set Running Status
-	//_status = 1;
-	adhocServerRunning = true;
+	// Login Result
+	int loginresult = 0;
 
-	// Create Empty Status Logfile
-	update_status();
-
-	// Handling Loop
-	while (adhocServerRunning) //(_status == 1)
+	// Login Processing Loop
+	do
 	{
-		// Login Block
+		// Prepare Address Structure
+		struct sockaddr_in addr;
+		socklen_t addrlen = sizeof(addr);
+		memset(&addr, 0, sizeof(addr));
+
+		// Accept Login Requests
+		// loginresult = accept4(server, (struct sockaddr *)&addr, &addrlen, SOCK_NONBLOCK);
+
+		// Alternative Accept Approach (some Linux Kernel don't support the accept4 Syscall... wtf?)
+		loginresult = accept(server, (struct sockaddr *)&addr, &addrlen);
+		if(loginresult != -1)
 		{
-			// Login Result
-			int loginresult = 0;
+			// Switch Socket into Non-Blocking Mode
+			change_blocking_mode(loginresult, 1);
+		}
 
-			// Login Processing Loop
-			do
-			{
-				// Prepare Address Structure
-				struct sockaddr_in addr;
-				socklen_t addrlen = sizeof(addr);
-				memset(&addr, 0, sizeof(addr));
+		// Login User (Stream)
+		if (loginresult != -1) {
+			u32_le sip = addr.sin_addr.s_addr;
+			if (sip == 0x0100007f) { //127.0.0.1 should be replaced with LAN/WAN IP whenever available
+				char str[100];
+				gethostname(str, 100);
+				u8 *pip = (u8*)&sip;
+				if (gethostbyname(str)->h_addrtype == AF_INET && gethostbyname(str)->h_addr_list[0] != NULL) pip = (u8*)gethostbyname(str)->h_addr_list[0];
+				sip = *(u32_le*)pip;
+				WARN_LOG(SCENET, "AdhocServer: Replacing IP %s with %u.%u.%u.%u", inet_ntoa(addr.sin_addr), pip[0], pip[1], pip[2], pip[3]);
+			}
+			login_user_stream(loginresult, sip);
+		}
+	} while(loginresult != -1);
+}
 
-				// Accept Login Requests
-				// loginresult = accept4(server, (struct sockaddr *)&addr, &addrlen, SOCK_NONBLOCK);
+/**
+ * Handle the Packet at the Front of the RX Buffer
+ * @param user User Node (may be logged out and freed)
+ */
+static void process_user_packet(SceNetAdhocctlUserNode * user)
+{
+	// Waiting for Login Packet
+	if(get_user_state(user) == USER_STATE_WAITING)
+	{
+		// Valid Opcode
+		if(user->rx[0] == OPCODE_LOGIN)
+		{
+			// Enough Data available
+			if(user->rxpos >= sizeof(SceNetAdhocctlLoginPacketC2S))
+			{
+				// Clone Packet
+				SceNetAdhocctlLoginPacketC2S packet = *(SceNetAdhocctlLoginPacketC2S *)user->rx;
 
-				// Alternative Accept Approach (some Linux Kernel don't support the accept4 Syscall... wtf?)
-				loginresult = accept(server, (struct sockaddr *)&addr, &addrlen);
-				if(loginresult != -1)
-				{
-					// Switch Socket into Non-Blocking Mode
-					change_blocking_mode(loginresult, 1);
-				}
+				// Remove Packet from RX Buffer
+				clear_user_rxbuf(user, sizeof(SceNetAdhocctlLoginPacketC2S));
 
-				// Login User (Stream)
-				if (loginresult != -1) {
-					u32_le sip = addr.sin_addr.s_addr;
-					if (sip == 0x0100007f) { //127.0.0.1 should be replaced with LAN/WAN IP whenever available
-						char str[100];
-						gethostname(str, 100);
-						u8 *pip = (u8*)&sip;
-						if (gethostbyname(str)->h_addrtype == AF_INET && gethostbyname(str)->h_addr_list[0] != NULL) pip = (u8*)gethostbyname(str)->h_addr_list[0];
-						sip = *(u32_le*)pip;
-						WARN_LOG(SCENET, "AdhocServer: Replacing IP %s with %u.%u.%u.%u", inet_ntoa(addr.sin_addr), pip[0], pip[1], pip[2], pip[3]);
-					}
-					login_user_stream(loginresult, sip);
-				}
-			} while(loginresult != -1);
+				// Login User (Data)
+				login_user_data(user, &packet);
+			}
 		}
 
-		// Receive Data from Users
-		SceNetAdhocctlUserNode * user = _db_user;
-		while(user != NULL)
+		// Invalid Opcode
+		else
 		{
-			// Next User (for safe delete)
-			SceNetAdhocctlUserNode * next = user->next;
+			// Notify User
+			uint8_t * ip = (uint8_t *)&user->resolver.ip;
+			INFO_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Waiting State from %u.%u.%u.%u", user->rx[0], ip[0], ip[1], ip[2], ip[3]);
 
-			// Receive Data from User
-			int recvresult = recv(user->stream, (char*)user->rx + user->rxpos, sizeof(user->rx) - user->rxpos, 0);
+			// Logout User
+			logout_user(user);
+		}
+	}
+
+	// Logged-In User
+	else if(get_user_state(user) == USER_STATE_LOGGED_IN)
+	{
+		// Ping Packet
+		if(user->rx[0] == OPCODE_PING)
+		{
+			// Delete Packet from RX Buffer
+			clear_user_rxbuf(user, 1);
+		}
 
-			// Connection Closed or Timed Out
-			if(recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK) || get_user_state(user) == USER_STATE_TIMED_OUT)
+		// Group Connect Packet
+		else if(user->rx[0] == OPCODE_CONNECT)
+		{
+			// Enough Data available
+			if(user->rxpos >= sizeof(SceNetAdhocctlConnectPacketC2S))
 			{
-				// Logout User
-				logout_user(user);
+				// Cast Packet
+				SceNetAdhocctlConnectPacketC2S * packet = (SceNetAdhocctlConnectPacketC2S *)user->rx;
+
+				// Clone Group Name
+				SceNetAdhocctlGroupName group = packet->group;
+
+				// Remove Packet from RX Buffer
+				clear_user_rxbuf(user, sizeof(SceNetAdhocctlConnectPacketC2S));
+
+				// Change Game Group
+				connect_user(user, &group);
 			}
+		}
 
-			// Received Data (or leftovers in RX-Buffer)
-			else if(recvresult > 0 || user->rxpos > 0)
+		// Group Disconnect Packet
+		else if(user->rx[0] == OPCODE_DISCONNECT)
+		{
+			// Remove Packet from RX Buffer
+			clear_user_rxbuf(user, 1);
+
+			// Leave Game Group
+			disconnect_user(user);
+		}
+
+		// Network Scan Packet
+		else if(user->rx[0] == OPCODE_SCAN)
+		{
+			// Remove Packet from RX Buffer
+			clear_user_rxbuf(user, 1);
+
+			// Send Network List
+			send_scan_results(user);
+		}
+
+		// Chat Text Packet
+		else if(user->rx[0] == OPCODE_CHAT)
+		{
+			// Enough Data available
+			if(user->rxpos >= sizeof(SceNetAdhocctlChatPacketC2S))
 			{
-				// New Incoming Data
-				if(recvresult > 0)
-				{
-					// Move RX Pointer
-					user->rxpos += recvresult;
+				// Cast Packet
+				SceNetAdhocctlChatPacketC2S * packet = (SceNetAdhocctlChatPacketC2S *)user->rx;
 
-					// Update Death Clock
-					user->last_recv = time(NULL);
-				}
+				// Clone Buffer for Message
+				char message[64];
+				memset(message, 0, sizeof(message));
+				strncpy(message, packet->message, sizeof(message) - 1);
 
-				// Waiting for Login Packet
-				if(get_user_state(user) == USER_STATE_WAITING)
-				{
-					// Valid Opcode
-					if(user->rx[0] == OPCODE_LOGIN)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlLoginPacketC2S))
-						{
-							// Clone Packet
-							SceNetAdhocctlLoginPacketC2S packet = *(SceNetAdhocctlLoginPacketC2S *)user->rx;
+				// Remove Packet from RX Buffer
+				clear_user_rxbuf(user, sizeof(SceNetAdhocctlChatPacketC2S));
 
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlLoginPacketC2S));
+				// Spread Chat Message
+				spread_message(user, message);
+			}
+		}
 
-							// Login User (Data)
-							login_user_data(user, &packet);
-						}
-					}
+		// Invalid Opcode
+		else
+		{
+			// Notify User
+			uint8_t * ip = (uint8_t *)&user->resolver.ip;
+			INFO_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Logged-In State from %s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u)", user->rx[0], (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3]);
 
-					// Invalid Opcode
-					else
-					{
-						// Notify User
-						uint8_t * ip = (uint8_t *)&user->resolver.ip;
-						INFO_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Waiting State from %u.%u.%u.%u", user->rx[0], ip[0], ip[1], ip[2], ip[3]);
+			// Logout User
+			logout_user(user);
+		}
+	}
+}
 
-						// Logout User
-						logout_user(user);
-					}
-				}
+/**
+ * Receive and handle Data from a User with pending Input
+ * @param user User Node
+ */
+static void receive_user_data(SceNetAdhocctlUserNode * user)
+{
+	// Stream identifies the User once the Node may be gone
+	int stream = user->stream;
 
-				// Logged-In User
-				else if(get_user_state(user) == USER_STATE_LOGGED_IN)
-				{
-					// Ping Packet
-					if(user->rx[0] == OPCODE_PING)
-					{
-						// Delete Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
-					}
+	// Receive Data from User
+	int recvresult = recv(user->stream, (char*)user->rx + user->rxpos, sizeof(user->rx) - user->rxpos, 0);
 
-					// Group Connect Packet
-					else if(user->rx[0] == OPCODE_CONNECT)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlConnectPacketC2S))
-						{
-							// Cast Packet
-							SceNetAdhocctlConnectPacketC2S * packet = (SceNetAdhocctlConnectPacketC2S *)user->rx;
+	// Connection Closed or Timed Out
+	if(recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK) || get_user_state(user) == USER_STATE_TIMED_OUT)
+	{
+		// Logout User
+		logout_user(user);
+		return;
+	}
 
-							// Clone Group Name
-							SceNetAdhocctlGroupName group = packet->group;
+	// New Incoming Data
+	if(recvresult > 0)
+	{
+		// Move RX Pointer
+		user->rxpos += recvresult;
 
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlConnectPacketC2S));
+		// Update Death Clock
+		user->last_recv = time(NULL);
+	}
 
-							// Change Game Group
-							connect_user(user, &group);
-						}
-					}
+	// Handle every complete Packet, we won't be woken up again for leftovers
+	while(user->rxpos > 0)
+	{
+		uint32_t rxpos = user->rxpos;
+		process_user_packet(user);
 
-					// Group Disconnect Packet
-					else if(user->rx[0] == OPCODE_DISCONNECT)
-					{
-						// Remove Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
+		// Logged out (and freed) by the Packet Handler
+		auto it = _db_user_by_stream.find(stream);
+		if(it == _db_user_by_stream.end() || it->second != user) return;
 
-						// Leave Game Group
-						disconnect_user(user);
-					}
+		// Incomplete Packet
+		if(user->rxpos == rxpos) break;
+	}
+}
 
-					// Network Scan Packet
-					else if(user->rx[0] == OPCODE_SCAN)
-					{
-						// Remove Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
+/**
+ * Logout Users that went quiet
+ */
+static void check_user_timeouts(void)
+{
+	SceNetAdhocctlUserNode * user = _db_user;
+	while(user != NULL)
+	{
+		// Next User (for safe delete)
+		SceNetAdhocctlUserNode * next = user->next;
 
-						// Send Network List
-						send_scan_results(user);
-					}
+		// Timed Out
+		if(get_user_state(user) == USER_STATE_TIMED_OUT) logout_user(user);
 
-					// Chat Text Packet
-					else if(user->rx[0] == OPCODE_CHAT)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlChatPacketC2S))
-						{
-							// Cast Packet
-							SceNetAdhocctlChatPacketC2S * packet = (SceNetAdhocctlChatPacketC2S *)user->rx;
+		// Move Pointer
+		user = next;
+	}
+}
+
+/**
+ * Server Main Loop
+ * @param server Server Listening Socket
+ * @return OS Error Code
+ */
+int server_loop(int server)
+{
+	// Set Running Status
+	//_status = 1;
+	adhocServerRunning = true;
 
-							// Clone Buffer for Message
-							char message[64];
-							memset(message, 0, sizeof(message));
-							strncpy(message, packet->message, sizeof(message) - 1);
+	// Prepare Event Poller
+	if(!server_poller.Init())
+	{
+		adhocServerRunning = false;
+		closesocket(server);
+		return -1;
+	}
+	server_poller.Add(server);
 
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlChatPacketC2S));
+	// Create Empty Status Logfile
+	write_status();
 
-							// Spread Chat Message
-							spread_message(user, message);
-						}
-					}
+	// Ready Sockets
+	std::vector<int> ready;
 
-					// Invalid Opcode
-					else
-					{
-						// Notify User
-						uint8_t * ip = (uint8_t *)&user->resolver.ip;
-						INFO_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Logged-In State from %s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u)", user->rx[0], (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3]);
+	// Last Timeout Sweep
+	time_t last_timeout_check = time(NULL);
 
-						// Logout User
-						logout_user(user);
-					}
-				}
+	// Handling Loop
+	while (adhocServerRunning) //(_status == 1)
+	{
+		// Sleep until there's Data, waking up regularly for Timeouts and Shutdown
+		server_poller.Wait(SERVER_POLL_TIMEOUT_MS, ready);
+
+		for(size_t i = 0; i < ready.size(); i++)
+		{
+			// Login Requests
+			if(ready[i] == server) accept_logins(server);
+
+			// Data from Users (unless logged out in the meantime)
+			else
+			{
+				auto it = _db_user_by_stream.find(ready[i]);
+				if(it != _db_user_by_stream.end()) receive_user_data(it->second);
 			}
+		}
 
-			// Move Pointer
-			user = next;
+		// Timeouts only have second granularity
+		time_t now = time(NULL);
+		if(now != last_timeout_check)
+		{
+			check_user_timeouts();
+			last_timeout_check = now;
 		}
 
-		// Prevent needless CPU Overload (1ms Sleep)
-		sleep_ms(1);
+		// Batched Status Update
+		if(status_dirty && real_time_now() - status_last_write >= SERVER_STATUS_INTERVAL) write_status();
 
 		// Don't do anything if it's paused, otherwise the log will be flooded
 		while (adhocServerRunning && Core_IsStepping()) sleep_ms(1);
@@ -2031,7 +2295,11 @@ int server_loop(int server)
 	// Free User Database Memory
 	free_database();
 
+	// Final Status
+	write_status();
+
 	// Close Server Socket
+	server_poller.Shutdown();
 	closesocket(server);
 
 	// Return Success
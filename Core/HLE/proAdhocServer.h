@@ -31,10 +31,10 @@
 //#define SERVER_PORT 27312
 
 // Listener Connection Backlog (aka. Max Concurrent Logins)
-#define SERVER_LISTEN_BACKLOG 128
+#define SERVER_LISTEN_BACKLOG 1024
 
 // Server User Maximum
-#define SERVER_USER_MAXIMUM 1024
+#define SERVER_USER_MAXIMUM 16384
 
 // Server User Timeout (in seconds)
 #define SERVER_USER_TIMEOUT 15
@@ -45,6 +45,12 @@
 // Server Status Logfile
 #define SERVER_STATUS_XMLOUT "www/status.xml"
 
+// Minimum Interval between Status Logfile Updates (in seconds)
+#define SERVER_STATUS_INTERVAL 2.0
+
+// Longest Sleep waiting for Socket Activity (in milliseconds)
+#define SERVER_POLL_TIMEOUT_MS 100
+
 // Server Shutdown Message
 #define SERVER_SHUTDOWN_MESSAGE "PROMETHEUS HUB IS SHUTTING DOWN!"
 
@@ -356,7 +362,7 @@ void game_product_override(SceNetAdhocctlProductCode * product);
 /* STATUS */
 
 /**
- * Update Status Logfile
+ * Update Status Logfile (deferred, see SERVER_STATUS_INTERVAL)
  */
 void update_status(void);
 
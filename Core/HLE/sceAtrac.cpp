@@ -27,6 +27,7 @@
 #include "Core/Debugger/Breakpoints.h"
 #include "Core/HW/MediaEngine.h"
 #include "Core/HW/BufferQueue.h"
+#include "Core/Util/AudioFormat.h"
 #include "Common/ChunkFile.h"
 
 #include "Core/HLE/sceKernel.h"
@@ -1137,6 +1138,17 @@ static u32 sceAtracAddStreamData(int atracID, u32 bytesToAdd) {
 	return hleLogSuccessI(ME, 0);
 }
 
+#ifdef USE_FFMPEG
+// Decoded frames are planar float.  Unless the channel count changes, we can convert them directly.
+static int __AtracConvertFrame(Atrac *atrac, u8 *out, const u8 **inbuf, int numSamples) {
+	if (atrac->frame_->format == AV_SAMPLE_FMT_FLTP && atrac->frame_->channels == atrac->outputChannels_) {
+		ConvertPlanarF32ToS16((s16 *)out, (const float *const *)inbuf, atrac->outputChannels_, numSamples);
+		return numSamples;
+	}
+	return swr_convert(atrac->swrCtx_, &out, numSamples, inbuf, numSamples);
+}
+#endif // USE_FFMPEG
+
 u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u32 *finish, int *remains) {
 	Atrac *atrac = getAtrac(atracID);
 
@@ -1218,7 +1230,7 @@ u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u3
 								atrac->frame_->extended_data[0] + inbufOffset,
 								atrac->frame_->extended_data[1] + inbufOffset,
 							};
-							int avret = swr_convert(atrac->swrCtx_, &out, numSamples, inbuf, numSamples);
+							int avret = __AtracConvertFrame(atrac, out, inbuf, numSamples);
 							if (outbufPtr != 0) {
 								u32 outBytes = numSamples * atrac->outputChannels_ * sizeof(s16);
 								CBreakPoints::ExecMemCheck(outbufPtr, true, outBytes, currentMIPS->pc);
@@ -2445,8 +2457,7 @@ static int sceAtracLowLevelDecode(int atracID, u32 sourceAddr, u32 sourceBytesCo
 			numSamples = atrac->frame_->nb_samples;
 
 			u8 *out = outp;
-			int avret = swr_convert(atrac->swrCtx_, &out, numSamples,
-				(const u8**)atrac->frame_->extended_data, numSamples);
+			int avret = __AtracConvertFrame(atrac, out, (const u8 **)atrac->frame_->extended_data, numSamples);
 			u32 outBytes = numSamples * atrac->outputChannels_ * sizeof(s16);
 			CBreakPoints::ExecMemCheck(samplesAddr, true, outBytes, currentMIPS->pc);
 			if (avret < 0) {
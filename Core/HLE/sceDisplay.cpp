@@ -20,12 +20,6 @@
 #include <cmath>
 #include <algorithm>
 
-// TODO: Move this somewhere else, cleanup.
-#ifndef _WIN32
-#include <unistd.h>
-#include <sys/time.h>
-#endif
-
 // TODO: Move the relevant parts into common. Don't want the core
 // to be dependent on "native", I think. Or maybe should get rid of common
 // and move everything into native...
@@ -42,6 +36,7 @@
 #include "Core/CoreParameter.h"
 #include "Core/Host.h"
 #include "Core/Reporting.h"
+#include "Core/SaveState.h"
 #include "Core/System.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
@@ -49,6 +44,9 @@
 #include "Core/HLE/sceKernel.h"
 #include "Core/HLE/sceKernelThread.h"
 #include "Core/HLE/sceKernelInterrupt.h"
+#include "Core/HW/MediaEngine.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/Util/FramePacer.h"
 
 #include "GPU/GPU.h"
 #include "GPU/GPUState.h"
@@ -107,6 +105,7 @@ static int width;
 static int height;
 static bool wasPaused;
 static bool flippedThisFrame;
+static bool speculativeFrame;
 
 // 1.001f to compensate for the classic 59.94 NTSC framerate that the PSP seems to have.
 static const double timePerVblank = 1.001f / 60.0f;
@@ -115,6 +114,8 @@ static const double timePerVblank = 1.001f / 60.0f;
 static double curFrameTime;
 static double lastFrameTime;
 static double nextFrameTime;
+// When the last throttled wait ended, for the pacing telemetry.
+static double lastPacedFrameEnd;
 static int numVBlanks;
 static int numVBlanksSinceFlip;
 
@@ -205,6 +206,7 @@ void __DisplayInit() {
 	lastFlipCycles = 0;
 	nextFlipCycles = 0;
 	wasPaused = false;
+	speculativeFrame = false;
 
 	enterVblankEvent = CoreTiming::RegisterEvent("EnterVBlank", &hleEnterVblank);
 	leaveVblankEvent = CoreTiming::RegisterEvent("LeaveVBlank", &hleLeaveVblank);
@@ -221,6 +223,8 @@ void __DisplayInit() {
 	curFrameTime = 0.0;
 	nextFrameTime = 0.0;
 	lastFrameTime = 0.0;
+	lastPacedFrameEnd = 0.0;
+	FramePacer::Reset();
 
 	flips = 0;
 	fps = 0.0;
@@ -463,16 +467,33 @@ static void CalculateFPS() {
 void __DisplayGetDebugStats(char *stats, size_t bufsize) {
 	char statbuf[4096];
 	gpu->GetStats(statbuf, sizeof(statbuf));
+	char videobuf[256];
+	GetMediaEngineDebugStats(videobuf, sizeof(videobuf));
+	char pacingbuf[256] = "";
+	const FramePacingStats pacing = FramePacer::GetStats();
+	if (pacing.frames != 0) {
+		snprintf(pacingbuf, sizeof(pacingbuf), "Frame pacing: %0.2f ms avg error, %0.2f ms worst, %0.2f ms spin margin\n",
+			pacing.avgSleepError * 1000.0, pacing.maxSleepError * 1000.0, pacing.spinMargin * 1000.0);
+	}
+	char runaheadbuf[256];
+	SaveState::GetRunAheadDebugStats(runaheadbuf, sizeof(runaheadbuf));
 
 	snprintf(stats, bufsize,
 		"Kernel processing time: %0.2f ms\n"
 		"Slowest syscall: %s : %0.2f ms\n"
-		"Most active syscall: %s : %0.2f ms\n%s",
+		"Most active syscall: %s : %0.2f ms\n"
+		"Jit invalidations: %d (%d blocks), %0.2f ms\n%s%s%s%s",
 		kernelStats.msInSyscalls * 1000.0f,
 		kernelStats.slowestSyscallName ? kernelStats.slowestSyscallName : "(none)",
 		kernelStats.slowestSyscallTime * 1000.0f,
 		kernelStats.summedSlowestSyscallName ? kernelStats.summedSlowestSyscallName : "(none)",
 		kernelStats.summedSlowestSyscallTime * 1000.0f,
+		jitInvalidateStats.numInvalidations,
+		jitInvalidateStats.numBlocksInvalidated,
+		jitInvalidateStats.secondsInvalidating * 1000.0,
+		videobuf,
+		pacingbuf,
+		runaheadbuf,
 		statbuf);
 }
 
@@ -485,6 +506,15 @@ void __DisplaySetWasPaused() {
 	wasPaused = true;
 }
 
+void __DisplaySetSpeculative(bool speculative, bool draw) {
+	speculativeFrame = speculative;
+	if (draw) {
+		gstate_c.skipDrawReason &= ~(SKIPDRAW_SKIPFRAME | SKIPDRAW_TURBO);
+	} else {
+		gstate_c.skipDrawReason |= SKIPDRAW_SKIPFRAME;
+	}
+}
+
 static bool FrameTimingThrottled() {
 	if (PSP_CoreParameter().fpsLimit == FPS_LIMIT_CUSTOM && g_Config.iFpsLimit == 0) {
 		return false;
@@ -492,6 +522,14 @@ static bool FrameTimingThrottled() {
 	return !PSP_CoreParameter().unthrottle;
 }
 
+bool __DisplayIsTurbo() {
+	return g_Config.bTurboUnthrottle && !FrameTimingThrottled();
+}
+
+static int TurboMaxSkippedFrames() {
+	return std::max(g_Config.iTurboRenderInterval, 1) - 1;
+}
+
 static void DoFrameDropLogging(float scaledTimestep) {
 	if (lastFrameTime != 0.0 && !wasPaused && lastFrameTime + scaledTimestep < curFrameTime) {
 		const double actualTimestep = curFrameTime - lastFrameTime;
@@ -513,10 +551,10 @@ static void DoFrameTiming(bool &throttle, bool &skipFrame, float timestep) {
 	// we have nothing to do here.
 	bool doFrameSkip = g_Config.iFrameSkip != 0;
 
-	if (!throttle && g_Config.bFrameSkipUnthrottle) {
+	if (!throttle && (g_Config.bFrameSkipUnthrottle || g_Config.bTurboUnthrottle)) {
 		doFrameSkip = true;
 		skipFrame = true;
-		if (numSkippedFrames >= 7) {
+		if (numSkippedFrames >= (g_Config.bTurboUnthrottle ? TurboMaxSkippedFrames() : 7)) {
 			skipFrame = false;
 		}
 		return;
@@ -563,25 +601,33 @@ static void DoFrameTiming(bool &throttle, bool &skipFrame, float timestep) {
 			skipFrame = true;
 	}
 
+	const double waitStart = curFrameTime;
+	double spinSeconds = 0.0;
+	bool waited = false;
 	if (curFrameTime < nextFrameTime && throttle) {
 		// If time gap is huge just jump (somebody unthrottled)
 		if (nextFrameTime - curFrameTime > 2*scaledTimestep) {
 			nextFrameTime = curFrameTime;
 		} else {
 			// Wait until we've caught up.
-			while (time_now_d() < nextFrameTime) {
-#ifdef _WIN32
-				sleep_ms(1); // Sleep for 1ms on this thread
-#else
-				const double left = nextFrameTime - curFrameTime;
-				usleep((long)(left * 1000000));
-#endif
-				time_update();
-			}
+			spinSeconds = FramePacer::WaitUntil(nextFrameTime);
+			waited = true;
 		}
 		curFrameTime = time_now_d();
 	}
 
+	if (throttle) {
+		FrameTimingSample sample;
+		sample.start = lastPacedFrameEnd == 0.0 || wasPaused ? waitStart : lastPacedFrameEnd;
+		sample.end = curFrameTime;
+		sample.emuSeconds = waitStart - sample.start;
+		sample.deadline = nextFrameTime;
+		sample.sleepError = waited ? curFrameTime - nextFrameTime : 0.0;
+		sample.spinSeconds = spinSeconds;
+		FramePacer::RecordFrame(sample);
+		lastPacedFrameEnd = curFrameTime;
+	}
+
 	lastFrameTime = nextFrameTime;
 	wasPaused = false;
 }
@@ -611,15 +657,7 @@ static void DoFrameIdleTiming() {
 	// Give a little extra wiggle room in case the next vblank does more work.
 	const double goal = lastFrameTime + (numVBlanksSinceFlip - 1) * scaledVblank - 0.001;
 	if (numVBlanksSinceFlip >= 2 && time_now_d() < goal) {
-		while (time_now_d() < goal) {
-#ifdef _WIN32
-			sleep_ms(1);
-#else
-			const double left = goal - time_now_d();
-			usleep((long)(left * 1000000));
-#endif
-			time_update();
-		}
+		FramePacer::WaitUntil(goal);
 	}
 }
 
@@ -660,7 +698,8 @@ void hleEnterVblank(u64 userdata, int cyclesLate) {
 	// Trigger VBlank interrupt handlers.
 	__TriggerInterrupt(PSP_INTR_IMMEDIATE | PSP_INTR_ONLY_IF_ENABLED | PSP_INTR_ALWAYS_RESCHED, PSP_VBLANK_INTR, PSP_INTR_SUB_ALL);
 
-	numVBlanks++;
+	if (!speculativeFrame)
+		numVBlanks++;
 	numVBlanksSinceFlip++;
 
 	// TODO: Should this be done here or in hleLeaveVblank?
@@ -689,7 +728,16 @@ void __DisplayFlip(int cyclesLate) {
 	if (shaderInfo && g_Config.iRenderingMode != FB_NON_BUFFERED_MODE)
 		postEffectRequiresFlip = shaderInfo->requires60fps;
 	const bool fbDirty = gpu->FramebufferDirty();
-	if (fbDirty || noRecentFlip || postEffectRequiresFlip) {
+	if ((fbDirty || noRecentFlip || postEffectRequiresFlip) && speculativeFrame) {
+		// Running ahead: the real frame was already timed, and what's drawn is decided for us.
+		const bool fbReallyDirty = gpu->FramebufferReallyDirty();
+		if ((fbReallyDirty || noRecentFlip || postEffectRequiresFlip) && coreState == CORE_RUNNING) {
+			coreState = CORE_NEXTFRAME;
+			gpu->CopyDisplayToOutput();
+		}
+		CoreTiming::ScheduleEvent(0 - cyclesLate, afterFlipEvent, 0);
+		numVBlanksSinceFlip = 0;
+	} else if (fbDirty || noRecentFlip || postEffectRequiresFlip) {
 		CalculateFPS();
 
 		// Let the user know if we're running slow, so they know to adjust settings.
@@ -728,9 +776,12 @@ void __DisplayFlip(int cyclesLate) {
 		DoFrameTiming(throttle, skipFrame, (float)numVBlanksSinceFlip * timePerVblank);
 
 		int maxFrameskip = 8;
+		const bool turbo = !throttle && g_Config.bTurboUnthrottle;
 		if (throttle) {
 			// 4 here means 1 drawn, 4 skipped - so 12 fps minimum.
 			maxFrameskip = g_Config.iFrameSkip;
+		} else if (turbo) {
+			maxFrameskip = TurboMaxSkippedFrames();
 		}
 		if (numSkippedFrames >= maxFrameskip) {
 			skipFrame = false;
@@ -738,9 +789,13 @@ void __DisplayFlip(int cyclesLate) {
 
 		if (skipFrame) {
 			gstate_c.skipDrawReason |= SKIPDRAW_SKIPFRAME;
+			if (turbo)
+				gstate_c.skipDrawReason |= SKIPDRAW_TURBO;
+			else
+				gstate_c.skipDrawReason &= ~SKIPDRAW_TURBO;
 			numSkippedFrames++;
 		} else {
-			gstate_c.skipDrawReason &= ~SKIPDRAW_SKIPFRAME;
+			gstate_c.skipDrawReason &= ~(SKIPDRAW_SKIPFRAME | SKIPDRAW_TURBO);
 			numSkippedFrames = 0;
 		}
 
@@ -750,7 +805,7 @@ void __DisplayFlip(int cyclesLate) {
 
 		CoreTiming::ScheduleEvent(0 - cyclesLate, afterFlipEvent, 0);
 		numVBlanksSinceFlip = 0;
-	} else {
+	} else if (!speculativeFrame) {
 		// Okay, there's no new frame to draw.  But audio may be playing, so we need to time still.
 		DoFrameIdleTiming();
 	}
@@ -794,13 +849,9 @@ void hleLagSync(u64 userdata, int cyclesLate) {
 
 	const double goal = lastLagSync + (scale / 1000.0f);
 	time_update();
-	// Don't lag too long ever, if they leave it paused.
-	while (time_now_d() < goal && goal < time_now_d() + 0.01) {
-#ifndef _WIN32
-		const double left = goal - time_now_d();
-		usleep((long)(left * 1000000));
-#endif
-		time_update();
+	// Don't lag too long ever, if they leave it paused.  Frames run ahead don't wait at all.
+	if (!speculativeFrame && time_now_d() < goal && goal < time_now_d() + 0.01) {
+		FramePacer::WaitUntil(goal);
 	}
 
 	const int emuOver = (int)cyclesToUs(cyclesLate);
@@ -46,5 +46,9 @@ int __DisplayGetFlipCount();
 
 // Call this when resuming to avoid a small speedup burst
 void __DisplaySetWasPaused();
+// Unthrottled with bTurboUnthrottle: most frames aren't drawn, and SAS and audio aren't mixed.
+bool __DisplayIsTurbo();
+// Run-ahead frames aren't timed or counted, and whether they're drawn is up to the caller.
+void __DisplaySetSpeculative(bool speculative, bool draw);
 
 void Register_sceDisplay_driver();
@@ -36,6 +36,7 @@
 #include "Core/HLE/KernelWaitHelpers.h"
 #include "GPU/GPUState.h"
 #include "GPU/GPUInterface.h"
+#include "GPU/Debugger/Record.h"
 
 static const int LIST_ID_MAGIC = 0x35000000;
 
@@ -249,6 +250,7 @@ void __GeDoState(PointerWrap &p) {
 }
 
 void __GeShutdown() {
+	GPURecord::ReplayShutdown();
 }
 
 bool __GeTriggerSync(GPUSyncType type, int id, u64 atTicks) {
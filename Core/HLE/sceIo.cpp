@@ -17,9 +17,7 @@
 
 #include <cstdlib>
 #include <set>
-#include <thread>
 
-#include "thread/threadutil.h"
 #include "profiler/profiler.h"
 
 #include "Core/Core.h"
@@ -128,7 +126,6 @@ static MemStickFatState lastMemStickFatState;
 
 static AsyncIOManager ioManager;
 static bool ioManagerThreadEnabled = false;
-static std::thread *ioManagerThread;
 
 // TODO: Is it better to just put all on the thread?
 // Let's try. (was 256)
@@ -490,15 +487,8 @@ static DirectoryFileSystem *flash0System = nullptr;
 static VFSFileSystem *flash0System = nullptr;
 #endif
 
-static void __IoManagerThread() {
-	setCurrentThreadName("IO");
-	while (ioManagerThreadEnabled && coreState != CORE_ERROR && coreState != CORE_POWERDOWN) {
-		ioManager.RunEventsUntil(CoreTiming::GetTicks() + msToCycles(1000));
-	}
-}
-
 static void __IoWakeManager() {
-	// Ping the thread so that it knows to check coreState.
+	// Ping the threads so that they know to check coreState.
 	ioManagerThreadEnabled = false;
 	ioManager.FinishEventLoop();
 }
@@ -585,11 +575,9 @@ void __IoInit() {
 	memset(fds, 0, sizeof(fds));
 
 	ioManagerThreadEnabled = g_Config.bSeparateIOThread;
-	ioManager.SetThreadEnabled(ioManagerThreadEnabled);
+	ioManager.Startup(ioManagerThreadEnabled, g_Config.iIOThreadCount);
 	if (ioManagerThreadEnabled) {
 		Core_ListenShutdown(&__IoWakeManager);
-		ioManagerThread = new std::thread(&__IoManagerThread);
-		ioManagerThread->detach();
 	}
 
 	__KernelRegisterWaitTypeFuncs(WAITTYPE_ASYNCIO, __IoAsyncBeginCallback, __IoAsyncEndCallback);
@@ -639,11 +627,7 @@ void __IoShutdown() {
 	ioManagerThreadEnabled = false;
 	ioManager.SyncThread();
 	ioManager.FinishEventLoop();
-	if (ioManagerThread != NULL) {
-		delete ioManagerThread;
-		ioManagerThread = NULL;
-		ioManager.Shutdown();
-	}
+	ioManager.Shutdown();
 
 	pspFileSystem.Unmount("ms0:", memstickSystem);
 	pspFileSystem.Unmount("fatms0:", memstickSystem);
@@ -907,7 +891,7 @@ static bool __IoRead(int &result, int id, u32 data_addr, int size, int &us) {
 				// If there's a pending operation on this file, wait for it to finish and don't overwrite it.
 				useThread = !ioManager.HasOperation(f->handle);
 				if (!useThread) {
-					ioManager.SyncThread();
+					ioManager.SyncHandle(f->handle);
 				}
 			}
 			if (useThread) {
@@ -1042,7 +1026,7 @@ static bool __IoWrite(int &result, int id, u32 data_addr, int size, int &us) {
 			// If there's a pending operation on this file, wait for it to finish and don't overwrite it.
 			useThread = !ioManager.HasOperation(f->handle);
 			if (!useThread) {
-				ioManager.SyncThread();
+				ioManager.SyncHandle(f->handle);
 			}
 		}
 		if (useThread) {
@@ -1200,7 +1184,7 @@ static s64 __IoLseekDest(FileNode *f, s64 offset, int whence, FileMove &seek) {
 
 	// Let's make sure this isn't incorrect mid-operation.
 	if (ioManager.HasOperation(f->handle)) {
-		ioManager.SyncThread();
+		ioManager.SyncHandle(f->handle);
 	}
 
 	s64 newPos = 0;
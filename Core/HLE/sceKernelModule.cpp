@@ -1270,6 +1270,7 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, size_t elfSize, u32 loadAdd
 
 		// If the ELF has debug symbols, don't add entries to the symbol table.
 		bool insertSymbols = scan && !reader.LoadSymbols();
+		std::vector<std::pair<u32, u32>> scanRanges;
 		std::vector<SectionID> codeSections = reader.GetCodeSections();
 		for (SectionID id : codeSections) {
 			u32 start = reader.GetSectionAddr(id);
@@ -1282,7 +1283,7 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, size_t elfSize, u32 loadAdd
 				module->textEnd = end;
 
 			if (scan) {
-				insertSymbols = MIPSAnalyst::ScanForFunctions(start, end, insertSymbols);
+				scanRanges.push_back(std::make_pair(start, end));
 			}
 		}
 
@@ -1292,17 +1293,18 @@ static Module *__KernelLoadELFFromPtr(const u8 *ptr, size_t elfSize, u32 loadAdd
 			u32 scanEnd = module->textEnd;
 			// Skip the exports and imports sections, they're not code.
 			if (scanEnd >= std::min(modinfo->libent, modinfo->libstub)) {
-				insertSymbols = MIPSAnalyst::ScanForFunctions(scanStart, std::min(modinfo->libent, modinfo->libstub) - 4, insertSymbols);
+				scanRanges.push_back(std::make_pair(scanStart, std::min(modinfo->libent, modinfo->libstub) - 4));
 				scanStart = std::min(modinfo->libentend, modinfo->libstubend);
 			}
 			if (scanEnd >= std::max(modinfo->libent, modinfo->libstub)) {
-				insertSymbols = MIPSAnalyst::ScanForFunctions(scanStart, std::max(modinfo->libent, modinfo->libstub) - 4, insertSymbols);
+				scanRanges.push_back(std::make_pair(scanStart, std::max(modinfo->libent, modinfo->libstub) - 4));
 				scanStart = std::max(modinfo->libentend, modinfo->libstubend);
 			}
-			insertSymbols = MIPSAnalyst::ScanForFunctions(scanStart, scanEnd, insertSymbols);
+			scanRanges.push_back(std::make_pair(scanStart, scanEnd));
 		}
 
 		if (scan) {
+			insertSymbols = MIPSAnalyst::ScanForFunctions(scanRanges, insertSymbols);
 			MIPSAnalyst::FinalizeScan(insertSymbols);
 		}
 	}
@@ -24,6 +24,7 @@
 #include "Core/MemMapHelpers.h"
 #include "Common/ChunkFile.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 
 #include "Core/HLE/HLEHelperThread.h"
 #include "Core/HLE/FunctionWrappers.h"
@@ -49,7 +50,6 @@ int netAdhocMatchingStarted = 0;
 SceUID threadAdhocID;
 
 std::mutex adhocEvtMtx;
-std::vector<std::pair<u32, u32>> adhocctlEvents;
 std::vector<u64> matchingEvents;
 u32 dummyThreadHackAddr = 0;
 u32_le dummyThreadCode[3];
@@ -92,7 +92,7 @@ void __NetAdhocShutdown() {
 }
 
 void __NetAdhocDoState(PointerWrap &p) {
-	auto s = p.Section("sceNetAdhoc", 1, 2);
+	auto s = p.Section("sceNetAdhoc", 1, 3);
 	if (!s)
 		return;
 
@@ -116,11 +116,13 @@ void __NetAdhocDoState(PointerWrap &p) {
 	if (dummyThreadHackAddr) {
 		Memory::Memcpy(dummyThreadHackAddr, dummyThreadCode, sizeof(dummyThreadCode));
 	}
-}
 
-void __UpdateAdhocctlHandlers(u32 flag, u32 error) {
-	std::lock_guard<std::mutex> adhocGuard(adhocEvtMtx);
-	adhocctlEvents.push_back({ flag, error });
+	if (s >= 3) {
+		p.Do(actionAfterAdhocctlMipsCall);
+		__KernelRestoreActionType(actionAfterAdhocctlMipsCall, AfterAdhocctlMipsCall::Create);
+	} else if (p.mode == p.MODE_READ) {
+		actionAfterAdhocctlMipsCall = __KernelRegisterActionType(AfterAdhocctlMipsCall::Create);
+	}
 }
 
 // TODO: MipsCall needs to be called from it's own PSP Thread instead of from any random PSP Thread
@@ -152,6 +154,7 @@ void __NetAdhocInit() {
 	dummyThreadHackAddr = kernelMemory.Alloc(blockSize, false, "dummythreadhack");
 	Memory::Memcpy(dummyThreadHackAddr, dummyThreadCode, sizeof(dummyThreadCode)); // This area will be cleared again after loading an old savestate :(
 	actionAfterMatchingMipsCall = __KernelRegisterActionType(AfterMatchingMipsCall::Create);
+	actionAfterAdhocctlMipsCall = __KernelRegisterActionType(AfterAdhocctlMipsCall::Create);
 	// Create built-in AdhocServer Thread
 	if (g_Config.bEnableWlan && g_Config.bEnableAdhocServer) {
 		adhocServerRunning = true;
@@ -195,6 +198,7 @@ static u32 sceNetAdhocctlInit(int stackSize, int prio, u32 productAddr) {
 	if(g_Config.bEnableWlan) {
 		if (initNetwork((SceNetAdhocctlAdhocId *)Memory::GetPointer(productAddr)) == 0) {
 			if (!friendFinderRunning) {
+				adhocReactor.Init();
 				friendFinderRunning = true;
 				friendFinderThread = std::thread(friendFinder);
 			}
@@ -306,6 +310,7 @@ static int sceNetAdhocPdpCreate(const char *mac, u32 port, int bufferSize, u32 u
 
 								// Link Socket to Translator ID
 								pdp[i] = internal;
+								adhocReactor.WatchSocket(ADHOC_REACTOR_PDP, i + 1, usocket);
 
 								// Forward Port on Router
 								//sceNetPortOpen("UDP", sport); // I need to figure out how to use this in windows/linux
@@ -575,6 +580,9 @@ static int sceNetAdhocPdpRecv(int id, void *addr, void * port, void *buf, void *
 			// Valid Arguments
 			if (saddr != NULL && port != NULL && buf != NULL && len != NULL && *len > 0) { 
 #ifndef PDP_DIRTY_MAGIC
+				// Nothing arrived yet, no need to ask the socket
+				if (flag == 1 && !adhocReactor.MayHaveData(ADHOC_REACTOR_PDP, id)) return ERROR_NET_ADHOC_WOULD_BLOCK;
+
 				// Schedule Timeout Removal
 				if (flag == 1) timeout = 0;
 #else
@@ -612,12 +620,14 @@ static int sceNetAdhocPdpRecv(int id, void *addr, void * port, void *buf, void *
 
 				// Receive Data
 				changeBlockingMode(socket->id, flag);
+				JitPageProtect::HostWriteScope hostWrite(buf, *len);
 				int received = recvfrom(socket->id, (char *)buf, *len,0,(sockaddr *)&sin, &sinlen);
 				int error = errno;
 				if (received == SOCKET_ERROR) {
 					VERBOSE_LOG(SCENET, "Socket Error (%i) on sceNetAdhocPdpRecv [size=%i]", error, *len);
 				}
 				changeBlockingMode(socket->id, 0); 
+				adhocReactor.Consumed(ADHOC_REACTOR_PDP, id, received >= 0, received == SOCKET_ERROR && error == EAGAIN);
 
 				// Received Data
 				if (received >= 0) {
@@ -812,6 +822,7 @@ static int sceNetAdhocPdpDelete(int id, int unknown) {
 			// Valid Socket
 			if (sock != NULL) {
 				// Close Connection
+				adhocReactor.UnwatchSocket(ADHOC_REACTOR_PDP, id);
 				closesocket(sock->id);
 
 				// Remove Port Forward from Router
@@ -1097,10 +1108,7 @@ static u32 sceNetAdhocctlDisconnect() {
 		}
 		
 		// Notify Event Handlers (even if we weren't connected, not doing this will freeze games like God Eater, which expect this behaviour)
-		{
-			std::lock_guard<std::mutex> adhocGuard(adhocEvtMtx);
-			adhocctlEvents.push_back({ ADHOCCTL_EVENT_DISCONNECT, 0 });
-		}
+		notifyAdhocctlHandlers(ADHOCCTL_EVENT_DISCONNECT, 0, adhocNowUs());
 		// Return Success, some games might ignore returned value and always treat it as success, otherwise repeatedly calling this function
 		return 0;
 	}
@@ -1129,9 +1137,12 @@ int sceNetAdhocctlTerm() {
 	if (netAdhocctlInited) {
 		netAdhocctlInited = false;
 		friendFinderRunning = false;
+		adhocReactor.Wake();
 		if (friendFinderThread.joinable()) {
 			friendFinderThread.join();
 		}
+		adhocReactor.LogStats();
+		adhocReactor.Shutdown();
 		//May also need to clear Handlers
 		adhocctlHandlers.clear();
 		// Free stuff here
@@ -1697,6 +1708,7 @@ static int sceNetAdhocPtpOpen(const char *srcmac, int sport, const char *dstmac,
 									
 									// Link PTP Socket
 									ptp[i] = internal;
+									adhocReactor.WatchSocket(ADHOC_REACTOR_PTP, i + 1, tcpsocket);
 									
 									// Add Port Forward to Router
 									// sceNetPortOpen("TCP", sport);
@@ -1866,6 +1878,7 @@ static int sceNetAdhocPtpAccept(int id, u32 peerMacAddrPtr, u32 peerPortPtr, int
 										
 										// Link PTP Socket
 										ptp[i] = internal;
+										adhocReactor.WatchSocket(ADHOC_REACTOR_PTP, i + 1, newsocket);
 										
 										// Add Port Forward to Router
 										// sceNetPortOpen("TCP", internal->lport);
@@ -2055,6 +2068,7 @@ static int sceNetAdhocPtpClose(int id, int unknown) {
 			SceNetAdhocPtpStat * socket = ptp[id - 1];
 			
 			// Close Connection
+			adhocReactor.UnwatchSocket(ADHOC_REACTOR_PTP, id);
 			closesocket(socket->id);
 			
 			// Remove Port Forward from Router
@@ -2328,6 +2342,9 @@ static int sceNetAdhocPtpRecv(int id, u32 dataAddr, u32 dataSizeAddr, int timeou
 			
 			// Valid Arguments
 			if (buf != NULL && len != NULL && *len > 0) {
+				// Nothing arrived yet, no need to ask the socket
+				if (flag && !adhocReactor.MayHaveData(ADHOC_REACTOR_PTP, id)) return ERROR_NET_ADHOC_WOULD_BLOCK;
+
 				// Schedule Timeout Removal
 				if (flag) timeout = 0;
 				
@@ -2339,9 +2356,11 @@ static int sceNetAdhocPtpRecv(int id, u32 dataAddr, u32 dataSizeAddr, int timeou
 				
 				// Receive Data
 				changeBlockingMode(socket->id, flag);
+				JitPageProtect::HostWriteScope hostWrite(buf, *len);
 				int received = recv(socket->id, (char *)buf, *len, 0);
 				int error = errno;
 				changeBlockingMode(socket->id, 0);
+				adhocReactor.Consumed(ADHOC_REACTOR_PTP, id, received > 0, received == -1 && error == EAGAIN);
 				
 				// Free Network Lock
 				// _freeNetworkLock();
@@ -3469,23 +3488,28 @@ int sceNetAdhocMatchingGetPoolStat(u32 poolstatPtr) {
 
 void __NetTriggerCallbacks()
 {
-	{
-		std::lock_guard<std::mutex> adhocGuard(adhocEvtMtx);
-
-		for (auto &params : adhocctlEvents)
-		{
-			int flags = params.first;
-			int error = params.second;
-			u32 args[3] = { 0, 0, 0 };
-			args[0] = flags;
-			args[1] = error;
-
-			for (std::map<int, AdhocctlHandler>::iterator it = adhocctlHandlers.begin(); it != adhocctlHandlers.end(); ++it) {
-				args[2] = it->second.argument;
-				__KernelDirectMipsCall(it->second.entryPoint, NULL, args, 3, true);
+	// Events from the friend finder, each acknowledged once the last handler returns
+	AdhocctlReactorEvent ev;
+	while (adhocReactor.PopAdhocctl(ev)) {
+		adhocReactor.adhocctlLatency.Add(adhocNowUs() - ev.arrivalUs);
+
+		u32 args[3] = { ev.flag, ev.error, 0 };
+		size_t remaining = adhocctlHandlers.size();
+		for (std::map<int, AdhocctlHandler>::iterator it = adhocctlHandlers.begin(); it != adhocctlHandlers.end(); ++it) {
+			AfterAdhocctlMipsCall *after = NULL;
+			if (--remaining == 0) {
+				after = (AfterAdhocctlMipsCall *)__KernelCreateAction(actionAfterAdhocctlMipsCall);
+				after->SetSequence(ev.sequence);
 			}
+			args[2] = it->second.argument;
+			__KernelDirectMipsCall(it->second.entryPoint, after, args, 3, true);
 		}
-		adhocctlEvents.clear();
+		if (adhocctlHandlers.empty())
+			adhocReactor.AdhocctlDelivered(ev.sequence);
+	}
+
+	{
+		std::lock_guard<std::mutex> adhocGuard(adhocEvtMtx);
 
 		for (auto &param : matchingEvents)
 		{
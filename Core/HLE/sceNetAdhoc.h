@@ -24,7 +24,6 @@ void Register_sceNetAdhoc();
 void __NetAdhocInit();
 void __NetAdhocShutdown();
 void __NetAdhocDoState(PointerWrap &p);
-void __UpdateAdhocctlHandlers(u32 flags, u32 error);
 void __UpdateMatchingHandler(u64 params);
 
 // I have to call this from netdialog
@@ -45,6 +45,7 @@
 #include "Core/MemMap.h"
 #include "Core/Reporting.h"
 
+#include "Core/HLE/sceDisplay.h"
 #include "Core/HLE/sceSas.h"
 #include "Core/HLE/sceKernel.h"
 #include "Core/HLE/sceKernelThread.h"
@@ -89,6 +90,7 @@ struct SasThreadParams {
 	u32 inAddr;
 	int leftVol;
 	int rightVol;
+	bool silent;
 };
 
 static std::thread *sasThread;
@@ -107,7 +109,10 @@ int __SasThread() {
 	while (sasThreadState != SasThreadState::DISABLED) {
 		sasWake.wait(guard);
 		if (sasThreadState == SasThreadState::QUEUED) {
-			sas->Mix(sasThreadParams.outAddr, sasThreadParams.inAddr, sasThreadParams.leftVol, sasThreadParams.rightVol);
+			if (sasThreadParams.silent)
+				sas->MixSilent(sasThreadParams.outAddr);
+			else
+				sas->Mix(sasThreadParams.outAddr, sasThreadParams.inAddr, sasThreadParams.leftVol, sasThreadParams.rightVol);
 
 			sasDoneMutex.lock();
 			sasThreadState = SasThreadState::READY;
@@ -125,9 +130,14 @@ static void __SasDrain() {
 }
 
 static void __SasEnqueueMix(u32 outAddr, u32 inAddr = 0, int leftVol = 0, int rightVol = 0) {
+	// Nobody's listening in turbo, so skip the actual mixing.
+	const bool silent = __DisplayIsTurbo();
 	if (sasThreadState == SasThreadState::DISABLED) {
 		// No thread, call it immediately.
-		sas->Mix(outAddr, inAddr, leftVol, rightVol);
+		if (silent)
+			sas->MixSilent(outAddr);
+		else
+			sas->Mix(outAddr, inAddr, leftVol, rightVol);
 		return;
 	}
 
@@ -142,6 +152,7 @@ static void __SasEnqueueMix(u32 outAddr, u32 inAddr = 0, int leftVol = 0, int ri
 	sasThreadParams.inAddr = inAddr;
 	sasThreadParams.leftVol = leftVol;
 	sasThreadParams.rightVol = rightVol;
+	sasThreadParams.silent = silent;
 
 	// And now, notify.
 	sasWakeMutex.lock();
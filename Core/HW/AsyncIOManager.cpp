@@ -15,8 +15,12 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
+
+#include "thread/threadutil.h"
 
 #include "Common/ChunkFile.h"
 #include "Core/MIPS/MIPS.h"
@@ -25,6 +29,95 @@
 #include "Core/HW/AsyncIOManager.h"
 #include "Core/FileSystems/MetaFileSystem.h"
 
+void AsyncIOWorker::ProcessEvent(AsyncIOEvent ev) {
+	switch (ev.type) {
+	case IO_EVENT_READ:
+		manager_->Read(index_, ev);
+		break;
+
+	case IO_EVENT_WRITE:
+		manager_->Write(index_, ev);
+		break;
+
+	default:
+		ERROR_LOG_REPORT(SCEIO, "Unsupported IO event type");
+	}
+}
+
+AsyncIOManager::AsyncIOManager() : threadEnabled_(false), threadsRunning_(false), numWorkers_(1) {
+	for (int i = 0; i < MAX_WORKERS; ++i) {
+		workers_[i].Init(this, i);
+	}
+}
+
+AsyncIOManager::~AsyncIOManager() {
+	JoinWorkers();
+}
+
+void AsyncIOManager::Startup(bool threaded, int numWorkers) {
+	// Each worker's queue only allows one consumer, so the old threads must be gone first.
+	JoinWorkers();
+
+	threadEnabled_ = threaded;
+	numWorkers_ = threaded ? std::max(1, std::min(numWorkers, (int)MAX_WORKERS)) : 1;
+	for (int i = 0; i < MAX_WORKERS; ++i) {
+		workers_[i].SetThreadEnabled(threaded);
+	}
+
+	if (threaded) {
+		threadsRunning_ = true;
+		for (int i = 0; i < numWorkers_; ++i) {
+			threads_[i] = std::thread(&AsyncIOManager::WorkerThread, this, i);
+		}
+	}
+}
+
+void AsyncIOManager::WorkerThread(int index) {
+	setCurrentThreadName("IO");
+	AsyncIOWorker &worker = workers_[index];
+	while (threadsRunning_ && coreState != CORE_ERROR && coreState != CORE_POWERDOWN) {
+		worker.RunEventsUntil(CoreTiming::GetTicks() + msToCycles(1000));
+	}
+}
+
+void AsyncIOManager::FinishEventLoop() {
+	// Ping the threads so that they know to check coreState.
+	threadsRunning_ = false;
+	for (int i = 0; i < numWorkers_; ++i) {
+		// A worker may be just about to enter RunEventsUntil(), so queue the finish regardless.
+		workers_[i].FinishEventLoop(true);
+	}
+}
+
+void AsyncIOManager::JoinWorkers() {
+	bool any = false;
+	for (int i = 0; i < MAX_WORKERS; ++i) {
+		any = any || threads_[i].joinable();
+	}
+	if (!any) {
+		return;
+	}
+
+	FinishEventLoop();
+	for (int i = 0; i < MAX_WORKERS; ++i) {
+		if (threads_[i].joinable()) {
+			threads_[i].join();
+		}
+		// Drop any finish the worker exited without reading, so it can't end the next thread's loop early.
+		workers_[i].ClearEvents();
+	}
+}
+
+void AsyncIOManager::Shutdown() {
+	JoinWorkers();
+	resultsPending_.clear();
+	results_.clear();
+	for (int i = 0; i < MAX_WORKERS; ++i) {
+		completions_[i].clear();
+	}
+	threadEnabled_ = false;
+}
+
 bool AsyncIOManager::HasOperation(u32 handle) {
 	if (resultsPending_.find(handle) != resultsPending_.end()) {
 		return true;
@@ -36,30 +129,51 @@ bool AsyncIOManager::HasOperation(u32 handle) {
 }
 
 void AsyncIOManager::ScheduleOperation(AsyncIOEvent ev) {
-	{
-		std::lock_guard<std::mutex> guard(resultsLock_);
-		if (!resultsPending_.insert(ev.handle).second) {
-			ERROR_LOG_REPORT(SCEIO, "Scheduling operation for file %d while one is pending (type %d)", ev.handle, ev.type);
-		}
+	if (!resultsPending_.insert(ev.handle).second) {
+		ERROR_LOG_REPORT(SCEIO, "Scheduling operation for file %d while one is pending (type %d)", ev.handle, ev.type);
+	}
+	ev.scheduledTicks = CoreTiming::GetTicks();
+	WorkerFor(ev.handle).ScheduleEvent(ev);
+	if (!threadEnabled_) {
+		// Already ran synchronously, so grab the result now.
+		CollectResults();
 	}
-	ScheduleEvent(ev);
 }
 
-void AsyncIOManager::Shutdown() {
-	std::lock_guard<std::mutex> guard(resultsLock_);
-	resultsPending_.clear();
-	results_.clear();
+void AsyncIOManager::SyncThread(bool force) {
+	for (int i = 0; i < numWorkers_; ++i) {
+		workers_[i].SyncThread(force);
+	}
+	CollectResults();
+}
+
+void AsyncIOManager::SyncHandle(u32 handle) {
+	WorkerFor(handle).SyncThread();
+	CollectResults();
+}
+
+void AsyncIOManager::CollectResults() {
+	for (int i = 0; i < numWorkers_; ++i) {
+		Completion c;
+		while (completions_[i].pop(c)) {
+			if (results_.find(c.handle) != results_.end()) {
+				ERROR_LOG_REPORT(SCEIO, "Overwriting previous result for file action on handle %d", c.handle);
+			}
+			results_[c.handle] = c.result;
+		}
+	}
 }
 
 bool AsyncIOManager::HasResult(u32 handle) {
-	std::lock_guard<std::mutex> guard(resultsLock_);
+	CollectResults();
 	return results_.find(handle) != results_.end();
 }
 
 bool AsyncIOManager::PopResult(u32 handle, AsyncIOResult &result) {
-	if (results_.find(handle) != results_.end()) {
-		result = results_[handle];
-		results_.erase(handle);
+	auto it = results_.find(handle);
+	if (it != results_.end()) {
+		result = it->second;
+		results_.erase(it);
 		resultsPending_.erase(handle);
 
 		if (result.invalidateAddr && result.result > 0) {
@@ -72,37 +186,48 @@ bool AsyncIOManager::PopResult(u32 handle, AsyncIOResult &result) {
 }
 
 bool AsyncIOManager::ReadResult(u32 handle, AsyncIOResult &result) {
-	if (results_.find(handle) != results_.end()) {
-		result = results_[handle];
+	auto it = results_.find(handle);
+	if (it != results_.end()) {
+		result = it->second;
 		return true;
 	} else {
 		return false;
 	}
 }
 
-bool AsyncIOManager::WaitResult(u32 handle, AsyncIOResult &result) {
-	std::unique_lock<std::mutex> guard(resultsLock_);
-	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
-		if (PopResult(handle, result)) {
+bool AsyncIOManager::WaitForResult(u32 handle) {
+	CollectResults();
+	if (results_.find(handle) != results_.end()) {
+		return true;
+	}
+
+	AsyncIOWorker &worker = WorkerFor(handle);
+	// While the last event is processing, HasEvents() is false, so queue a sync to wait behind it.
+	worker.ScheduleEvent(IO_EVENT_SYNC);
+	while (worker.HasEvents() && threadEnabled_ && resultsPending_.find(handle) != resultsPending_.end()) {
+		{
+			std::unique_lock<std::mutex> guard(resultsWaitLock_);
+			CompletionQueue &queue = completions_[handle % numWorkers_];
+			resultsWait_.wait_for(guard, std::chrono::milliseconds(16), [&] { return !queue.empty(); });
+		}
+		CollectResults();
+		if (results_.find(handle) != results_.end()) {
 			return true;
 		}
-		resultsWait_.wait_for(guard, std::chrono::milliseconds(16));
 	}
+
+	CollectResults();
+	return results_.find(handle) != results_.end();
+}
+
+bool AsyncIOManager::WaitResult(u32 handle, AsyncIOResult &result) {
+	WaitForResult(handle);
 	return PopResult(handle, result);
 }
 
 u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 	AsyncIOResult result;
-
-	std::unique_lock<std::mutex> guard(resultsLock_);
-	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
-		if (ReadResult(handle, result)) {
-			return result.finishTicks;
-		}
-		resultsWait_.wait_for(guard, std::chrono::milliseconds(16));
-	}
+	WaitForResult(handle);
 	if (ReadResult(handle, result)) {
 		return result.finishTicks;
 	}
@@ -110,40 +235,35 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 	return 0;
 }
 
-void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
-	switch (ev.type) {
-	case IO_EVENT_READ:
-		Read(ev.handle, ev.buf, ev.bytes, ev.invalidateAddr);
-		break;
-
-	case IO_EVENT_WRITE:
-		Write(ev.handle, ev.buf, ev.bytes);
-		break;
-
-	default:
-		ERROR_LOG_REPORT(SCEIO, "Unsupported IO event type");
-	}
-}
-
-void AsyncIOManager::Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr) {
+void AsyncIOManager::Read(int worker, const AsyncIOEvent &ev) {
 	int usec = 0;
-	s64 result = pspFileSystem.ReadFile(handle, buf, bytes, usec);
-	EventResult(handle, AsyncIOResult(result, usec, invalidateAddr));
+	s64 result = pspFileSystem.ReadFile(ev.handle, ev.buf, ev.bytes, usec);
+	EventResult(worker, ev.handle, AsyncIOResult(result, ev.scheduledTicks, usec, ev.invalidateAddr));
 }
 
-void AsyncIOManager::Write(u32 handle, u8 *buf, size_t bytes) {
+void AsyncIOManager::Write(int worker, const AsyncIOEvent &ev) {
 	int usec = 0;
-	s64 result = pspFileSystem.WriteFile(handle, buf, bytes, usec);
-	EventResult(handle, AsyncIOResult(result, usec));
+	s64 result = pspFileSystem.WriteFile(ev.handle, ev.buf, ev.bytes, usec);
+	EventResult(worker, ev.handle, AsyncIOResult(result, ev.scheduledTicks, usec, 0));
 }
 
-void AsyncIOManager::EventResult(u32 handle, AsyncIOResult result) {
-	std::lock_guard<std::mutex> guard(resultsLock_);
-	if (results_.find(handle) != results_.end()) {
-		ERROR_LOG_REPORT(SCEIO, "Overwriting previous result for file action on handle %d", handle);
+void AsyncIOManager::EventResult(int worker, u32 handle, const AsyncIOResult &result) {
+	Completion c;
+	c.handle = handle;
+	c.result = result;
+	while (!completions_[worker].push(c)) {
+		// Shouldn't really happen, the emu thread drains these often.  Don't block a shutdown on it, though.
+		if (threadEnabled_ && !threadsRunning_) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+
+	if (threadEnabled_) {
+		// Taking the lock makes sure a waiter can't miss this between its check and its wait.
+		std::lock_guard<std::mutex> guard(resultsWaitLock_);
+		resultsWait_.notify_one();
 	}
-	results_[handle] = result;
-	resultsWait_.notify_one();
 }
 
 void AsyncIOManager::DoState(PointerWrap &p) {
@@ -152,7 +272,6 @@ void AsyncIOManager::DoState(PointerWrap &p) {
 		return;
 
 	SyncThread();
-	std::lock_guard<std::mutex> guard(resultsLock_);
 	p.Do(resultsPending_);
 	if (s >= 2) {
 		p.Do(results_);
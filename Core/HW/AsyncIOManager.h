@@ -15,10 +15,15 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 
+#include "Common/ChunkFile.h"
+#include "Common/SPSCQueue.h"
 #include "Core/ThreadEventQueue.h"
 
 class NoBase {
@@ -33,12 +38,14 @@ enum AsyncIOEventType {
 };
 
 struct AsyncIOEvent {
-	AsyncIOEvent(AsyncIOEventType t) : type(t) {}
+	AsyncIOEvent(AsyncIOEventType t) : type(t), scheduledTicks(0) {}
 	AsyncIOEventType type;
 	u32 handle;
 	u8 *buf;
 	size_t bytes;
 	u32 invalidateAddr;
+	// Emulated time when the operation was issued, so finish ticks don't depend on host thread timing.
+	u64 scheduledTicks;
 
 	operator AsyncIOEventType() const {
 		return type;
@@ -56,6 +63,10 @@ struct AsyncIOResult {
 		finishTicks = CoreTiming::GetTicks() + usToCycles(usec);
 	}
 
+	AsyncIOResult(s64 r, u64 startTicks, int usec, u32 addr) : result(r), invalidateAddr(addr) {
+		finishTicks = startTicks + usToCycles(usec);
+	}
+
 	void DoState(PointerWrap &p) {
 		auto s = p.Section("AsyncIOResult", 1, 2);
 		if (!s)
@@ -76,34 +87,104 @@ struct AsyncIOResult {
 };
 
 typedef ThreadEventQueue<NoBase, AsyncIOEvent, AsyncIOEventType, IO_EVENT_INVALID, IO_EVENT_SYNC, IO_EVENT_FINISH> IOThreadEventQueue;
-class AsyncIOManager : public IOThreadEventQueue {
+
+class AsyncIOManager;
+
+// One queue of operations, serviced by a single host thread.
+// All operations on a given handle go to the same worker, so they stay ordered.
+class AsyncIOWorker : public IOThreadEventQueue {
+public:
+	AsyncIOWorker() : manager_(nullptr), index_(0) {
+	}
+
+	void Init(AsyncIOManager *manager, int index) {
+		manager_ = manager;
+		index_ = index;
+	}
+
+protected:
+	void ProcessEvent(AsyncIOEvent ev) override;
+	bool ShouldExitEventLoop() override {
+		return coreState == CORE_ERROR || coreState == CORE_POWERDOWN;
+	}
+
+private:
+	AsyncIOManager *manager_;
+	int index_;
+};
+
+class AsyncIOManager {
 public:
+	enum {
+		MAX_WORKERS = 4,
+	};
+
+	AsyncIOManager();
+	~AsyncIOManager();
+
 	void DoState(PointerWrap &p);
 
+	// Threaded mode spreads handles across numWorkers host threads.
+	void Startup(bool threaded, int numWorkers);
+	// Asks the worker threads to exit, e.g. on core shutdown.  This doesn't wait, Shutdown() joins them.
+	void FinishEventLoop();
+	void Shutdown();
+
+	bool ThreadEnabled() const {
+		return threadEnabled_;
+	}
+
 	bool HasOperation(u32 handle);
 	void ScheduleOperation(AsyncIOEvent ev);
-	void Shutdown();
+	// Waits for every worker to drain.
+	void SyncThread(bool force = false);
+	// Waits only for the worker that owns this handle.
+	void SyncHandle(u32 handle);
 
 	bool HasResult(u32 handle);
 	bool WaitResult(u32 handle, AsyncIOResult &result);
 	u64 ResultFinishTicks(u32 handle);
 
-protected:
-	void ProcessEvent(AsyncIOEvent ref) override;
-	bool ShouldExitEventLoop() override {
-		return coreState == CORE_ERROR || coreState == CORE_POWERDOWN;
+private:
+	friend class AsyncIOWorker;
+
+	struct Completion {
+		u32 handle;
+		AsyncIOResult result;
+	};
+	// Plenty, since each handle only has one operation in flight.
+	typedef SPSCQueue<Completion, 256> CompletionQueue;
+
+	AsyncIOWorker &WorkerFor(u32 handle) {
+		return workers_[handle % numWorkers_];
 	}
+	void WorkerThread(int index);
+	void JoinWorkers();
 
-private:
 	bool PopResult(u32 handle, AsyncIOResult &result);
 	bool ReadResult(u32 handle, AsyncIOResult &result);
-	void Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr);
-	void Write(u32 handle, u8 *buf, size_t bytes);
+	// Pulls finished operations from the workers into results_.  Emu thread only.
+	void CollectResults();
+	bool WaitForResult(u32 handle);
 
-	void EventResult(u32 handle, AsyncIOResult result);
+	void Read(int worker, const AsyncIOEvent &ev);
+	void Write(int worker, const AsyncIOEvent &ev);
 
-	std::mutex resultsLock_;
+	void EventResult(int worker, u32 handle, const AsyncIOResult &result);
+
+	bool threadEnabled_;
+	std::atomic<bool> threadsRunning_;
+	int numWorkers_;
+	AsyncIOWorker workers_[MAX_WORKERS];
+	std::thread threads_[MAX_WORKERS];
+	// Workers push, the emu thread pops.  One queue per worker keeps it single producer.
+	CompletionQueue completions_[MAX_WORKERS];
+
+	// Only used to sleep while waiting for a result, the data itself is lock-free.
+	std::mutex resultsWaitLock_;
 	std::condition_variable resultsWait_;
+
+	// These are only touched from the emu thread.
 	std::set<u32> resultsPending_;
 	std::map<u32, AsyncIOResult> results_;
-};
\ No newline at end of file
+};
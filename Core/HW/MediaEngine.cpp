@@ -15,6 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include "ppsspp_config.h"
+#include "base/timeutil.h"
+#include "Common/Common.h"
 #include "Core/Config.h"
 #include "Core/Debugger/Breakpoints.h"
 #include "Core/HW/MediaEngine.h"
@@ -27,6 +30,13 @@
 #include "Core/HW/SimpleAudioDec.h"
 
 #include <algorithm>
+#include <cstdio>
+
+#ifdef _M_SSE
+#include <emmintrin.h>
+#elif PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #ifdef USE_FFMPEG
 
@@ -116,17 +126,77 @@ static int getPixelFormatBytes(int pspFormat)
 	}
 }
 
+// Emulator thread time spent decoding and converting video, rolled up about once a second.
+// Only the emulator thread writes this, the debug overlay just reads the last published window.
+struct VideoDecodeStats {
+	double windowStart;
+	double busy;
+	double maxFrame;
+	int frames;
+
+	double avgFrameMs;
+	double maxFrameMs;
+	double busyPercent;
+	int fps;
+};
+
+static VideoDecodeStats videoStats;
+
+static void AccountVideoTime(double start, bool frame) {
+	const double now = real_time_now();
+	const double elapsed = now - start;
+	if (videoStats.windowStart == 0.0 || now - videoStats.windowStart > 2.0) {
+		// Nothing for a while (or ever), so start fresh instead of averaging across the gap.
+		videoStats.windowStart = start;
+		videoStats.busy = 0.0;
+		videoStats.maxFrame = 0.0;
+		videoStats.frames = 0;
+	}
+
+	videoStats.busy += elapsed;
+	if (frame) {
+		videoStats.frames++;
+		videoStats.maxFrame = std::max(videoStats.maxFrame, elapsed);
+	}
+
+	const double window = now - videoStats.windowStart;
+	if (window >= 1.0) {
+		videoStats.avgFrameMs = videoStats.frames == 0 ? 0.0 : videoStats.busy * 1000.0 / videoStats.frames;
+		videoStats.maxFrameMs = videoStats.maxFrame * 1000.0;
+		videoStats.busyPercent = videoStats.busy * 100.0 / window;
+		videoStats.fps = (int)(videoStats.frames / window + 0.5);
+
+		videoStats.windowStart = now;
+		videoStats.busy = 0.0;
+		videoStats.maxFrame = 0.0;
+		videoStats.frames = 0;
+	}
+}
+
+void GetMediaEngineDebugStats(char *stats, size_t bufsize) {
+	if (videoStats.windowStart == 0.0 || real_time_now() - videoStats.windowStart > 2.0) {
+		snprintf(stats, bufsize, "Video decode: idle\n");
+		return;
+	}
+	snprintf(stats, bufsize,
+		"Video decode: %0.2f ms/frame avg, %0.2f ms max, %d fps, %0.1f%% CPU\n",
+		videoStats.avgFrameMs, videoStats.maxFrameMs, videoStats.fps, videoStats.busyPercent);
+}
+
 MediaEngine::MediaEngine(): m_pdata(0) {
 #ifdef USE_FFMPEG
 	m_pFormatCtx = 0;
 	m_pCodecCtxs.clear();
 	m_pFrame = 0;
+	m_pDecodeFrame = 0;
 	m_pFrameRGB = 0;
 	m_pIOContext = 0;
 	m_sws_ctx = 0;
 #endif
 	m_sws_fmt = 0;
 	m_buffer = 0;
+	m_frameRGBStale = false;
+	m_lastPixelMode = GE_CMODE_32BIT_ABGR8888;
 
 	m_videoStream = -1;
 	m_audioStream = -1;
@@ -347,6 +417,8 @@ void MediaEngine::closeContext()
 		av_frame_free(&m_pFrameRGB);
 	if (m_pFrame)
 		av_frame_free(&m_pFrame);
+	if (m_pDecodeFrame)
+		av_frame_free(&m_pDecodeFrame);
 	if (m_pIOContext && m_pIOContext->buffer)
 		av_free(m_pIOContext->buffer);
 	if (m_pIOContext)
@@ -361,6 +433,7 @@ void MediaEngine::closeContext()
 	m_pIOContext = 0;
 #endif
 	m_buffer = 0;
+	m_frameRGBStale = false;
 }
 
 bool MediaEngine::loadStream(const u8 *buffer, int readSize, int RingbufferSize)
@@ -465,6 +538,8 @@ bool MediaEngine::setVideoStream(int streamNum, bool force) {
 		AVDictionary *opt = nullptr;
 		// Allow ffmpeg to use any number of threads it wants.  Without this, it doesn't use threads.
 		av_dict_set(&opt, "threads", "0", 0);
+		// We hold on to the last picture across decode calls, which needs our own reference to it.
+		m_pCodecCtx->refcounted_frames = 1;
 		int openResult = avcodec_open2(m_pCodecCtx, pCodec, &opt);
 		av_dict_free(&opt);
 		if (openResult < 0) {
@@ -503,6 +578,9 @@ bool MediaEngine::setVideoDim(int width, int height)
 	if (!m_pFrame) {
 		m_pFrame = av_frame_alloc();
 	}
+	if (!m_pDecodeFrame) {
+		m_pDecodeFrame = av_frame_alloc();
+	}
 
 	sws_freeContext(m_sws_ctx);
 	m_sws_ctx = NULL;
@@ -571,6 +649,30 @@ void MediaEngine::updateSwsFormat(int videoPixelMode) {
 #endif
 }
 
+// Fills m_pFrameRGB from the last kept picture, if it hasn't been already.
+bool MediaEngine::convertFrameRGB(int videoPixelMode) {
+#ifdef USE_FFMPEG
+	if (!m_pFrameRGB)
+		return false;
+	if (!m_frameRGBStale)
+		return true;
+
+	auto codecIter = m_pCodecCtxs.find(m_videoStream);
+	AVCodecContext *m_pCodecCtx = codecIter == m_pCodecCtxs.end() ? 0 : codecIter->second;
+	if (!m_pCodecCtx)
+		return false;
+
+	updateSwsFormat(videoPixelMode);
+	// Update the linesize for the new format too.  We started with the largest size, so it should fit.
+	m_pFrameRGB->linesize[0] = getPixelFormatBytes(videoPixelMode) * m_desWidth;
+
+	sws_scale(m_sws_ctx, m_pFrame->data, m_pFrame->linesize, 0,
+		m_pCodecCtx->height, m_pFrameRGB->data, m_pFrameRGB->linesize);
+	m_frameRGBStale = false;
+#endif
+	return true;
+}
+
 bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 #ifdef USE_FFMPEG
 	auto codecIter = m_pCodecCtxs.find(m_videoStream);
@@ -580,9 +682,10 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 		return false;
 	if (!m_pCodecCtx)
 		return false;
-	if (!m_pFrame)
+	if (!m_pFrame || !m_pDecodeFrame)
 		return false;
 
+	double st = real_time_now();
 	AVPacket packet;
 	av_init_packet(&packet);
 	int frameFinished;
@@ -601,25 +704,27 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 				av_free_packet(&packet);
 #endif
 
-			int result = avcodec_decode_video2(m_pCodecCtx, m_pFrame, &frameFinished, &packet);
+			int result = avcodec_decode_video2(m_pCodecCtx, m_pDecodeFrame, &frameFinished, &packet);
 			if (frameFinished) {
 				if (!m_pFrameRGB) {
 					setVideoDim();
 				}
-				if (m_pFrameRGB && !skipFrame) {
-					updateSwsFormat(videoPixelMode);
-					// TODO: Technically we could set this to frameWidth instead of m_desWidth for better perf.
-					// Update the linesize for the new format too.  We started with the largest size, so it should fit.
-					m_pFrameRGB->linesize[0] = getPixelFormatBytes(videoPixelMode) * m_desWidth;
-
-					sws_scale(m_sws_ctx, m_pFrame->data, m_pFrame->linesize, 0,
-						m_pCodecCtx->height, m_pFrameRGB->data, m_pFrameRGB->linesize);
-				}
 
-				if (av_frame_get_best_effort_timestamp(m_pFrame) != AV_NOPTS_VALUE)
-					m_videopts = av_frame_get_best_effort_timestamp(m_pFrame) + av_frame_get_pkt_duration(m_pFrame) - m_firstTimeStamp;
+				if (av_frame_get_best_effort_timestamp(m_pDecodeFrame) != AV_NOPTS_VALUE)
+					m_videopts = av_frame_get_best_effort_timestamp(m_pDecodeFrame) + av_frame_get_pkt_duration(m_pDecodeFrame) - m_firstTimeStamp;
 				else
-					m_videopts += av_frame_get_pkt_duration(m_pFrame);
+					m_videopts += av_frame_get_pkt_duration(m_pDecodeFrame);
+
+				// Conversion waits until we know where it's going, see writeVideoImage().
+				// A skipped frame leaves the previous picture in place, as before.
+				if (!skipFrame) {
+					av_frame_unref(m_pFrame);
+					av_frame_move_ref(m_pFrame, m_pDecodeFrame);
+					m_frameRGBStale = true;
+					m_lastPixelMode = videoPixelMode;
+				} else {
+					av_frame_unref(m_pDecodeFrame);
+				}
 				bGetFrame = true;
 			}
 			if (result <= 0 && dataEnd) {
@@ -637,6 +742,7 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 		av_free_packet(&packet);
 #endif
 	}
+	AccountVideoTime(st, bGetFrame);
 	return bGetFrame;
 #else
 	// If video engine is not available, just add to the timestamp at least.
@@ -647,41 +753,74 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 
 // Helpers that null out alpha (which seems to be the case on the PSP.)
 // Some games depend on this, for example Sword Art Online (doesn't clear A's from buffer.)
+// These may also run in place (destp == srcp) after converting straight into the destination.
 inline void writeVideoLineRGBA(void *destp, const void *srcp, int width) {
-	// TODO: Use SSE/NEON, investigate why AV_PIX_FMT_RGB0 does not work.
+	// TODO: Investigate why AV_PIX_FMT_RGB0 does not work.
 	u32_le *dest = (u32_le *)destp;
 	const u32_le *src = (u32_le *)srcp;
 
 	const u32 mask = 0x00FFFFFF;
-	for (int i = 0; i < width; ++i) {
+	int i = 0;
+#ifdef _M_SSE
+	const __m128i maskx4 = _mm_set1_epi32(mask);
+	for (; i + 8 <= width; i += 8) {
+		__m128i c0 = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i c1 = _mm_loadu_si128((const __m128i *)(src + i + 4));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_and_si128(c0, maskx4));
+		_mm_storeu_si128((__m128i *)(dest + i + 4), _mm_and_si128(c1, maskx4));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint32x4_t maskx4 = vdupq_n_u32(mask);
+	for (; i + 8 <= width; i += 8) {
+		uint32x4_t c0 = vld1q_u32((const uint32_t *)(src + i));
+		uint32x4_t c1 = vld1q_u32((const uint32_t *)(src + i + 4));
+		vst1q_u32((uint32_t *)(dest + i), vandq_u32(c0, maskx4));
+		vst1q_u32((uint32_t *)(dest + i + 4), vandq_u32(c1, maskx4));
+	}
+#endif
+	for (; i < width; ++i) {
 		dest[i] = src[i] & mask;
 	}
 }
 
-inline void writeVideoLineABGR5650(void *destp, const void *srcp, int width) {
-	memcpy(destp, srcp, width * sizeof(u16));
-}
-
-inline void writeVideoLineABGR5551(void *destp, const void *srcp, int width) {
-	// TODO: Use SSE/NEON.
+inline void writeVideoLineMask16(void *destp, const void *srcp, int width, u16 mask) {
 	u16_le *dest = (u16_le *)destp;
 	const u16_le *src = (u16_le *)srcp;
 
-	const u16 mask = 0x7FFF;
-	for (int i = 0; i < width; ++i) {
+	int i = 0;
+#ifdef _M_SSE
+	const __m128i maskx8 = _mm_set1_epi16(mask);
+	for (; i + 16 <= width; i += 16) {
+		__m128i c0 = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i c1 = _mm_loadu_si128((const __m128i *)(src + i + 8));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_and_si128(c0, maskx8));
+		_mm_storeu_si128((__m128i *)(dest + i + 8), _mm_and_si128(c1, maskx8));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t maskx8 = vdupq_n_u16(mask);
+	for (; i + 16 <= width; i += 16) {
+		uint16x8_t c0 = vld1q_u16((const uint16_t *)(src + i));
+		uint16x8_t c1 = vld1q_u16((const uint16_t *)(src + i + 8));
+		vst1q_u16((uint16_t *)(dest + i), vandq_u16(c0, maskx8));
+		vst1q_u16((uint16_t *)(dest + i + 8), vandq_u16(c1, maskx8));
+	}
+#endif
+	for (; i < width; ++i) {
 		dest[i] = src[i] & mask;
 	}
 }
 
-inline void writeVideoLineABGR4444(void *destp, const void *srcp, int width) {
-	// TODO: Use SSE/NEON.
-	u16_le *dest = (u16_le *)destp;
-	const u16_le *src = (u16_le *)srcp;
+inline void writeVideoLineABGR5650(void *destp, const void *srcp, int width) {
+	if (destp != srcp)
+		memcpy(destp, srcp, width * sizeof(u16));
+}
 
-	const u16 mask = 0x0FFF;
-	for (int i = 0; i < width; ++i) {
-		dest[i] = src[i] & mask;
-	}
+inline void writeVideoLineABGR5551(void *destp, const void *srcp, int width) {
+	writeVideoLineMask16(destp, srcp, width, 0x7FFF);
+}
+
+inline void writeVideoLineABGR4444(void *destp, const void *srcp, int width) {
+	writeVideoLineMask16(destp, srcp, width, 0x0FFF);
 }
 
 int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMode) {
@@ -697,11 +836,12 @@ int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMo
 	if (!m_pFrame || !m_pFrameRGB)
 		return 0;
 
+	double st = real_time_now();
+
 	// lock the image size
 	int height = m_desHeight;
 	int width = m_desWidth;
 	u8 *imgbuf = buffer;
-	const u8 *data = m_pFrameRGB->data[0];
 
 	int videoLineSize = 0;
 	switch (videoPixelMode) {
@@ -722,32 +862,54 @@ int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMo
 		imgbuf = new u8[videoImageSize];
 	}
 
+	auto codecIter = m_pCodecCtxs.find(m_videoStream);
+	AVCodecContext *m_pCodecCtx = codecIter == m_pCodecCtxs.end() ? 0 : codecIter->second;
+
+	// Unless we have to swizzle, convert straight into the game's buffer at its stride and skip m_pFrameRGB.
+	// The line writers below then just clear alpha in place.
+	const u8 *data;
+	int dataLineSize;
+	bool direct = !swizzle && m_frameRGBStale && m_pCodecCtx && videoLineSize != 0 && frameWidth >= width && Memory::IsValidRange(bufferPtr, videoImageSize);
+	if (direct) {
+		updateSwsFormat(videoPixelMode);
+		u8 *dstData[4] = { imgbuf, nullptr, nullptr, nullptr };
+		int dstLineSize[4] = { videoLineSize, 0, 0, 0 };
+		sws_scale(m_sws_ctx, m_pFrame->data, m_pFrame->linesize, 0,
+			m_pCodecCtx->height, dstData, dstLineSize);
+		data = imgbuf;
+		dataLineSize = videoLineSize;
+	} else {
+		convertFrameRGB(videoPixelMode);
+		data = m_pFrameRGB->data[0];
+		dataLineSize = width * getPixelFormatBytes(videoPixelMode);
+	}
+
 	switch (videoPixelMode) {
 	case GE_CMODE_32BIT_ABGR8888:
 		for (int y = 0; y < height; y++) {
 			writeVideoLineRGBA(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u32);
+			data += dataLineSize;
 		}
 		break;
 
 	case GE_CMODE_16BIT_BGR5650:
 		for (int y = 0; y < height; y++) {
 			writeVideoLineABGR5650(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u16);
+			data += dataLineSize;
 		}
 		break;
 
 	case GE_CMODE_16BIT_ABGR5551:
 		for (int y = 0; y < height; y++) {
 			writeVideoLineABGR5551(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u16);
+			data += dataLineSize;
 		}
 		break;
 
 	case GE_CMODE_16BIT_ABGR4444:
 		for (int y = 0; y < height; y++) {
 			writeVideoLineABGR4444(imgbuf + videoLineSize * y, data, width);
-			data += width * sizeof(u16);
+			data += dataLineSize;
 		}
 		break;
 
@@ -765,6 +927,7 @@ int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMo
 		DoSwizzleTex16((const u32 *)imgbuf, buffer, bxc, byc, videoLineSize);
 		delete [] imgbuf;
 	}
+	AccountVideoTime(st, false);
 
 #ifndef MOBILE_DEVICE
 	CBreakPoints::ExecMemCheck(bufferPtr, true, videoImageSize, currentMIPS->pc);
@@ -788,6 +951,9 @@ int MediaEngine::writeVideoImageWithRange(u32 bufferPtr, int frameWidth, int vid
 	if (!m_pFrame || !m_pFrameRGB)
 		return 0;
 
+	double st = real_time_now();
+	convertFrameRGB(videoPixelMode);
+
 	// lock the image size
 	u8 *imgbuf = buffer;
 	const u8 *data = m_pFrameRGB->data[0];
@@ -880,6 +1046,7 @@ int MediaEngine::writeVideoImageWithRange(u32 bufferPtr, int frameWidth, int vid
 		DoSwizzleTex16((const u32 *)imgbuf, buffer, bxc, byc, videoLineSize);
 		delete [] imgbuf;
 	}
+	AccountVideoTime(st, false);
 
 	// Account for the y offset as well.
 	return videoImageSize + videoLineSize * ypos;
@@ -889,6 +1056,7 @@ int MediaEngine::writeVideoImageWithRange(u32 bufferPtr, int frameWidth, int vid
 
 u8 *MediaEngine::getFrameImage() {
 #ifdef USE_FFMPEG
+	convertFrameRGB(m_lastPixelMode);
 	return m_pFrameRGB->data[0];
 #else
 	return NULL;
@@ -50,6 +50,9 @@ inline s64 getMpegTimeStamp(const u8 *buf) {
 bool InitFFmpeg();
 #endif
 
+// Per frame decode time and the share of wall time spent on video, for the debug stats.
+void GetMediaEngineDebugStats(char *stats, size_t bufsize);
+
 class MediaEngine
 {
 public:
@@ -96,6 +99,7 @@ class MediaEngine
 	bool SetupStreams();
 	bool setVideoDim(int width = 0, int height = 0);
 	void updateSwsFormat(int videoPixelMode);
+	bool convertFrameRGB(int videoPixelMode);
 	int getNextAudioFrame(u8 **buf, int *headerCode1, int *headerCode2);
 
 public:  // TODO: Very little of this below should be public.
@@ -104,7 +108,9 @@ class MediaEngine
 #ifdef USE_FFMPEG
 	AVFormatContext *m_pFormatCtx;
 	std::map<int, AVCodecContext *> m_pCodecCtxs;
+	// The last picture stepVideo() kept, converted lazily since writeVideoImage() can usually skip m_pFrameRGB.
 	AVFrame *m_pFrame;
+	AVFrame *m_pDecodeFrame;
 	AVFrame *m_pFrameRGB;
 	AVIOContext *m_pIOContext;
 	SwsContext *m_sws_ctx;
@@ -112,6 +118,8 @@ class MediaEngine
 
 	int m_sws_fmt;
 	u8 *m_buffer;
+	bool m_frameRGBStale;
+	int m_lastPixelMode;
 	int m_videoStream;
 
 	// Used by the demuxer.
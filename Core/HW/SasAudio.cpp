@@ -25,8 +25,16 @@
 #include "Core/Config.h"
 #include "Core/Reporting.h"
 #include "Core/Util/AudioFormat.h"
+#include "Common/ThreadPools.h"
 #include "SasAudio.h"
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+#if PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // #define AUDIO_TO_FILE
 
 static const u8 f[16][2] = {
@@ -64,7 +72,53 @@ void VagDecoder::Start(u32 data, u32 vagSize, bool loopEnabled) {
 	s_2 = 0;
 }
 
-void VagDecoder::DecodeBlock(u8 *&read_pointer) {
+// Expands the 28 nibbles of a block to 16-bit samples, before prediction.
+static void UnpackVagNibbles(const u8 *readp, int shift_factor, s16 *out) {
+#ifdef _M_SSE
+	// Each byte goes to the top of a 16-bit lane, and then the nibbles get split out.
+	u8 block[16] = {};
+	memcpy(block, readp, 14);
+	const __m128i data = _mm_loadu_si128((const __m128i *)block);
+	const __m128i mask = _mm_set1_epi16((s16)0xF000);
+	const __m128i shift = _mm_cvtsi32_si128(shift_factor);
+	for (int half = 0; half < 2; ++half) {
+		const __m128i bytes = half == 0 ? _mm_unpacklo_epi8(_mm_setzero_si128(), data) : _mm_unpackhi_epi8(_mm_setzero_si128(), data);
+		const __m128i lo = _mm_and_si128(_mm_slli_epi16(bytes, 4), mask);
+		const __m128i hi = _mm_and_si128(bytes, mask);
+		_mm_storeu_si128((__m128i *)(out + half * 16), _mm_sra_epi16(_mm_unpacklo_epi16(lo, hi), shift));
+		if (half == 0)
+			_mm_storeu_si128((__m128i *)(out + 8), _mm_sra_epi16(_mm_unpackhi_epi16(lo, hi), shift));
+		else
+			_mm_storel_epi64((__m128i *)(out + 24), _mm_sra_epi16(_mm_unpackhi_epi16(lo, hi), shift));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	u8 block[16] = {};
+	memcpy(block, readp, 14);
+	const uint8x16_t data = vld1q_u8(block);
+	// Low nibbles into the top of the byte, then widen each byte to the top of a 16-bit lane.
+	const uint8x16x2_t nibbles = vzipq_u8(vshlq_n_u8(data, 4), vandq_u8(data, vdupq_n_u8(0xF0)));
+	const int16x8_t shift = vdupq_n_s16(-shift_factor);
+	for (int half = 0; half < 2; ++half) {
+		const uint8x16_t n = nibbles.val[half];
+		const int16x8_t lo = vreinterpretq_s16_u16(vshll_n_u8(vget_low_u8(n), 8));
+		const int16x8_t hi = vreinterpretq_s16_u16(vshll_n_u8(vget_high_u8(n), 8));
+		vst1q_s16(out + half * 16, vshlq_s16(lo, shift));
+		if (half == 0)
+			vst1q_s16(out + 8, vshlq_s16(hi, shift));
+		else
+			vst1_s16(out + 24, vget_low_s16(vshlq_s16(hi, shift)));
+	}
+#else
+	for (int i = 0; i < 28; i += 2) {
+		u8 d = *readp++;
+		out[i] = (short)((d & 0xf) << 12) >> shift_factor;
+		out[i + 1] = (short)((d & 0xf0) << 8) >> shift_factor;
+	}
+#endif
+}
+
+template <typename T>
+void VagDecoder::DecodeBlock(u8 *&read_pointer, T *out) {
 	u8 *readp = read_pointer;
 	int predict_nr = *readp++;
 	int shift_factor = predict_nr & 0xf;
@@ -91,15 +145,24 @@ void VagDecoder::DecodeBlock(u8 *&read_pointer) {
 	int coef1 = f[predict_nr][0];
 	int coef2 = -f[predict_nr][1];
 
-	// TODO: Unroll once more and interleave the unpacking with the decoding more?
-	for (int i = 0; i < 28; i += 2) {
-		u8 d = *readp++;
-		int sample1 = (short)((d & 0xf) << 12) >> shift_factor;
-		int sample2 = (short)((d & 0xf0) << 8) >> shift_factor;
-		s2 = clamp_s16(sample1 + ((s1 * coef1 + s2 * coef2) >> 6));
-		s1 = clamp_s16(sample2 + ((s2 * coef1 + s1 * coef2) >> 6));
-		samples[i] = s2;
-		samples[i + 1] = s1;
+	// The unpacking is independent per sample, only the filter has to go in order.
+	s16 unpacked[32];
+	UnpackVagNibbles(readp, shift_factor, unpacked);
+	readp += 14;
+
+	if (coef1 == 0 && coef2 == 0) {
+		// No prediction, the samples are used as is.
+		for (int i = 0; i < 28; i++)
+			out[i] = unpacked[i];
+		s2 = unpacked[26];
+		s1 = unpacked[27];
+	} else {
+		for (int i = 0; i < 28; i += 2) {
+			s2 = clamp_s16(unpacked[i] + ((s1 * coef1 + s2 * coef2) >> 6));
+			s1 = clamp_s16(unpacked[i + 1] + ((s2 * coef1 + s1 * coef2) >> 6));
+			out[i] = s2;
+			out[i + 1] = s1;
+		}
 	}
 
 	s_1 = s1;
@@ -113,6 +176,10 @@ void VagDecoder::DecodeBlock(u8 *&read_pointer) {
 	read_pointer = readp;
 }
 
+void VagDecoder::DecodeBlock(u8 *&readp) {
+	DecodeBlock(readp, samples);
+}
+
 void VagDecoder::GetSamples(s16_le *outSamples, int numSamples) {
 	if (end_) {
 		memset(outSamples, 0, numSamples * sizeof(s16));
@@ -125,7 +192,8 @@ void VagDecoder::GetSamples(s16_le *outSamples, int numSamples) {
 	u8 *readp = Memory::GetPointerUnchecked(read_);
 	u8 *origp = readp;
 
-	for (int i = 0; i < numSamples; i++) {
+	int i = 0;
+	while (i < numSamples) {
 		if (curSample == 28) {
 			if (loopAtNextBlock_) {
 				VERBOSE_LOG(SASMIX, "Looping VAG from block %d/%d to %d", curBlock_, numBlocks_, loopStartBlock_);
@@ -136,14 +204,29 @@ void VagDecoder::GetSamples(s16_le *outSamples, int numSamples) {
 				curBlock_ = loopStartBlock_;
 				loopAtNextBlock_ = false;
 			}
-			DecodeBlock(readp);
+			// Whole blocks go straight to the output, only a partial one is kept around.
+			const bool wholeBlock = numSamples - i >= 28;
+			if (wholeBlock)
+				DecodeBlock(readp, &outSamples[i]);
+			else
+				DecodeBlock(readp, samples);
 			if (end_) {
 				// Clear the rest of the buffer and return.
 				memset(&outSamples[i], 0, (numSamples - i) * sizeof(s16));
 				return;
 			}
+			if (wholeBlock) {
+				curSample = 28;
+				i += 28;
+				continue;
+			}
 		}
-		outSamples[i] = samples[curSample++];
+
+		const int count = std::min(28 - curSample, numSamples - i);
+		for (int j = 0; j < count; j++)
+			outSamples[i + j] = samples[curSample + j];
+		curSample += count;
+		i += count;
 	}
 
 	if (readp > origp) {
@@ -337,7 +420,8 @@ SasInstance::SasInstance()
 		sendBuffer(0),
 		sendBufferDownsampled(0),
 		sendBufferProcessed(0),
-		grainSize(0) {
+		grainSize(0),
+		voiceMix_(nullptr) {
 #ifdef AUDIO_TO_FILE
 	audioDump = fopen("D:\\audio.raw", "wb");
 #endif
@@ -375,10 +459,12 @@ void SasInstance::ClearGrainSize() {
 	delete[] sendBuffer;
 	delete[] sendBufferDownsampled;
 	delete[] sendBufferProcessed;
+	delete[] voiceMix_;
 	mixBuffer = nullptr;
 	sendBuffer = nullptr;
 	sendBufferDownsampled = nullptr;
 	sendBufferProcessed = nullptr;
+	voiceMix_ = nullptr;
 }
 
 void SasInstance::SetGrainSize(int newGrainSize) {
@@ -389,11 +475,13 @@ void SasInstance::SetGrainSize(int newGrainSize) {
 	delete[] sendBuffer;
 	delete[] sendBufferDownsampled;
 	delete[] sendBufferProcessed;
+	delete[] voiceMix_;
 
 	mixBuffer = new s32[grainSize * 2];
 	sendBuffer = new s32[grainSize * 2];
 	sendBufferDownsampled = new s16[grainSize];
 	sendBufferProcessed = new s16[grainSize * 2];
+	voiceMix_ = new int[PSP_SAS_VOICES_MAX * grainSize];
 	memset(mixBuffer, 0, sizeof(int) * grainSize * 2);
 	memset(sendBuffer, 0, sizeof(int) * grainSize * 2);
 	memset(sendBufferDownsampled, 0, sizeof(s16) * grainSize);
@@ -472,7 +560,106 @@ bool SasVoice::HaveSamplesEnded() const {
 	}
 }
 
-void SasInstance::MixVoice(SasVoice &voice) {
+// Linear interpolation, writing count samples. Good enough. Need to make resampleHist bigger if we want more.
+// Unity and double pitch keep the same fraction for every sample, so they get SIMD paths.
+static void ResampleVoice(int *out, const s16_le *in, u32 sampleFrac, int pitch, int count) {
+	int i = 0;
+	if (pitch == PSP_SAS_PITCH_BASE || pitch == PSP_SAS_PITCH_BASE * 2) {
+		const int step = pitch >> PSP_SAS_PITCH_BASE_SHIFT;
+		const s16 *s = (const s16 *)in + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+		const int f = sampleFrac & PSP_SAS_PITCH_MASK;
+#ifdef _M_SSE
+		// Each pair of 16-bit lanes is (s[0], s[1]), so madd does the whole interpolation.
+		const __m128i weights = _mm_set1_epi32((f << 16) | (PSP_SAS_PITCH_MASK - f));
+		if (step == 1) {
+			for (; i + 8 <= count; i += 8) {
+				const __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+				const __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 1));
+				const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights);
+				const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights);
+				_mm_storeu_si128((__m128i *)(out + i), _mm_srai_epi32(lo, PSP_SAS_PITCH_BASE_SHIFT));
+				_mm_storeu_si128((__m128i *)(out + i + 4), _mm_srai_epi32(hi, PSP_SAS_PITCH_BASE_SHIFT));
+			}
+		} else {
+			// At double pitch, the pairs are already next to each other.
+			for (; i + 4 <= count; i += 4) {
+				const __m128i a = _mm_loadu_si128((const __m128i *)(s + i * 2));
+				_mm_storeu_si128((__m128i *)(out + i), _mm_srai_epi32(_mm_madd_epi16(a, weights), PSP_SAS_PITCH_BASE_SHIFT));
+			}
+		}
+#elif PPSSPP_ARCH(ARM_NEON)
+		if (step == 1) {
+			for (; i + 4 <= count; i += 4) {
+				int32x4_t sum = vmull_n_s16(vld1_s16(s + i), PSP_SAS_PITCH_MASK - f);
+				sum = vmlal_n_s16(sum, vld1_s16(s + i + 1), f);
+				vst1q_s32(out + i, vshrq_n_s32(sum, PSP_SAS_PITCH_BASE_SHIFT));
+			}
+		} else {
+			for (; i + 4 <= count; i += 4) {
+				const int16x4x2_t pairs = vld2_s16(s + i * 2);
+				int32x4_t sum = vmull_n_s16(pairs.val[0], PSP_SAS_PITCH_MASK - f);
+				sum = vmlal_n_s16(sum, pairs.val[1], f);
+				vst1q_s32(out + i, vshrq_n_s32(sum, PSP_SAS_PITCH_BASE_SHIFT));
+			}
+		}
+#endif
+		for (; i < count; i++) {
+			const s16 *p = s + i * step;
+			out[i] = (p[0] * (PSP_SAS_PITCH_MASK - f) + p[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
+		}
+		return;
+	}
+
+	for (; i < count; i++) {
+		const s16_le *s = in + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+		int f = sampleFrac & PSP_SAS_PITCH_MASK;
+		out[i] = (s[0] * (PSP_SAS_PITCH_MASK - f) + s[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
+		sampleFrac += pitch;
+	}
+}
+
+// Adds samples scaled by a stereo volume into an interleaved stereo buffer.
+// If fitsS16 is false, the samples or volumes might not fit in 16 bits and only the plain loop is exact.
+static void MixSamplesStereo(int *dest, const int *samples, int count, int volLeft, int volRight, bool fitsS16) {
+	int i = 0;
+#if defined(_M_SSE) || PPSSPP_ARCH(ARM_NEON)
+	const bool volFits = volLeft == (s16)volLeft && volRight == (s16)volRight;
+	if (fitsS16 && volFits) {
+#ifdef _M_SSE
+		const __m128i vol = _mm_set1_epi32(((u32)volRight << 16) | ((u32)volLeft & 0xFFFF));
+		for (; i + 8 <= count; i += 8) {
+			const __m128i s = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)(samples + i)), _mm_loadu_si128((const __m128i *)(samples + i + 4)));
+			// Duplicate each sample for left and right, then widen the 16x16 products to 32 bits.
+			const __m128i dup[2] = { _mm_unpacklo_epi16(s, s), _mm_unpackhi_epi16(s, s) };
+			for (int j = 0; j < 2; ++j) {
+				const __m128i lo = _mm_mullo_epi16(dup[j], vol);
+				const __m128i hi = _mm_mulhi_epi16(dup[j], vol);
+				__m128i *d = (__m128i *)(dest + i * 2 + j * 8);
+				_mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 12)));
+				_mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 12)));
+			}
+		}
+#else
+		const int16x4_t vol = vzip_s16(vdup_n_s16((s16)volLeft), vdup_n_s16((s16)volRight)).val[0];
+		for (; i + 4 <= count; i += 4) {
+			const int16x4_t s = vmovn_s32(vld1q_s32(samples + i));
+			const int16x4x2_t dup = vzip_s16(s, s);
+			int *d = dest + i * 2;
+			vst1q_s32(d, vaddq_s32(vld1q_s32(d), vshrq_n_s32(vmull_s16(dup.val[0], vol), 12)));
+			vst1q_s32(d + 4, vaddq_s32(vld1q_s32(d + 4), vshrq_n_s32(vmull_s16(dup.val[1], vol), 12)));
+		}
+#endif
+	}
+#endif
+	for (; i < count; i++) {
+		dest[i * 2] += (samples[i] * volLeft) >> 12;
+		dest[i * 2 + 1] += (samples[i] * volRight) >> 12;
+	}
+}
+
+SasInstance::RenderedVoice SasInstance::RenderVoice(SasVoice &voice, s16_le *temp, int *envelope, int *out) {
+	RenderedVoice rendered = { false, 0, true };
+
 	switch (voice.type) {
 	case VOICETYPE_VAG:
 		if (voice.type == VOICETYPE_VAG && !voice.vagAddr)
@@ -492,56 +679,54 @@ void SasInstance::MixVoice(SasVoice &voice) {
 			if (voice.type == VOICETYPE_VAG)
 				++delay;
 		}
+		// Could happen with a really high pitch.
+		delay = std::min(delay, grainSize);
+		rendered.audible = out != nullptr;
+		rendered.delay = delay;
+		const int count = grainSize - delay;
 
 		// Resample to the correct pitch, writing exactly "grainSize" samples. We need a buffer that can
 		// fit 4x that, as the max pitch is 0x4000.
-		// TODO: Special case no-resample case (and 2x and 0.5x) for speed, it's not uncommon
 
 		// Two passes: First read, then resample.
-		mixTemp_[0] = voice.resampleHist[0];
-		mixTemp_[1] = voice.resampleHist[1];
+		temp[0] = voice.resampleHist[0];
+		temp[1] = voice.resampleHist[1];
 
 		int voicePitch = voice.pitch;
 		u32 sampleFrac = voice.sampleFrac;
-		int samplesToRead = (sampleFrac + voicePitch * std::max(0, grainSize - delay)) >> PSP_SAS_PITCH_BASE_SHIFT;
-		if (samplesToRead > ARRAY_SIZE(mixTemp_) - 2) {
+		int samplesToRead = (sampleFrac + voicePitch * count) >> PSP_SAS_PITCH_BASE_SHIFT;
+		if (samplesToRead > MIX_TEMP_SIZE - 2) {
 			ERROR_LOG(SCESAS, "Too many samples to read (%d)! This shouldn't happen.", samplesToRead);
-			samplesToRead = ARRAY_SIZE(mixTemp_) - 2;
+			samplesToRead = MIX_TEMP_SIZE - 2;
 		}
-		voice.ReadSamples(&mixTemp_[2], samplesToRead);
+		voice.ReadSamples(&temp[2], samplesToRead);
 		int tempPos = 2 + samplesToRead;
 
-		for (int i = delay; i < grainSize; i++) {
-			const s16_le *s = mixTemp_ + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
-
-			// Linear interpolation. Good enough. Need to make resampleHist bigger if we want more.
-			int f = sampleFrac & PSP_SAS_PITCH_MASK;
-			int sample = (s[0] * (PSP_SAS_PITCH_MASK - f) + s[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
-			sampleFrac += voicePitch;
-
-			// The maximum envelope height (PSP_SAS_ENVELOPE_HEIGHT_MAX) is (1 << 30) - 1.
-			// Reduce it to 14 bits, by shifting off 15.  Round up by adding (1 << 14) first.
-			int envelopeValue = voice.envelope.GetHeight();
-			voice.envelope.Step();
-			envelopeValue = (envelopeValue + (1 << 14)) >> 15;
-
-			// We just scale by the envelope before we scale by volumes.
-			// Again, we round up by adding (1 << 14) first (*after* multiplying.)
-			sample = ((sample * envelopeValue) + (1 << 14)) >> 15;
-
-			// We mix into this 32-bit temp buffer and clip in a second loop
-			// Ideally, the shift right should be there too but for now I'm concerned about
-			// not overflowing.
-			mixBuffer[i * 2] += (sample * voice.volumeLeft) >> 12;
-			mixBuffer[i * 2 + 1] += (sample * voice.volumeRight) >> 12;
-			sendBuffer[i * 2] += sample * voice.effectLeft >> 12;
-			sendBuffer[i * 2 + 1] += sample * voice.effectRight >> 12;
+		// The envelope doesn't depend on the samples, so walk it all at once.
+		voice.envelope.Walk(envelope, count);
+		if (out) {
+			ResampleVoice(out + delay, temp, sampleFrac, voicePitch, count);
+
+			u32 range = 0;
+			for (int i = 0; i < count; i++) {
+				// The maximum envelope height (PSP_SAS_ENVELOPE_HEIGHT_MAX) is (1 << 30) - 1.
+				// Reduce it to 14 bits, by shifting off 15.  Round up by adding (1 << 14) first.
+				int envelopeValue = (envelope[i] + (1 << 14)) >> 15;
+
+				// We just scale by the envelope before we scale by volumes.
+				// Again, we round up by adding (1 << 14) first (*after* multiplying.)
+				int sample = ((out[delay + i] * envelopeValue) + (1 << 14)) >> 15;
+				out[delay + i] = sample;
+				range |= (u32)(sample + 0x8000);
+			}
+			rendered.fitsS16 = (range & ~0xFFFF) == 0;
 		}
+		sampleFrac += voicePitch * count;
 
-		voice.resampleHist[0] = mixTemp_[tempPos - 2];
-		voice.resampleHist[1] = mixTemp_[tempPos - 1];
+		voice.resampleHist[0] = temp[tempPos - 2];
+		voice.resampleHist[1] = temp[tempPos - 1];
 
-		voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;;
+		voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;
 
 		if (voice.HaveSamplesEnded())
 			voice.envelope.End();
@@ -551,17 +736,58 @@ void SasInstance::MixVoice(SasVoice &voice) {
 			voice.on = false;
 		}
 	}
+
+	return rendered;
+}
+
+void SasInstance::MixRenderedVoice(const SasVoice &voice, const RenderedVoice &rendered, const int *samples) {
+	if (!rendered.audible)
+		return;
+
+	// We mix into this 32-bit temp buffer and clip in a second loop
+	// Ideally, the shift right should be there too but for now I'm concerned about
+	// not overflowing.
+	const int delay = rendered.delay;
+	MixSamplesStereo(mixBuffer + delay * 2, samples + delay, grainSize - delay, voice.volumeLeft, voice.volumeRight, rendered.fitsS16);
+	MixSamplesStereo(sendBuffer + delay * 2, samples + delay, grainSize - delay, voice.effectLeft, voice.effectRight, rendered.fitsS16);
+}
+
+void SasInstance::MixVoice(SasVoice &voice) {
+	RenderedVoice rendered = RenderVoice(voice, mixTemp_, mixEnvelope_, voiceMix_);
+	MixRenderedVoice(voice, rendered, voiceMix_);
 }
 
 void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
 	int voicesPlayingCount = 0;
+	int parallelVoices[PSP_SAS_VOICES_MAX];
+	int parallelCount = 0;
 
 	for (int v = 0; v < PSP_SAS_VOICES_MAX; v++) {
 		SasVoice &voice = voices[v];
 		if (!voice.playing || voice.paused)
 			continue;
 		voicesPlayingCount++;
-		MixVoice(voice);
+		// Atrac3 voices go through sceAtrac state, so they always mix here.
+		if (g_Config.bParallelSASVoices && voice.type != VOICETYPE_ATRAC3)
+			parallelVoices[parallelCount++] = v;
+		else
+			MixVoice(voice);
+	}
+
+	if (parallelCount != 0) {
+		RenderedVoice rendered[PSP_SAS_VOICES_MAX];
+		GlobalThreadPool::Loop([&](int lower, int upper) {
+			s16_le temp[MIX_TEMP_SIZE];
+			int envelope[PSP_SAS_MAX_GRAIN];
+			for (int i = lower; i < upper; ++i) {
+				rendered[i] = RenderVoice(voices[parallelVoices[i]], temp, envelope, voiceMix_ + i * grainSize);
+			}
+		}, 0, parallelCount);
+
+		// Sum on this thread in voice order, so the result never depends on how the work was split.
+		for (int i = 0; i < parallelCount; ++i) {
+			MixRenderedVoice(voices[parallelVoices[i]], rendered[i], voiceMix_ + i * grainSize);
+		}
 	}
 
 	// Then mix the send buffer in with the rest.
@@ -593,6 +819,20 @@ void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
 #endif
 }
 
+void SasInstance::MixSilent(u32 outAddr) {
+	// The samples still have to be read, that's what moves streams along and finds their ends.
+	for (int v = 0; v < PSP_SAS_VOICES_MAX; v++) {
+		SasVoice &voice = voices[v];
+		if (voice.playing && !voice.paused)
+			RenderVoice(voice, mixTemp_, mixEnvelope_, nullptr);
+	}
+
+	// Raw output has the send buffer too.
+	const int planes = outputMode == PSP_SAS_OUTPUTMODE_MIXED ? 2 : 4;
+	s16_le *outp = (s16_le *)Memory::GetPointer(outAddr);
+	memset(outp, 0, grainSize * planes * sizeof(s16));
+}
+
 void SasInstance::WriteMixedOutput(s16_le *outp, const s16_le *inp, int leftVol, int rightVol) {
 	const bool dry = waveformEffect.isDryOn != 0;
 	const bool wet = waveformEffect.isWetOn != 0;
@@ -863,7 +1103,7 @@ void ADSREnvelope::SetState(ADSRState state) {
 	state_ = state;
 }
 
-inline void ADSREnvelope::Step() {
+void ADSREnvelope::Step() {
 	switch (state_) {
 	case STATE_ATTACK:
 		WalkCurve(attackType, attackRate);
@@ -910,6 +1150,122 @@ inline void ADSREnvelope::Step() {
 	}
 }
 
+// The range the height has to stay within for Step() to stay in the current state.
+bool ADSREnvelope::StateRange(s64 &lo, s64 &hi) const {
+	switch (state_) {
+	case STATE_ATTACK:
+		lo = 0;
+		hi = PSP_SAS_ENVELOPE_HEIGHT_MAX - 1;
+		return true;
+	case STATE_DECAY:
+		lo = sustainLevel;
+		hi = INT64_MAX;
+		return true;
+	case STATE_SUSTAIN:
+	case STATE_RELEASE:
+		lo = 1;
+		hi = INT64_MAX;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ADSREnvelope::Walk(int *heights, int count) {
+	int i = 0;
+	while (i < count) {
+		int type;
+		int rate;
+		switch (state_) {
+		case STATE_ATTACK: type = attackType; rate = attackRate; break;
+		case STATE_DECAY: type = decayType; rate = decayRate; break;
+		case STATE_SUSTAIN: type = sustainType; rate = sustainRate; break;
+		case STATE_RELEASE: type = releaseType; rate = releaseRate; break;
+		case STATE_OFF:
+			// Nothing changes from here on.
+			for (; i < count; i++)
+				heights[i] = GetHeight();
+			return;
+		default:
+			heights[i++] = GetHeight();
+			Step();
+			continue;
+		}
+
+		s64 lo, hi;
+		StateRange(lo, hi);
+
+		// Walk the curve as long as it stays in this state, then let Step() handle the change.
+		const int start = i;
+		s64 h = height_;
+		switch (type) {
+		case PSP_SAS_ADSR_CURVE_MODE_LINEAR_INCREASE:
+		case PSP_SAS_ADSR_CURVE_MODE_LINEAR_DECREASE:
+		{
+			// A straight line, so we know right away how long it lasts.
+			const s64 delta = type == PSP_SAS_ADSR_CURVE_MODE_LINEAR_INCREASE ? (s64)rate : -(s64)rate;
+			s64 steps;
+			if (h + delta < lo || h + delta > hi)
+				steps = 0;
+			else if (delta > 0)
+				steps = hi == INT64_MAX ? count - i : (hi - h) / delta;
+			else if (delta < 0)
+				steps = (h - lo) / -delta;
+			else
+				steps = count - i;
+			steps = std::min(steps, (s64)(count - i));
+			for (int j = 0; j < steps; j++) {
+				heights[i++] = h > (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : (int)h;
+				h += delta;
+			}
+			break;
+		}
+
+		case PSP_SAS_ADSR_CURVE_MODE_LINEAR_BENT:
+			while (i < count) {
+				const s64 next = h + (h <= (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX * 3 / 4 ? rate : rate / 4);
+				if (next < lo || next > hi)
+					break;
+				heights[i++] = h > (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : (int)h;
+				h = next;
+			}
+			break;
+
+		case PSP_SAS_ADSR_CURVE_MODE_EXPONENT_DECREASE:
+		case PSP_SAS_ADSR_CURVE_MODE_EXPONENT_INCREASE:
+			while (i < count) {
+				// Same math as WalkCurve().
+				s64 expDelta = h - PSP_SAS_ENVELOPE_HEIGHT_MAX;
+				expDelta += (-expDelta * rate) >> 32;
+				s64 next;
+				if (type == PSP_SAS_ADSR_CURVE_MODE_EXPONENT_DECREASE)
+					next = expDelta + PSP_SAS_ENVELOPE_HEIGHT_MAX - (rate + 3UL) / 4UL;
+				else
+					next = expDelta + 0x4000 + PSP_SAS_ENVELOPE_HEIGHT_MAX;
+				if (next < lo || next > hi)
+					break;
+				heights[i++] = h > (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : (int)h;
+				h = next;
+			}
+			break;
+
+		case PSP_SAS_ADSR_CURVE_MODE_DIRECT:
+			// After the first step, this just holds.
+			if (h == rate && h >= lo && h <= hi) {
+				for (; i < count; i++)
+					heights[i] = GetHeight();
+			}
+			break;
+		}
+		height_ = h;
+
+		if (i == start) {
+			heights[i++] = GetHeight();
+			Step();
+		}
+	}
+}
+
 void ADSREnvelope::KeyOn() {
 	SetState(STATE_KEYON);
 }
@@ -110,6 +110,9 @@ class VagDecoder {
 	u32 GetReadPtr() const { return read_; }
 
 private:
+	template <typename T>
+	void DecodeBlock(u8 *&readp, T *out);
+
 	s16 samples[28];
 	int curSample;
 
@@ -158,7 +161,9 @@ class ADSREnvelope {
 	void KeyOff();
 	void End();
 
-	inline void Step();
+	void Step();
+	// Same as GetHeight() then Step(), count times, but walks each curve segment in a tight loop.
+	void Walk(int *heights, int count);
 
 	int GetHeight() const {
 		return height_ > (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : height_;
@@ -196,6 +201,7 @@ class ADSREnvelope {
 		STATE_RELEASE = 3,
 	};
 	void SetState(ADSRState state);
+	bool StateRange(s64 &lo, s64 &hi) const;
 
 	ADSRState state_;
 	s64 height_;  // s64 to avoid having to care about overflow when calculating. TODO: this should be fine as s32
@@ -294,6 +300,8 @@ class SasInstance {
 	FILE *audioDump;
 
 	void Mix(u32 outAddr, u32 inAddr = 0, int leftVol = 0, int rightVol = 0);
+	// For turbo: the voices advance exactly as in Mix, so they end on time, but the output is silent.
+	void MixSilent(u32 outAddr);
 	void MixVoice(SasVoice &voice);
 
 	// Applies reverb to send buffer, according to waveformEffect.
@@ -309,7 +317,28 @@ class SasInstance {
 	WaveformEffect waveformEffect;
 
 private:
+	enum {
+		MIX_TEMP_SIZE = PSP_SAS_MAX_GRAIN * 4 + 2 + 8,  // some extra margin for very high pitches.
+	};
+
+	struct RenderedVoice {
+		bool audible;
+		// The first samples after a keyon are silent.
+		int delay;
+		// All samples fit in 16 bits, so the SIMD mixer can be used.
+		bool fitsS16;
+	};
+
+	// Resamples a voice and applies its envelope, but doesn't touch the mix buffers.
+	// Only touches the voice itself, so different voices can render in parallel.
+	// With no out, only advances the voice.
+	RenderedVoice RenderVoice(SasVoice &voice, s16_le *temp, int *envelope, int *out);
+	void MixRenderedVoice(const SasVoice &voice, const RenderedVoice &rendered, const int *samples);
+
 	SasReverb reverb_;
 	int grainSize;
-	s16_le mixTemp_[PSP_SAS_MAX_GRAIN * 4 + 2 + 8];  // some extra margin for very high pitches.
+	// One grain per voice, for rendering them in parallel.
+	int *voiceMix_;
+	s16_le mixTemp_[MIX_TEMP_SIZE];
+	int mixEnvelope_[PSP_SAS_MAX_GRAIN];
 };
@@ -15,60 +15,26 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 
 #include "base/basictypes.h"
+#include "Common/Common.h"
 #include "Core/HW/SasReverb.h"
 #include "Core/Util/AudioFormat.h"
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+#if PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // This is under the assumption that the reverb used in Sas is the same as the PSX SPU reverb.
 
 // Source: http://problemkaputt.de/psx-spx.htm#spureverbformula
 
-struct SasReverbData {
-	const char *name;
-	int32_t size;
-
-	int16_t dAPF1;
-	int16_t dAPF2;
-	int16_t vIIR;
-	int16_t vCOMB1;
-	int16_t vCOMB2;
-	int16_t vCOMB3;
-	int16_t vCOMB4;
-	int16_t vWALL;
-
-	int16_t vAPF1;
-	int16_t vAPF2;
-	int16_t mLSAME;
-	int16_t mRSAME;
-	int16_t mLCOMB1;
-	int16_t mRCOMB1;
-	int16_t mLCOMB2;
-	int16_t mRCOMB2;
-
-	int16_t dLSAME;
-	int16_t dRSAME;
-	int16_t mLDIFF;
-	int16_t mRDIFF;
-	int16_t mLCOMB3;
-	int16_t mRCOMB3;
-	int16_t mLCOMB4;
-	int16_t mRCOMB4;
-
-	int16_t dLDIFF;
-	int16_t dRDIFF;
-	int16_t mLAPF1;
-	int16_t mRAPF1;
-	int16_t mLAPF2;
-	int16_t mRAPF2;
-
-	// These aren't used for anything else than 1.0 in any of the presets so let's drop them.
-	// int16_t vLIN;
-	// int16_t vRIN;
-};
-
 static const SasReverbData presets[10] = {
 	{
 		"Room",
@@ -167,6 +133,13 @@ const char *SasReverb::GetPresetName(int preset) {
 	return presets[preset].name;
 }
 
+const SasReverbData *SasReverb::GetPresetData(int preset) {
+	if (preset == -1) {
+		return nullptr;
+	}
+	return &presets[preset];
+}
+
 void SasReverb::SetPreset(int preset) {
 	if (preset < (int)ARRAY_SIZE(presets))
 		preset_ = preset;
@@ -206,65 +179,202 @@ class BufferWrapper {
 	int size_;
 };
 
-void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
-	// This means replicate the input signal in the processed buffer.
-	// Can also be used to verify that the error is in here...
-	if (preset_ == -1) {
-		// Strangely, OFF is not filled with zeroes every other.  Seems special cased.
-		for (size_t i = 0; i < inputSize; ++i) {
-			output[i * 4 + 0] = clamp_s16((int)input[i * 2 + 0] * volLeft >> 15);
-			output[i * 4 + 1] = clamp_s16((int)input[i * 2 + 1] * volRight >> 15);
-			output[i * 4 + 2] = clamp_s16((int)input[i * 2 + 0] * volLeft >> 15);
-			output[i * 4 + 3] = clamp_s16((int)input[i * 2 + 1] * volRight >> 15);
-		}
-		return;
+// Most of the time no tap is close to the end of the buffer, so they're plain offsets from the position.
+class BufferPointer {
+public:
+	BufferPointer(int16_t *buffer) : p_(buffer) {}
+	int16_t &operator [](int index) {
+		return p_[index];
 	}
 
-	const SasReverbData &d = presets[preset_];
+	void Next() {
+		p_++;
+	}
 
-	// We put this on the stack instead of in the object to let the compiler optimize better (avoid mem r/w).
-	BufferWrapper<BUFSIZE> b(workspace_, pos_, d.size);
+private:
+	int16_t *p_;
+};
 
-	// This runs at 22khz.
-	// Very unoptimized, straight from the description. Can probably be reformulated into something way more efficient.
-	// Or we could actually template the whole thing with the parameters as template arguments, as the presets are fixed.
-	for (size_t i = 0; i < inputSize; i++) {
-		// Dividing by two here is an incorrect hack. Some multiplication factor is needed to prevent the reverb from getting too loud, though.
-		int16_t LeftInput = input[i * 2] >> 1;
-		int16_t RightInput = input[i * 2 + 1] >> 1;
+static void GetTapRange(const SasReverbData &d, int &lowest, int &highest) {
+	const int taps[] = {
+		d.mLSAME, d.mRSAME, d.mLDIFF, d.mRDIFF,
+		d.mLSAME - 1, d.mRSAME - 1, d.mLDIFF - 1, d.mRDIFF - 1,
+		d.dLSAME, d.dRSAME, d.dLDIFF, d.dRDIFF,
+		d.mLCOMB1, d.mLCOMB2, d.mLCOMB3, d.mLCOMB4,
+		d.mRCOMB1, d.mRCOMB2, d.mRCOMB3, d.mRCOMB4,
+		d.mLAPF1, d.mRAPF1, d.mLAPF1 - d.dAPF1, d.mRAPF1 - d.dAPF1,
+		d.mLAPF2, d.mRAPF2, d.mLAPF2 - d.dAPF2, d.mRAPF2 - d.dAPF2,
+	};
+	lowest = taps[0];
+	highest = taps[0];
+	for (size_t i = 1; i < ARRAY_SIZE(taps); ++i) {
+		lowest = std::min(lowest, taps[i]);
+		highest = std::max(highest, taps[i]);
+	}
+}
 
-		int16_t Lin = LeftInput; //  (d.vLIN * LeftInput) >> 15;
-		int16_t Rin = RightInput; // (d.vRIN * RightInput) >> 15;
+// The four reflections can only be computed side by side if none of them reads what an earlier one
+// just wrote.  In Room and the echo presets, the diff reflections share a slot, so those stay in order.
+static bool ReflectionsIndependent(const SasReverbData &d) {
+	if (d.size == 0)
+		return false;
+	const int writes[4] = { d.mLSAME, d.mRSAME, d.mLDIFF, d.mRDIFF };
+	const int reads[4][2] = {
+		{ d.dLSAME, d.mLSAME - 1 },
+		{ d.dRSAME, d.mRSAME - 1 },
+		{ d.dRDIFF, d.mLDIFF - 1 },
+		{ d.dLDIFF, d.mRDIFF - 1 },
+	};
+	for (int w = 0; w < 4; ++w) {
+		for (int r = w + 1; r < 4; ++r) {
+			if ((writes[w] - reads[r][0]) % d.size == 0 || (writes[w] - reads[r][1]) % d.size == 0)
+				return false;
+		}
+	}
+	return true;
+}
 
+// One 22khz sample, straight from the description.  The presets are fixed, so when this is inlined
+// with a constant preset all the offsets and coefficients (many of them zero) fold away.
+template <bool simdReflections, typename B>
+static __forceinline void ReverbSample(B &b, const SasReverbData &d, const int16_t *input, int16_t *output, uint16_t volLeft, uint16_t volRight) {
+	// Dividing by two here is an incorrect hack. Some multiplication factor is needed to prevent the reverb from getting too loud, though.
+	int16_t LeftInput = input[0] >> 1;
+	int16_t RightInput = input[1] >> 1;
+
+	int16_t Lin = LeftInput; //  (d.vLIN * LeftInput) >> 15;
+	int16_t Rin = RightInput; // (d.vRIN * RightInput) >> 15;
+
+#if defined(_M_SSE) || PPSSPP_ARCH(ARM_NEON)
+	if (simdReflections) {
+		// All four reflections at once: L-to-L, R-to-R, R-to-L, L-to-R.
+#ifdef _M_SSE
+		const __m128i in = _mm_setr_epi32(Lin, Rin, Lin, Rin);
+		const __m128i taps = _mm_setr_epi16(b[d.dLSAME], b[d.dRSAME], b[d.dRDIFF], b[d.dLDIFF], b[d.mLSAME - 1], b[d.mRSAME - 1], b[d.mLDIFF - 1], b[d.mRDIFF - 1]);
+		const __m128i coefs = _mm_setr_epi16(d.vWALL, d.vWALL, d.vWALL, d.vWALL, d.vIIR, d.vIIR, d.vIIR, d.vIIR);
+		const __m128i lo = _mm_mullo_epi16(taps, coefs);
+		const __m128i hi = _mm_mulhi_epi16(taps, coefs);
+		const __m128i wall = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+		const __m128i iir = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+		const __m128i prev = _mm_srai_epi32(_mm_unpackhi_epi16(taps, taps), 16);
+		__m128i sum = _mm_add_epi32(_mm_sub_epi32(_mm_add_epi32(in, wall), iir), prev);
+		sum = _mm_packs_epi32(sum, sum);
+		b[d.mLSAME] = (int16_t)_mm_extract_epi16(sum, 0);
+		b[d.mRSAME] = (int16_t)_mm_extract_epi16(sum, 1);
+		b[d.mLDIFF] = (int16_t)_mm_extract_epi16(sum, 2);
+		b[d.mRDIFF] = (int16_t)_mm_extract_epi16(sum, 3);
+#else
+		const int16_t in[4] = { Lin, Rin, Lin, Rin };
+		const int16_t walls[4] = { b[d.dLSAME], b[d.dRSAME], b[d.dRDIFF], b[d.dLDIFF] };
+		const int16_t prevs[4] = { b[d.mLSAME - 1], b[d.mRSAME - 1], b[d.mLDIFF - 1], b[d.mRDIFF - 1] };
+		const int16x4_t prev = vld1_s16(prevs);
+		int32x4_t sum = vaddq_s32(vmovl_s16(vld1_s16(in)), vshrq_n_s32(vmull_n_s16(vld1_s16(walls), d.vWALL), 15));
+		sum = vaddw_s16(vsubq_s32(sum, vshrq_n_s32(vmull_n_s16(prev, d.vIIR), 15)), prev);
+		int16_t result[4];
+		vst1_s16(result, vqmovn_s32(sum));
+		b[d.mLSAME] = result[0];
+		b[d.mRSAME] = result[1];
+		b[d.mLDIFF] = result[2];
+		b[d.mRDIFF] = result[3];
+#endif
+	} else
+#endif
+	{
 		// ____Same Side Reflection(left - to - left and right - to - right)___________________
 		b[d.mLSAME] = clamp_s16(Lin + (b[d.dLSAME] * d.vWALL >> 15) - (b[d.mLSAME - 1]*d.vIIR >> 15) + b[d.mLSAME - 1]); // L - to - L
 		b[d.mRSAME] = clamp_s16(Rin + (b[d.dRSAME] * d.vWALL >> 15) - (b[d.mRSAME - 1]*d.vIIR >> 15) + b[d.mRSAME - 1]); // R - to - R
 		// ___Different Side Reflection(left - to - right and right - to - left)_______________
 		b[d.mLDIFF] = clamp_s16(Lin + (b[d.dRDIFF] * d.vWALL >> 15) - (b[d.mLDIFF - 1]*d.vIIR >> 15) + b[d.mLDIFF - 1]); // R - to - L
 		b[d.mRDIFF] = clamp_s16(Rin + (b[d.dLDIFF] * d.vWALL >> 15) - (b[d.mRDIFF - 1]*d.vIIR >> 15) + b[d.mRDIFF - 1]); // L - to - R
-		// ___Early Echo(Comb Filter, with input from buffer)__________________________
-		int32_t Lout = ((d.vCOMB1*b[d.mLCOMB1] + d.vCOMB2*b[d.mLCOMB2] + d.vCOMB3*b[d.mLCOMB3] + d.vCOMB4*b[d.mLCOMB4]) >> 15);
-		int32_t Rout = ((d.vCOMB1*b[d.mRCOMB1] + d.vCOMB2*b[d.mRCOMB2] + d.vCOMB3*b[d.mRCOMB3] + d.vCOMB4*b[d.mRCOMB4]) >> 15);
-		// ___Late Reverb APF1(All Pass Filter 1, with input from COMB)________________
-		b[d.mLAPF1] = clamp_s16(Lout - (d.vAPF1*b[(d.mLAPF1 - d.dAPF1)] >> 15));
-		Lout = b[(d.mLAPF1 - d.dAPF1)] + (b[d.mLAPF1] * d.vAPF1 >> 15);
-		b[d.mRAPF1] = clamp_s16(Rout - (d.vAPF1*b[(d.mRAPF1 - d.dAPF1)] >> 15));
-		Rout = b[(d.mRAPF1 - d.dAPF1)] + (b[d.mRAPF1] * d.vAPF1 >> 15);
-		// ___Late Reverb APF2(All Pass Filter 2, with input from APF1)________________
-		b[d.mLAPF2] = clamp_s16(Lout - (d.vAPF2*b[(d.mLAPF2 - d.dAPF2)] >> 15));
-		Lout = b[(d.mLAPF2 - d.dAPF2)] + (b[d.mLAPF2] * d.vAPF2 >> 15);
-		b[d.mRAPF2] = clamp_s16(Rout - (d.vAPF2*b[(d.mRAPF2 - d.dAPF2)] >> 15));
-		Rout = b[(d.mRAPF2 - d.dAPF2)] + (b[d.mRAPF2] * d.vAPF2 >> 15);
-		// ___Output to Mixer(Output volume multiplied with input from APF2)___________
-		output[i * 4 + 0] = clamp_s16(Lout * volLeft >> 15);
-		output[i * 4 + 1] = clamp_s16(Rout * volRight >> 15);
-		output[i * 4 + 2] = 0;
-		output[i * 4 + 3] = 0;
-
-		b.Next();
 	}
+	// ___Early Echo(Comb Filter, with input from buffer)__________________________
+	int32_t Lout = ((d.vCOMB1*b[d.mLCOMB1] + d.vCOMB2*b[d.mLCOMB2] + d.vCOMB3*b[d.mLCOMB3] + d.vCOMB4*b[d.mLCOMB4]) >> 15);
+	int32_t Rout = ((d.vCOMB1*b[d.mRCOMB1] + d.vCOMB2*b[d.mRCOMB2] + d.vCOMB3*b[d.mRCOMB3] + d.vCOMB4*b[d.mRCOMB4]) >> 15);
+	// ___Late Reverb APF1(All Pass Filter 1, with input from COMB)________________
+	b[d.mLAPF1] = clamp_s16(Lout - (d.vAPF1*b[(d.mLAPF1 - d.dAPF1)] >> 15));
+	Lout = b[(d.mLAPF1 - d.dAPF1)] + (b[d.mLAPF1] * d.vAPF1 >> 15);
+	b[d.mRAPF1] = clamp_s16(Rout - (d.vAPF1*b[(d.mRAPF1 - d.dAPF1)] >> 15));
+	Rout = b[(d.mRAPF1 - d.dAPF1)] + (b[d.mRAPF1] * d.vAPF1 >> 15);
+	// ___Late Reverb APF2(All Pass Filter 2, with input from APF1)________________
+	b[d.mLAPF2] = clamp_s16(Lout - (d.vAPF2*b[(d.mLAPF2 - d.dAPF2)] >> 15));
+	Lout = b[(d.mLAPF2 - d.dAPF2)] + (b[d.mLAPF2] * d.vAPF2 >> 15);
+	b[d.mRAPF2] = clamp_s16(Rout - (d.vAPF2*b[(d.mRAPF2 - d.dAPF2)] >> 15));
+	Rout = b[(d.mRAPF2 - d.dAPF2)] + (b[d.mRAPF2] * d.vAPF2 >> 15);
+	// ___Output to Mixer(Output volume multiplied with input from APF2)___________
+	output[0] = clamp_s16(Lout * volLeft >> 15);
+	output[1] = clamp_s16(Rout * volRight >> 15);
+	output[2] = 0;
+	output[3] = 0;
+}
 
-	// Save the state in the object.
-	pos_ = b.GetPosition();
+// Returns the new position.
+template <int bufsize, bool simdReflections>
+static __forceinline int RunReverb(const SasReverbData &d, int16_t *workspace, int pos, int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
+	int lowest, highest;
+	GetTapRange(d, lowest, highest);
+	const int base = bufsize - d.size;
+
+	size_t i = 0;
+	while (i < inputSize) {
+		if (pos + lowest >= base && pos + highest < bufsize) {
+			// Run until the furthest tap reaches the end of the buffer.
+			const size_t end = std::min(inputSize, i + (size_t)(bufsize - (pos + highest)));
+			BufferPointer b(workspace + pos);
+			pos += (int)(end - i);
+			for (; i < end; ++i) {
+				ReverbSample<simdReflections>(b, d, input + i * 2, output + i * 4, volLeft, volRight);
+				b.Next();
+			}
+			if (pos >= bufsize) {
+				pos -= d.size;
+			}
+		} else {
+			// Some tap wraps around, go one sample at a time until we're clear.
+			BufferWrapper<bufsize> b(workspace, pos, d.size);
+			ReverbSample<false>(b, d, input + i * 2, output + i * 4, volLeft, volRight);
+			b.Next();
+			pos = b.GetPosition();
+			++i;
+		}
+	}
+	return pos;
+}
+
+template <int bufsize, int preset>
+static int RunReverbPreset(int16_t *workspace, int pos, int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
+	const SasReverbData &d = presets[preset];
+	if (ReflectionsIndependent(d))
+		return RunReverb<bufsize, true>(d, workspace, pos, output, input, inputSize, volLeft, volRight);
+	return RunReverb<bufsize, false>(d, workspace, pos, output, input, inputSize, volLeft, volRight);
 }
 
+void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
+	// This means replicate the input signal in the processed buffer.
+	// Can also be used to verify that the error is in here...
+	if (preset_ == -1) {
+		// Strangely, OFF is not filled with zeroes every other.  Seems special cased.
+		for (size_t i = 0; i < inputSize; ++i) {
+			output[i * 4 + 0] = clamp_s16((int)input[i * 2 + 0] * volLeft >> 15);
+			output[i * 4 + 1] = clamp_s16((int)input[i * 2 + 1] * volRight >> 15);
+			output[i * 4 + 2] = clamp_s16((int)input[i * 2 + 0] * volLeft >> 15);
+			output[i * 4 + 3] = clamp_s16((int)input[i * 2 + 1] * volRight >> 15);
+		}
+		return;
+	}
+
+	// This runs at 22khz.  Each preset gets its own copy of the loop with its taps as constants.
+	switch (preset_) {
+	case 0: pos_ = RunReverbPreset<BUFSIZE, 0>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 1: pos_ = RunReverbPreset<BUFSIZE, 1>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 2: pos_ = RunReverbPreset<BUFSIZE, 2>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 3: pos_ = RunReverbPreset<BUFSIZE, 3>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 4: pos_ = RunReverbPreset<BUFSIZE, 4>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 5: pos_ = RunReverbPreset<BUFSIZE, 5>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 6: pos_ = RunReverbPreset<BUFSIZE, 6>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 7: pos_ = RunReverbPreset<BUFSIZE, 7>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	case 8: pos_ = RunReverbPreset<BUFSIZE, 8>(workspace_, pos_, output, input, inputSize, volLeft, volRight); break;
+	default:
+		pos_ = RunReverb<BUFSIZE, false>(presets[preset_], workspace_, pos_, output, input, inputSize, volLeft, volRight);
+		break;
+	}
+}
@@ -17,7 +17,51 @@
 
 #pragma once
 
-struct SasReverbData;
+#include <cstddef>
+#include <cstdint>
+
+struct SasReverbData {
+	const char *name;
+	int32_t size;
+
+	int16_t dAPF1;
+	int16_t dAPF2;
+	int16_t vIIR;
+	int16_t vCOMB1;
+	int16_t vCOMB2;
+	int16_t vCOMB3;
+	int16_t vCOMB4;
+	int16_t vWALL;
+
+	int16_t vAPF1;
+	int16_t vAPF2;
+	int16_t mLSAME;
+	int16_t mRSAME;
+	int16_t mLCOMB1;
+	int16_t mRCOMB1;
+	int16_t mLCOMB2;
+	int16_t mRCOMB2;
+
+	int16_t dLSAME;
+	int16_t dRSAME;
+	int16_t mLDIFF;
+	int16_t mRDIFF;
+	int16_t mLCOMB3;
+	int16_t mRCOMB3;
+	int16_t mLCOMB4;
+	int16_t mRCOMB4;
+
+	int16_t dLDIFF;
+	int16_t dRDIFF;
+	int16_t mLAPF1;
+	int16_t mRAPF1;
+	int16_t mLAPF2;
+	int16_t mRAPF2;
+
+	// These aren't used for anything else than 1.0 in any of the presets so let's drop them.
+	// int16_t vLIN;
+	// int16_t vRIN;
+};
 
 class SasReverb {
 public:
@@ -28,6 +72,8 @@ class SasReverb {
 	int GetPreset() { return preset_; }
 
 	static const char *GetPresetName(int preset);
+	// Returns nullptr for off.
+	static const SasReverbData *GetPresetData(int preset);
 
 	// Input should be a mixdown of all the channels that have reverb enabled, at 22khz.
 	// Output is written back at 44khz.
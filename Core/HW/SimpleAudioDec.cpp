@@ -22,6 +22,7 @@
 #include "Core/HW/SimpleAudioDec.h"
 #include "Core/HW/MediaEngine.h"
 #include "Core/HW/BufferQueue.h"
+#include "Core/Util/AudioFormat.h"
 
 #ifdef USE_FFMPEG
 
@@ -202,7 +203,12 @@ bool SimpleAudio::Decode(void *inbuf, int inbytes, uint8_t *outbuf, int *outbyte
 	// get bytes consumed in source
 	srcPos = len;
 
-	if (got_frame) {
+	if (got_frame && frame_->format == AV_SAMPLE_FMT_FLTP && frame_->channels == 2 && codecCtx_->sample_rate == wanted_resample_freq) {
+		// Nothing to resample or remix, so skip swresample and just interleave and convert.
+		ConvertPlanarF32ToS16((s16 *)outbuf, (const float *const *)frame_->extended_data, 2, frame_->nb_samples);
+		outSamples = frame_->nb_samples * 2;
+		*outbytes = outSamples * 2;
+	} else if (got_frame) {
 		// Initializing the sample rate convert. We will use it to convert float output into int.
 		int64_t wanted_channel_layout = AV_CH_LAYOUT_STEREO; // we want stereo output layout
 		int64_t dec_channel_layout = frame_->channel_layout; // decoded channel layout
@@ -29,13 +29,14 @@
 #define CONTROL_FACTOR  0.2f // in freq_shift per fifo size offset
 #define CONTROL_AVG     32
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
 #include "base/logging.h"
 #include "base/NativeApp.h"
 #include "Common/ChunkFile.h"
 #include "Common/MathUtil.h"
-#include "Common/Atomics.h"
 #include "Core/Config.h"
 #include "Core/HW/StereoResampler.h"
 #include "Core/HLE/__sceAudio.h"
@@ -58,11 +59,37 @@ StereoResampler::StereoResampler()
 		, m_numLeftI(0.0f)
 		, m_frac(0)
 		, underrunCount_(0)
+		, underrunFrames_(0)
 		, overrunCount_(0)
+		, minBuffered_(-1)
+		, maxBuffered_(-1)
 		, sample_rate_(0.0f)
 		, lastBufSize_(0) {
 	// Need to have space for the worst case in case it changes.
-	m_buffer = new int16_t[MAX_SAMPLES_EXTRA * 2]();
+	m_buffer = new int16_t[MAX_SAMPLES_EXTRA * 2 + RING_MIRROR]();
+
+	// Blackman windowed sinc, a bit below Nyquist.  In 1.14 fixed point, each phase sums to exactly 1.0.
+	const double pi = 3.14159265358979323846;
+	const double cutoff = 0.9;
+	for (int p = 0; p < SINC_PHASES; ++p) {
+		double taps[SINC_TAPS];
+		double sum = 0.0;
+		for (int k = 0; k < SINC_TAPS; ++k) {
+			// Tap SINC_TAPS / 2 - 1 is the current frame.
+			const double t = (k - (SINC_TAPS / 2 - 1)) - (double)p / SINC_PHASES;
+			const double x = pi * cutoff * t;
+			const double n = (t + SINC_TAPS / 2) / SINC_TAPS;
+			const double window = 0.42 - 0.5 * cos(2.0 * pi * n) + 0.08 * cos(4.0 * pi * n);
+			taps[k] = (fabs(x) < 1e-9 ? 1.0 : sin(x) / x) * window;
+			sum += taps[k];
+		}
+		int total = 0;
+		for (int k = 0; k < SINC_TAPS; ++k) {
+			sincTable_[p][k] = (s16)floor(taps[k] * 16384.0 / sum + 0.5);
+			total += sincTable_[p][k];
+		}
+		sincTable_[p][SINC_TAPS / 2 - 1] += (s16)(16384 - total);
+	}
 
 	// Some Android devices are v-synced to non-60Hz framerates. We simply timestretch audio to fit.
 	// TODO: should only do this if auto frameskip is off?
@@ -82,12 +109,11 @@ StereoResampler::~StereoResampler() {
 }
 
 void StereoResampler::UpdateBufferSize() {
-	if (g_Config.bExtraAudioBuffering) {
-		m_bufsize = MAX_SAMPLES_EXTRA;
-		m_lowwatermark = LOW_WATERMARK_EXTRA;
-	} else {
-		m_bufsize = MAX_SAMPLES_DEFAULT;
-		m_lowwatermark = LOW_WATERMARK_DEFAULT;
+	// Mix() reads these on the audio thread, so only write when the setting actually changed.
+	const int bufsize = g_Config.bExtraAudioBuffering ? MAX_SAMPLES_EXTRA : MAX_SAMPLES_DEFAULT;
+	if (m_bufsize != bufsize) {
+		m_bufsize = bufsize;
+		m_lowwatermark = g_Config.bExtraAudioBuffering ? LOW_WATERMARK_EXTRA : LOW_WATERMARK_DEFAULT;
 	}
 }
 
@@ -142,7 +168,80 @@ inline void ClampBufferToS16WithVolume(s16 *out, const s32 *in, size_t size) {
 }
 
 void StereoResampler::Clear() {
-	memset(m_buffer, 0, m_bufsize * 2 * sizeof(int16_t));
+	memset(m_buffer, 0, (m_bufsize * 2 + RING_MIRROR) * sizeof(int16_t));
+}
+
+u32 StereoResampler::MixLinear(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio) {
+	const int INDEX_MASK = (m_bufsize * 2 - 1);
+	u32 currentSample = 0;
+	for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2) {
+		u32 indexR2 = indexR + 2; //next sample
+		s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
+		s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
+		s16 l2 = m_buffer[indexR2 & INDEX_MASK]; //next
+		s16 r2 = m_buffer[(indexR2 + 1) & INDEX_MASK]; //next
+		int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
+		int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
+		samples[currentSample] = sampleL;
+		samples[currentSample + 1] = sampleR;
+		m_frac += ratio;
+		indexR += 2 * (u16)(m_frac >> 16);
+		m_frac &= 0xffff;
+	}
+	return currentSample;
+}
+
+u32 StereoResampler::MixSinc(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio) {
+	const int INDEX_MASK = (m_bufsize * 2 - 1);
+	u32 currentSample = 0;
+	// We need SINC_TAPS / 2 frames ahead of the current one.  The ones behind are never overwritten by PushSamples.
+	for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) >= SINC_TAPS + 2; currentSample += 2) {
+		// Thanks to the mirror at the end, these never wrap.
+		const s16 *in = &m_buffer[(indexR - (SINC_TAPS - 2)) & INDEX_MASK];
+		const s16 *coefs = sincTable_[m_frac >> 10];
+#ifdef _M_SSE
+		__m128i acc = _mm_setzero_si128();
+		for (int k = 0; k < SINC_TAPS; k += 4) {
+			// L0 R0 L1 R1 ... to L0 L1 R0 R1 ..., against c0 c1 c0 c1 ...
+			__m128i data = _mm_loadu_si128((const __m128i *)(in + k * 2));
+			data = _mm_shufflehi_epi16(_mm_shufflelo_epi16(data, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+			__m128i c = _mm_loadl_epi64((const __m128i *)(coefs + k));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(data, _mm_unpacklo_epi32(c, c)));
+		}
+		acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_srli_si128(acc, 8)), 14);
+		acc = _mm_packs_epi32(acc, acc);
+		samples[currentSample] = (s16)_mm_extract_epi16(acc, 0);
+		samples[currentSample + 1] = (s16)_mm_extract_epi16(acc, 1);
+#elif PPSSPP_ARCH(ARM_NEON)
+		int32x4_t accL = vdupq_n_s32(0);
+		int32x4_t accR = vdupq_n_s32(0);
+		for (int k = 0; k < SINC_TAPS; k += 8) {
+			int16x8x2_t data = vld2q_s16(in + k * 2);
+			int16x8_t c = vld1q_s16(coefs + k);
+			accL = vmlal_s16(accL, vget_low_s16(data.val[0]), vget_low_s16(c));
+			accL = vmlal_s16(accL, vget_high_s16(data.val[0]), vget_high_s16(c));
+			accR = vmlal_s16(accR, vget_low_s16(data.val[1]), vget_low_s16(c));
+			accR = vmlal_s16(accR, vget_high_s16(data.val[1]), vget_high_s16(c));
+		}
+		int32x2_t sum = vpadd_s32(vadd_s32(vget_low_s32(accL), vget_high_s32(accL)), vadd_s32(vget_low_s32(accR), vget_high_s32(accR)));
+		int16x4_t out = vqmovn_s32(vshrq_n_s32(vcombine_s32(sum, sum), 14));
+		samples[currentSample] = vget_lane_s16(out, 0);
+		samples[currentSample + 1] = vget_lane_s16(out, 1);
+#else
+		int sampleL = 0;
+		int sampleR = 0;
+		for (int k = 0; k < SINC_TAPS; ++k) {
+			sampleL += in[k * 2] * coefs[k];
+			sampleR += in[k * 2 + 1] * coefs[k];
+		}
+		samples[currentSample] = clamp_s16(sampleL >> 14);
+		samples[currentSample + 1] = clamp_s16(sampleR >> 14);
+#endif
+		m_frac += ratio;
+		indexR += 2 * (u16)(m_frac >> 16);
+		m_frac &= 0xffff;
+	}
+	return currentSample;
 }
 
 // Executed from sound stream thread
@@ -150,29 +249,27 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 	if (!samples)
 		return 0;
 
-	unsigned int currentSample = 0;
+	u32 currentSample = 0;
 
-	// Cache access in non-volatile variable
-	// This is the only function changing the read value, so it's safe to
-	// cache it locally although it's written here.
-	// The writing pointer will be modified outside, but it will only increase,
-	// so we will just ignore new written data while interpolating.
-	// Without this cache, the compiler wouldn't be allowed to optimize the
-	// interpolation loop.
-	u32 indexR = Common::AtomicLoad(m_indexR);
-	u32 indexW = Common::AtomicLoad(m_indexW);
+	// This is the only function changing the read index, so it's safe to keep it locally.
+	// The write index will only increase, new data arriving meanwhile is just picked up next time.
+	u32 indexR = m_indexR.load(std::memory_order_relaxed);
+	u32 indexW = m_indexW.load(std::memory_order_acquire);
 
 	const int INDEX_MASK = (m_bufsize * 2 - 1);
+	TrackBufferLevel((indexW - indexR) & INDEX_MASK);
 
 	// We force on the audio resampler if the output sample rate doesn't match the input.
 	if (!g_Config.bAudioResampler && sample_rate == (int)m_input_sample_rate) {
-		for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2) {
-			s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
-			s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
-			samples[currentSample] = l1;
-			samples[currentSample + 1] = r1;
-			indexR += 2;
-		}
+		// Leave the last frame, like the resampling paths do.  At most two copies, around the end of the ring.
+		const u32 buffered = (indexW - indexR) & INDEX_MASK;
+		const u32 count = std::min(numSamples * 2, buffered > 2 ? buffered - 2 : 0);
+		const u32 start = indexR & INDEX_MASK;
+		const u32 first = std::min(count, (u32)(m_bufsize * 2) - start);
+		memcpy(samples, &m_buffer[start], first * sizeof(s16));
+		memcpy(samples + first, &m_buffer[0], (count - first) * sizeof(s16));
+		indexR += count;
+		currentSample = count;
 		sample_rate_ = (float)sample_rate;
 	} else {
 		// Drift prevention mechanism
@@ -185,27 +282,18 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 		sample_rate_ = (float)(m_input_sample_rate + offset);
 		const u32 ratio = (u32)(65536.0 * sample_rate_ / (double)sample_rate);
 
-		// TODO: consider a higher-quality resampling algorithm.
-		// TODO: Add a fast path for 1:1.
-		for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2) {
-			u32 indexR2 = indexR + 2; //next sample
-			s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
-			s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
-			s16 l2 = m_buffer[indexR2 & INDEX_MASK]; //next
-			s16 r2 = m_buffer[(indexR2 + 1) & INDEX_MASK]; //next
-			int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
-			int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
-			samples[currentSample] = sampleL;
-			samples[currentSample + 1] = sampleR;
-			m_frac += ratio;
-			indexR += 2 * (u16)(m_frac >> 16);
-			m_frac &= 0xffff;
+		if (g_Config.bSincResampler) {
+			currentSample = MixSinc(samples, numSamples, indexR, indexW, ratio);
+		} else {
+			currentSample = MixLinear(samples, numSamples, indexR, indexW, ratio);
 		}
 	}
 
 	int realSamples = currentSample;
-	if (currentSample < numSamples * 2)
+	if (currentSample < numSamples * 2) {
 		underrunCount_++;
+		underrunFrames_ += numSamples - currentSample / 2;
+	}
 
 	// Padding with the last value to reduce clicking
 	short s[2];
@@ -216,24 +304,39 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 		samples[currentSample + 1] = s[1];
 	}
 
-	// Flush cached variable
-	Common::AtomicStore(m_indexR, indexR);
+	// Hand the space back to PushSamples.
+	m_indexR.store(indexR, std::memory_order_release);
 
 	//if (realSamples != numSamples * 2) {
 	//	ILOG("Underrun! %i / %i", realSamples / 2, numSamples);
 	//}
-	lastBufSize_ = (m_indexW - m_indexR) & INDEX_MASK;
+	lastBufSize_ = (m_indexW.load(std::memory_order_relaxed) - indexR) & INDEX_MASK;
 
 	return realSamples / 2;
 }
 
+void StereoResampler::WriteSamples(u32 start, const s32 *samples, unsigned int numSamples) {
+	const u32 size = m_bufsize * 2;
+	const u32 count = numSamples * 2;
+	const u32 first = std::min(count, size - start);
+	ClampBufferToS16WithVolume(&m_buffer[start], samples, first);
+	if (first < count)
+		ClampBufferToS16WithVolume(&m_buffer[0], samples + first, count - first);
+
+	// Keep the copy of the start of the ring (past the end) up to date.
+	if (start < RING_MIRROR)
+		memcpy(&m_buffer[size + start], &m_buffer[start], (std::min(start + count, (u32)RING_MIRROR) - start) * sizeof(s16));
+	if (first < count)
+		memcpy(&m_buffer[size], &m_buffer[0], std::min(count - first, (u32)RING_MIRROR) * sizeof(s16));
+}
+
 void StereoResampler::PushSamples(const s32 *samples, unsigned int num_samples) {
 	UpdateBufferSize();
 	const int INDEX_MASK = (m_bufsize * 2 - 1);
-	// Cache access in non-volatile variable
-	// indexR isn't allowed to cache in the audio throttling loop as it
-	// needs to get updates to not deadlock.
-	u32 indexW = Common::AtomicLoad(m_indexW);
+	// This is the only function changing the write index.
+	// The read index must be reloaded each time, the audio throttling loop waits on it.
+	u32 indexW = m_indexW.load(std::memory_order_relaxed);
+	u32 indexR = m_indexR.load(std::memory_order_acquire);
 
 	u32 cap = m_bufsize * 2;
 	// If unthottling, no need to fill up the entire buffer, just screws up timing after releasing unthrottle.
@@ -241,30 +344,39 @@ void StereoResampler::PushSamples(const s32 *samples, unsigned int num_samples)
 		cap = m_lowwatermark * 2;
 
 	// Check if we have enough free space
-	// indexW == m_indexR results in empty buffer, so indexR must always be smaller than indexW
-	if (num_samples * 2 + ((indexW - Common::AtomicLoad(m_indexR)) & INDEX_MASK) >= cap) {
+	// indexW == m_indexR results in empty buffer, so indexR must always be smaller than indexW.
+	// The frames just behind indexR are also kept, the sinc resampler still reads them.
+	if (num_samples * 2 + ((indexW - indexR) & INDEX_MASK) >= cap - RING_MIRROR) {
 		if (!PSP_CoreParameter().unthrottle)
 			overrunCount_++;
 		// TODO: "Timestretch" by doing a windowed overlap with existing buffer content?
 		return;
 	}
 
-	int over_bytes = num_samples * 4 - (m_bufsize * 2 - (indexW & INDEX_MASK)) * sizeof(short);
-	if (over_bytes > 0) {
-		ClampBufferToS16WithVolume(&m_buffer[indexW & INDEX_MASK], samples, (num_samples * 4 - over_bytes) / 2);
-		ClampBufferToS16WithVolume(&m_buffer[0], samples + (num_samples * 4 - over_bytes) / sizeof(short), over_bytes / 2);
-	} else {
-		ClampBufferToS16WithVolume(&m_buffer[indexW & INDEX_MASK], samples, num_samples * 2);
-	}
+	WriteSamples(indexW & INDEX_MASK, samples, num_samples);
 
-	Common::AtomicAdd(m_indexW, num_samples * 2);
+	m_indexW.store(indexW + num_samples * 2, std::memory_order_release);
 	lastPushSize_ = num_samples;
 }
 
+void StereoResampler::TrackBufferLevel(int buffered) {
+	if (minBuffered_ < 0 || buffered < minBuffered_)
+		minBuffered_ = buffered;
+	if (buffered > maxBuffered_)
+		maxBuffered_ = buffered;
+}
+
 void StereoResampler::GetAudioDebugStats(AudioDebugStats *stats) {
 	stats->buffered = lastBufSize_;
+	// Since the last time we were asked, so these show how close to the edge we get.
+	stats->minBuffered = minBuffered_ < 0 ? lastBufSize_ : minBuffered_;
+	stats->maxBuffered = maxBuffered_ < 0 ? lastBufSize_ : maxBuffered_;
+	minBuffered_ = -1;
+	maxBuffered_ = -1;
 	stats->underrunCount += underrunCount_;
 	underrunCount_ = 0;
+	stats->underrunFrames += underrunFrames_;
+	underrunFrames_ = 0;
 	stats->overrunCount += overrunCount_;
 	overrunCount_ = 0;
 	stats->watermark = m_lowwatermark;
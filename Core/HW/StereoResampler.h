@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 
 #include "Common/ChunkFile.h"
@@ -47,17 +48,36 @@ class StereoResampler {
 protected:
 	void UpdateBufferSize();
 	void SetInputSampleRate(unsigned int rate);
+	void WriteSamples(u32 start, const s32 *samples, unsigned int numSamples);
+	u32 MixLinear(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio);
+	u32 MixSinc(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio);
+	void TrackBufferLevel(int buffered);
+
+	enum {
+		CACHE_LINE = 64,
+		// Frames on either side of the output position, for the sinc resampler.
+		SINC_TAPS = 16,
+		SINC_PHASES = 64,
+		// In shorts. The start of the ring is copied past the end so the taps can always be read in one go.
+		RING_MIRROR = SINC_TAPS * 2,
+	};
 
 	int m_bufsize;
 	int m_lowwatermark;
 	unsigned int m_input_sample_rate;
 	int16_t *m_buffer;
-	volatile u32 m_indexW;
-	volatile u32 m_indexR;
+	// Only PushSamples moves the write index, and only Mix moves the read index.
+	// Keep them on separate cache lines so the two threads don't fight over them.
+	alignas(CACHE_LINE) std::atomic<u32> m_indexW;
+	alignas(CACHE_LINE) std::atomic<u32> m_indexR;
+	alignas(CACHE_LINE) s16 sincTable_[SINC_PHASES][SINC_TAPS];
 	float m_numLeftI;
 	u32 m_frac;
 	int underrunCount_;
+	int underrunFrames_;
 	int overrunCount_;
+	int minBuffered_;
+	int maxBuffered_;
 	float sample_rate_;
 	int lastBufSize_;
 	int lastPushSize_;
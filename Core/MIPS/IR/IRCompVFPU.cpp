@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <cmath>
+#include <cstring>
 
 #include "math/math_util.h"
 
@@ -151,21 +152,51 @@ namespace MIPSComp {
 
 		// Some common vector prefixes
 		if (sz == V_Quad && IsConsecutive4(vregs)) {
-			if (prefix == 0xF00E4) {
+			// A shuffle, then abs and/or negate on every lane, but no constants.
+			int abs = (prefix >> 8) & 0xF;
+			int negate = (prefix >> 16) & 0xF;
+			if ((prefix & 0xFFF0F000) == 0 && (abs == 0 || abs == 0xF) && (negate == 0 || negate == 0xF)) {
 				InitRegs(vregs, tempReg);
-				ir.Write(IROp::Vec4Neg, vregs[0], origV[0]);
-				return;
-			}
-			if (prefix == 0x00FE4) {
-				InitRegs(vregs, tempReg);
-				ir.Write(IROp::Vec4Abs, vregs[0], origV[0]);
+				u8 src = origV[0];
+				if ((prefix & 0xFF) != 0xE4) {
+					ir.Write(IROp::Vec4Shuffle, vregs[0], src, prefix & 0xFF);
+					src = vregs[0];
+				}
+				if (abs) {
+					ir.Write(IROp::Vec4Abs, vregs[0], src);
+					src = vregs[0];
+				}
+				if (negate)
+					ir.Write(IROp::Vec4Neg, vregs[0], src);
 				return;
 			}
-			// Pure shuffle
-			if (prefix == (prefix & 0xFF)) {
-				InitRegs(vregs, tempReg);
-				ir.Write(IROp::Vec4Shuffle, vregs[0], origV[0], prefix);
-				return;
+		}
+
+		// All constants, which are often one of the common vec4 ones.
+		if (((prefix >> 12) & ((1 << n) - 1)) == (1 << n) - 1) {
+			static const float initValues[][4] = {
+				{ 0.0f, 0.0f, 0.0f, 0.0f },
+				{ 1.0f, 1.0f, 1.0f, 1.0f },
+				{ -1.0f, -1.0f, -1.0f, -1.0f },
+				{ 1.0f, 0.0f, 0.0f, 0.0f },
+				{ 0.0f, 1.0f, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, 1.0f, 0.0f },
+				{ 0.0f, 0.0f, 0.0f, 1.0f },
+			};
+			float values[4];
+			for (int i = 0; i < n; i++) {
+				int regnum = (prefix >> (i * 2)) & 3;
+				int abs = (prefix >> (8 + i)) & 1;
+				int negate = (prefix >> (16 + i)) & 1;
+				values[i] = negate ? -constantArray[regnum + (abs << 2)] : constantArray[regnum + (abs << 2)];
+			}
+			for (int init = 0; init < (int)ARRAY_SIZE(initValues); init++) {
+				// Only the used lanes matter, and -0.0 is not the same as 0.0 here.
+				if (memcmp(values, initValues[init], n * sizeof(float)) == 0) {
+					InitRegs(vregs, tempReg);
+					ir.Write(IROp::Vec4Init, vregs[0], init);
+					return;
+				}
 			}
 		}
 
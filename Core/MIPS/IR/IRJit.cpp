@@ -34,6 +34,7 @@
 #include "Core/MIPS/IR/IRPassSimplify.h"
 #include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 #include "Core/Reporting.h"
 
 namespace MIPSComp {
@@ -258,6 +259,7 @@ void IRBlockCache::Clear() {
 	}
 	blocks_.clear();
 	byPage_.clear();
+	JitPageProtect::UnprotectAll();
 }
 
 void IRBlockCache::InvalidateICache(u32 address, u32 length) {
@@ -286,6 +288,7 @@ void IRBlockCache::FinalizeBlock(int i, bool preload) {
 
 	u32 startAddr, size;
 	blocks_[i].GetRange(startAddr, size);
+	JitPageProtect::Protect(startAddr, size);
 
 	u32 startPage = AddressToPage(startAddr);
 	u32 endPage = AddressToPage(startAddr + size);
@@ -312,7 +315,8 @@ int IRBlockCache::FindPreloadBlock(u32 em_address) {
 		blocks_[i].GetRange(start, mipsBytes);
 
 		if (start == em_address) {
-			if (blocks_[i].HashMatches()) {
+			// If the pages are still protected, nothing wrote to them and there's no need to hash.
+			if (JitPageProtect::RangeUnwritten(start, mipsBytes) || blocks_[i].HashMatches()) {
 				return i;
 			}
 		}
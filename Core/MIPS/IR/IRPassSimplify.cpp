@@ -901,6 +901,103 @@ bool PurgeTemps(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	return logBlocks;
 }
 
+static bool IsVfpuPrefixTemp(int reg) {
+	return reg >= IRVTEMP_PFX_S && reg < IRVTEMP_PFX_D + 4;
+}
+
+static int IRFPRTypeSize(char type) {
+	switch (type) {
+	case 'F': return 1;
+	case '2': return 2;
+	case 'V': return 4;
+	default: return 0;
+	}
+}
+
+static bool IRFPRsOverlap(int reg1, int size1, int reg2, int size2) {
+	return reg1 < reg2 + size2 && reg2 < reg1 + size1;
+}
+
+static bool IRReadsFromFPRs(const IRInst &inst, int reg, int size) {
+	const IRMeta *m = GetIRMeta(inst.op);
+
+	if (IRFPRsOverlap(inst.src1, IRFPRTypeSize(m->types[1]), reg, size)) {
+		return true;
+	}
+	if (IRFPRsOverlap(inst.src2, IRFPRTypeSize(m->types[2]), reg, size)) {
+		return true;
+	}
+	if ((m->flags & (IRFLAG_SRC3 | IRFLAG_SRC3DST)) != 0 && IRFPRsOverlap(inst.src3, IRFPRTypeSize(m->types[0]), reg, size)) {
+		return true;
+	}
+	if (inst.op == IROp::Interpret || inst.op == IROp::CallReplacement) {
+		return true;
+	}
+	// Only writes dest when the condition holds, so the old value may survive.
+	if (inst.op == IROp::FCmovVfpuCC && IRFPRsOverlap(inst.dest, 1, reg, size)) {
+		return true;
+	}
+	return false;
+}
+
+// Whether the value in the FPRs written at index is read again, or is overwritten first.
+static bool IsFPRWriteRead(const std::vector<IRInst> &insts, int index, int reg, int size) {
+	for (int j = index + 1, n = (int)insts.size(); j < n; j++) {
+		const IRInst &inst = insts[j];
+		if (IRReadsFromFPRs(inst, reg, size)) {
+			return true;
+		}
+		const IRMeta *m = GetIRMeta(inst.op);
+		if ((m->flags & (IRFLAG_SRC3 | IRFLAG_SRC3DST)) == 0 && inst.dest == reg && IRFPRTypeSize(m->types[0]) >= size) {
+			return false;
+		}
+	}
+	return false;
+}
+
+// The VFPU prefix temps only hold a value from the prefix to the op using it (or, for the
+// write mask, not at all), so writes to them can often be dropped or folded into that op.
+bool OptimizeVfpuTemps(const IRWriter &in, IRWriter &out, const IROptions &opts) {
+	const std::vector<IRInst> &insts = in.GetInstructions();
+	bool logBlocks = false;
+	for (int i = 0, n = (int)insts.size(); i < n; i++) {
+		IRInst inst = insts[i];
+		const IRMeta *m = GetIRMeta(inst.op);
+		const int destSize = (m->flags & (IRFLAG_SRC3 | IRFLAG_SRC3DST)) == 0 ? IRFPRTypeSize(m->types[0]) : 0;
+		if (destSize == 0 || !IsVfpuPrefixTemp(inst.dest)) {
+			out.Write(inst);
+			continue;
+		}
+
+		if (!IsFPRWriteRead(insts, i, inst.dest, destSize)) {
+			// Masked out lanes of a D prefix, mostly.
+			continue;
+		}
+
+		if (inst.op == IROp::Vec4Neg && i + 1 < n && !IRFPRsOverlap(inst.src1, 4, inst.dest, 4) && !IsFPRWriteRead(insts, i + 1, inst.dest, 4)) {
+			// a + -b is a - b, and a - -b is a + b.
+			IRInst next = insts[i + 1];
+			if ((next.op == IROp::Vec4Add || next.op == IROp::Vec4Sub) && next.src2 == inst.dest && next.src1 != inst.dest) {
+				next.op = next.op == IROp::Vec4Add ? IROp::Vec4Sub : IROp::Vec4Add;
+				next.src2 = inst.src1;
+				out.Write(next);
+				i++;
+				continue;
+			} else if (next.op == IROp::Vec4Add && next.src1 == inst.dest && next.src2 != inst.dest) {
+				next.op = IROp::Vec4Sub;
+				next.src1 = next.src2;
+				next.src2 = inst.src1;
+				out.Write(next);
+				i++;
+				continue;
+			}
+		}
+
+		out.Write(inst);
+	}
+	return logBlocks;
+}
+
 bool ReduceLoads(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	// This tells us to skip an AND op that has been optimized out.
 	// Maybe we could skip multiple, but that'd slow things down and is pretty uncommon.
@@ -31,6 +31,8 @@
 #include "Common/CommonWindows.h"
 #endif
 
+#include "base/timeutil.h"
+#include "ext/xxhash.h"
 #include "Core/Core.h"
 #include "Core/MemMap.h"
 #include "Core/CoreTiming.h"
@@ -42,6 +44,7 @@
 
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 
 // #include "JitBase.h"
 
@@ -59,6 +62,73 @@ op_agent_t agent;
 
 const u32 INVALID_EXIT = 0xFFFFFFFF;
 
+JitInvalidateStats jitInvalidateStats;
+
+void JitBlockPageIndex::Add(int blockNum, u32 start, u32 end) {
+	if (end <= start)
+		return;
+	const Entry entry{ blockNum, start, end };
+	for (u32 page = start >> PAGE_SHIFT; page <= (end - 1) >> PAGE_SHIFT; ++page)
+		pages_[page].push_back(entry);
+}
+
+void JitBlockPageIndex::Remove(int blockNum, u32 start, u32 end) {
+	if (end <= start)
+		return;
+	for (u32 page = start >> PAGE_SHIFT; page <= (end - 1) >> PAGE_SHIFT; ++page) {
+		auto it = pages_.find(page);
+		if (it == pages_.end())
+			continue;
+		std::vector<Entry> &entries = it->second;
+		for (size_t i = 0; i < entries.size(); ++i) {
+			if (entries[i].blockNum == blockNum) {
+				entries[i] = entries.back();
+				entries.pop_back();
+				break;
+			}
+		}
+		if (entries.empty())
+			pages_.erase(it);
+	}
+}
+
+void JitBlockPageIndex::FindOverlapping(u32 start, u32 end, std::vector<int> *blockNums) const {
+	if (end <= start)
+		return;
+
+	const size_t firstFound = blockNums->size();
+	auto check = [&](const std::vector<Entry> &entries) {
+		for (const Entry &entry : entries) {
+			if (entry.start < end && entry.end > start)
+				blockNums->push_back(entry.blockNum);
+		}
+	};
+
+	const u32 firstPage = start >> PAGE_SHIFT;
+	const u32 lastPage = (end - 1) >> PAGE_SHIFT;
+	if (lastPage - firstPage >= pages_.size()) {
+		// Huge range, cheaper to just go through what's there.
+		for (const auto &it : pages_) {
+			if (it.first >= firstPage && it.first <= lastPage)
+				check(it.second);
+		}
+	} else {
+		for (u32 page = firstPage; page <= lastPage; ++page) {
+			auto it = pages_.find(page);
+			if (it != pages_.end())
+				check(it->second);
+		}
+	}
+
+	// Blocks that cross a page boundary were found more than once.
+	std::sort(blockNums->begin() + firstFound, blockNums->end());
+	blockNums->erase(std::unique(blockNums->begin() + firstFound, blockNums->end()), blockNums->end());
+}
+
+void JitBlockPageIndex::Clear() {
+	pages_.clear();
+}
+
 JitBlockCache::JitBlockCache(MIPSState *mips, CodeBlockCommon *codeBlock) :
 	codeBlock_(codeBlock), blocks_(nullptr), num_blocks_(0) {
 }
@@ -102,7 +172,8 @@ void JitBlockCache::Shutdown() {
 // This clears the JIT cache. It's called from JitCache.cpp when the JIT cache
 // is full and when saving and loading states.
 void JitBlockCache::Clear() {
-	block_map_.clear();
+	pageIndex_.Clear();
+	JitPageProtect::UnprotectAll();
 	proxyBlockMap_.clear();
 	for (int i = 0; i < num_blocks_; i++)
 		DestroyBlock(i, DestroyType::CLEAR);
@@ -148,6 +219,8 @@ int JitBlockCache::AllocateBlock(u32 startAddress) {
 
 	b.invalid = false;
 	b.originalAddress = startAddress;
+	b.spillCount = 0;
+	b.reloadCount = 0;
 	for (int i = 0; i < MAX_JIT_BLOCK_EXITS; ++i) {
 		b.exitAddress[i] = INVALID_EXIT;
 		b.exitPtrs[i] = 0;
@@ -174,6 +247,8 @@ void JitBlockCache::ProxyBlock(u32 rootAddress, u32 startAddress, u32 size, cons
 	b.invalid = false;
 	b.originalAddress = startAddress;
 	b.originalSize = size;
+	b.spillCount = 0;
+	b.reloadCount = 0;
 	for (int i = 0; i < MAX_JIT_BLOCK_EXITS; ++i) {
 		b.exitAddress[i] = INVALID_EXIT;
 		b.exitPtrs[i] = 0;
@@ -198,7 +273,8 @@ void JitBlockCache::AddBlockMap(int block_num) {
 	// Convert the logical address to a physical address for the block map
 	// Yeah, this'll work fine for PSP too I think.
 	u32 pAddr = b.originalAddress & 0x1FFFFFFF;
-	block_map_[std::make_pair(pAddr + 4 * b.originalSize, pAddr)] = block_num;
+	pageIndex_.Add(block_num, pAddr, pAddr + 4 * b.originalSize);
+	JitPageProtect::Protect(pAddr, 4 * b.originalSize);
 }
 
 void JitBlockCache::RemoveBlockMap(int block_num) {
@@ -208,18 +284,7 @@ void JitBlockCache::RemoveBlockMap(int block_num) {
 	}
 
 	const u32 pAddr = b.originalAddress & 0x1FFFFFFF;
-	auto it = block_map_.find(std::make_pair(pAddr + 4 * b.originalSize, pAddr));
-	if (it != block_map_.end() && it->second == (u32)block_num) {
-		block_map_.erase(it);
-	} else {
-		// It wasn't in there, or it has the wrong key.  Let's search...
-		for (auto it = block_map_.begin(); it != block_map_.end(); ++it) {
-			if (it->second == (u32)block_num) {
-				block_map_.erase(it);
-				break;
-			}
-		}
-	}
+	pageIndex_.Remove(block_num, pAddr, pAddr + 4 * b.originalSize);
 }
 
 static void ExpandRange(std::pair<u32, u32> &range, u32 newStart, u32 newEnd) {
@@ -461,6 +526,36 @@ std::vector<u32> JitBlockCache::SaveAndClearEmuHackOps() {
 	return result;
 }
 
+static u64 HashBlockRange(const JitBlock &b) {
+	return XXH64(Memory::GetPointerUnchecked(b.originalAddress), 4 * b.originalSize, 0x4A17B10C);
+}
+
+std::vector<u64> JitBlockCache::HashBlockRanges() const {
+	std::vector<u64> result;
+	result.resize(num_blocks_);
+
+	for (int block_num = 0; block_num < num_blocks_; ++block_num) {
+		const JitBlock &b = blocks_[block_num];
+		if (!b.invalid && !b.IsPureProxy())
+			result[block_num] = HashBlockRange(b);
+	}
+
+	return result;
+}
+
+void JitBlockCache::ForgetChangedEmuHackOps(const std::vector<u64> &hashes, std::vector<u32> &saved) const {
+	if (num_blocks_ != (int)hashes.size() || num_blocks_ != (int)saved.size()) {
+		ERROR_LOG(JIT, "ForgetChangedEmuHackOps: Wrong saved block size.");
+		return;
+	}
+
+	// The first op alone isn't enough, code loaded later often starts with the same prologue.
+	for (int block_num = 0; block_num < num_blocks_; ++block_num) {
+		if (saved[block_num] != 0 && HashBlockRange(blocks_[block_num]) != hashes[block_num])
+			saved[block_num] = 0;
+	}
+}
+
 void JitBlockCache::RestoreSavedEmuHackOps(std::vector<u32> saved) {
 	if (num_blocks_ != (int)saved.size()) {
 		ERROR_LOG(JIT, "RestoreSavedEmuHackOps: Wrong saved block size.");
@@ -563,40 +658,43 @@ void JitBlockCache::InvalidateICache(u32 address, const u32 length) {
 		return;
 	}
 
-	// Blocks may start and end in overlapping ways, and destroying one invalidates iterators.
-	// So after destroying one, we start over.
-	do {
-	restart:
-		auto next = block_map_.lower_bound(std::make_pair(pAddr, 0));
-		auto last = block_map_.upper_bound(std::make_pair(pEnd + MAX_BLOCK_INSTRUCTIONS, 0));
-		// Note that if next is end(), last will be end() too (equal.)
-		for (; next != last; ++next) {
-			const u32 blockStart = next->first.second;
-			const u32 blockEnd = next->first.first;
-			if (blockStart < pEnd && blockEnd > pAddr) {
-				DestroyBlock(next->second, DestroyType::INVALIDATE);
-				// Our iterator is now invalid.  Break and search again.
-				// Most of the time there shouldn't be a bunch of matching blocks.
-				goto restart;
-			}
+	double st = real_time_now();
+	invalidateBlocks_.clear();
+	pageIndex_.FindOverlapping(pAddr, pEnd, &invalidateBlocks_);
+	for (int block_num : invalidateBlocks_) {
+		// Destroying one may have taken others (that proxied it) with it.
+		if (!blocks_[block_num].invalid) {
+			DestroyBlock(block_num, DestroyType::INVALIDATE);
+			jitInvalidateStats.numBlocksInvalidated++;
 		}
-		// We got here - it wasn't in the map at all (or anymore.)
-	} while (false);
+	}
+
+	jitInvalidateStats.numInvalidations++;
+	jitInvalidateStats.secondsInvalidating += real_time_now() - st;
 }
 
 void JitBlockCache::InvalidateChangedBlocks() {
+	double st = real_time_now();
 	// The primary goal of this is to make sure block linking is cleared up.
 	for (int block_num = 0; block_num < num_blocks_; ++block_num) {
 		JitBlock &b = blocks_[block_num];
 		if (b.invalid || b.IsPureProxy())
 			continue;
 
+		// Nothing could've changed it without a fault, and those are taken care of on the next slice.
+		if (JitPageProtect::RangeUnwritten(b.originalAddress, 4 * b.originalSize))
+			continue;
+
 		const u32 emuhack = GetEmuHackOpForBlock(block_num).encoding;
 		if (Memory::ReadUnchecked_U32(b.originalAddress) != emuhack) {
 			DEBUG_LOG(JIT, "Invalidating changed block at %08x", b.originalAddress);
 			DestroyBlock(block_num, DestroyType::INVALIDATE);
+			jitInvalidateStats.numBlocksInvalidated++;
 		}
 	}
+
+	jitInvalidateStats.numInvalidations++;
+	jitInvalidateStats.secondsInvalidating += real_time_now() - st;
 }
 
 int JitBlockCache::GetBlockExitSize() {
@@ -646,6 +744,8 @@ JitBlockDebugInfo JitBlockCache::GetBlockDebugInfo(int blockNum) const {
 	JitBlockDebugInfo debugInfo{};
 	const JitBlock *block = GetBlock(blockNum);
 	debugInfo.originalAddress = block->originalAddress;
+	debugInfo.spillCount = block->spillCount;
+	debugInfo.reloadCount = block->reloadCount;
 	for (u32 addr = block->originalAddress; addr <= block->originalAddress + block->originalSize * 4; addr += 4) {
 		char temp[256];
 		MIPSDisAsm(Memory::Read_Instruction(addr), addr, temp, true);
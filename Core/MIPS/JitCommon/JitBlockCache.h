@@ -70,6 +70,9 @@ struct JitBlock {
 	u16 codeSize;
 	u16 originalSize;
 	u16 blockNum;
+	// Register cache spills to memory, and loads of those regs again later in the block.
+	u16 spillCount;
+	u16 reloadCount;
 
 	bool invalid;
 	bool linkStatus[MAX_JIT_BLOCK_EXITS];
@@ -98,6 +101,48 @@ struct JitBlockDebugInfo {
 	std::vector<std::string> origDisasm;
 	std::vector<std::string> irDisasm;  // if any
 	std::vector<std::string> targetDisasm;
+	int spillCount;
+	int reloadCount;
+};
+
+// Counted by every JitBlockCache and reset every frame, like the kernel stats.
+struct JitInvalidateStats {
+	void ResetFrame() {
+		numInvalidations = 0;
+		numBlocksInvalidated = 0;
+		secondsInvalidating = 0.0;
+	}
+
+	int numInvalidations;
+	int numBlocksInvalidated;
+	double secondsInvalidating;
+};
+
+extern JitInvalidateStats jitInvalidateStats;
+
+// Which blocks overlap each 4KB page of physical memory, so invalidating a range
+// only has to look at the blocks near it.
+class JitBlockPageIndex {
+public:
+	// Ranges are physical addresses, end exclusive.
+	void Add(int blockNum, u32 start, u32 end);
+	void Remove(int blockNum, u32 start, u32 end);
+	// Appends each block overlapping the range once, in block number order.
+	void FindOverlapping(u32 start, u32 end, std::vector<int> *blockNums) const;
+	void Clear();
+
+private:
+	enum {
+		PAGE_SHIFT = 12,
+	};
+
+	struct Entry {
+		int blockNum;
+		u32 start;
+		u32 end;
+	};
+
+	std::unordered_map<u32, std::vector<Entry>> pages_;
 };
 
 class JitBlockCacheDebugInterface {
@@ -157,6 +202,11 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 	// Meant to be used to make memory safe for savestates, memcpy, etc.
 	std::vector<u32> SaveAndClearEmuHackOps();
 	void RestoreSavedEmuHackOps(std::vector<u32> saved);
+	// To keep blocks across a savestate load: hash every block's whole range while the emuhacks are out,
+	// then after memory is loaded, forget the saved emuhack of any block whose code differs.
+	// RestoreSavedEmuHackOps() then leaves those out, and InvalidateChangedBlocks() drops them.
+	std::vector<u64> HashBlockRanges() const;
+	void ForgetChangedEmuHackOps(const std::vector<u64> &hashes, std::vector<u32> &saved) const;
 
 	int GetNumBlocks() const override { return num_blocks_; }
 
@@ -184,7 +234,8 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 
 	int num_blocks_;
 	std::unordered_multimap<u32, int> links_to_;
-	std::map<std::pair<u32,u32>, u32> block_map_; // (end_addr, start_addr) -> number
+	JitBlockPageIndex pageIndex_;
+	std::vector<int> invalidateBlocks_;
 
 	enum {
 		JITBLOCK_RANGE_SCRATCH = 0,
@@ -0,0 +1,355 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "ppsspp_config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "Common/CommonWindows.h"
+#include "Common/Log.h"
+#include "Common/MemoryUtil.h"
+#include "Core/Config.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
+
+#if PPSSPP_PLATFORM(IOS) || PPSSPP_PLATFORM(UWP) || defined(__wiiu__)
+#define PAGE_PROTECT_UNSUPPORTED
+#elif !defined(_WIN32)
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#endif
+
+namespace JitPageProtect {
+
+// Covers the largest RAM size (three 31 MB views) at the smallest page size.
+static const u32 RAM_START = 0x08000000;
+static const u32 MAX_TRACKED_SIZE = 0x06000000;
+static const int MAX_PAGES = MAX_TRACKED_SIZE >> 12;
+static const int BITMAP_WORDS = MAX_PAGES / 32;
+
+// Each PSP address is mapped cached, uncached, and kernel.  Any of them can be written.
+static const int NUM_MIRRORS = 3;
+static const u32 mirrors[NUM_MIRRORS] = { 0x00000000, 0x40000000, 0x80000000 };
+
+// Written by the emu thread, cleared by the fault handler on whichever thread wrote.
+static std::atomic<u32> protectedPages[BITMAP_WORDS];
+static std::atomic<u32> writtenPages[BITMAP_WORDS];
+static std::atomic<bool> hasWrites;
+static std::atomic<int> writeFaults;
+static std::atomic<bool> anyProtected;
+// Keeps Protect() and WriteOpcode() from re-protecting a page while a host call writes into it.
+static std::mutex hostWriteLock;
+static int hostWrites = 0;
+
+static int pageShift = 0;
+static u32 trackedPages = 0;
+static bool handlerInstalled = false;
+static bool handlerFailed = false;
+
+static inline u8 *HostPointer(u32 mirror, u32 pAddr) {
+#ifdef MASKED_PSP_MEMORY
+	return Memory::base + ((mirror | pAddr) & Memory::MEMVIEW32_MASK);
+#else
+	return Memory::base + (mirror | pAddr);
+#endif
+}
+
+// No logging or allocation in here, it's used from the fault handler.
+static bool SetPageWritable(u32 page, bool writable) {
+	const u32 pageSize = 1 << pageShift;
+	const u32 pAddr = RAM_START + (page << pageShift);
+	bool success = true;
+	u8 *ptrs[NUM_MIRRORS];
+	for (int i = 0; i < NUM_MIRRORS; ++i) {
+		u8 *ptr = HostPointer(mirrors[i], pAddr);
+		ptrs[i] = ptr;
+		// When masked, the mirrors may land on the same view.
+		bool seen = false;
+		for (int j = 0; j < i; ++j)
+			seen = seen || ptrs[j] == ptr;
+		if (seen)
+			continue;
+#if defined(_WIN32) && !defined(PAGE_PROTECT_UNSUPPORTED)
+		DWORD oldValue;
+		success = VirtualProtect(ptr, pageSize, writable ? PAGE_READWRITE : PAGE_READONLY, &oldValue) != FALSE && success;
+#elif !defined(PAGE_PROTECT_UNSUPPORTED)
+		success = mprotect(ptr, pageSize, writable ? (PROT_READ | PROT_WRITE) : PROT_READ) == 0 && success;
+#endif
+	}
+	return success;
+}
+
+// Finds the tracked page a host pointer lands in, from any mirror.
+static bool HostToPage(uintptr_t ptr, u32 *page) {
+	if (Memory::base == nullptr || ptr < (uintptr_t)Memory::base)
+		return false;
+	const uintptr_t offset = ptr - (uintptr_t)Memory::base;
+	if (offset > 0xFFFFFFFFULL)
+		return false;
+	const u32 pAddr = (u32)offset & 0x1FFFFFFF;
+	if (pAddr < RAM_START || pAddr - RAM_START >= (trackedPages << pageShift))
+		return false;
+	*page = (pAddr - RAM_START) >> pageShift;
+	return true;
+}
+
+static void MarkPageWritten(u32 page) {
+	const u32 bit = 1U << (page & 31);
+	// Another thread may have beat us to it, in which case making it writable again is harmless.
+	protectedPages[page >> 5].fetch_and(~bit);
+	SetPageWritable(page, true);
+	writtenPages[page >> 5].fetch_or(bit);
+	hasWrites = true;
+}
+
+// Returns true if the address was ours and the write can simply be retried.
+static bool HandleWriteFault(uintptr_t faultAddress) {
+	u32 page;
+	if (!anyProtected || !HostToPage(faultAddress, &page))
+		return false;
+
+	MarkPageWritten(page);
+	writeFaults++;
+	return true;
+}
+
+#if defined(_WIN32) && !defined(PAGE_PROTECT_UNSUPPORTED)
+
+static LONG NTAPI WriteFaultHandler(PEXCEPTION_POINTERS info) {
+	const EXCEPTION_RECORD *record = info->ExceptionRecord;
+	if (record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || record->NumberParameters < 2)
+		return EXCEPTION_CONTINUE_SEARCH;
+	// 1 means it was a write.
+	if (record->ExceptionInformation[0] != 1)
+		return EXCEPTION_CONTINUE_SEARCH;
+	if (HandleWriteFault((uintptr_t)record->ExceptionInformation[1]))
+		return EXCEPTION_CONTINUE_EXECUTION;
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+static bool InstallHandler() {
+	return AddVectoredExceptionHandler(1, &WriteFaultHandler) != nullptr;
+}
+
+#elif !defined(PAGE_PROTECT_UNSUPPORTED)
+
+static struct sigaction oldSegvAction;
+static struct sigaction oldBusAction;
+
+static void WriteFaultHandler(int sig, siginfo_t *info, void *context) {
+	if (HandleWriteFault((uintptr_t)info->si_addr))
+		return;
+
+	// Not ours, pass it along to whoever was there before.
+	const struct sigaction &old = sig == SIGBUS ? oldBusAction : oldSegvAction;
+	if (old.sa_flags & SA_SIGINFO) {
+		old.sa_sigaction(sig, info, context);
+	} else if (old.sa_handler == SIG_DFL || old.sa_handler == SIG_IGN) {
+		// Returning will fault again, this time with the default action.
+		struct sigaction dfl;
+		memset(&dfl, 0, sizeof(dfl));
+		dfl.sa_handler = SIG_DFL;
+		sigaction(sig, &dfl, nullptr);
+	} else {
+		old.sa_handler(sig);
+	}
+}
+
+static bool InstallHandler() {
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = &WriteFaultHandler;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGSEGV, &sa, &oldSegvAction) != 0)
+		return false;
+	// Some platforms (like macOS) report protection faults as SIGBUS.
+	if (sigaction(SIGBUS, &sa, &oldBusAction) != 0) {
+		sigaction(SIGSEGV, &oldSegvAction, nullptr);
+		return false;
+	}
+	return true;
+}
+
+#else
+
+static bool InstallHandler() {
+	return false;
+}
+
+#endif
+
+bool IsSupported() {
+#ifdef PAGE_PROTECT_UNSUPPORTED
+	return false;
+#else
+	// We can't protect anything finer than the host page, and the bitmaps assume at least 4 KB.
+	const int pageSize = GetMemoryProtectPageSize();
+	return pageSize >= 4096 && pageSize <= 0x10000 && (pageSize & (pageSize - 1)) == 0;
+#endif
+}
+
+static bool Enable() {
+	if (!g_Config.bJitWriteProtect || handlerFailed || Memory::base == nullptr)
+		return false;
+	if (!handlerInstalled) {
+		if (!IsSupported() || !InstallHandler()) {
+			WARN_LOG(JIT, "Code write protection not supported, falling back to invalidation by the game");
+			handlerFailed = true;
+			return false;
+		}
+		const int pageSize = GetMemoryProtectPageSize();
+		pageShift = 12;
+		while ((1 << pageShift) < pageSize)
+			pageShift++;
+		handlerInstalled = true;
+		INFO_LOG(JIT, "Code write protection enabled with %d byte pages", pageSize);
+	}
+	trackedPages = std::min((u32)Memory::g_MemorySize, MAX_TRACKED_SIZE) >> pageShift;
+	return true;
+}
+
+void Protect(u32 addr, u32 size) {
+	if (!Enable())
+		return;
+	// The page may be written by a host call right now, in which case it just stays unprotected.
+	std::lock_guard<std::mutex> guard(hostWriteLock);
+	if (hostWrites != 0)
+		return;
+
+	const u32 pAddr = addr & 0x1FFFFFFF;
+	if (pAddr < RAM_START || size == 0)
+		return;
+	const u32 startPage = (pAddr - RAM_START) >> pageShift;
+	const u32 endPage = (pAddr - RAM_START + size - 1) >> pageShift;
+	for (u32 page = startPage; page <= endPage && page < trackedPages; ++page) {
+		const u32 bit = 1U << (page & 31);
+		// Mark it first, so a write that sneaks in before it's protected still counts.
+		if (protectedPages[page >> 5].fetch_or(bit) & bit)
+			continue;
+		anyProtected = true;
+		if (!SetPageWritable(page, false)) {
+			ERROR_LOG(JIT, "Unable to write protect code at %08x", RAM_START + (page << pageShift));
+			protectedPages[page >> 5].fetch_and(~bit);
+		}
+	}
+}
+
+void UnprotectAll() {
+	if (!anyProtected)
+		return;
+	// The memory size may have changed since these were protected.
+	for (u32 page = 0; page < (MAX_TRACKED_SIZE >> pageShift); ++page) {
+		const u32 bit = 1U << (page & 31);
+		if (protectedPages[page >> 5].fetch_and(~bit) & bit)
+			SetPageWritable(page, true);
+	}
+	for (int i = 0; i < BITMAP_WORDS; ++i)
+		writtenPages[i] = 0;
+	hasWrites = false;
+	anyProtected = false;
+}
+
+void WriteOpcode(u32 addr, u32 op) {
+	const u32 pAddr = addr & 0x1FFFFFFF;
+	const u32 page = (pAddr - RAM_START) >> pageShift;
+	if (!anyProtected || pAddr < RAM_START || page >= trackedPages || !(protectedPages[page >> 5] & (1U << (page & 31)))) {
+		Memory::WriteUnchecked_U32(op, addr);
+		return;
+	}
+
+	// A write from another thread in this window would be missed, but those don't target code in practice.
+	std::lock_guard<std::mutex> guard(hostWriteLock);
+	SetPageWritable(page, true);
+	Memory::WriteUnchecked_U32(op, addr);
+	if (protectedPages[page >> 5] & (1U << (page & 31)))
+		SetPageWritable(page, false);
+}
+
+HostWriteScope::HostWriteScope(const void *ptr, size_t size) : active_(false) {
+	if (!g_Config.bJitWriteProtect || size == 0)
+		return;
+
+	// Even if nothing is protected yet, something could be while the call runs.
+	std::lock_guard<std::mutex> guard(hostWriteLock);
+	hostWrites++;
+	active_ = true;
+
+	u32 startPage, endPage;
+	if (!anyProtected || !HostToPage((uintptr_t)ptr, &startPage))
+		return;
+	// The range may run past the end of RAM, then just go as far as we track.
+	if (!HostToPage((uintptr_t)ptr + size - 1, &endPage) || endPage < startPage)
+		endPage = trackedPages - 1;
+	for (u32 page = startPage; page <= endPage; ++page) {
+		if (protectedPages[page >> 5] & (1U << (page & 31)))
+			MarkPageWritten(page);
+	}
+}
+
+HostWriteScope::~HostWriteScope() {
+	if (active_) {
+		std::lock_guard<std::mutex> guard(hostWriteLock);
+		hostWrites--;
+	}
+}
+
+bool RangeUnwritten(u32 addr, u32 size) {
+	const u32 pAddr = addr & 0x1FFFFFFF;
+	if (!anyProtected || pAddr < RAM_START || size == 0)
+		return false;
+	const u32 startPage = (pAddr - RAM_START) >> pageShift;
+	const u32 endPage = (pAddr - RAM_START + size - 1) >> pageShift;
+	if (endPage >= trackedPages)
+		return false;
+	for (u32 page = startPage; page <= endPage; ++page) {
+		const u32 bit = 1U << (page & 31);
+		if (!(protectedPages[page >> 5] & bit) || (writtenPages[page >> 5] & bit))
+			return false;
+	}
+	return true;
+}
+
+bool HasWrites() {
+	return hasWrites;
+}
+
+void FlushWrites(void (*invalidate)(u32 addr, u32 size)) {
+	if (!hasWrites.exchange(false))
+		return;
+
+	const u32 pageSize = 1 << pageShift;
+	for (u32 word = 0; word < (trackedPages + 31) / 32; ++word) {
+		u32 bits = writtenPages[word].exchange(0);
+		while (bits != 0) {
+			int i = 0;
+			while (!(bits & (1U << i)))
+				i++;
+			bits &= ~(1U << i);
+			invalidate(RAM_START + (((word << 5) + i) << pageShift), pageSize);
+		}
+	}
+}
+
+int GetWriteFaultCount() {
+	return writeFaults;
+}
+
+}  // namespace JitPageProtect
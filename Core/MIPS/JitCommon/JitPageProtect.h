@@ -0,0 +1,65 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <cstddef>
+
+#include "Common/CommonTypes.h"
+
+// Optional detection of writes to compiled code (g_Config.bJitWriteProtect.)
+// The host pages backing PSP RAM that blocks were compiled from are made read only, in every mirror.
+// A write from any thread faults, the handler makes the page writable again and notes it, and the
+// emu thread invalidates the blocks in written pages at its next safe point.  A page stays writable
+// until something in it is compiled again.
+namespace JitPageProtect {
+
+// False if the platform can't do it, regardless of the setting.
+bool IsSupported();
+
+// Protects the pages covering [addr, addr + size), if enabled.  Only main RAM is tracked.
+void Protect(u32 addr, u32 size);
+// Unprotects everything, e.g. when the cache is cleared or memory is about to go away.
+void UnprotectAll();
+
+// Writes an emuhack (or the original op back) without it counting as a write to the code.
+void WriteOpcode(u32 addr, u32 op);
+
+// The kernel doesn't fault on protected pages, a read()/ReadFile()/recv() into them just fails.
+// Wrap host calls that write into PSP RAM in this.  The range counts as written, like after a
+// fault, and nothing gets protected again until the scope ends.  Pointers outside RAM are ignored.
+class HostWriteScope {
+public:
+	HostWriteScope(const void *ptr, size_t size);
+	~HostWriteScope();
+
+private:
+	bool active_;
+};
+
+// True when every page of the range is protected and hasn't been written since.
+bool RangeUnwritten(u32 addr, u32 size);
+
+// Cheap enough to check on every slice.
+bool HasWrites();
+// Calls invalidate for each written page (cached RAM address) and clears them.  Emu thread only.
+void FlushWrites(void (*invalidate)(u32 addr, u32 size));
+
+// For stats: how many write faults were taken in total.
+int GetWriteFaultCount();
+
+}  // namespace JitPageProtect
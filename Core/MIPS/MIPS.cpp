@@ -32,6 +32,7 @@
 #include "Core/System.h"
 #include "Core/HLE/sceDisplay.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 #include "Core/CoreTiming.h"
 
 MIPSState mipsr4k;
@@ -256,8 +257,8 @@ void MIPSState::DoState(PointerWrap &p) {
 	if (!s)
 		return;
 
-	// Reset the jit if we're loading.
-	if (p.mode == p.MODE_READ)
+	// Reset the jit if we're loading, unless it's a quick restore that keeps it (see SaveState.)
+	if (p.mode == p.MODE_READ && !PSP_CoreParameter().keepCachesOnLoad)
 		Reset();
 	if (MIPSComp::jit)
 		MIPSComp::jit->DoState(p);
@@ -311,6 +312,7 @@ int MIPSState::RunLoopUntil(u64 globalTicks) {
 	switch (PSP_CoreParameter().cpuCore) {
 	case CPUCore::JIT:
 	case CPUCore::IR_JIT:
+		InvalidateWrittenCode();
 		MIPSComp::jit->RunLoopUntil(globalTicks);
 		break;
 
@@ -326,6 +328,14 @@ void MIPSState::InvalidateICache(u32 address, int length) {
 		MIPSComp::jit->InvalidateCacheAt(address, length);
 }
 
+void MIPSState::InvalidateWrittenCode() {
+	if (MIPSComp::jit && JitPageProtect::HasWrites()) {
+		JitPageProtect::FlushWrites([](u32 address, u32 length) {
+			MIPSComp::jit->InvalidateCacheAt(address, length);
+		});
+	}
+}
+
 void MIPSState::ClearJitCache() {
 	if (MIPSComp::jit)
 		MIPSComp::jit->ClearCache();
@@ -264,6 +264,8 @@ class MIPSState
 	int RunLoopUntil(u64 globalTicks);
 	// To clear jit caches, etc.
 	void InvalidateICache(u32 address, int length = 4);
+	// Invalidates code that was caught being written, see JitPageProtect.
+	void InvalidateWrittenCode();
 
 	void ClearJitCache();
 };
@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <unordered_map>
@@ -24,6 +25,7 @@
 #include "base/timeutil.h"
 #include "ext/cityhash/city.h"
 #include "Common/FileUtil.h"
+#include "Common/ThreadPools.h"
 #include "Core/Config.h"
 #include "Core/MemMap.h"
 #include "Core/System.h"
@@ -873,40 +875,331 @@ namespace MIPSAnalyst {
 		return DetermineRegisterUsage(reg, addr, instrs) == USAGE_CLOBBERED;
 	}
 
-	void HashFunctions() {
-		std::lock_guard<std::recursive_mutex> guard(functions_lock);
-		std::vector<u32> buffer;
+	template <int N>
+	static void AgeLiveness(u8 (&next)[N]) {
+		for (int i = 0; i < N; ++i) {
+			if (next[i] < BlockLiveness::MAX_DISTANCE)
+				next[i]++;
+		}
+	}
 
-		for (auto iter = functions.begin(), end = functions.end(); iter != end; iter++) {
-			AnalyzedFunction &f = *iter;
-			if (!Memory::IsValidRange(f.start, f.end - f.start + 4)) {
-				continue;
+	struct VfpuRegUsage {
+		u8 reads[32];
+		int numReads;
+		u8 writes[16];
+		int numWrites;
+
+		void Read(VectorSize sz, int vreg) {
+			u8 regs[4];
+			GetVectorRegs(regs, sz, vreg);
+			for (int i = 0, n = GetNumVectorElements(sz); i < n; ++i)
+				reads[numReads++] = regs[i];
+		}
+		void ReadMatrix(MatrixSize sz, int mreg) {
+			u8 regs[16];
+			GetMatrixRegs(regs, sz, mreg);
+			for (int i = 0, n = GetMatrixSide(sz) * GetMatrixSide(sz); i < n; ++i)
+				reads[numReads++] = regs[i];
+		}
+		void Write(VectorSize sz, int vreg) {
+			u8 regs[4];
+			GetVectorRegs(regs, sz, vreg);
+			for (int i = 0, n = GetNumVectorElements(sz); i < n; ++i)
+				writes[numWrites++] = regs[i];
+		}
+		void WriteMatrix(MatrixSize sz, int mreg) {
+			u8 regs[16];
+			GetMatrixRegs(regs, sz, mreg);
+			for (int i = 0, n = GetMatrixSide(sz) * GetMatrixSide(sz); i < n; ++i)
+				writes[numWrites++] = regs[i];
+		}
+	};
+
+	// Which VFPU registers an op reads, and which it replaces entirely.  This only steers spills,
+	// so it can be rough: ops without a case here count as reading vs and vd at the op's size.
+	static void GetVfpuRegUsage(MIPSOpcode op, bool prefixD, VfpuRegUsage &usage) {
+		usage.numReads = 0;
+		usage.numWrites = 0;
+
+		const VectorSize sz = GetVecSize(op);
+		const int vd = _VD;
+		const int vs = _VS;
+		const int vt = _VT;
+		switch (op >> 26) {
+		case 50: // lv.s
+			usage.Write(V_Single, ((op >> 16) & 0x1f) | ((op & 3) << 5));
+			break;
+		case 58: // sv.s
+			usage.Read(V_Single, ((op >> 16) & 0x1f) | ((op & 3) << 5));
+			break;
+		case 54: // lv.q
+			usage.Write(V_Quad, ((op >> 16) & 0x1f) | ((op & 1) << 5));
+			break;
+		case 53: // lvl.q/lvr.q only replace some lanes.
+		case 61: // svl.q/svr.q
+		case 62: // sv.q
+			usage.Read(V_Quad, ((op >> 16) & 0x1f) | ((op & 1) << 5));
+			break;
+
+		case 18: // mfv/mtv and the control register forms.
+			if ((op & 0xFF) < 128) {
+				if (((op >> 21) & 0x1f) == 3)
+					usage.Read(V_Single, op & 0xFF);
+				else if (((op >> 21) & 0x1f) == 7)
+					usage.Write(V_Single, op & 0xFF);
+			}
+			break;
+
+		case 24: // vadd, vsub, vsbn, vdiv
+			usage.Read(sz, vs);
+			usage.Read(sz, vt);
+			usage.Write(sz, vd);
+			break;
+		case 25:
+			switch ((op >> 23) & 7) {
+			case 1: // vdot
+			case 4: // vhdp
+			case 6: // vdet
+				usage.Read(sz, vs);
+				usage.Read(sz, vt);
+				usage.Write(V_Single, vd);
+				break;
+			case 2: // vscl
+				usage.Read(sz, vs);
+				usage.Read(V_Single, vt);
+				usage.Write(sz, vd);
+				break;
+			default: // vmul, vcrs
+				usage.Read(sz, vs);
+				usage.Read(sz, vt);
+				usage.Write(sz, vd);
+				break;
 			}
+			break;
+		case 27: // vcmp, vmin, vmax, vscmp, vsge, vslt
+			usage.Read(sz, vs);
+			usage.Read(sz, vt);
+			if (((op >> 23) & 7) != 0)
+				usage.Write(sz, vd);
+			break;
+
+		case 52:
+			if (((op >> 21) & 0x1f) == 0) {
+				const int sub = (op >> 16) & 0x1f;
+				if (sub == 3 || sub == 6 || sub == 7) {
+					// vidt, vzero, vone
+					usage.Write(sz, vd);
+				} else {
+					usage.Read(sz, vs);
+					usage.Write(sz, vd);
+				}
+			} else if (((op >> 21) & 0x1f) == 3) {
+				// vcst
+				usage.Write(sz, vd);
+			} else {
+				usage.Read(sz, vs);
+				usage.Read(sz, vd);
+			}
+			break;
+
+		case 55:
+			// viim.s, vfim.s (the prefixes don't touch registers.)
+			if (((op >> 24) & 3) == 3)
+				usage.Write(V_Single, vt);
+			break;
+
+		case 60:
+		{
+			const int sub = (op >> 21) & 0x1f;
+			const MatrixSize msz = GetMtxSize(op);
+			if (sub < 4) {
+				// vmmul
+				usage.ReadMatrix(msz, vs);
+				usage.ReadMatrix(msz, vt);
+				usage.WriteMatrix(msz, vd);
+			} else if (sub < 16) {
+				// vtfm/vhtfm, the homogenous form reads one more row than it writes.
+				MatrixSize tsz = msz;
+				if (GetNumVectorElements(sz) == ((op >> 23) & 7))
+					tsz = (MatrixSize)((int)tsz + 1);
+				usage.ReadMatrix(tsz, vs);
+				usage.Read(sz, vt);
+				usage.Write(sz, vd);
+			} else if (sub < 20) {
+				// vmscl
+				usage.ReadMatrix(msz, vs);
+				usage.Read(V_Single, vt);
+				usage.WriteMatrix(msz, vd);
+			} else if (sub < 24) {
+				// vcrsp/vqmul
+				usage.Read(sz, vs);
+				usage.Read(sz, vt);
+				usage.Write(sz, vd);
+			} else if (sub == 28) {
+				// vmmov reads vs, vmidt/vmzero/vmone don't.
+				if (((op >> 16) & 0xF) == 0)
+					usage.ReadMatrix(msz, vs);
+				usage.WriteMatrix(msz, vd);
+			} else if (sub == 29) {
+				// vrot
+				usage.Read(V_Single, vs);
+				usage.Write(sz, vd);
+			}
+			break;
+		}
+
+		default:
+			usage.Read(sz, vs);
+			usage.Read(sz, vd);
+			break;
+		}
+
+		if (prefixD) {
+			// Masked lanes keep their old value, so the write doesn't end the old value's life.
+			memcpy(usage.reads + usage.numReads, usage.writes, usage.numWrites);
+			usage.numReads += usage.numWrites;
+			usage.numWrites = 0;
+		}
+	}
+
+	static bool IsVfpuPrefixD(MIPSOpcode op) {
+		return (op >> 26) == 55 && ((op >> 24) & 3) == 2;
+	}
+
+	void AnalyzeLiveness(u32 address, BlockLiveness *liveness) {
+		// First find the run, then walk it backwards.
+		MIPSOpcode ops[BlockLiveness::MAX_OPS];
+		int count = 0;
+		while (count < BlockLiveness::MAX_OPS) {
+			const u32 addr = address + count * 4;
+			if (!Memory::IsValidAddress(addr))
+				break;
+			const MIPSOpcode op = Memory::Read_Opcode_JIT(addr);
+			const MIPSInfo info = MIPSGetInfo(op);
+			// The jit compiles the delay slot before the branch, so stop before both.
+			if (info & (IS_CONDBRANCH | IS_JUMP))
+				break;
+			ops[count++] = op;
+		}
+		liveness->start = address;
+		liveness->count = count;
+
+		u8 gpr[MIPS_REG_LO + 1];
+		u8 fpr[32];
+		u8 vfpr[128];
+		memset(gpr, BlockLiveness::NEXT_USE_EXIT, sizeof(gpr));
+		memset(fpr, BlockLiveness::NEXT_USE_EXIT, sizeof(fpr));
+		memset(vfpr, BlockLiveness::NEXT_USE_EXIT, sizeof(vfpr));
+		for (int i = count - 1; i >= 0; --i) {
+			const MIPSOpcode op = ops[i];
+			const MIPSInfo info = MIPSGetInfo(op);
+			AgeLiveness(gpr);
+			AgeLiveness(fpr);
+			AgeLiveness(vfpr);
+
+			// Anything that leaves the jit (or might) needs everything in memory.
+			if (MIPS_IS_EMUHACK(op) || IsSyscall(op) || (info & BAD_INSTRUCTION) || op == 0x0000000D) {
+				memset(gpr, BlockLiveness::NEXT_USE_EXIT, sizeof(gpr));
+				memset(fpr, BlockLiveness::NEXT_USE_EXIT, sizeof(fpr));
+				memset(vfpr, BlockLiveness::NEXT_USE_EXIT, sizeof(vfpr));
+			} else {
+				// Writes first, since the reads happen before them.  Conditional moves might not write.
+				if ((info & IS_CONDMOVE) == 0) {
+					const MIPSGPReg out = GetOutGPReg(op);
+					if (out != MIPS_REG_INVALID && out != MIPS_REG_ZERO)
+						gpr[out] = BlockLiveness::NEXT_USE_NONE;
+					if (info & OUT_HI)
+						gpr[MIPS_REG_HI] = BlockLiveness::NEXT_USE_NONE;
+					if (info & OUT_LO)
+						gpr[MIPS_REG_LO] = BlockLiveness::NEXT_USE_NONE;
+					if (info & IS_FPU) {
+						if (info & OUT_FD)
+							fpr[MIPS_GET_FD(op)] = BlockLiveness::NEXT_USE_NONE;
+						if (info & OUT_FS)
+							fpr[MIPS_GET_FS(op)] = BlockLiveness::NEXT_USE_NONE;
+						if (info & OUT_FT)
+							fpr[MIPS_GET_FT(op)] = BlockLiveness::NEXT_USE_NONE;
+					}
+				} else {
+					const MIPSGPReg out = GetOutGPReg(op);
+					if (out != MIPS_REG_INVALID)
+						gpr[out] = 0;
+				}
+
+				if (info & IN_RS)
+					gpr[MIPS_GET_RS(op)] = 0;
+				if (info & IN_RT)
+					gpr[MIPS_GET_RT(op)] = 0;
+				if (info & IN_HI)
+					gpr[MIPS_REG_HI] = 0;
+				if (info & IN_LO)
+					gpr[MIPS_REG_LO] = 0;
+				if (info & IS_FPU) {
+					if (info & IN_FS)
+						fpr[MIPS_GET_FS(op)] = 0;
+					if (info & IN_FT)
+						fpr[MIPS_GET_FT(op)] = 0;
+				}
 
-			// This is unfortunate.  In case of emuhacks or relocs, we have to make a copy.
-			buffer.resize((f.end - f.start + 4) / 4);
-			size_t pos = 0;
-			for (u32 addr = f.start; addr <= f.end; addr += 4) {
-				u32 validbits = 0xFFFFFFFF;
-				MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr, true);
-				if (MIPS_IS_EMUHACK(instr)) {
-					f.hasHash = false;
-					goto skip;
+				if (info & IS_VFPU) {
+					// The prefixes come right before the op they apply to.
+					bool prefixD = false;
+					for (int j = i - 1; j >= 0 && j >= i - 3 && (ops[j] >> 26) == 55 && ((ops[j] >> 24) & 3) != 3; --j)
+						prefixD = prefixD || IsVfpuPrefixD(ops[j]);
+
+					VfpuRegUsage usage;
+					GetVfpuRegUsage(op, prefixD, usage);
+					for (int j = 0; j < usage.numWrites; ++j)
+						vfpr[usage.writes[j]] = BlockLiveness::NEXT_USE_NONE;
+					for (int j = 0; j < usage.numReads; ++j)
+						vfpr[usage.reads[j]] = 0;
 				}
+			}
+
+			memcpy(liveness->gpr[i], gpr, sizeof(gpr));
+			memcpy(liveness->fpr[i], fpr, sizeof(fpr));
+			memcpy(liveness->vfpr[i], vfpr, sizeof(vfpr));
+		}
+	}
+
+	static void HashFunction(AnalyzedFunction &f, std::vector<u32> &buffer) {
+		if (!Memory::IsValidRange(f.start, f.end - f.start + 4)) {
+			return;
+		}
 
-				MIPSInfo flags = MIPSGetInfo(instr);
-				if (flags & IN_IMM16)
-					validbits &= ~0xFFFF;
-				if (flags & IN_IMM26)
-					validbits &= ~0x03FFFFFF;
-				buffer[pos++] = instr & validbits;
+		// This is unfortunate.  In case of emuhacks or relocs, we have to make a copy.
+		buffer.resize((f.end - f.start + 4) / 4);
+		size_t pos = 0;
+		for (u32 addr = f.start; addr <= f.end; addr += 4) {
+			u32 validbits = 0xFFFFFFFF;
+			MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr, true);
+			if (MIPS_IS_EMUHACK(instr)) {
+				f.hasHash = false;
+				return;
 			}
 
-			f.hash = CityHash64((const char *) &buffer[0], buffer.size() * sizeof(u32));
-			f.hasHash = true;
-skip:
-			;
+			MIPSInfo flags = MIPSGetInfo(instr);
+			if (flags & IN_IMM16)
+				validbits &= ~0xFFFF;
+			if (flags & IN_IMM26)
+				validbits &= ~0x03FFFFFF;
+			buffer[pos++] = instr & validbits;
 		}
+
+		f.hash = CityHash64((const char *) &buffer[0], buffer.size() * sizeof(u32));
+		f.hasHash = true;
+	}
+
+	void HashFunctions() {
+		std::lock_guard<std::recursive_mutex> guard(functions_lock);
+
+		// Each function only reads its own memory, so they can be hashed in any order.
+		GlobalThreadPool::Loop([](int lower, int upper) {
+			std::vector<u32> buffer;
+			for (int i = lower; i < upper; ++i) {
+				HashFunction(functions[i], buffer);
+			}
+		}, 0, (int)functions.size());
 	}
 
 	void PrecompileFunction(u32 startAddr, u32 length) {
@@ -1019,9 +1312,10 @@ namespace MIPSAnalyst {
 		return furthestJumpbackAddr;
 	}
 
-	bool ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols) {
-		std::lock_guard<std::recursive_mutex> guard(functions_lock);
-
+	// Scans until the first function that starts at or after stopAddr, and returns where that is.
+	// From any function start on, the scan only depends on memory, so it comes out the same
+	// no matter where it began.
+	static u32 ScanRangeForFunctions(u32 startAddr, u32 endAddr, u32 stopAddr, FunctionsVector &found) {
 		AnalyzedFunction currentFunction = {startAddr};
 
 		u32 furthestBranch = 0;
@@ -1133,16 +1427,9 @@ namespace MIPSAnalyst {
 				u32 existingSize = g_symbolMap->GetFunctionSize(currentFunction.start);
 				if (existingSize != SymbolMap::INVALID_ADDRESS) {
 					currentFunction.foundInSymbolMap = true;
-
-					// If we run into a func with a different size, skip updating the hash map.
-					// This will prevent us saving incorrectly named funcs with wrong hashes.
-					u32 detectedSize = currentFunction.end - currentFunction.start + 4;
-					if (existingSize != detectedSize) {
-						insertSymbols = false;
-					}
 				}
 
-				functions.push_back(currentFunction);
+				found.push_back(currentFunction);
 
 				furthestBranch = 0;
 				addr += 4;
@@ -1152,30 +1439,136 @@ namespace MIPSAnalyst {
 				decreasedSp = false;
 				currentFunction.start = addr + 4;
 				currentFunction.foundInSymbolMap = false;
+				if (currentFunction.start >= stopAddr)
+					return currentFunction.start;
 			}
 		}
 
 		if (addr <= endAddr) {
 			currentFunction.end = addr + 4;
-			functions.push_back(currentFunction);
+			found.push_back(currentFunction);
 		}
 
-		for (auto iter = functions.begin(); iter != functions.end(); iter++) {
-			iter->size = iter->end - iter->start + 4;
-			if (insertSymbols && !iter->foundInSymbolMap) {
+		return addr;
+	}
+
+	// Large ranges are scanned in pieces of this size, each from a guessed function start.
+	static const u32 SCAN_CHUNK_SIZE = 0x8000;
+
+	struct ScanChunk {
+		size_t range;
+		u32 start;
+		u32 next;
+		u32 stopped;
+		FunctionsVector found;
+	};
+
+	// Joins a range's chunks into what one scan of the whole range would have found.
+	static void StitchScanChunks(std::vector<ScanChunk>::iterator chunk, std::vector<ScanChunk>::iterator last, u32 endAddr, FunctionsVector &found) {
+		found.swap(chunk->found);
+		u32 pos = chunk->stopped;
+		for (++chunk; chunk != last && pos <= endAddr; ++chunk) {
+			if (pos >= chunk->next)
+				continue;
+
+			// Leading nops are skipped without changing anything, so the first function here
+			// starts at the first non-nop.  If the chunk got to that start too, the rest of it is right.
+			u32 funcStart = pos;
+			while (funcStart <= endAddr && Memory::Read_Instruction(funcStart, true) == MIPS_MAKE_NOP())
+				funcStart += 4;
+			auto match = std::lower_bound(chunk->found.begin(), chunk->found.end(), funcStart, [](const AnalyzedFunction &f, u32 addr) {
+				return f.start < addr;
+			});
+			if (match != chunk->found.end() && match->start == funcStart) {
+				found.insert(found.end(), match, chunk->found.end());
+				pos = chunk->stopped;
+			} else {
+				// It guessed wrong, so redo this piece from where the previous one really left off.
+				pos = ScanRangeForFunctions(pos, endAddr, chunk->next, found);
+			}
+		}
+	}
+
+	// Returns false if a function found disagrees with the size of an existing symbol.
+	static bool CheckFoundSizes(const FunctionsVector &found) {
+		for (const AnalyzedFunction &f : found) {
+			// If we run into a func with a different size, skip updating the hash map.
+			// This will prevent us saving incorrectly named funcs with wrong hashes.
+			if (f.foundInSymbolMap && g_symbolMap->GetFunctionSize(f.start) != f.end - f.start + 4)
+				return false;
+		}
+		return true;
+	}
+
+	bool ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols) {
+		std::vector<std::pair<u32, u32>> ranges;
+		ranges.push_back(std::make_pair(startAddr, endAddr));
+		return ScanForFunctions(ranges, insertSymbols);
+	}
+
+	bool ScanForFunctions(const std::vector<std::pair<u32, u32>> &ranges, bool insertSymbols) {
+		std::lock_guard<std::recursive_mutex> guard(functions_lock);
+		double st = real_time_now();
+
+		// Every range starts from scratch, and gets split into chunks that are scanned in parallel.
+		std::vector<ScanChunk> chunks;
+		std::vector<size_t> firstChunk(ranges.size() + 1);
+		for (size_t i = 0; i < ranges.size(); ++i) {
+			firstChunk[i] = chunks.size();
+			const u32 end = ranges[i].second;
+			for (u32 start = ranges[i].first; start <= end; start += SCAN_CHUNK_SIZE) {
+				const u32 next = end - start >= SCAN_CHUNK_SIZE ? start + SCAN_CHUNK_SIZE : end + 4;
+				chunks.push_back({ i, start, next, 0 });
+				if (next > end)
+					break;
+			}
+		}
+		firstChunk[ranges.size()] = chunks.size();
+
+		GlobalThreadPool::Loop([&](int lower, int upper) {
+			for (int i = lower; i < upper; ++i) {
+				ScanChunk &chunk = chunks[i];
+				chunk.stopped = ScanRangeForFunctions(chunk.start, ranges[chunk.range].second, chunk.next, chunk.found);
+			}
+		}, 0, (int)chunks.size());
+
+		// Same as scanning them one at a time: each range's functions are named unless it or an
+		// earlier range ran into a symbol of a different size.
+		size_t namedCount = 0;
+		size_t foundCount = 0;
+		for (size_t i = 0; i < ranges.size(); ++i) {
+			FunctionsVector found;
+			if (firstChunk[i] != firstChunk[i + 1])
+				StitchScanChunks(chunks.begin() + firstChunk[i], chunks.begin() + firstChunk[i + 1], ranges[i].second, found);
+			functions.insert(functions.end(), found.begin(), found.end());
+			foundCount += found.size();
+			insertSymbols = insertSymbols && CheckFoundSizes(found);
+			if (insertSymbols) {
+				namedCount = functions.size();
+			}
+		}
+
+		for (size_t i = 0; i < functions.size(); ++i) {
+			AnalyzedFunction &f = functions[i];
+			f.size = f.end - f.start + 4;
+			if (i < namedCount && !f.foundInSymbolMap) {
 				char temp[256];
-				g_symbolMap->AddFunction(DefaultFunctionName(temp, iter->start), iter->start, iter->end - iter->start + 4);
+				g_symbolMap->AddFunction(DefaultFunctionName(temp, f.start), f.start, f.size);
 			}
 		}
 
+		INFO_LOG(LOADER, "Scanned %d ranges in %d chunks, found %d functions in %0.2f ms", (int)ranges.size(), (int)chunks.size(), (int)foundCount, (real_time_now() - st) * 1000.0);
 		return insertSymbols;
 	}
 
 	void FinalizeScan(bool insertSymbols) {
+		double st = real_time_now();
 		HashFunctions();
+		INFO_LOG(LOADER, "Hashed %d functions in %0.2f ms", (int)functions.size(), (real_time_now() - st) * 1000.0);
 
 		std::string hashMapFilename = GetSysDirectory(DIRECTORY_SYSTEM) + "knownfuncs.ini";
 		if (g_Config.bFuncHashMap || g_Config.bFuncReplacements) {
+			st = real_time_now();
 			LoadBuiltinHashMap();
 			if (g_Config.bFuncHashMap) {
 				LoadHashMap(hashMapFilename);
@@ -1187,6 +1580,7 @@ namespace MIPSAnalyst {
 			if (g_Config.bFuncReplacements) {
 				ReplaceFunctions();
 			}
+			INFO_LOG(LOADER, "Matched function hashes in %0.2f ms", (real_time_now() - st) * 1000.0);
 		}
 	}
 
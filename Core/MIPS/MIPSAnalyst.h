@@ -18,6 +18,7 @@
 #pragma once
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "Common/CommonTypes.h"
@@ -82,6 +83,50 @@ namespace MIPSAnalyst
 	// This tells us if the reg is clobbered within intrs of addr (e.g. it is surely not used.)
 	bool IsRegisterClobbered(MIPSGPReg reg, u32 addr, int instrs);
 
+	// How soon each register is read next, at every instruction of a straight run of code
+	// (up to, not including, the first branch or jump.)  Used by the jit to pick what to spill.
+	struct BlockLiveness {
+		enum : u8 {
+			// Distances are capped at this.
+			MAX_DISTANCE = 250,
+			// Not read again in the run, but needed in memory once it ends.
+			NEXT_USE_EXIT = 254,
+			// Overwritten before it's read, so the current value can just be dropped.
+			NEXT_USE_NONE = 255,
+		};
+		static const int MAX_OPS = 128;
+
+		u32 start;
+		int count;
+		// Per instruction, counting the instruction itself as distance 0.
+		u8 gpr[MAX_OPS][MIPS_REG_LO + 1];
+		u8 fpr[MAX_OPS][32];
+		// Indexed like GetVectorRegs() names them.
+		u8 vfpr[MAX_OPS][128];
+
+		bool Covers(u32 addr) const {
+			return addr >= start && addr < start + count * 4;
+		}
+		// NEXT_USE_EXIT for anything it doesn't know about.
+		u8 NextGPRUse(MIPSGPReg reg, u32 addr) const {
+			if (!Covers(addr) || reg < 0 || reg > MIPS_REG_LO)
+				return NEXT_USE_EXIT;
+			return gpr[(addr - start) / 4][reg];
+		}
+		u8 NextFPRUse(int reg, u32 addr) const {
+			if (!Covers(addr) || reg < 0 || reg >= 32)
+				return NEXT_USE_EXIT;
+			return fpr[(addr - start) / 4][reg];
+		}
+		u8 NextVFPRUse(int vreg, u32 addr) const {
+			if (!Covers(addr) || vreg < 0 || vreg >= 128)
+				return NEXT_USE_EXIT;
+			return vfpr[(addr - start) / 4][vreg];
+		}
+	};
+
+	void AnalyzeLiveness(u32 address, BlockLiveness *liveness);
+
 	struct AnalyzedFunction {
 		u32 start;
 		u32 end;
@@ -107,6 +152,8 @@ namespace MIPSAnalyst
 	void RegisterFunction(u32 startAddr, u32 size, const char *name);
 	// Returns new insertSymbols value for FinalizeScan().
 	bool ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols);
+	// Same, but scans several ranges (end inclusive) at once on the thread pool.
+	bool ScanForFunctions(const std::vector<std::pair<u32, u32>> &ranges, bool insertSymbols);
 	void FinalizeScan(bool insertSymbols);
 	void ForgetFunctions(u32 startAddr, u32 endAddr);
 	void PrecompileFunctions();
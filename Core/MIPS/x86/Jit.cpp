@@ -345,15 +345,20 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b) {
 	b->normalEntry = GetCodePtr();
 
 	MIPSAnalyst::AnalysisResults analysis = MIPSAnalyst::Analyze(em_address);
+	MIPSAnalyst::AnalyzeLiveness(em_address, &liveness_);
 
-	gpr.Start(mips_, &js, &jo, analysis);
-	fpr.Start(mips_, &js, &jo, analysis, RipAccessible(&mips_->v[0]));
+	gpr.Start(mips_, &js, &jo, analysis, &liveness_);
+	fpr.Start(mips_, &js, &jo, analysis, &liveness_, RipAccessible(&mips_->v[0]));
 
 	js.numInstructions = 0;
 	while (js.compiling) {
 		// Jit breakpoints are quite fast, so let's do them in release too.
 		CheckJitBreakpoint(GetCompilerPC(), 0);
 
+		// Past a branch (or continued into its target), so the spill choices need the next run.
+		if (!liveness_.Covers(GetCompilerPC()) && GetCompilerPC() != liveness_.start)
+			MIPSAnalyst::AnalyzeLiveness(GetCompilerPC(), &liveness_);
+
 		MIPSOpcode inst = Memory::Read_Opcode_JIT(GetCompilerPC());
 		js.downcountAmount += MIPSGetInstructionCycleEstimate(inst);
 
@@ -398,6 +403,8 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b) {
 	}
 
 	b->codeSize = (u32)(GetCodePtr() - b->normalEntry);
+	b->spillCount = (u16)std::min(gpr.SpillCount() + fpr.SpillCount(), 0xFFFF);
+	b->reloadCount = (u16)std::min(gpr.ReloadCount() + fpr.ReloadCount(), 0xFFFF);
 	NOP();
 	AlignCode4();
 	if (js.lastContinuedPC == 0) {
@@ -305,6 +305,7 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 
 	GPRRegCache gpr;
 	FPURegCache fpr;
+	MIPSAnalyst::BlockLiveness liveness_;
 
 	ThunkManager thunks;
 	JitSafeMemFuncs safeMemFuncs;
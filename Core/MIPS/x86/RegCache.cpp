@@ -59,7 +59,7 @@ GPRRegCache::GPRRegCache() : mips(0), emit(0) {
 	memset(xregs, 0, sizeof(xregs));
 }
 
-void GPRRegCache::Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats) {
+void GPRRegCache::Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats, const MIPSAnalyst::BlockLiveness *liveness) {
 #ifdef _M_X64
 	if (allocationOrderR15[0] == INVALID_REG) {
 		memcpy(allocationOrderR15, allocationOrder, sizeof(allocationOrder));
@@ -102,6 +102,11 @@ void GPRRegCache::Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOp
 
 	js_ = js;
 	jo_ = jo;
+	liveness_ = liveness;
+
+	memset(spilled_, 0, sizeof(spilled_));
+	spillCount_ = 0;
+	reloadCount_ = 0;
 }
 
 
@@ -136,6 +141,37 @@ void GPRRegCache::UnlockAllX() {
 		xregs[i].allocLocked = false;
 }
 
+X64Reg GPRRegCache::FindBestToSpillLive(bool *clobbered) {
+	int allocCount;
+	const X64Reg *allocOrder = GetAllocationOrder(allocCount);
+
+	// Whatever is needed furthest away, or not at all.  Clean ones don't even need a store.
+	X64Reg best = INVALID_REG;
+	int bestScore = -1;
+	*clobbered = false;
+	for (int i = 0; i < allocCount; i++) {
+		X64Reg reg = allocOrder[i];
+		if (xregs[reg].allocLocked)
+			continue;
+		if (xregs[reg].mipsReg != MIPS_REG_INVALID && regs[xregs[reg].mipsReg].locked)
+			continue;
+
+		const u8 next = liveness_->NextGPRUse(xregs[reg].mipsReg, js_->compilerPC);
+		if (next == MIPSAnalyst::BlockLiveness::NEXT_USE_NONE) {
+			*clobbered = true;
+			return reg;
+		}
+
+		int score = next * 2 + (xregs[reg].dirty ? 0 : 1);
+		if (score > bestScore) {
+			best = reg;
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
 X64Reg GPRRegCache::FindBestToSpill(bool unusedOnly, bool *clobbered) {
 	int allocCount;
 	const X64Reg *allocOrder = GetAllocationOrder(allocCount);
@@ -182,9 +218,14 @@ X64Reg GPRRegCache::GetFreeXReg()
 
 	//Okay, not found :( Force grab one
 	bool clobbered;
-	X64Reg bestToSpill = FindBestToSpill(true, &clobbered);
-	if (bestToSpill == INVALID_REG) {
-		bestToSpill = FindBestToSpill(false, &clobbered);
+	X64Reg bestToSpill;
+	if (liveness_ && liveness_->Covers(js_->compilerPC)) {
+		bestToSpill = FindBestToSpillLive(&clobbered);
+	} else {
+		bestToSpill = FindBestToSpill(true, &clobbered);
+		if (bestToSpill == INVALID_REG) {
+			bestToSpill = FindBestToSpill(false, &clobbered);
+		}
 	}
 
 	if (bestToSpill != INVALID_REG) {
@@ -192,7 +233,12 @@ X64Reg GPRRegCache::GetFreeXReg()
 		if (clobbered) {
 			DiscardRegContentsIfCached(xregs[bestToSpill].mipsReg);
 		} else {
-			StoreFromRegister(xregs[bestToSpill].mipsReg);
+			MIPSGPReg spilled = xregs[bestToSpill].mipsReg;
+			if (spilled != MIPS_REG_INVALID) {
+				spilled_[spilled] = true;
+				spillCount_++;
+			}
+			StoreFromRegister(spilled);
 		}
 		return bestToSpill;
 	}
@@ -368,6 +414,10 @@ void GPRRegCache::MapReg(MIPSGPReg i, bool doLoad, bool makeDirty) {
 				emit->MOV(32, newloc, Imm32(0));
 			else
 				emit->MOV(32, newloc, regs[i].location);
+			if (spilled_[i]) {
+				spilled_[i] = false;
+				reloadCount_++;
+			}
 		}
 		for (int j = 0; j < 32; j++) {
 			if (i != MIPSGPReg(j) && regs[j].location.IsSimpleReg(xr)) {
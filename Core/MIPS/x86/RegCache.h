@@ -69,7 +69,7 @@ class GPRRegCache
 public:
 	GPRRegCache();
 	~GPRRegCache() {}
-	void Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats);
+	void Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats, const MIPSAnalyst::BlockLiveness *liveness);
 
 	void DiscardRegContentsIfCached(MIPSGPReg preg);
 	void DiscardR(MIPSGPReg preg);
@@ -119,11 +119,16 @@ class GPRRegCache
 	void GetState(GPRRegCacheState &state) const;
 	void RestoreState(const GPRRegCacheState& state);
 
+	// Since Start(), for the block debug info.
+	int SpillCount() const { return spillCount_; }
+	int ReloadCount() const { return reloadCount_; }
+
 	MIPSState *mips;
 
 private:
 	Gen::X64Reg GetFreeXReg();
 	Gen::X64Reg FindBestToSpill(bool unusedOnly, bool *clobbered);
+	Gen::X64Reg FindBestToSpillLive(bool *clobbered);
 	const Gen::X64Reg *GetAllocationOrder(int &count);
 
 	MIPSCachedReg regs[X64JitConstants::NUM_MIPS_GPRS];
@@ -132,4 +137,9 @@ class GPRRegCache
 	Gen::XEmitter *emit;
 	MIPSComp::JitState *js_;
 	MIPSComp::JitOptions *jo_;
+	const MIPSAnalyst::BlockLiveness *liveness_;
+
+	bool spilled_[X64JitConstants::NUM_MIPS_GPRS];
+	int spillCount_;
+	int reloadCount_;
 };
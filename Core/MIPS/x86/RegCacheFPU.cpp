@@ -37,7 +37,7 @@ FPURegCache::FPURegCache() : mips(0), initialReady(false), emit(0) {
 	vregs = regs + 32;
 }
 
-void FPURegCache::Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats, bool useRip) {
+void FPURegCache::Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats, const MIPSAnalyst::BlockLiveness *liveness, bool useRip) {
 	this->mips = mips;
 	useRip_ = useRip;
 	if (!initialReady) {
@@ -51,6 +51,11 @@ void FPURegCache::Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOp
 
 	js_ = js;
 	jo_ = jo;
+	liveness_ = liveness;
+
+	memset(spilled_, 0, sizeof(spilled_));
+	spillCount_ = 0;
+	reloadCount_ = 0;
 }
 
 void FPURegCache::SetupInitialRegs() {
@@ -428,6 +433,7 @@ X64Reg FPURegCache::LoadRegsVS(const u8 *v, int n) {
 		auto loadXR = [&](int l) {
 			if (!xrsLoaded[l] && n >= l + 1) {
 				emit->MOVSS(xrs[l], vregs[v[l]].location);
+				CountReload(v[l] + 32);
 			}
 		};
 		// The order here is intentional.
@@ -615,6 +621,7 @@ void FPURegCache::MapReg(const int i, bool doLoad, bool makeDirty) {
 		OpArg newloc = ::Gen::R(xr);
 		if (doLoad)	{
 			emit->MOVSS(xr, regs[i].location);
+			CountReload(i);
 		}
 		regs[i].location = newloc;
 		regs[i].lane = 0;
@@ -1047,6 +1054,29 @@ X64Reg FPURegCache::GetFreeXReg() {
 	return res;
 }
 
+X64Reg FPURegCache::FindBestToSpill(const int *aOrder, int aCount) {
+	// Temps have no liveness info and count as needed far away.
+	X64Reg best = INVALID_REG;
+	int bestNext = -1;
+	for (int i = 0; i < aCount; i++) {
+		X64Reg xr = (X64Reg)aOrder[i];
+		int preg = xregs[xr].mipsReg;
+		if (preg == -1 || regs[preg].locked)
+			continue;
+
+		int next = MIPSAnalyst::BlockLiveness::MAX_DISTANCE;
+		if (preg < 32)
+			next = liveness_->NextFPRUse(preg, js_->compilerPC);
+		else if (preg < 32 + 128)
+			next = liveness_->NextVFPRUse(preg - 32, js_->compilerPC);
+		if (next > bestNext) {
+			best = xr;
+			bestNext = next;
+		}
+	}
+	return best;
+}
+
 int FPURegCache::GetFreeXRegs(X64Reg *res, int n, bool spill) {
 	pendingFlush = true;
 	int aCount;
@@ -1066,9 +1096,20 @@ int FPURegCache::GetFreeXRegs(X64Reg *res, int n, bool spill) {
 		}
 	}
 
-	if (r < n && spill) {
+	if (r < n && spill && liveness_ && liveness_->Covers(js_->compilerPC)) {
+		// Spill whatever is needed furthest away in this block.
+		while (r < n) {
+			X64Reg xr = FindBestToSpill(aOrder, aCount);
+			if (xr == INVALID_REG)
+				break;
+			int preg = xregs[xr].mipsReg;
+			spilled_[preg] = true;
+			spillCount_++;
+			StoreFromRegister(preg);
+			res[r++] = xr;
+		}
+	} else if (r < n && spill) {
 		// Okay, not found :(... Force grab one.
-		// TODO - add a pass to grab xregs whose mipsreg is not used in the next 3 instructions.
 		for (int i = 0; i < aCount; i++) {
 			X64Reg xr = (X64Reg)aOrder[i];
 			int preg = xregs[xr].mipsReg;
@@ -1076,6 +1117,8 @@ int FPURegCache::GetFreeXRegs(X64Reg *res, int n, bool spill) {
 
 			// We're only spilling here, so don't overlap.
 			if (preg != -1 && !regs[preg].locked) {
+				spilled_[preg] = true;
+				spillCount_++;
 				StoreFromRegister(preg);
 				res[r++] = xr;
 				if (r >= n) {
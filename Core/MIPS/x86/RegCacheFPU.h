@@ -97,7 +97,7 @@ class FPURegCache
 	FPURegCache();
 	~FPURegCache() {}
 
-	void Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats, bool useRip);
+	void Start(MIPSState *mips, MIPSComp::JitState *js, MIPSComp::JitOptions *jo, MIPSAnalyst::AnalysisResults &stats, const MIPSAnalyst::BlockLiveness *liveness, bool useRip);
 	void MapReg(int preg, bool doLoad = true, bool makeDirty = true);
 	void StoreFromRegister(int preg);
 	void StoreFromRegisterV(int preg) {
@@ -214,8 +214,19 @@ class FPURegCache
 
 	void Invariant() const;
 
+	// Since Start(), for the block debug info.
+	int SpillCount() const { return spillCount_; }
+	int ReloadCount() const { return reloadCount_; }
+
 private:
 	const int *GetAllocationOrder(int &count);
+	Gen::X64Reg FindBestToSpill(const int *aOrder, int aCount);
+	void CountReload(int mreg) {
+		if (spilled_[mreg]) {
+			spilled_[mreg] = false;
+			reloadCount_++;
+		}
+	}
 	void SetupInitialRegs();
 
 	// These are intentionally not public so the interface is "locked" or "unlocked", no levels.
@@ -240,4 +251,9 @@ class FPURegCache
 	Gen::XEmitter *emit;
 	MIPSComp::JitState *js_;
 	MIPSComp::JitOptions *jo_;
+	const MIPSAnalyst::BlockLiveness *liveness_;
+
+	bool spilled_[NUM_MIPS_FPRS];
+	int spillCount_;
+	int reloadCount_;
 };
@@ -40,6 +40,7 @@
 #include "Core/Config.h"
 #include "Core/HLE/ReplaceTables.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 
 namespace Memory {
 
@@ -202,6 +203,8 @@ bool MemoryMap_Setup(u32 flags) {
 	// We reserve the memory, then simply commit in TryBase.
 	base = (u8*)VirtualAllocFromApp(0, 0x10000000, MEM_RESERVE, PAGE_READWRITE);
 #else
+	// Has to be set before roundup() is used.
+	g_arena.SetHugePages(g_Config.bHugePageMemory);
 
 	// Figure out how much memory we need to allocate in total.
 	size_t total_mem = 0;
@@ -338,6 +341,7 @@ void DoState(PointerWrap &p) {
 
 void Shutdown() {
 	std::lock_guard<std::recursive_mutex> guard(g_shutdownLock);
+	JitPageProtect::UnprotectAll();
 	u32 flags = 0;
 	MemoryMap_Shutdown(flags);
 	base = nullptr;
@@ -437,7 +441,8 @@ Opcode Read_Opcode_JIT(u32 address)
 // We assume that _Address is cached
 void Write_Opcode_JIT(const u32 _Address, const Opcode& _Value)
 {
-	Memory::WriteUnchecked_U32(_Value.encoding, _Address);
+	// The page may be write protected to catch the game changing code, but this isn't the game.
+	JitPageProtect::WriteOpcode(_Address, _Value.encoding);
 }
 
 void Memset(const u32 _Address, const u8 _iValue, const u32 _iLength) {
@@ -43,6 +43,7 @@
 #include "Core/MemMap.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 #include "HW/MemoryStick.h"
 #include "GPU/GPUState.h"
 
@@ -82,15 +83,32 @@ namespace SaveState
 
 	CChunkFileReader::Error SaveToRam(std::vector<u8> &data) {
 		SaveStart state;
-		size_t sz = CChunkFileReader::MeasurePtr(state);
-		if (data.size() < sz)
-			data.resize(sz);
+		size_t sz = 0;
+		if (data.capacity() != 0) {
+			// The size rarely changes, so just try to save into what we had last time.
+			// Growing back to the capacity doesn't reallocate.
+			data.resize(data.capacity());
+			CChunkFileReader::Error err = CChunkFileReader::SavePtr(&data[0], state, data.size(), &sz);
+			if (err != CChunkFileReader::ERROR_BAD_ALLOC) {
+				if (err == CChunkFileReader::ERROR_NONE)
+					data.resize(sz);
+				return err;
+			}
+			// Didn't fit, but now we know how big it is.
+		} else {
+			sz = CChunkFileReader::MeasurePtr(state);
+		}
+
+		data.resize(sz);
 		return CChunkFileReader::SavePtr(&data[0], state);
 	}
 
-	CChunkFileReader::Error LoadFromRam(std::vector<u8> &data) {
+	CChunkFileReader::Error LoadFromRam(std::vector<u8> &data, bool keepCaches) {
 		SaveStart state;
-		return CChunkFileReader::LoadPtr(&data[0], state);
+		PSP_CoreParameter().keepCachesOnLoad = keepCaches;
+		CChunkFileReader::Error err = CChunkFileReader::LoadPtr(&data[0], state);
+		PSP_CoreParameter().keepCachesOnLoad = false;
+		return err;
 	}
 
 	struct StateRingbuffer
@@ -241,6 +259,12 @@ namespace SaveState
 	static std::mutex mutex;
 	static bool hasLoadedState = false;
 
+	// The state after the last real frame, while frames are being run ahead of it.
+	static std::vector<u8> runAheadState;
+	static bool runningAhead = false;
+	static double runAheadSaveSeconds = 0.0;
+	static double runAheadLoadSeconds = 0.0;
+
 	// TODO: Should this be configurable?
 	static const int REWIND_NUM_STATES = 20;
 	static StateRingbuffer rewindStates(REWIND_NUM_STATES);
@@ -260,12 +284,23 @@ namespace SaveState
 		CoreTiming::DoState(p);
 
 		// Memory is a bit tricky when jit is enabled, since there's emuhacks in it.
+		// When keeping the jit on load, they're put back wherever the loaded code still matches.
+		const bool keepJit = p.mode == p.MODE_READ && PSP_CoreParameter().keepCachesOnLoad;
 		auto savedReplacements = SaveAndClearReplacements();
-		if (MIPSComp::jit && p.mode == p.MODE_WRITE)
+		if (MIPSComp::jit && (p.mode == p.MODE_WRITE || keepJit))
 		{
+			// Otherwise, loading would fault on every protected page and throw away all their blocks.
+			if (keepJit)
+				JitPageProtect::UnprotectAll();
 			std::vector<u32> savedBlocks;
 			savedBlocks = MIPSComp::jit->SaveAndClearEmuHackOps();
+			JitBlockCache *blockCache = keepJit ? MIPSComp::jit->GetBlockCache() : nullptr;
+			std::vector<u64> blockHashes;
+			if (blockCache)
+				blockHashes = blockCache->HashBlockRanges();
 			Memory::DoState(p);
+			if (blockCache)
+				blockCache->ForgetChangedEmuHackOps(blockHashes, savedBlocks);
 			MIPSComp::jit->RestoreSavedEmuHackOps(savedBlocks);
 		}
 		else
@@ -278,6 +313,16 @@ namespace SaveState
 		__KernelDoState(p);
 		// Kernel object destructors might close open files, so do the filesystem last.
 		pspFileSystem.DoState(p);
+
+		if (MIPSComp::jit && keepJit) {
+			// Drop anything whose code changed anywhere in its range (its emuhack wasn't put back),
+			// including blocks that others are linked to.
+			JitBlockCache *blockCache = MIPSComp::jit->GetBlockCache();
+			if (blockCache)
+				blockCache->InvalidateChangedBlocks();
+			else
+				MIPSComp::jit->ClearCache();
+		}
 	}
 
 	void Enqueue(SaveState::Operation op)
@@ -607,8 +652,52 @@ namespace SaveState
 		return hasLoadedState;
 	}
 
+	bool SaveRunAhead()
+	{
+		double start = real_time_now();
+		CChunkFileReader::Error err = SaveToRam(runAheadState);
+		runAheadSaveSeconds = real_time_now() - start;
+		if (err != CChunkFileReader::ERROR_NONE) {
+			ERROR_LOG(SAVESTATE, "Unable to snapshot state for run-ahead");
+			return false;
+		}
+		runningAhead = true;
+		return true;
+	}
+
+	bool RestoreRunAhead()
+	{
+		if (!runningAhead)
+			return false;
+		runningAhead = false;
+
+		double start = real_time_now();
+		CChunkFileReader::Error err = LoadFromRam(runAheadState, true);
+		runAheadLoadSeconds = real_time_now() - start;
+		if (err != CChunkFileReader::ERROR_NONE) {
+			ERROR_LOG(SAVESTATE, "Unable to restore state after run-ahead");
+			return false;
+		}
+		return true;
+	}
+
+	void GetRunAheadDebugStats(char *stats, size_t bufsize)
+	{
+		if (g_Config.iRunAheadFrames <= 0 || runAheadState.empty()) {
+			if (bufsize > 0)
+				stats[0] = '\0';
+			return;
+		}
+		snprintf(stats, bufsize, "Run-ahead: %d frames, %0.2f ms snapshot, %0.2f ms restore (%d KB)\n",
+			g_Config.iRunAheadFrames, runAheadSaveSeconds * 1000.0, runAheadLoadSeconds * 1000.0, (int)(runAheadState.size() / 1024));
+	}
+
 	void Process()
 	{
+		// Anything saved now would be a frame that's about to be thrown away, and a load would be.
+		if (runningAhead)
+			return;
+
 #ifndef MOBILE_DEVICE
 		if (g_Config.iRewindFlipFrequency != 0 && gpuStats.numFlips != 0)
 			CheckRewindState();
@@ -780,5 +869,8 @@ namespace SaveState
 	{
 		std::lock_guard<std::mutex> guard(mutex);
 		rewindStates.Clear();
+		runAheadState.clear();
+		runAheadState.shrink_to_fit();
+		runningAhead = false;
 	}
 }
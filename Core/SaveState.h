@@ -62,8 +62,17 @@ namespace SaveState
 	// Warning: callback will be called on a different thread.
 	void Save(const std::string &filename, Callback callback = Callback(), void *cbUserData = 0);
 
+	// Reuses the buffer's existing space when it can, so keeping one around for repeated saves is cheap.
 	CChunkFileReader::Error SaveToRam(std::vector<u8> &state);
-	CChunkFileReader::Error LoadFromRam(std::vector<u8> &state);
+	// keepCaches is for a state from moments ago, it keeps the jit and GPU caches instead of starting fresh.
+	CChunkFileReader::Error LoadFromRam(std::vector<u8> &state, bool keepCaches = false);
+
+	// Run-ahead (g_Config.iRunAheadFrames): snapshot after the real frame, run and show frames
+	// past it, then restore.  Queued saves and loads wait until it's restored.
+	bool SaveRunAhead();
+	bool RestoreRunAhead();
+	// Last frame's snapshot and restore cost.  Empty when run-ahead is off.
+	void GetRunAheadDebugStats(char *stats, size_t bufsize);
 
 	// For testing / automated tests.  Runs a save state verification pass (async.)
 	// Warning: callback will be called on a different thread.
@@ -39,6 +39,7 @@
 
 #include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSAnalyst.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
 
 #include "Debugger/SymbolMap.h"
 #include "Core/Host.h"
@@ -285,6 +286,7 @@ void Core_UpdateDebugStats(bool collectStats) {
 	}
 
 	kernelStats.ResetFrame();
+	jitInvalidateStats.ResetFrame();
 	gpuStats.ResetFrame();
 }
 
@@ -17,16 +17,19 @@
 
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <deque>
 
+#include "Common/MPSCQueue.h"
 #include "Core/System.h"
 #include "Core/CoreTiming.h"
 
+// Events go through a lock-free queue.  The lock is only for the event thread to sleep when there's
+// nothing to do (after spinning a bit), for SyncThread to wait for a drain, and for the running state.
 template <typename B, typename Event, typename EventType, EventType EVENT_INVALID, EventType EVENT_SYNC, EventType EVENT_FINISH>
 struct ThreadEventQueue : public B {
-	ThreadEventQueue() : threadEnabled_(false), eventsRunning_(false), eventsHaveRun_(false) {
+	ThreadEventQueue() : threadEnabled_(false), eventsRunning_(false), eventsHaveRun_(false), eventsSleeping_(false) {
 	}
 
 	void SetThreadEnabled(bool threadEnabled) {
@@ -39,25 +42,25 @@ struct ThreadEventQueue : public B {
 
 	void ScheduleEvent(Event ev) {
 		if (threadEnabled_) {
-			std::lock_guard<std::recursive_mutex> guard(eventsLock_);
-			events_.push_back(ev);
-			eventsWait_.notify_one();
+			// If it's full, the event thread is busy and will make room soon.
+			events_.push_wait(ev);
+			// Pairs with the one in WaitForEvents(), so either it sees the event or we see it sleeping.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (eventsSleeping_.load(std::memory_order_relaxed)) {
+				std::lock_guard<std::recursive_mutex> guard(eventsLock_);
+				eventsWait_.notify_one();
+			}
 		} else {
-			events_.push_back(ev);
-		}
-
-		if (!threadEnabled_) {
+			while (!events_.push(ev)) {
+				// Only when ProcessEvent() schedules a lot more, run what's there to make room.
+				RunEventsUntil(0);
+			}
 			RunEventsUntil(0);
 		}
 	}
 
 	bool HasEvents() {
-		if (threadEnabled_) {
-			std::lock_guard<std::recursive_mutex> guard(eventsLock_);
-			return !events_.empty();
-		} else {
-			return !events_.empty();
-		}
+		return !events_.empty();
 	}
 
 	void NotifyDrain() {
@@ -68,24 +71,11 @@ struct ThreadEventQueue : public B {
 	}
 
 	Event GetNextEvent() {
-		if (threadEnabled_) {
-			std::lock_guard<std::recursive_mutex> guard(eventsLock_);
-			if (events_.empty()) {
-				NotifyDrain();
-				return EVENT_INVALID;
-			}
-
-			Event ev = events_.front();
-			events_.pop_front();
-			return ev;
-		} else {
-			if (events_.empty()) {
-				return EVENT_INVALID;
-			}
-			Event ev = events_.front();
-			events_.pop_front();
-			return ev;
+		Event ev = EVENT_INVALID;
+		if (!events_.pop(ev) && threadEnabled_ && events_.empty()) {
+			NotifyDrain();
 		}
+		return ev;
 	}
 
 	void RunEventsUntil(u64 globalticks) {
@@ -98,25 +88,23 @@ struct ThreadEventQueue : public B {
 			return;
 		}
 
-		std::unique_lock<std::recursive_mutex> guard(eventsLock_);
-		eventsRunning_ = true;
-		eventsHaveRun_ = true;
+		{
+			std::lock_guard<std::recursive_mutex> guard(eventsLock_);
+			eventsRunning_ = true;
+			eventsHaveRun_ = true;
+		}
 		do {
-			while (events_.empty() && !ShouldExitEventLoop()) {
-				eventsWait_.wait(guard);
-			}
 			// Quit the loop if the queue is drained and coreState has tripped, or threading is disabled.
-			if (events_.empty()) {
+			if (!WaitForEvents()) {
 				break;
 			}
 
 			for (Event ev = GetNextEvent(); EventType(ev) != EVENT_INVALID; ev = GetNextEvent()) {
-				guard.unlock();
 				ProcessEventIfApplicable(ev, globalticks);
-				guard.lock();
 			}
 		} while (CoreTiming::GetTicks() < globalticks);
 
+		std::lock_guard<std::recursive_mutex> guard(eventsLock_);
 		// This will force the waiter to check coreState, even if we didn't actually drain.
 		NotifyDrain();
 		eventsRunning_ = false;
@@ -162,22 +150,50 @@ struct ThreadEventQueue : public B {
 		}
 	}
 
-	void FinishEventLoop() {
+	// With always, the finish is queued even if the thread hasn't reached RunEventsUntil() yet,
+	// so one about to start won't sleep forever.  The owner should ClearEvents() once it's joined.
+	void FinishEventLoop(bool always = false) {
 		if (!threadEnabled_) {
 			return;
 		}
 
 		std::lock_guard<std::recursive_mutex> guard(eventsLock_);
 		// Don't schedule a finish if it's not even running.
-		if (eventsRunning_) {
+		if (eventsRunning_ || always) {
 			ScheduleEvent(EVENT_FINISH);
 		}
 	}
 
+	// Only safe when the event thread has exited (or never started.)
+	void ClearEvents() {
+		events_.clear();
+	}
+
 protected:
 	virtual void ProcessEvent(Event ev) = 0;
 	virtual bool ShouldExitEventLoop() = 0;
 
+	// Returns false if there's nothing to do and the loop should exit.
+	bool WaitForEvents() {
+		// Events tend to come in bursts, so it's worth spinning a little before going to sleep.
+		SpinBackoff backoff;
+		while (events_.empty() && !ShouldExitEventLoop()) {
+			if (!backoff.Exhausted()) {
+				backoff.Wait();
+				continue;
+			}
+
+			std::unique_lock<std::recursive_mutex> guard(eventsLock_);
+			eventsSleeping_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (events_.empty() && !ShouldExitEventLoop()) {
+				eventsWait_.wait(guard);
+			}
+			eventsSleeping_.store(false, std::memory_order_relaxed);
+		}
+		return !events_.empty();
+	}
+
 	inline void ProcessEventIfApplicable(Event &ev, u64 &globalticks) {
 		switch (EventType(ev)) {
 		case EVENT_FINISH:
@@ -195,10 +211,13 @@ struct ThreadEventQueue : public B {
 	}
 
 private:
+	enum { MAX_QUEUED_EVENTS = 256 };
+
 	bool threadEnabled_;
 	bool eventsRunning_;
 	bool eventsHaveRun_;
-	std::deque<Event> events_;
+	std::atomic<bool> eventsSleeping_;
+	MPSCQueue<Event, MAX_QUEUED_EVENTS> events_;
 	std::recursive_mutex eventsLock_;  // TODO: Should really make this non-recursive - condition_variable_any is dangerous
 	std::condition_variable_any eventsWait_;
 	std::condition_variable_any eventsDrain_;
@@ -15,6 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <cmath>
+
+#include "math/math_util.h"
 #include "Common/Common.h"
 #include "Common/CPUDetect.h"
 #include "Core/Util/AudioFormat.h"
@@ -110,8 +113,62 @@ void ConvertS16ToF32(float *out, const s16 *in, size_t size) {
 	}
 }
 
+static inline s16 ConvertF32ToS16(float f) {
+	// Clamp first, lrintf() of something huge isn't defined.
+	f *= 32768.0f;
+	if (f >= 32767.0f)
+		return 32767;
+	if (f <= -32768.0f)
+		return -32768;
+	// FFmpeg's result for NaN depends on the CPU, silence at least doesn't.
+	if (my_isnan(f))
+		return 0;
+	return (s16)lrintf(f);
+}
+
+#ifdef _M_SSE
+// Clamping in float keeps huge values from wrapping.  NaN is zeroed first, minps would turn it into the max.
+static inline __m128 ScaleAndClampF32(__m128 f) {
+	f = _mm_and_ps(f, _mm_cmpord_ps(f, f));
+	f = _mm_mul_ps(f, _mm_set1_ps(32768.0f));
+	return _mm_max_ps(_mm_min_ps(f, _mm_set1_ps(32767.0f)), _mm_set1_ps(-32768.0f));
+}
+#endif
+
+void ConvertPlanarF32ToS16Standard(s16 *out, const float *const *in, int channels, size_t frames) {
+	size_t i = 0;
+#ifdef _M_SSE
+	// cvtps2dq rounds to nearest even, like lrintf().
+	if (channels == 2) {
+		const float *left = in[0];
+		const float *right = in[1];
+		for (; i + 4 <= frames; i += 4) {
+			__m128 l = ScaleAndClampF32(_mm_loadu_ps(left + i));
+			__m128 r = ScaleAndClampF32(_mm_loadu_ps(right + i));
+			// l0 l1 l2 l3 r0 r1 r2 r3, then interleave the halves.
+			__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(l), _mm_cvtps_epi32(r));
+			_mm_storeu_si128((__m128i *)(out + i * 2), _mm_unpacklo_epi16(packed, _mm_srli_si128(packed, 8)));
+		}
+	} else if (channels == 1) {
+		const float *mono = in[0];
+		for (; i + 8 <= frames; i += 8) {
+			__m128 a = ScaleAndClampF32(_mm_loadu_ps(mono + i));
+			__m128 b = ScaleAndClampF32(_mm_loadu_ps(mono + i + 4));
+			_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+		}
+	}
+#endif
+	// This does the remainder if SIMD was used, otherwise it does it all.
+	for (; i < frames; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			out[i * channels + c] = ConvertF32ToS16(in[c][i]);
+		}
+	}
+}
+
 #ifndef _M_SSE
 AdjustVolumeBlockFunc AdjustVolumeBlock = &AdjustVolumeBlockStandard;
+ConvertPlanarF32ToS16Func ConvertPlanarF32ToS16 = &ConvertPlanarF32ToS16Standard;
 
 // This has to be done after CPUDetect has done its magic.
 void SetupAudioFormats() {
@@ -120,6 +177,11 @@ void SetupAudioFormats() {
 		AdjustVolumeBlock = &AdjustVolumeBlockNEON;
 	}
 #endif
+#if PPSSPP_ARCH(ARM_NEON)
+	if (cpu_info.bNEON) {
+		ConvertPlanarF32ToS16 = &ConvertPlanarF32ToS16NEON;
+	}
+#endif
 }
 #else
 void SetupAudioFormats() {
@@ -69,10 +69,16 @@ static inline s16 ApplySampleVolume20Bit(s16 sample, int vol20) {
 void SetupAudioFormats();
 void AdjustVolumeBlockStandard(s16_le *out, s16_le *in, size_t size, int leftVol, int rightVol);
 void ConvertS16ToF32(float *ou, const s16 *in, size_t size);
+// Interleaves planar float samples (as decoded by FFmpeg) into s16, rounding and clamping like libswresample.
+// NaN becomes 0 on every path.
+void ConvertPlanarF32ToS16Standard(s16 *out, const float *const *in, int channels, size_t frames);
 
 #ifdef _M_SSE
 #define AdjustVolumeBlock AdjustVolumeBlockStandard
+#define ConvertPlanarF32ToS16 ConvertPlanarF32ToS16Standard
 #else
 typedef void (*AdjustVolumeBlockFunc)(s16_le *out, s16_le *in, size_t size, int leftVol, int rightVol);
 extern AdjustVolumeBlockFunc AdjustVolumeBlock;
+typedef void (*ConvertPlanarF32ToS16Func)(s16 *out, const float *const *in, int channels, size_t frames);
+extern ConvertPlanarF32ToS16Func ConvertPlanarF32ToS16;
 #endif
@@ -19,6 +19,8 @@
 #if PPSSPP_ARCH(ARM_NEON)
 
 #include <arm_neon.h>
+#include <cmath>
+#include "math/math_util.h"
 #include "Common/Common.h"
 #include "Core/Util/AudioFormat.h"
 #include "Core/Util/AudioFormatNEON.h"
@@ -71,4 +73,38 @@ void AdjustVolumeBlockNEON(s16 *out, s16 *in, size_t size, int leftVol, int righ
 	}
 }
 
+// ARMv7 can only truncate when converting, so round in float first: adding and removing 1.5 * 2^23
+// leaves the nearest integer (ties to even, like lrintf.)  NaN stays NaN throughout and converts to 0.
+static inline int16x4_t ConvertF32ToS16NEON(float32x4_t f) {
+	const float32x4_t magic = vdupq_n_f32(12582912.0f);
+	f = vmaxq_f32(vminq_f32(vmulq_n_f32(f, 32768.0f), vdupq_n_f32(32767.0f)), vdupq_n_f32(-32768.0f));
+	f = vsubq_f32(vaddq_f32(f, magic), magic);
+	return vmovn_s32(vcvtq_s32_f32(f));
+}
+
+void ConvertPlanarF32ToS16NEON(s16 *out, const float *const *in, int channels, size_t frames) {
+	size_t i = 0;
+	if (channels == 2) {
+		const float *left = in[0];
+		const float *right = in[1];
+		for (; i + 4 <= frames; i += 4) {
+			int16x4x2_t lr;
+			lr.val[0] = ConvertF32ToS16NEON(vld1q_f32(left + i));
+			lr.val[1] = ConvertF32ToS16NEON(vld1q_f32(right + i));
+			vst2_s16(out + i * 2, lr);
+		}
+	} else if (channels == 1) {
+		const float *mono = in[0];
+		for (; i + 4 <= frames; i += 4) {
+			vst1_s16(out + i, ConvertF32ToS16NEON(vld1q_f32(mono + i)));
+		}
+	}
+	for (; i < frames; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			float f = in[c][i] * 32768.0f;
+			out[i * channels + c] = f >= 32767.0f ? 32767 : (f <= -32768.0f ? -32768 : (my_isnan(f) ? 0 : (s16)lrintf(f)));
+		}
+	}
+}
+
 #endif // PPSSPP_ARCH(ARM_NEON)
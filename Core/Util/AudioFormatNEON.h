@@ -20,3 +20,4 @@
 #include "Common/CommonTypes.h"
 
 void AdjustVolumeBlockNEON(s16 *out, s16 *in, size_t size, int leftVol, int rightVol);
+void ConvertPlanarF32ToS16NEON(s16 *out, const float *const *in, int channels, size_t frames);
@@ -23,9 +23,17 @@
 #include "Core/Util/BlockAllocator.h"
 #include "Core/Reporting.h"
 
-// Slow freaking thing but works (eventually) :)
+// Blocks stay in an address ordered list, indexed by address and by free size class for speed.
 
-BlockAllocator::BlockAllocator(int grain) : bottom_(NULL), top_(NULL), grain_(grain)
+static inline int FreeBin(u32 size)
+{
+	int bin = 0;
+	while (size >>= 1)
+		bin++;
+	return bin;
+}
+
+BlockAllocator::BlockAllocator(int grain) : bottom_(NULL), top_(NULL), grain_(grain), freeBytes_(0)
 {
 }
 
@@ -42,6 +50,7 @@ void BlockAllocator::Init(u32 rangeStart, u32 rangeSize)
 	//Initial block, covering everything
 	top_ = new Block(rangeStart_, rangeSize_, false, NULL, NULL);
 	bottom_ = top_;
+	IndexBlock(top_);
 }
 
 void BlockAllocator::Shutdown()
@@ -53,6 +62,90 @@ void BlockAllocator::Shutdown()
 		bottom_ = next;
 	}
 	top_ = NULL;
+
+	blocks_.clear();
+	for (int i = 0; i < NUM_FREE_BINS; ++i)
+		freeBins_[i].clear();
+	freeBytes_ = 0;
+}
+
+void BlockAllocator::IndexBlock(Block *b)
+{
+	// Empty blocks (from a zero sized AllocAt) can never contain an address.
+	if (b->size != 0)
+		blocks_[b->start] = b;
+	if (!b->taken)
+	{
+		freeBins_[FreeBin(b->size)].insert(b);
+		freeBytes_ += b->size;
+	}
+}
+
+void BlockAllocator::UnindexBlock(Block *b)
+{
+	if (b->size != 0)
+		blocks_.erase(b->start);
+	if (!b->taken)
+	{
+		freeBins_[FreeBin(b->size)].erase(b);
+		freeBytes_ -= b->size;
+	}
+}
+
+void BlockAllocator::RebuildIndex()
+{
+	blocks_.clear();
+	for (int i = 0; i < NUM_FREE_BINS; ++i)
+		freeBins_[i].clear();
+	freeBytes_ = 0;
+
+	for (Block *bp = bottom_; bp != NULL; bp = bp->next)
+		IndexBlock(bp);
+}
+
+// Finds the same block a walk over every block would: the lowest (or highest) one that fits.
+BlockAllocator::Block *BlockAllocator::FindFreeBlock(u32 size, u32 grain, bool fromTop)
+{
+	Block *best = NULL;
+	// Smaller bins can't hold anything big enough.
+	for (int bin = FreeBin(size); bin < NUM_FREE_BINS; ++bin)
+	{
+		const std::set<Block *, BlockStartLess> &freeBin = freeBins_[bin];
+		if (!fromTop)
+		{
+			for (auto it = freeBin.begin(); it != freeBin.end(); ++it)
+			{
+				Block &b = **it;
+				// Nothing further along can beat what another bin found.
+				if (best != NULL && b.start > best->start)
+					break;
+				u32 offset = b.start % grain;
+				if (offset != 0)
+					offset = grain - offset;
+				if (b.size >= offset + size)
+				{
+					best = &b;
+					break;
+				}
+			}
+		}
+		else
+		{
+			for (auto it = freeBin.rbegin(); it != freeBin.rend(); ++it)
+			{
+				Block &b = **it;
+				if (best != NULL && b.start < best->start)
+					break;
+				u32 offset = (b.start + b.size - size) % grain;
+				if (b.size >= offset + size)
+				{
+					best = &b;
+					break;
+				}
+			}
+		}
+	}
+	return best;
 }
 
 u32 BlockAllocator::AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromTop, const char *tag)
@@ -72,67 +165,37 @@ u32 BlockAllocator::AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromT
 	// upalign size to grain
 	size = (size + sizeGrain - 1) & ~(sizeGrain - 1);
 
-	if (!fromTop)
+	Block *bp = FindFreeBlock(size, grain, fromTop);
+	if (bp != NULL)
 	{
-		//Allocate from bottom of mem
-		for (Block *bp = bottom_; bp != NULL; bp = bp->next)
+		Block &b = *bp;
+		UnindexBlock(bp);
+		if (!fromTop)
 		{
-			Block &b = *bp;
+			//Allocate from bottom of mem
 			u32 offset = b.start % grain;
 			if (offset != 0)
 				offset = grain - offset;
 			u32 needed = offset + size;
-			if (b.taken == false && b.size >= needed)
-			{
-				if (b.size == needed)
-				{
-					if (offset >= grain_)
-						InsertFreeBefore(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-				else
-				{
-					InsertFreeAfter(&b, b.size - needed);
-					if (offset >= grain_)
-						InsertFreeBefore(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-			}
+			if (b.size != needed)
+				InsertFreeAfter(&b, b.size - needed);
+			if (offset >= grain_)
+				InsertFreeBefore(&b, offset);
 		}
-	}
-	else
-	{
-		// Allocate from top of mem.
-		for (Block *bp = top_; bp != NULL; bp = bp->prev)
+		else
 		{
-			Block &b = *bp;
+			// Allocate from top of mem.
 			u32 offset = (b.start + b.size - size) % grain;
 			u32 needed = offset + size;
-			if (b.taken == false && b.size >= needed)
-			{
-				if (b.size == needed)
-				{
-					if (offset >= grain_)
-						InsertFreeAfter(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-				else
-				{
-					InsertFreeBefore(&b, b.size - needed);
-					if (offset >= grain_)
-						InsertFreeAfter(&b, offset);
-					b.taken = true;
-					b.SetTag(tag);
-					return b.start;
-				}
-			}
+			if (b.size != needed)
+				InsertFreeBefore(&b, b.size - needed);
+			if (offset >= grain_)
+				InsertFreeAfter(&b, offset);
 		}
+		b.taken = true;
+		b.SetTag(tag);
+		IndexBlock(bp);
+		return b.start;
 	}
 
 	//Out of memory :(
@@ -191,20 +254,24 @@ u32 BlockAllocator::AllocAt(u32 position, u32 size, const char *tag)
 			//good to go
 			else if (b.start == alignedPosition)
 			{
+				UnindexBlock(bp);
 				if (b.size != alignedSize)
 					InsertFreeAfter(&b, b.size - alignedSize);
 				b.taken = true;
 				b.SetTag(tag);
+				IndexBlock(bp);
 				CheckBlocks();
 				return position;
 			}
 			else
 			{
+				UnindexBlock(bp);
 				InsertFreeBefore(&b, alignedPosition - b.start);
 				if (b.size > alignedSize)
 					InsertFreeAfter(&b, b.size - alignedSize);
 				b.taken = true;
 				b.SetTag(tag);
+				IndexBlock(bp);
 
 				return position;
 			}
@@ -222,6 +289,7 @@ u32 BlockAllocator::AllocAt(u32 position, u32 size, const char *tag)
 	return -1;
 }
 
+// fromBlock must already be unindexed, the merged result gets indexed.
 void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 {
 	DEBUG_LOG(SCEKERNEL, "Merging Blocks");
@@ -230,6 +298,7 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 	while (prev != NULL && prev->taken == false)
 	{
 		DEBUG_LOG(SCEKERNEL, "Block Alloc found adjacent free blocks - merging");
+		UnindexBlock(prev);
 		prev->size += fromBlock->size;
 		if (fromBlock->next == NULL)
 			top_ = prev;
@@ -250,6 +319,7 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 	while (next != NULL && next->taken == false)
 	{
 		DEBUG_LOG(SCEKERNEL, "Block Alloc found adjacent free blocks - merging");
+		UnindexBlock(next);
 		fromBlock->size += next->size;
 		fromBlock->next = next->next;
 		delete next;
@@ -260,6 +330,8 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 		top_ = fromBlock;
 	else
 		next->prev = fromBlock;
+
+	IndexBlock(fromBlock);
 }
 
 bool BlockAllocator::Free(u32 position)
@@ -267,6 +339,7 @@ bool BlockAllocator::Free(u32 position)
 	Block *b = GetBlockFromAddress(position);
 	if (b && b->taken)
 	{
+		UnindexBlock(b);
 		b->taken = false;
 		MergeFreeBlocks(b);
 		return true;
@@ -283,6 +356,7 @@ bool BlockAllocator::FreeExact(u32 position)
 	Block *b = GetBlockFromAddress(position);
 	if (b && b->taken && b->start == position)
 	{
+		UnindexBlock(b);
 		b->taken = false;
 		MergeFreeBlocks(b);
 		return true;
@@ -294,6 +368,7 @@ bool BlockAllocator::FreeExact(u32 position)
 	}
 }
 
+// b must be unindexed, since its start or size changes.
 BlockAllocator::Block *BlockAllocator::InsertFreeBefore(Block *b, u32 size)
 {
 	Block *inserted = new Block(b->start, size, false, b->prev, b);
@@ -305,6 +380,7 @@ BlockAllocator::Block *BlockAllocator::InsertFreeBefore(Block *b, u32 size)
 
 	b->start += size;
 	b->size -= size;
+	IndexBlock(inserted);
 	return inserted;
 }
 
@@ -318,6 +394,7 @@ BlockAllocator::Block *BlockAllocator::InsertFreeAfter(Block *b, u32 size)
 		inserted->next->prev = inserted;
 
 	b->size -= size;
+	IndexBlock(inserted);
 	return inserted;
 }
 
@@ -343,28 +420,31 @@ const char *BlockAllocator::GetBlockTag(u32 addr) const {
 
 inline BlockAllocator::Block *BlockAllocator::GetBlockFromAddress(u32 addr)
 {
-	for (Block *bp = bottom_; bp != NULL; bp = bp->next)
+	// The last block starting at or before addr is the only candidate.
+	auto it = blocks_.upper_bound(addr);
+	if (it == blocks_.begin())
+		return NULL;
+	--it;
+	Block *bp = it->second;
+	if (bp->start + bp->size > addr)
 	{
-		Block &b = *bp;
-		if (b.start <= addr && b.start + b.size > addr)
-		{
-			// Got one!
-			return bp;
-		}
+		// Got one!
+		return bp;
 	}
 	return NULL;
 }
 
 const BlockAllocator::Block *BlockAllocator::GetBlockFromAddress(u32 addr) const
 {
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
+	auto it = blocks_.upper_bound(addr);
+	if (it == blocks_.begin())
+		return NULL;
+	--it;
+	const Block *bp = it->second;
+	if (bp->start + bp->size > addr)
 	{
-		const Block &b = *bp;
-		if (b.start <= addr && b.start + b.size > addr)
-		{
-			// Got one!
-			return bp;
-		}
+		// Got one!
+		return bp;
 	}
 	return NULL;
 }
@@ -401,13 +481,13 @@ void BlockAllocator::ListBlocks() const
 u32 BlockAllocator::GetLargestFreeBlockSize() const
 {
 	u32 maxFreeBlock = 0;
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
+	// Only the largest non-empty size class matters.
+	for (int bin = NUM_FREE_BINS - 1; bin >= 0 && maxFreeBlock == 0; --bin)
 	{
-		const Block &b = *bp;
-		if (!b.taken)
+		for (const Block *bp : freeBins_[bin])
 		{
-			if (b.size > maxFreeBlock)
-				maxFreeBlock = b.size;
+			if (bp->size > maxFreeBlock)
+				maxFreeBlock = bp->size;
 		}
 	}
 	if (maxFreeBlock & (grain_ - 1))
@@ -417,15 +497,7 @@ u32 BlockAllocator::GetLargestFreeBlockSize() const
 
 u32 BlockAllocator::GetTotalFreeBytes() const
 {
-	u32 sum = 0;
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
-	{
-		const Block &b = *bp;
-		if (!b.taken)
-		{
-			sum += b.size;
-		}
-	}
+	u32 sum = freeBytes_;
 	if (sum & (grain_ - 1))
 		WARN_LOG_REPORT(HLE, "GetTotalFreeBytes: free size %08x does not align to grain %08x.", sum, grain_);
 	return sum;
@@ -476,6 +548,9 @@ void BlockAllocator::DoState(PointerWrap &p)
 	p.Do(rangeStart_);
 	p.Do(rangeSize_);
 	p.Do(grain_);
+
+	if (p.mode == p.MODE_READ)
+		RebuildIndex();
 }
 
 BlockAllocator::Block::Block(u32 _start, u32 _size, bool _taken, Block *_prev, Block *_next)
@@ -19,6 +19,9 @@
 
 class PointerWrap;
 
+#include <map>
+#include <set>
+
 #include "Common/CommonTypes.h"
 
 class BlockAllocator
@@ -72,6 +75,16 @@ class BlockAllocator
 		Block *next;
 	};
 
+	struct BlockStartLess
+	{
+		bool operator ()(const Block *a, const Block *b) const {
+			return a->start < b->start;
+		}
+	};
+
+	// Free blocks are binned by the highest set bit of their size.
+	enum { NUM_FREE_BINS = 32 };
+
 	Block *bottom_;
 	Block *top_;
 	u32 rangeStart_;
@@ -79,6 +92,18 @@ class BlockAllocator
 
 	u32 grain_;
 
+	// Every block by start address, for lookups.
+	std::map<u32, Block *> blocks_;
+	// Free blocks by size class, each in address order so first fit stays first fit.
+	std::set<Block *, BlockStartLess> freeBins_[NUM_FREE_BINS];
+	u32 freeBytes_;
+
+	// A block's start, size, or taken flag may only change while it's unindexed.
+	void IndexBlock(Block *b);
+	void UnindexBlock(Block *b);
+	void RebuildIndex();
+	Block *FindFreeBlock(u32 size, u32 grain, bool fromTop);
+
 	void MergeFreeBlocks(Block *fromBlock);
 	Block *GetBlockFromAddress(u32 addr);
 	const Block *GetBlockFromAddress(u32 addr) const;
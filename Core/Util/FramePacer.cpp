@@ -0,0 +1,152 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#include "base/timeutil.h"
+#include "Common/CommonWindows.h"
+#include "Core/Util/FramePacer.h"
+
+#if defined(__linux__)
+#include <time.h>
+#elif !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace FramePacer {
+
+// Never spin less than this, the estimate can dip below what a bad wakeup costs.
+static const double MIN_SPIN_MARGIN = 0.0002;
+// Or more, if the OS is that bad it's better to be a bit late than to burn the CPU.
+static const double MAX_SPIN_MARGIN = 0.004;
+
+// How late the OS wakes us, mostly tracking the worst recent case.
+// Updated by the emu thread, read by the UI for the stats overlay.
+static std::atomic<double> wakeLatency{ 0.001 };
+
+static std::mutex historyLock;
+static FrameTimingSample history[FRAME_HISTORY];
+static int historyNext = 0;
+static int historyCount = 0;
+
+static double SpinMargin() {
+	return std::min(std::max(wakeLatency.load() * 1.25 + 0.0001, MIN_SPIN_MARGIN), MAX_SPIN_MARGIN);
+}
+
+#if defined(__linux__)
+static long long MonotonicNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+#endif
+
+static void SleepUntil(double target, double now) {
+#if defined(__linux__)
+	// real_time_now() runs on CLOCK_MONOTONIC too, just from a different zero.  Measure that once,
+	// then every deadline is absolute, so time spent getting here isn't added on again.
+	static const long long offsetNanos = MonotonicNanos() - (long long)(real_time_now() * 1000000000.0);
+	const long long ns = offsetNanos + (long long)(target * 1000000000.0);
+	struct timespec ts;
+	ts.tv_sec = (time_t)(ns / 1000000000LL);
+	ts.tv_nsec = (long)(ns % 1000000000LL);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+		continue;
+#elif defined(_WIN32)
+	// Sleep() only does whole milliseconds, don't round up past the target.
+	const DWORD ms = (DWORD)((target - now) * 1000.0);
+	if (ms > 0)
+		Sleep(ms);
+#else
+	usleep((useconds_t)((target - now) * 1000000.0));
+#endif
+}
+
+double WaitUntil(double deadline) {
+	double now = real_time_now();
+	double spinStart = now;
+	const double sleepTarget = deadline - SpinMargin();
+	if (sleepTarget > now) {
+		SleepUntil(sleepTarget, now);
+		now = real_time_now();
+		spinStart = now;
+
+		// Rise right away on a late wakeup, but only come back down slowly.  Only this thread writes it.
+		const double latency = std::max(now - sleepTarget, 0.0);
+		const double prevLatency = wakeLatency.load();
+		if (latency > prevLatency)
+			wakeLatency = latency;
+		else
+			wakeLatency = prevLatency * 0.95 + latency * 0.05;
+	}
+
+	while (now < deadline) {
+		// Let anything else that's ready run, but stay runnable ourselves.
+		std::this_thread::yield();
+		now = real_time_now();
+	}
+
+	time_update();
+	return now > spinStart ? now - spinStart : 0.0;
+}
+
+void RecordFrame(const FrameTimingSample &sample) {
+	std::lock_guard<std::mutex> guard(historyLock);
+	history[historyNext] = sample;
+	historyNext = (historyNext + 1) % FRAME_HISTORY;
+	historyCount = std::min(historyCount + 1, (int)FRAME_HISTORY);
+}
+
+void GetFrameHistory(std::vector<FrameTimingSample> *samples) {
+	std::lock_guard<std::mutex> guard(historyLock);
+	samples->clear();
+	samples->reserve(historyCount);
+	const int first = (historyNext - historyCount + FRAME_HISTORY) % FRAME_HISTORY;
+	for (int i = 0; i < historyCount; ++i)
+		samples->push_back(history[(first + i) % FRAME_HISTORY]);
+}
+
+FramePacingStats GetStats() {
+	FramePacingStats stats{};
+	stats.spinMargin = SpinMargin();
+
+	std::lock_guard<std::mutex> guard(historyLock);
+	// Just the last second or so, for the overlay.
+	const int count = std::min(historyCount, 60);
+	double total = 0.0;
+	for (int i = 0; i < count; ++i) {
+		const FrameTimingSample &sample = history[(historyNext - 1 - i + FRAME_HISTORY) % FRAME_HISTORY];
+		total += fabs(sample.sleepError);
+		stats.maxSleepError = std::max(stats.maxSleepError, sample.sleepError);
+	}
+	stats.frames = count;
+	stats.avgSleepError = count == 0 ? 0.0 : total / count;
+	return stats;
+}
+
+void Reset() {
+	std::lock_guard<std::mutex> guard(historyLock);
+	historyNext = 0;
+	historyCount = 0;
+}
+
+}  // namespace FramePacer
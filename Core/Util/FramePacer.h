@@ -0,0 +1,59 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <vector>
+
+// One throttled frame, all in real_time_now() seconds.
+struct FrameTimingSample {
+	// When the previous frame's wait ended, i.e. when emulating this frame started.
+	double start;
+	// When this frame's wait ended.
+	double end;
+	// Time spent emulating, before the wait.
+	double emuSeconds;
+	// The deadline, and how far past it we woke (negative would be early, which shouldn't happen.)
+	double deadline;
+	double sleepError;
+	// How much of the wait was spent spinning instead of sleeping.
+	double spinSeconds;
+};
+
+struct FramePacingStats {
+	int frames;
+	double avgSleepError;
+	double maxSleepError;
+	double spinMargin;
+};
+
+namespace FramePacer {
+
+// Waits until real_time_now() reaches deadline, by sleeping on an absolute deadline until shortly before
+// it and spinning the rest.  How early to stop sleeping adapts to how late the OS has been waking us.
+// Returns the time spent spinning.  Also updates time_now_d().
+double WaitUntil(double deadline);
+
+// Keeps the last FRAME_HISTORY frames.
+enum { FRAME_HISTORY = 512 };
+void RecordFrame(const FrameTimingSample &sample);
+// Oldest first.
+void GetFrameHistory(std::vector<FrameTimingSample> *samples);
+FramePacingStats GetStats();
+void Reset();
+
+}  // namespace FramePacer
@@ -30,6 +30,7 @@
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/Util/AudioFormat.h"  // for clamp_u8
 #include "GPU/Common/ShaderCommon.h"
+#include "GPU/GPU.h"
 #include "GPU/GPUState.h"
 #include "GPU/ge_constants.h"
 #include "GPU/Math3D.h"
@@ -1291,6 +1292,10 @@ void VertexDecoder::DecodeVerts(u8 *decodedptr, const void *verts, int indexLowe
 	int count = indexUpperBound - indexLowerBound + 1;
 	int stride = decFmt.stride;
 
+	GPUTimingScope timing(&gpuTimings.vertexDecodeSeconds);
+	if (gpuCollectTimings)
+		gpuTimings.vertsDecoded += count;
+
 	// Check alignment before running the decoder, as we may crash if it's bad (as should the real PSP but doesn't always)
 	if (((uintptr_t)verts & (biggest - 1)) != 0) {
 		// Bad alignment. Not really sure what to do here... zero the verts to be safe?
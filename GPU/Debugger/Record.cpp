@@ -17,9 +17,11 @@
 
 #include <algorithm>
 #include <cstring>
+#include <unordered_map>
 #include <vector>
 #include <snappy-c.h>
 #include "base/stringutil.h"
+#include "base/timeutil.h"
 #include "Common/Common.h"
 #include "Common/FileUtil.h"
 #include "Common/Log.h"
@@ -32,6 +34,7 @@
 #include "Core/MemMap.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/System.h"
+#include "ext/xxhash.h"
 #include "GPU/GPUInterface.h"
 #include "GPU/GPUState.h"
 #include "GPU/ge_constants.h"
@@ -42,11 +45,15 @@
 namespace GPURecord {
 
 static const char *HEADER = "PPSSPPGE";
-static const int VERSION = 2;
+// Version 3 streams chunks and stores memory data deduplicated, see WriteChunk().
+static const int VERSION = 3;
+static const int MIN_VERSION = 2;
 
 static bool active = false;
 static bool nextFrame = false;
-static bool writePending = false;
+static int nextFrameCount = 0;
+static int framesLeft = 0;
+static bool displayPending = false;
 
 enum class CommandType : u8 {
 	INIT = 0,
@@ -80,10 +87,25 @@ struct Command {
 
 #pragma pack(pop)
 
+// Commands, and the small data (registers, state, display) they point into, go out chunk by chunk.
 static std::vector<u8> pushbuf;
 static std::vector<Command> commands;
 static std::vector<u32> lastRegisters;
-static std::vector<u32> lastTextures;
+
+// Memory data (textures, verts, uploads...) is stored once by content in a separate stream.
+// Commands address it by position in the whole stream, so later chunks can refer back to it.
+// While recording, blobbuf holds only the data new since the last chunk, starting at blobBase.
+static std::vector<u8> blobbuf;
+static u32 blobBase;
+struct BlobRef {
+	u32 ptr;
+	u32 sz;
+};
+static std::unordered_map<u64, BlobRef> blobsByHash;
+static FILE *recordFile;
+
+// Write out what we have once it reaches this size, so long recordings don't sit in RAM.
+static const size_t CHUNK_FLUSH_SIZE = 8 * 1024 * 1024;
 
 // TODO: Maybe move execute to another file?
 static u32 execMemcpyDest;
@@ -93,6 +115,33 @@ static u32 execListID;
 static const int LIST_BUF_SIZE = 256 * 1024;
 static std::vector<u32_le> execListQueue;
 
+// Replay state, kept between calls so each call plays one recorded frame.
+static u32 execFile;
+static std::string execFilename;
+static int execVersion;
+static size_t execCommandIndex;
+static bool execEnded;
+static int execFramesPlayed;
+static int execLoopsPlayed;
+// Time spent opening, reading, decompressing and copying dump data into PSP memory, rather than replaying.
+static double execLoadSeconds;
+static int execLoadDepth;
+
+// Counts the time until it goes out of scope as loading, unless an outer one already does.
+struct ReplayLoadTimer {
+	ReplayLoadTimer() : start_(execLoadDepth++ == 0 ? real_time_now() : 0.0) {}
+	~ReplayLoadTimer() {
+		if (--execLoadDepth == 0)
+			execLoadSeconds += real_time_now() - start_;
+	}
+	double start_;
+};
+
+// Version 2 dumps keep everything in pushbuf.
+static const std::vector<u8> &ExecBlobs() {
+	return execVersion < 3 ? pushbuf : blobbuf;
+}
+
 // This class maps pushbuffer (dump data) sections to PSP memory.
 // Dumps can be larger than available PSP memory, because they include generated data too.
 //
@@ -117,7 +166,7 @@ class BufMapping {
 	}
 
 protected:
-	u32 MapSlab(u32 bufpos);
+	u32 MapSlab(u32 bufpos, u32 sz);
 	u32 MapExtra(u32 bufpos, u32 sz);
 
 	enum {
@@ -137,6 +186,7 @@ class BufMapping {
 	struct SlabInfo {
 		u32 psp_pointer_;
 		u32 buf_pointer_;
+		u32 size_;
 		int last_used_;
 
 		bool Matches(u32 bufpos) {
@@ -144,6 +194,11 @@ class BufMapping {
 			return buf_pointer_ == bufpos && psp_pointer_ != 0;
 		}
 
+		// When streaming, data may have arrived after this slab was copied.
+		bool Covers(u32 bufpos, u32 sz) {
+			return bufpos + sz <= buf_pointer_ + size_;
+		}
+
 		// Automatically marks used for LRU purposes.
 		u32 Ptr(u32 bufpos) {
 			last_used_ = slabGeneration_;
@@ -195,19 +250,22 @@ u32 BufMapping::Map(u32 bufpos, u32 sz) {
 
 	if (slab1 == slab2) {
 		// Doesn't straddle, so we can just map to a slab.
-		return MapSlab(bufpos);
+		return MapSlab(bufpos, sz);
 	} else {
 		// We need contiguous, so we'll just allocate separately.
 		return MapExtra(bufpos, sz);
 	}
 }
 
-u32 BufMapping::MapSlab(u32 bufpos) {
+u32 BufMapping::MapSlab(u32 bufpos, u32 sz) {
 	u32 slab_pos = (bufpos / SLAB_SIZE) * SLAB_SIZE;
 
 	int best = 0;
 	for (int i = 0; i < SLAB_COUNT; ++i) {
 		if (slabs_[i].Matches(slab_pos)) {
+			if (!slabs_[i].Covers(bufpos, sz) && !slabs_[i].Setup(slab_pos)) {
+				return 0;
+			}
 			return slabs_[i].Ptr(bufpos);
 		}
 
@@ -260,11 +318,13 @@ void BufMapping::SlabInfo::Free() {
 		userMemory.Free(psp_pointer_);
 		psp_pointer_ = 0;
 		buf_pointer_ = 0;
+		size_ = 0;
 		last_used_ = 0;
 	}
 }
 
 bool BufMapping::ExtraInfo::Alloc(u32 bufpos, u32 sz) {
+	ReplayLoadTimer timer;
 	// Make sure we've freed any previous allocation first.
 	Free();
 
@@ -279,7 +339,7 @@ bool BufMapping::ExtraInfo::Alloc(u32 bufpos, u32 sz) {
 
 	buf_pointer_ = bufpos;
 	size_ = sz;
-	Memory::MemcpyUnchecked(psp_pointer_, pushbuf.data() + bufpos, sz);
+	Memory::MemcpyUnchecked(psp_pointer_, ExecBlobs().data() + bufpos, sz);
 	return true;
 }
 
@@ -292,6 +352,7 @@ void BufMapping::ExtraInfo::Free() {
 }
 
 bool BufMapping::SlabInfo::Setup(u32 bufpos) {
+	ReplayLoadTimer timer;
 	// If it already has RAM, we're simply taking it over.  Slabs come only in one size.
 	if (psp_pointer_ == 0) {
 		if (!Alloc()) {
@@ -299,9 +360,10 @@ bool BufMapping::SlabInfo::Setup(u32 bufpos) {
 		}
 	}
 
+	const std::vector<u8> &blobs = ExecBlobs();
 	buf_pointer_ = bufpos;
-	u32 sz = std::min((u32)SLAB_SIZE, (u32)pushbuf.size() - bufpos);
-	Memory::MemcpyUnchecked(psp_pointer_, pushbuf.data() + bufpos, sz);
+	size_ = std::min((u32)SLAB_SIZE, (u32)blobs.size() - bufpos);
+	Memory::MemcpyUnchecked(psp_pointer_, blobs.data() + bufpos, size_);
 
 	slabGeneration_++;
 	last_used_ = slabGeneration_;
@@ -356,13 +418,28 @@ static void EmitDisplayBuf() {
 	commands.push_back({CommandType::DISPLAY, sz, ptr});
 }
 
-static void BeginRecording() {
+static bool BeginRecording() {
+	const std::string filename = GenRecordingFilename();
+	NOTICE_LOG(G3D, "Recording filename: %s", filename.c_str());
+
+	recordFile = File::OpenCFile(filename, "wb");
+	if (!recordFile) {
+		ERROR_LOG(G3D, "Unable to open %s for recording", filename.c_str());
+		return false;
+	}
+	fwrite(HEADER, 8, 1, recordFile);
+	fwrite(&VERSION, sizeof(VERSION), 1, recordFile);
+
+	blobBase = 0;
+	blobsByHash.clear();
+
 	u32 ptr = (u32)pushbuf.size();
 	u32 sz = 512 * 4;
 	pushbuf.resize(pushbuf.size() + sz);
 	gstate.Save((u32_le *)(pushbuf.data() + ptr));
 
 	commands.push_back({CommandType::INIT, sz, ptr});
+	return true;
 }
 
 static void WriteCompressed(FILE *fp, const void *p, size_t sz) {
@@ -377,27 +454,40 @@ static void WriteCompressed(FILE *fp, const void *p, size_t sz) {
 	delete [] compressed;
 }
 
-static void WriteRecording() {
+// Each chunk is its command count and data sizes, then each part compressed separately.
+// A recording that got cut off is still good up to its last complete chunk.
+static void WriteChunk() {
 	FlushRegisters();
-	EmitDisplayBuf();
-
-	const std::string filename = GenRecordingFilename();
+	if (commands.empty()) {
+		return;
+	}
 
-	NOTICE_LOG(G3D, "Recording filename: %s", filename.c_str());
+	u32 header[3];
+	header[0] = (u32)commands.size();
+	header[1] = (u32)pushbuf.size();
+	header[2] = (u32)blobbuf.size();
+	fwrite(header, sizeof(header), 1, recordFile);
 
-	FILE *fp = File::OpenCFile(filename, "wb");
-	fwrite(HEADER, 8, 1, fp);
-	fwrite(&VERSION, sizeof(VERSION), 1, fp);
+	WriteCompressed(recordFile, commands.data(), commands.size() * sizeof(Command));
+	if (!pushbuf.empty())
+		WriteCompressed(recordFile, pushbuf.data(), pushbuf.size());
+	if (!blobbuf.empty())
+		WriteCompressed(recordFile, blobbuf.data(), blobbuf.size());
 
-	u32 sz = (u32)commands.size();
-	fwrite(&sz, sizeof(sz), 1, fp);
-	u32 bufsz = (u32)pushbuf.size();
-	fwrite(&bufsz, sizeof(bufsz), 1, fp);
+	blobBase += (u32)blobbuf.size();
+	commands.clear();
+	pushbuf.clear();
+	blobbuf.clear();
+}
 
-	WriteCompressed(fp, commands.data(), commands.size() * sizeof(Command));
-	WriteCompressed(fp, pushbuf.data(), bufsz);
+static void FinishRecording() {
+	WriteChunk();
+	fclose(recordFile);
+	recordFile = nullptr;
 
-	fclose(fp);
+	blobsByHash.clear();
+	NOTICE_LOG(SYSTEM, "Recording finished");
+	active = false;
 }
 
 static void GetVertDataSizes(int vcount, const void *indices, u32 &vbytes, u32 &ibytes) {
@@ -424,27 +514,14 @@ static void GetVertDataSizes(int vcount, const void *indices, u32 &vbytes, u32 &
 	}
 }
 
-static const u8 *mymemmem(const u8 *haystack, size_t hlen, const u8 *needle, size_t nlen) {
-	if (!nlen) {
-		return nullptr;
-	}
-
-	const u8 *last_possible = haystack + hlen - nlen;
-	int first = *needle;
-	const u8 *p = haystack;
-	while (p <= last_possible) {
-		p = (const u8 *)memchr(p, first, last_possible - p + 1);
-		if (!p) {
-			return nullptr;
-		}
-		if (!memcmp(p, needle, nlen)) {
-			return p;
-		}
-
-		p++;
-	}
+static Command EmitCommandWithData(CommandType t, const void *p, u32 sz) {
+	FlushRegisters();
 
-	return nullptr;
+	Command cmd{t, sz, (u32)pushbuf.size()};
+	pushbuf.resize(pushbuf.size() + sz);
+	memcpy(pushbuf.data() + cmd.ptr, p, sz);
+	commands.push_back(cmd);
+	return cmd;
 }
 
 static Command EmitCommandWithRAM(CommandType t, const void *p, u32 sz) {
@@ -453,31 +530,27 @@ static Command EmitCommandWithRAM(CommandType t, const void *p, u32 sz) {
 	Command cmd{t, sz, 0};
 
 	if (sz) {
-		// If at all possible, try to find it already in the buffer.
-		const u8 *prev = nullptr;
-		const size_t NEAR_WINDOW = std::max((int)sz * 2, 1024 * 10);
-		// Let's try nearby first... it will often be nearby.
-		if (pushbuf.size() > NEAR_WINDOW) {
-			prev = mymemmem(pushbuf.data() + pushbuf.size() - NEAR_WINDOW, NEAR_WINDOW, (const u8 *)p, sz);
-		}
-		if (!prev) {
-			prev = mymemmem(pushbuf.data(), pushbuf.size(), (const u8 *)p, sz);
-		}
-
-		if (prev) {
-			cmd.ptr = (u32)(prev - pushbuf.data());
+		// Dumps are huge, so store each distinct piece of memory only once.
+		const u64 hash = XXH64(p, sz, 0);
+		auto it = blobsByHash.find(hash);
+		if (it != blobsByHash.end() && it->second.sz == sz) {
+			cmd.ptr = it->second.ptr;
 		} else {
-			cmd.ptr = (u32)pushbuf.size();
+			// Keep the alignment in the whole stream, that's what replay maps.
+			u32 pos = (u32)blobbuf.size();
 			int pad = 0;
-			if (cmd.ptr & 0xF) {
-				pad = 0x10 - (cmd.ptr & 0xF);
-				cmd.ptr += pad;
+			if ((blobBase + pos) & 0xF) {
+				pad = 0x10 - ((blobBase + pos) & 0xF);
+				pos += pad;
 			}
-			pushbuf.resize(pushbuf.size() + sz + pad);
+			blobbuf.resize(blobbuf.size() + sz + pad);
 			if (pad) {
-				memset(pushbuf.data() + cmd.ptr - pad, 0, pad);
+				memset(blobbuf.data() + pos - pad, 0, pad);
 			}
-			memcpy(pushbuf.data() + cmd.ptr, p, sz);
+			memcpy(blobbuf.data() + pos, p, sz);
+
+			cmd.ptr = blobBase + pos;
+			blobsByHash[hash] = BlobRef{ cmd.ptr, sz };
 		}
 	}
 
@@ -496,27 +569,8 @@ static void EmitTextureData(int level, u32 texaddr) {
 
 	u32 bytes = Memory::ValidSize(texaddr, sizeInRAM);
 	if (Memory::IsValidAddress(texaddr)) {
-		FlushRegisters();
-
 		CommandType type = CommandType((int)CommandType::TEXTURE0 + level);
-		const u8 *p = Memory::GetPointerUnchecked(texaddr);
-
-		// Dumps are huge - let's try to find this already emitted.
-		for (u32 prevptr : lastTextures) {
-			if (pushbuf.size() < prevptr + bytes) {
-				continue;
-			}
-
-			if (memcmp(pushbuf.data() + prevptr, p, bytes) == 0) {
-				commands.push_back({type, bytes, prevptr});
-				// Okay, that was easy.  Bail out.
-				return;
-			}
-		}
-
-		// Not there, gotta emit anew.
-		Command cmd = EmitCommandWithRAM(type, p, bytes);
-		lastTextures.push_back(cmd.ptr);
+		EmitCommandWithRAM(type, Memory::GetPointerUnchecked(texaddr), bytes);
 	}
 }
 
@@ -605,24 +659,28 @@ bool IsActive() {
 	return active;
 }
 
-void Activate() {
-	nextFrame = true;
+void Activate(int frames) {
+	if (!active) {
+		nextFrame = true;
+		nextFrameCount = std::max(frames, 1);
+	}
 }
 
 void NotifyCommand(u32 pc) {
 	if (!active) {
 		return;
 	}
-	if (writePending) {
-		WriteRecording();
-		commands.clear();
-		pushbuf.clear();
+	if (displayPending) {
+		// The display buf is only right once the next frame starts, so each frame ends here.
+		FlushRegisters();
+		EmitDisplayBuf();
+		displayPending = false;
 
-		writePending = false;
-		// We're done - this was just to write the result out.
-		NOTICE_LOG(SYSTEM, "Recording finished");
-		active = false;
-		return;
+		if (framesLeft <= 0) {
+			// We're done - this was just to write the result out.
+			FinishRecording();
+			return;
+		}
 	}
 
 	const u32 op = Memory::Read_U32(pc);
@@ -671,6 +729,10 @@ void NotifyCommand(u32 pc) {
 		lastRegisters.push_back(op);
 		break;
 	}
+
+	if (pushbuf.size() + blobbuf.size() >= CHUNK_FLUSH_SIZE) {
+		WriteChunk();
+	}
 }
 
 void NotifyMemcpy(u32 dest, u32 src, u32 sz) {
@@ -678,10 +740,7 @@ void NotifyMemcpy(u32 dest, u32 src, u32 sz) {
 		return;
 	}
 	if (Memory::IsVRAMAddress(dest)) {
-		FlushRegisters();
-		Command cmd{CommandType::MEMCPYDEST, sizeof(dest), (u32)pushbuf.size()};
-		pushbuf.resize(pushbuf.size() + sizeof(dest));
-		memcpy(pushbuf.data() + cmd.ptr, &dest, sizeof(dest));
+		EmitCommandWithData(CommandType::MEMCPYDEST, &dest, sizeof(dest));
 
 		sz = Memory::ValidSize(dest, sz);
 		EmitCommandWithRAM(CommandType::MEMCPYDATA, Memory::GetPointer(dest), sz);
@@ -701,11 +760,7 @@ void NotifyMemset(u32 dest, int v, u32 sz) {
 	if (Memory::IsVRAMAddress(dest)) {
 		sz = Memory::ValidSize(dest, sz);
 		MemsetCommand data{dest, v, sz};
-
-		FlushRegisters();
-		Command cmd{CommandType::MEMSET, sizeof(data), (u32)pushbuf.size()};
-		pushbuf.resize(pushbuf.size() + sizeof(data));
-		memcpy(pushbuf.data() + cmd.ptr, &data, sizeof(data));
+		EmitCommandWithData(CommandType::MEMSET, &data, sizeof(data));
 	}
 }
 
@@ -717,17 +772,20 @@ void NotifyUpload(u32 dest, u32 sz) {
 }
 
 void NotifyFrame() {
-	if (active && !writePending) {
-		// Delay write until the first command of the next frame, so we get the right display buf.
-		NOTICE_LOG(SYSTEM, "Recording complete - waiting to get display buffer");
-		writePending = true;
+	if (active && !displayPending) {
+		// Delay the display buf until the first command of the next frame, so we get the right one.
+		framesLeft--;
+		if (framesLeft <= 0) {
+			NOTICE_LOG(SYSTEM, "Recording complete - waiting to get display buffer");
+		}
+		displayPending = true;
 	}
 	if (nextFrame) {
-		NOTICE_LOG(SYSTEM, "Recording starting...");
-		active = true;
+		NOTICE_LOG(SYSTEM, "Recording starting (%d frames)...", nextFrameCount);
 		nextFrame = false;
-		lastTextures.clear();
-		BeginRecording();
+		framesLeft = nextFrameCount;
+		displayPending = false;
+		active = BeginRecording();
 	}
 }
 
@@ -873,7 +931,7 @@ static void ExecuteMemcpyDest(u32 ptr, u32 sz) {
 
 static void ExecuteMemcpy(u32 ptr, u32 sz) {
 	if (Memory::IsVRAMAddress(execMemcpyDest)) {
-		Memory::MemcpyUnchecked(execMemcpyDest, pushbuf.data() + ptr, sz);
+		Memory::MemcpyUnchecked(execMemcpyDest, ExecBlobs().data() + ptr, sz);
 		gpu->PerformMemoryUpload(execMemcpyDest, sz);
 	}
 }
@@ -901,21 +959,49 @@ static void ExecuteDisplay(u32 ptr, u32 sz) {
 	__DisplaySetFramebuf(disp->topaddr.ptr, disp->linesize, disp->pixelFormat, 0);
 }
 
-static void ExecuteFree() {
-	execMemcpyDest = 0;
+// Drops the list after each frame, the mapped data stays around for the next one.
+static void ExecuteFreeList() {
 	if (execListBuf) {
 		userMemory.Free(execListBuf);
 		execListBuf = 0;
 	}
 	execListPos = 0;
+}
+
+static void ExecuteFree() {
+	execMemcpyDest = 0;
+	ExecuteFreeList();
 	execMapping.Reset();
 
+	if (execFile) {
+		pspFileSystem.CloseFile(execFile);
+		execFile = 0;
+	}
+	execFilename.clear();
+	execCommandIndex = 0;
+	execEnded = false;
+
 	commands.clear();
 	pushbuf.clear();
+	blobbuf.clear();
 }
 
-static bool ExecuteCommands() {
-	for (const Command &cmd : commands) {
+static bool ReadNextChunk();
+
+// Runs commands up to the end of the next recorded frame, reading chunks as needed.
+static bool ExecuteFrame() {
+	while (true) {
+		if (execCommandIndex >= commands.size()) {
+			if (execEnded || !ReadNextChunk()) {
+				// Cut off without a final display, count what we got as the last frame.
+				execEnded = true;
+				execFramesPlayed++;
+				execLoopsPlayed++;
+				break;
+			}
+		}
+
+		const Command &cmd = commands[execCommandIndex++];
 		switch (cmd.type) {
 		case CommandType::INIT:
 			ExecuteInit(cmd.ptr, cmd.sz);
@@ -966,7 +1052,15 @@ static bool ExecuteCommands() {
 
 		case CommandType::DISPLAY:
 			ExecuteDisplay(cmd.ptr, cmd.sz);
-			break;
+			// That's the end of a frame.  If it was also the last one, start over next time.
+			execFramesPlayed++;
+			if (execCommandIndex >= commands.size() && !ReadNextChunk()) {
+				execEnded = true;
+			}
+			if (execEnded) {
+				execLoopsPlayed++;
+			}
+			return true;
 
 		default:
 			ERROR_LOG(SYSTEM, "Unsupported GE dump command: %d", (int)cmd.type);
@@ -974,7 +1068,6 @@ static bool ExecuteCommands() {
 		}
 	}
 
-	ExecuteSubmitListEnd();
 	return true;
 }
 
@@ -997,44 +1090,130 @@ static bool ReadCompressed(u32 fp, void *dest, size_t sz) {
 	return real_size == sz;
 }
 
-bool RunMountedReplay(const std::string &filename) {
-	_assert_msg_(SYSTEM, !active && !nextFrame, "Cannot run replay while recording.");
+static bool ReadNextChunk() {
+	ReplayLoadTimer timer;
+	// Version 2 is a single chunk, read up front.
+	if (execVersion < 3 || !execFile) {
+		return false;
+	}
+
+	u32 header[3]{};
+	if (pspFileSystem.ReadFile(execFile, (u8 *)header, sizeof(header)) != sizeof(header)) {
+		return false;
+	}
+
+	const u32 sz = header[0];
+	const u32 bufsz = header[1];
+	const u32 blobsz = header[2];
+	commands.resize(sz);
+	pushbuf.resize(bufsz);
+	execCommandIndex = 0;
+
+	// The blob data only grows, later chunks refer back to it.
+	const size_t blobPos = blobbuf.size();
+	blobbuf.resize(blobPos + blobsz);
+
+	bool truncated = false;
+	truncated = truncated || !ReadCompressed(execFile, commands.data(), sizeof(Command) * sz);
+	if (bufsz != 0)
+		truncated = truncated || !ReadCompressed(execFile, pushbuf.data(), bufsz);
+	if (blobsz != 0)
+		truncated = truncated || !ReadCompressed(execFile, blobbuf.data() + blobPos, blobsz);
+
+	if (truncated) {
+		WARN_LOG(SYSTEM, "Truncated GE dump chunk, stopping there");
+		commands.clear();
+		return false;
+	}
+	return true;
+}
+
+static bool ExecuteOpen(const std::string &filename) {
+	ReplayLoadTimer timer;
+	ExecuteFree();
 
-	u32 fp = pspFileSystem.OpenFile(filename, FILEACCESS_READ);
+	execFile = pspFileSystem.OpenFile(filename, FILEACCESS_READ);
 	u8 header[8]{};
 	int version = 0;
-	pspFileSystem.ReadFile(fp, header, sizeof(header));
-	pspFileSystem.ReadFile(fp, (u8 *)&version, sizeof(version));
+	pspFileSystem.ReadFile(execFile, header, sizeof(header));
+	pspFileSystem.ReadFile(execFile, (u8 *)&version, sizeof(version));
 
-	if (memcmp(header, HEADER, sizeof(header)) != 0 || version != VERSION) {
+	if (memcmp(header, HEADER, sizeof(header)) != 0 || version < MIN_VERSION || version > VERSION) {
 		ERROR_LOG(SYSTEM, "Invalid GE dump or unsupported version");
-		pspFileSystem.CloseFile(fp);
+		ExecuteFree();
 		return false;
 	}
 
+	execFilename = filename;
+	execVersion = version;
+	if (version >= 3) {
+		if (!ReadNextChunk()) {
+			ERROR_LOG(SYSTEM, "Empty or truncated GE dump");
+			ExecuteFree();
+			return false;
+		}
+		return true;
+	}
+
 	u32 sz = 0;
-	pspFileSystem.ReadFile(fp, (u8 *)&sz, sizeof(sz));
+	pspFileSystem.ReadFile(execFile, (u8 *)&sz, sizeof(sz));
 	u32 bufsz = 0;
-	pspFileSystem.ReadFile(fp, (u8 *)&bufsz, sizeof(bufsz));
+	pspFileSystem.ReadFile(execFile, (u8 *)&bufsz, sizeof(bufsz));
 
 	commands.resize(sz);
 	pushbuf.resize(bufsz);
 
 	bool truncated = false;
-	truncated = truncated || !ReadCompressed(fp, commands.data(), sizeof(Command) * sz);
-	truncated = truncated || !ReadCompressed(fp, pushbuf.data(), bufsz);
+	truncated = truncated || !ReadCompressed(execFile, commands.data(), sizeof(Command) * sz);
+	truncated = truncated || !ReadCompressed(execFile, pushbuf.data(), bufsz);
 
-	pspFileSystem.CloseFile(fp);
+	pspFileSystem.CloseFile(execFile);
+	execFile = 0;
 
 	if (truncated) {
 		ERROR_LOG(SYSTEM, "Truncated GE dump");
 		ExecuteFree();
 		return false;
 	}
+	return true;
+}
 
-	bool success = ExecuteCommands();
-	ExecuteFree();
+// Plays one recorded frame per call, streaming the dump from disk, and loops at the end.
+bool RunMountedReplay(const std::string &filename) {
+	_assert_msg_(SYSTEM, !active && !nextFrame, "Cannot run replay while recording.");
+
+	if (execFilename != filename || execEnded) {
+		if (!ExecuteOpen(filename)) {
+			return false;
+		}
+	}
+
+	bool success = ExecuteFrame();
+	ExecuteSubmitListEnd();
+	ExecuteFreeList();
+	if (!success) {
+		ExecuteFree();
+	}
 	return success;
 }
 
+void GetReplayProgress(int *frames, int *loops, double *loadSeconds) {
+	*frames = execFramesPlayed;
+	*loops = execLoopsPlayed;
+	*loadSeconds = execLoadSeconds;
+}
+
+void ReplayShutdown() {
+	// The file handle and PSP memory belong to this boot, so let go of them now.
+	ExecuteFree();
+	execFramesPlayed = 0;
+	execLoopsPlayed = 0;
+	execLoadSeconds = 0.0;
+	// A streamed dump's data can be large, don't keep the capacity around either.
+	std::vector<Command>().swap(commands);
+	std::vector<u8>().swap(pushbuf);
+	std::vector<u8>().swap(blobbuf);
+	std::vector<u32_le>().swap(execListQueue);
+}
+
 };
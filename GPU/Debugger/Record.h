@@ -23,7 +23,8 @@
 namespace GPURecord {
 
 bool IsActive();
-void Activate();
+// Records the given number of frames, starting with the next one.
+void Activate(int frames = 1);
 
 void NotifyCommand(u32 pc);
 void NotifyMemcpy(u32 dest, u32 src, u32 sz);
@@ -31,6 +32,12 @@ void NotifyMemset(u32 dest, int v, u32 sz);
 void NotifyUpload(u32 dest, u32 sz);
 void NotifyFrame();
 
+// Replays the next recorded frame, starting over after the last one.
 bool RunMountedReplay(const std::string &filename);
+// Frames replayed, how many times the dump played through, and the time spent loading (not replaying)
+// dump data, since the replay started.
+void GetReplayProgress(int *frames, int *loops, double *loadSeconds);
+// Closes the dump and frees its PSP memory, called from __GeShutdown.
+void ReplayShutdown();
 
 };
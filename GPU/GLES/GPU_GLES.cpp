@@ -552,7 +552,7 @@ void GPU_GLES::DoState(PointerWrap &p) {
 	// TODO: Some of these things may not be necessary.
 	// None of these are necessary when saving.
 	// In Freeze-Frame mode, we don't want to do any of this.
-	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen) {
+	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen && !PSP_CoreParameter().keepCachesOnLoad) {
 		textureCacheGL_->Clear(true);
 		drawEngine_.ClearTrackedVertexArrays();
 
@@ -45,6 +45,14 @@
 #endif
 
 GPUStatistics gpuStats;
+bool gpuCollectTimings = false;
+GPUTimingStats gpuTimings;
+
+GPUTimingScope::GPUTimingScope(double *seconds) : seconds_(gpuCollectTimings ? seconds : nullptr), start_(0.0) {
+	if (seconds_)
+		start_ = real_time_now();
+}
+
 GPUInterface *gpu;
 GPUDebugInterface *gpuDebug;
 
@@ -18,8 +18,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <cstring>
 
+#include "base/timeutil.h"
+
 class GPUInterface;
 class GPUDebugInterface;
 class GraphicsContext;
@@ -29,6 +32,7 @@ enum SkipDrawReasonFlags {
 	SKIPDRAW_NON_DISPLAYED_FB = 2,   // Skip drawing to FBO:s that have not been displayed.
 	SKIPDRAW_BAD_FB_TEXTURE = 4,
 	SKIPDRAW_WINDOW_MINIMIZED = 8, // Don't draw when the host window is minimized.
+	SKIPDRAW_TURBO = 16, // Along with SKIPFRAME in turbo, where framebuffers read back to memory are still drawn.
 };
 
 // Global GPU-related utility functions. 
@@ -100,7 +104,38 @@ struct GPUStatistics {
 	int numFlips;
 };
 
+// Where the time goes, per command type and in the decoders.  Only collected while
+// gpuCollectTimings is set (for benchmarking), since it costs a timer call per command.
+struct GPUTimingStats {
+	void Reset() {
+		memset(this, 0, sizeof(*this));
+	}
+
+	double commandSeconds[256];
+	uint64_t commandCount[256];
+	double textureDecodeSeconds;
+	uint64_t textureLevelsDecoded;
+	double vertexDecodeSeconds;
+	uint64_t vertsDecoded;
+};
+
+// Adds the time spent in its scope to a GPUTimingStats counter, if collecting.
+class GPUTimingScope {
+public:
+	GPUTimingScope(double *seconds);
+	~GPUTimingScope() {
+		if (seconds_)
+			*seconds_ += real_time_now() - start_;
+	}
+
+private:
+	double *seconds_;
+	double start_;
+};
+
 extern GPUStatistics gpuStats;
+extern bool gpuCollectTimings;
+extern GPUTimingStats gpuTimings;
 extern GPUInterface *gpu;
 extern GPUDebugInterface *gpuDebug;
 
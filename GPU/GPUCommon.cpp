@@ -24,11 +24,25 @@
 #include "Core/HLE/sceGe.h"
 #include "Core/Debugger/Breakpoints.h"
 #include "Core/MemMapHelpers.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 #include "GPU/Common/FramebufferCommon.h"
 #include "GPU/Common/TextureCacheCommon.h"
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Debugger/Record.h"
 
+// Shorter runs of state commands cost more to look up than to just run.
+enum { LIST_BLOCK_MIN_WORDS = 6, LIST_BLOCK_MAX_WORDS = 512, LIST_BLOCK_MAX_CHANGES = 4 };
+enum { LIST_BLOCK_DECIMATION_INTERVAL = 17, LIST_BLOCK_KILL_AGE = 120 };
+// A block whose pages keep getting written (but not changed) stops being protected after this.
+enum { LIST_BLOCK_MAX_REPROTECTS = 4 };
+// Commands that end a block.  VADDR and IADDR execute, but are folded into blocks anyway.
+static const u64 LIST_BLOCK_STOP_FLAGS = FLAG_FLUSHBEFORE | FLAG_EXECUTE | FLAG_EXECUTEONCHANGE | FLAG_READS_PC | FLAG_WRITES_PC;
+
+inline bool GPUCommon::CanStartListBlock(u32 op) {
+	const u32 cmd = op >> 24;
+	return (cmdInfo_[cmd].flags & LIST_BLOCK_STOP_FLAGS) == 0 || cmd == GE_CMD_VADDR || cmd == GE_CMD_IADDR;
+}
+
 const CommonCommandTableEntry commonCommandTable[] = {
 	// From Common. No flushing but definitely need execute.
 	{ GE_CMD_OFFSETADDR, FLAG_EXECUTE, 0, &GPUCommon::Execute_OffsetAddr },
@@ -355,6 +369,16 @@ size_t commonCommandTableSize = ARRAY_SIZE(commonCommandTable);
 // TODO: Make class member?
 GPUCommon::CommandInfo GPUCommon::cmdInfo_[256];
 
+static inline bool ShouldSkipDraw(const VirtualFramebuffer *vfb) {
+	const u32 reason = gstate_c.skipDrawReason;
+	if ((reason & (SKIPDRAW_SKIPFRAME | SKIPDRAW_NON_DISPLAYED_FB)) == 0)
+		return false;
+	// Turbo skips nearly every frame, so still draw what the game will read back into RAM.
+	if ((reason & (SKIPDRAW_TURBO | SKIPDRAW_NON_DISPLAYED_FB)) == SKIPDRAW_TURBO && vfb && (vfb->usageFlags & FB_USAGE_DOWNLOAD) != 0)
+		return false;
+	return true;
+}
+
 void GPUCommon::Flush() {
 	drawEngineCommon_->DispatchFlush();
 }
@@ -365,13 +389,15 @@ GPUCommon::GPUCommon(GraphicsContext *gfxCtx, Draw::DrawContext *draw) :
 	framebufferManager_(nullptr),
 	resized_(false),
 	gfxCtx_(gfxCtx),
-	draw_(draw)
+	draw_(draw),
+	listBlocks_(256)
 {
 	// This assert failed on GCC x86 32-bit (but not MSVC 32-bit!) before adding the
 	// "padding" field at the end. This is important for save state compatibility.
 	// The compiler was not rounding the struct size up to an 8 byte boundary, which
 	// you'd expect due to the int64 field, but the Linux ABI apparently does not require that.
 	static_assert(sizeof(DisplayList) == 456, "Bad DisplayList size");
+	memset(listBlockSkip_, 0xFF, sizeof(listBlockSkip_));
 
 	Reinitialize();
 	SetupColorConv();
@@ -408,6 +434,9 @@ GPUCommon::GPUCommon(GraphicsContext *gfxCtx, Draw::DrawContext *draw) :
 }
 
 GPUCommon::~GPUCommon() {
+	InvalidateListBlocks(0, 0);
+	for (DisplayListBlock *block : listBlockPool_)
+		delete block;
 }
 
 void GPUCommon::UpdateCmdInfo() {
@@ -418,6 +447,8 @@ void GPUCommon::UpdateCmdInfo() {
 		cmdInfo_[GE_CMD_VERTEXTYPE].flags |= FLAG_FLUSHBEFOREONCHANGE;
 		cmdInfo_[GE_CMD_VERTEXTYPE].func = &GPUCommon::Execute_VertexType;
 	}
+	// Decoded blocks depend on the flags.
+	InvalidateListBlocks(0, 0);
 }
 
 void GPUCommon::BeginHostFrame() {
@@ -432,6 +463,7 @@ void GPUCommon::EndHostFrame() {
 }
 
 void GPUCommon::Reinitialize() {
+	InvalidateListBlocks(0, 0);
 	memset(dls, 0, sizeof(dls));
 	for (int i = 0; i < DisplayListMaxCount; ++i) {
 		dls[i].state = PSP_GE_DL_STATE_NONE;
@@ -922,7 +954,7 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 
 	debugRecording_ = GPURecord::IsActive();
 	const bool useDebugger = host->GPUDebuggingActive() || debugRecording_;
-	const bool useFastRunLoop = !dumpThisFrame_ && !useDebugger;
+	const bool useFastRunLoop = !dumpThisFrame_ && !useDebugger && !gpuCollectTimings;
 	while (gpuState == GPUSTATE_RUNNING) {
 		{
 			if (list.pc == list.stall) {
@@ -971,7 +1003,23 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 	PROFILE_THIS_SCOPE("gpuloop");
 	const CommandInfo *cmdInfo = cmdInfo_;
 	int dc = downcount;
+	// Runs of state commands start after anything that executes, so that's when to look for one.
+	// Peeking at the next command first keeps back to back prims from probing the cache.
+	const bool useBlocks = g_Config.bDisplayListBlockCache;
+	bool checkBlock = useBlocks && CanStartListBlock(Memory::ReadUnchecked_U32(list.pc));
 	for (; dc > 0; --dc) {
+		if (checkBlock) {
+			checkBlock = false;
+			const DisplayListBlock *block = GetListBlock(list.pc, dc);
+			if (block) {
+				ApplyListBlock(*block);
+				const int size = (int)block->words.size();
+				list.pc += size * 4;
+				dc -= size - 1;
+				continue;
+			}
+		}
+
 		// We know that display list PCs have the upper nibble == 0 - no need to mask the pointer
 		const u32 op = Memory::ReadUnchecked_U32(list.pc);
 		const u32 cmd = op >> 24;
@@ -982,6 +1030,7 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 				downcount = dc;
 				(this->*info.func)(op, diff);
 				dc = downcount;
+				checkBlock = useBlocks && dc > 1 && CanStartListBlock(Memory::ReadUnchecked_U32(list.pc + 4));
 			}
 		} else {
 			uint64_t flags = info.flags;
@@ -995,6 +1044,7 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 				downcount = dc;
 				(this->*info.func)(op, diff);
 				dc = downcount;
+				checkBlock = useBlocks && dc > 1 && CanStartListBlock(Memory::ReadUnchecked_U32(list.pc + 4));
 			} else {
 				uint64_t dirty = flags >> 8;
 				if (dirty)
@@ -1006,7 +1056,193 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 	downcount = 0;
 }
 
+GPUCommon::DisplayListBlock *GPUCommon::GetListBlock(u32 pc, int maxWords) {
+	// Addresses known to have nothing worth decoding, so that miss doesn't need a probe.
+	u32 &skip = listBlockSkip_[(pc >> 2) & (LIST_BLOCK_SKIP_SIZE - 1)];
+	if (skip == pc)
+		return nullptr;
+
+	DisplayListBlock *block = listBlocks_.Get(pc);
+	if (block) {
+		const int size = (int)block->words.size();
+		if (size == 0) {
+			skip = pc;
+			return nullptr;
+		}
+		if (size > maxWords)
+			return nullptr;
+		if (block->validEpoch == listBlockEpoch_ || ValidateListBlock(block, pc)) {
+			block->lastFrame = gpuStats.numFlips;
+			return block;
+		}
+
+		// The list was rewritten.  If it keeps happening, stop decoding it until it ages out.
+		if (++block->changes >= LIST_BLOCK_MAX_CHANGES) {
+			block->words.clear();
+			block->ops.clear();
+			skip = pc;
+			return nullptr;
+		}
+	} else {
+		block = AllocListBlock();
+		block->changes = 0;
+		listBlocks_.Insert(pc, block);
+	}
+
+	DecodeListBlock(block, pc, maxWords);
+	block->lastFrame = gpuStats.numFlips;
+	if (block->words.empty()) {
+		skip = pc;
+		return nullptr;
+	}
+
+	const u32 bytes = (u32)block->words.size() * 4;
+	block->validEpoch = listBlockEpoch_;
+	block->reprotects = 0;
+	JitPageProtect::Protect(pc, bytes);
+	listBlocksStart_ = std::min(listBlocksStart_, pc);
+	listBlocksEnd_ = std::max(listBlocksEnd_, pc + bytes);
+	return block;
+}
+
+bool GPUCommon::ValidateListBlock(DisplayListBlock *block, u32 pc) {
+	// With write protection on, pages nothing wrote to since the last check can't have changed.
+	const u32 bytes = (u32)block->words.size() * 4;
+	if (!JitPageProtect::RangeUnwritten(pc, bytes)) {
+		if (memcmp(Memory::GetPointerUnchecked(pc), block->words.data(), bytes) != 0)
+			return false;
+		if (block->reprotects < LIST_BLOCK_MAX_REPROTECTS) {
+			block->reprotects++;
+			JitPageProtect::Protect(pc, bytes);
+		}
+	}
+	block->validEpoch = listBlockEpoch_;
+	return true;
+}
+
+GPUCommon::DisplayListBlock *GPUCommon::AllocListBlock() {
+	if (listBlockPool_.empty())
+		return new DisplayListBlock();
+	DisplayListBlock *block = listBlockPool_.back();
+	listBlockPool_.pop_back();
+	return block;
+}
+
+void GPUCommon::FreeListBlock(DisplayListBlock *block) {
+	listBlockPool_.push_back(block);
+}
+
+void GPUCommon::DecodeListBlock(DisplayListBlock *block, u32 pc, int maxWords) {
+	block->words.clear();
+	block->ops.clear();
+	block->vaddr = 0;
+	block->iaddr = 0;
+
+	// Where each command is in ops, so repeats just update the value.
+	s16 slot[256];
+	memset(slot, -1, sizeof(slot));
+
+	const int limit = std::min(maxWords, (int)LIST_BLOCK_MAX_WORDS);
+	for (int i = 0; i < limit && Memory::IsValidAddress(pc + i * 4); ++i) {
+		const u32 op = Memory::ReadUnchecked_U32(pc + i * 4);
+		const u32 cmd = op >> 24;
+		u64 flags = cmdInfo_[cmd].flags;
+		if (cmd == GE_CMD_VADDR || cmd == GE_CMD_IADDR) {
+			// These only set an address, so only the last one matters.
+			flags = 0;
+			if (cmd == GE_CMD_VADDR)
+				block->vaddr = op;
+			else
+				block->iaddr = op;
+		} else if (flags & LIST_BLOCK_STOP_FLAGS) {
+			break;
+		} else if (cmd == GE_CMD_BASE && (block->vaddr != 0 || block->iaddr != 0)) {
+			// The addresses have to use the BASE from when they were set.
+			break;
+		}
+
+		block->words.push_back(op);
+		if (slot[cmd] < 0) {
+			slot[cmd] = (s16)block->ops.size();
+			block->ops.push_back({ op, flags });
+		} else {
+			block->ops[slot[cmd]].op = op;
+		}
+	}
+
+	if (block->words.size() < LIST_BLOCK_MIN_WORDS) {
+		block->words.clear();
+		block->ops.clear();
+	}
+}
+
+void GPUCommon::ApplyListBlock(const DisplayListBlock &block) {
+	// Same as running the commands one by one.  A command changed and then changed back
+	// doesn't need a flush or dirty anything, since nothing can draw in between.
+	u64 dirty = 0;
+	for (const DisplayListBlock::Op &op : block.ops) {
+		const u32 cmd = op.op >> 24;
+		if (gstate.cmdmem[cmd] == op.op)
+			continue;
+		if ((op.flags & FLAG_FLUSHBEFOREONCHANGE) && drawEngineCommon_->GetNumDrawCalls())
+			drawEngineCommon_->DispatchFlush();
+		gstate.cmdmem[cmd] = op.op;
+		dirty |= op.flags >> 8;
+	}
+	if (dirty)
+		gstate_c.Dirty(dirty);
+
+	if (block.vaddr != 0)
+		gstate_c.vertexAddr = gstate_c.getRelativeAddress(block.vaddr & 0x00FFFFFF);
+	if (block.iaddr != 0)
+		gstate_c.indexAddr = gstate_c.getRelativeAddress(block.iaddr & 0x00FFFFFF);
+}
+
+void GPUCommon::InvalidateListBlocks(u32 addr, int size) {
+	if (size <= 0)
+		memset(listBlockSkip_, 0xFF, sizeof(listBlockSkip_));
+	if (listBlocks_.size() == 0)
+		return;
+	// Blocks are always looked up by the plain address.
+	addr &= 0x0FFFFFFF;
+	if (size > 0 && (addr >= listBlocksEnd_ || addr + size <= listBlocksStart_))
+		return;
+
+	listBlocks_.Iterate([&](u32 pc, DisplayListBlock *block) {
+		const u32 end = pc + std::max((u32)block->words.size(), 1U) * 4;
+		if (size <= 0 || (pc < addr + size && end > addr)) {
+			FreeListBlock(block);
+			listBlocks_.Remove(pc);
+		}
+	});
+	listBlocks_.Maintain();
+	if (listBlocks_.size() == 0) {
+		listBlocksStart_ = 0xFFFFFFFF;
+		listBlocksEnd_ = 0;
+	}
+}
+
+void GPUCommon::DecimateListBlocks() {
+	if (--listBlockDecimationCounter_ <= 0) {
+		listBlockDecimationCounter_ = LIST_BLOCK_DECIMATION_INTERVAL;
+	} else {
+		return;
+	}
+
+	// This also retries the ones that weren't worth decoding last time.
+	memset(listBlockSkip_, 0xFF, sizeof(listBlockSkip_));
+	const int threshold = gpuStats.numFlips - LIST_BLOCK_KILL_AGE;
+	listBlocks_.Iterate([&](u32 pc, DisplayListBlock *block) {
+		if (block->lastFrame < threshold) {
+			FreeListBlock(block);
+			listBlocks_.Remove(pc);
+		}
+	});
+	listBlocks_.Maintain();
+}
+
 void GPUCommon::BeginFrame() {
+	DecimateListBlocks();
 	immCount_ = 0;
 	if (dumpNextFrame_) {
 		NOTICE_LOG(G3D, "DUMPING THIS FRAME");
@@ -1043,7 +1279,14 @@ void GPUCommon::SlowRunLoop(DisplayList &list)
 		}
 		gstate.cmdmem[cmd] = op;
 
-		ExecuteOp(op, diff);
+		if (gpuCollectTimings) {
+			double start = real_time_now();
+			ExecuteOp(op, diff);
+			gpuTimings.commandSeconds[cmd] += real_time_now() - start;
+			gpuTimings.commandCount[cmd]++;
+		} else {
+			ExecuteOp(op, diff);
+		}
 
 		list.pc += 4;
 		--downcount;
@@ -1112,6 +1355,8 @@ int GPUCommon::GetNextListIndex() {
 void GPUCommon::ProcessDLQueue() {
 	startingTicks = CoreTiming::GetTicks();
 	cyclesExecuted = 0;
+	// The CPU may have rewritten lists since the last time, so blocks need checking again.
+	listBlockEpoch_++;
 
 	// Seems to be correct behaviour to process the list anyway?
 	if (startingTicks < busyTicks) {
@@ -1489,9 +1734,9 @@ void GPUCommon::Execute_Prim(u32 op, u32 diff) {
 	}
 
 	// This also makes skipping drawing very effective.
-	framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
+	VirtualFramebuffer *vfb = framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
 
-	if (gstate_c.skipDrawReason & (SKIPDRAW_SKIPFRAME | SKIPDRAW_NON_DISPLAYED_FB)) {
+	if (ShouldSkipDraw(vfb)) {
 		// Rough estimate, not sure what's correct.
 		cyclesExecuted += EstimatePerVertexCost() * count;
 		if (gstate.isModeClear()) {
@@ -1667,8 +1912,8 @@ void GPUCommon::Execute_Bezier(u32 op, u32 diff) {
 	gstate_c.Dirty(DIRTY_UVSCALEOFFSET);
 
 	// This also make skipping drawing very effective.
-	framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
-	if (gstate_c.skipDrawReason & (SKIPDRAW_SKIPFRAME | SKIPDRAW_NON_DISPLAYED_FB)) {
+	VirtualFramebuffer *vfb = framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
+	if (ShouldSkipDraw(vfb)) {
 		// TODO: Should this eat some cycles?  Probably yes.  Not sure if important.
 		return;
 	}
@@ -1729,8 +1974,8 @@ void GPUCommon::Execute_Spline(u32 op, u32 diff) {
 	gstate_c.Dirty(DIRTY_UVSCALEOFFSET);
 
 	// This also make skipping drawing very effective.
-	framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
-	if (gstate_c.skipDrawReason & (SKIPDRAW_SKIPFRAME | SKIPDRAW_NON_DISPLAYED_FB)) {
+	VirtualFramebuffer *vfb = framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
+	if (ShouldSkipDraw(vfb)) {
 		// TODO: Should this eat some cycles?  Probably yes.  Not sure if important.
 		return;
 	}
@@ -2139,8 +2384,8 @@ void GPUCommon::Execute_ImmVertexAlphaPrim(u32 op, u32 diff) {
 
 void GPUCommon::FlushImm() {
 	SetDrawType(DRAW_PRIM, immPrim_);
-	framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
-	if (gstate_c.skipDrawReason & (SKIPDRAW_SKIPFRAME | SKIPDRAW_NON_DISPLAYED_FB)) {
+	VirtualFramebuffer *vfb = framebufferManager_->SetRenderFrameBuffer(gstate_c.IsDirty(DIRTY_FRAMEBUF), gstate_c.skipDrawReason);
+	if (ShouldSkipDraw(vfb)) {
 		// No idea how many cycles to skip, heh.
 		return;
 	}
@@ -2574,6 +2819,8 @@ void GPUCommon::DoBlockTransfer(u32 skipDrawReason) {
 		textureCache_->Invalidate(dstBasePtr + (dstY * dstStride + dstX) * bpp, height * dstStride * bpp, GPU_INVALIDATE_HINT);
 		framebufferManager_->NotifyBlockTransferAfter(dstBasePtr, dstStride, dstX, dstY, srcBasePtr, srcStride, srcX, srcY, width, height, bpp, skipDrawReason);
 	}
+	// Blocks already checked in this run aren't checked again, so a transfer over a list has to drop them.
+	InvalidateListBlocks(dstBasePtr + (dstY * dstStride + dstX) * bpp, height * dstStride * bpp);
 
 #ifndef MOBILE_DEVICE
 	CBreakPoints::ExecMemCheck(srcBasePtr + (srcY * srcStride + srcX) * bpp, false, height * srcStride * bpp, currentMIPS->pc);
@@ -2639,6 +2886,7 @@ bool GPUCommon::PerformMemoryUpload(u32 dest, int size) {
 }
 
 void GPUCommon::InvalidateCache(u32 addr, int size, GPUInvalidationType type) {
+	InvalidateListBlocks(addr, size);
 	if (size > 0)
 		textureCache_->Invalidate(addr, size, type);
 	else
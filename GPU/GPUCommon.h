@@ -1,6 +1,9 @@
 #pragma once
 
+#include <vector>
+
 #include "Common/Common.h"
+#include "Common/Hashmaps.h"
 #include "Common/MemoryUtil.h"
 #include "GPU/GPUInterface.h"
 #include "GPU/GPUState.h"
@@ -354,10 +357,53 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	std::string reportingFullInfo_;
 
 private:
+	// A run of plain state commands (and VADDR/IADDR) in a display list, decoded once.
+	// Games resubmit most of these unchanged every frame, so this skips the per-command dispatch.
+	struct DisplayListBlock {
+		struct Op {
+			u32 op;
+			u64 flags;
+		};
+		// What was in memory, checked once per ProcessDLQueue().  Empty if not worth decoding.
+		std::vector<u32> words;
+		// The last value of each command in the run, in order of first appearance.
+		std::vector<Op> ops;
+		u32 vaddr;
+		u32 iaddr;
+		int lastFrame;
+		int changes;
+		int reprotects;
+		// The listBlockEpoch_ it was last checked against memory in.
+		u32 validEpoch;
+	};
+
+	DisplayListBlock *GetListBlock(u32 pc, int maxWords);
+	bool ValidateListBlock(DisplayListBlock *block, u32 pc);
+	static bool CanStartListBlock(u32 op);
+	DisplayListBlock *AllocListBlock();
+	void FreeListBlock(DisplayListBlock *block);
+	void DecodeListBlock(DisplayListBlock *block, u32 pc, int maxWords);
+	void ApplyListBlock(const DisplayListBlock &block);
+	void InvalidateListBlocks(u32 addr, int size);
+	void DecimateListBlocks();
+
 	void FlushImm();
 	// Debug stats.
 	double timeSteppingStarted_;
 	double timeSpentStepping_;
+
+	DenseHashMap<u32, DisplayListBlock *, nullptr> listBlocks_;
+	// Freed blocks, reused (vectors and all) so new list addresses don't allocate.
+	std::vector<DisplayListBlock *> listBlockPool_;
+	// Bounds of everything in listBlocks_, to skip most invalidations quickly.
+	u32 listBlocksStart_ = 0xFFFFFFFF;
+	u32 listBlocksEnd_ = 0;
+	int listBlockDecimationCounter_ = 0;
+	// Bumped whenever the CPU may have run, since CPU writes to lists aren't seen otherwise.
+	u32 listBlockEpoch_ = 1;
+	enum { LIST_BLOCK_SKIP_SIZE = 256 };
+	// Direct mapped by address, pcs whose block is empty.  0xFFFFFFFF is never a list address.
+	u32 listBlockSkip_[LIST_BLOCK_SKIP_SIZE];
 };
 
 struct CommonCommandTableEntry {
@@ -321,7 +321,7 @@ void GPU_GX2::DoState(PointerWrap &p) {
 
 	// TODO: Some of these things may not be necessary.
 	// None of these are necessary when saving.
-	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen) {
+	if (p.mode == p.MODE_READ && !PSP_CoreParameter().frozen && !PSP_CoreParameter().keepCachesOnLoad) {
 		textureCacheGX2_->Clear(true);
 		drawEngine_.ClearTrackedVertexArrays();
 
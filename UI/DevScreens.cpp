@@ -37,6 +37,7 @@
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "GPU/GPUInterface.h"
 #include "GPU/GPUState.h"
+#include "GPU/Debugger/Record.h"
 #include "UI/MiscScreens.h"
 #include "UI/DevScreens.h"
 #include "UI/GameSettingsScreen.h"
@@ -74,6 +75,7 @@ void DevMenu::CreatePopupContents(UI::ViewGroup *parent) {
 	items->Add(new CheckBox(&g_Config.bShowAllocatorDebug, dev->T("Allocator Viewer")));
 	items->Add(new Choice(dev->T("Toggle Freeze")))->OnClick.Handle(this, &DevMenu::OnFreezeFrame);
 	items->Add(new Choice(dev->T("Dump Frame GPU Commands")))->OnClick.Handle(this, &DevMenu::OnDumpFrame);
+	items->Add(new Choice(dev->T("Record GE Dump")))->OnClick.Handle(this, &DevMenu::OnRecordGEDump);
 	items->Add(new Choice(dev->T("Toggle Audio Debug")))->OnClick.Handle(this, &DevMenu::OnToggleAudioDebug);
 #ifdef USE_PROFILER
 	items->Add(new CheckBox(&g_Config.bShowFrameProfiler, dev->T("Frame Profiler"), ""));
@@ -141,6 +143,12 @@ UI::EventReturn DevMenu::OnDumpFrame(UI::EventParams &e) {
 	return UI::EVENT_DONE;
 }
 
+UI::EventReturn DevMenu::OnRecordGEDump(UI::EventParams &e) {
+	// The frame count is set in Developer Tools.
+	GPURecord::Activate(g_Config.iGEDumpFrames);
+	return UI::EVENT_DONE;
+}
+
 void DevMenu::dialogFinished(const Screen *dialog, DialogResult result) {
 	UpdateUIState(UISTATE_INGAME);
 	// Close when a subscreen got closed.
@@ -746,7 +754,7 @@ void JitCompareScreen::UpdateDisasm() {
 	int numMips = leftDisasm_->GetNumSubviews();
 	int numHost = rightDisasm_->GetNumSubviews();
 
-	snprintf(temp, sizeof(temp), "%d to %d : %d%%", numMips, numHost, 100 * numHost / numMips);
+	snprintf(temp, sizeof(temp), "%d to %d : %d%%, %d spills, %d reloads", numMips, numHost, 100 * numHost / numMips, debugInfo.spillCount, debugInfo.reloadCount);
 	blockStats_->SetText(temp);
 }
 
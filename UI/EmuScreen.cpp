@@ -1077,12 +1077,14 @@ static void DrawAudioDebugStats(DrawBuffer *draw2d) {
 	const AudioDebugStats *stats = __AudioGetDebugStats();
 	snprintf(statbuf, sizeof(statbuf),
 		"Audio buffer: %d/%d (low watermark: %d)\n"
-		"Underruns: %d\n"
+		"Buffered min/max: %d/%d\n"
+		"Underruns: %d (%d frames)\n"
 		"Overruns: %d\n"
 		"Sample rate: %d\n"
 		"Push size: %d\n",
 		stats->buffered, stats->bufsize, stats->watermark,
-		stats->underrunCount,
+		stats->minBuffered, stats->maxBuffered,
+		stats->underrunCount, stats->underrunFrames,
 		stats->overrunCount,
 		stats->instantSampleRate,
 		stats->lastPushSize);
@@ -1096,15 +1098,20 @@ static void DrawFPS(DrawBuffer *draw2d, const Bounds &bounds) {
 	float vps, fps, actual_fps;
 	__DisplayGetFPS(&vps, &fps, &actual_fps);
 	char fpsbuf[256];
-	switch (g_Config.iShowFPSCounter) {
-	case 1:
-		snprintf(fpsbuf, sizeof(fpsbuf), "Speed: %0.1f%%", vps / (59.94f / 100.0f)); break;
-	case 2:
-		snprintf(fpsbuf, sizeof(fpsbuf), "FPS: %0.1f", actual_fps); break;
-	case 3:
-		snprintf(fpsbuf, sizeof(fpsbuf), "%0.0f/%0.0f (%0.1f%%)", actual_fps, fps, vps / (59.94f / 100.0f)); break;
-	default:
-		return;
+	if (__DisplayIsTurbo()) {
+		// flips is per 60 emulated vblanks, so scale it by how fast those are going by.
+		snprintf(fpsbuf, sizeof(fpsbuf), "Turbo: %0.0f fps (%0.1fx)", fps * vps / 60.0f, vps / 59.94f);
+	} else {
+		switch (g_Config.iShowFPSCounter) {
+		case 1:
+			snprintf(fpsbuf, sizeof(fpsbuf), "Speed: %0.1f%%", vps / (59.94f / 100.0f)); break;
+		case 2:
+			snprintf(fpsbuf, sizeof(fpsbuf), "FPS: %0.1f", actual_fps); break;
+		case 3:
+			snprintf(fpsbuf, sizeof(fpsbuf), "%0.0f/%0.0f (%0.1f%%)", actual_fps, fps, vps / (59.94f / 100.0f)); break;
+		default:
+			return;
+		}
 	}
 
 	draw2d->SetFontScale(0.7f, 0.7f);
@@ -1154,6 +1161,12 @@ void EmuScreen::postRender() {
 	draw->EndFrame();
 }
 
+static void RunUntilNextFrame(int blockTicks) {
+	while (coreState == CORE_RUNNING) {
+		PSP_RunLoopFor(blockTicks);
+	}
+}
+
 void EmuScreen::render() {
 	using namespace Draw;
 
@@ -1192,8 +1205,27 @@ void EmuScreen::render() {
 	int blockTicks = usToCycles(1000000 / 10);
 
 	// Run until CORE_NEXTFRAME
-	while (coreState == CORE_RUNNING) {
-		PSP_RunLoopFor(blockTicks);
+	const int runAheadFrames = PSP_CoreParameter().frozen ? 0 : g_Config.iRunAheadFrames;
+	if (runAheadFrames > 0 && coreState == CORE_RUNNING) {
+		// The real frame is timed and heard, but not drawn.  Then the frames after it are run from a
+		// snapshot, silently and drawing only the last, and thrown away.  Input shows up that much sooner.
+		__DisplaySetSpeculative(false, false);
+		RunUntilNextFrame(blockTicks);
+		if (coreState == CORE_NEXTFRAME && SaveState::SaveRunAhead()) {
+			__AudioSetSpeculative(true);
+			for (int i = 0; i < runAheadFrames && coreState == CORE_NEXTFRAME; ++i) {
+				coreState = CORE_RUNNING;
+				__DisplaySetSpeculative(true, i == runAheadFrames - 1);
+				RunUntilNextFrame(blockTicks);
+			}
+			__AudioSetSpeculative(false);
+			__DisplaySetSpeculative(false, true);
+			SaveState::RestoreRunAhead();
+		} else {
+			__DisplaySetSpeculative(false, true);
+		}
+	} else {
+		RunUntilNextFrame(blockTicks);
 	}
 
 	// Hopefully coreState is now CORE_NEXTFRAME
@@ -1217,7 +1249,7 @@ void EmuScreen::render() {
 
 	const bool hasVisibleUI = !osm.IsEmpty() || saveStatePreview_->GetVisibility() != UI::V_GONE || g_Config.bShowTouchControls || loadingSpinner_->GetVisibility() == UI::V_VISIBLE;
 	const bool showDebugUI = g_Config.bShowDebugStats || g_Config.bShowDeveloperMenu || g_Config.bShowAudioDebug || g_Config.bShowFrameProfiler;
-	if (hasVisibleUI || showDebugUI || g_Config.iShowFPSCounter != 0) {
+	if (hasVisibleUI || showDebugUI || g_Config.iShowFPSCounter != 0 || __DisplayIsTurbo()) {
 		renderUI();
 	}
 
@@ -1271,7 +1303,7 @@ void EmuScreen::renderUI() {
 		DrawAudioDebugStats(draw2d);
 	}
 
-	if (g_Config.iShowFPSCounter && !invalid_) {
+	if ((g_Config.iShowFPSCounter || __DisplayIsTurbo()) && !invalid_) {
 		DrawFPS(draw2d, ctx->GetBounds());
 	}
 
@@ -253,6 +253,9 @@ void GameSettingsScreen::CreateViews() {
 	PopupSliderChoice *altSpeed = graphicsSettings->Add(new PopupSliderChoice(&iAlternateSpeedPercent_, 0, 1000, gr->T("Alternative Speed", "Alternative speed"), 5, screenManager(), gr->T("%, 0:unlimited")));
 	altSpeed->SetFormat("%i%%");
 	altSpeed->SetZeroLabel(gr->T("Unlimited"));
+	graphicsSettings->Add(new CheckBox(&g_Config.bTurboUnthrottle, gr->T("Turbo when unthrottled", "Turbo when unthrottled (skips most rendering and audio)")));
+	PopupSliderChoice *turboInterval = graphicsSettings->Add(new PopupSliderChoice(&g_Config.iTurboRenderInterval, 1, 30, gr->T("Turbo render interval", "Turbo: render one frame in"), screenManager(), gr->T("frames")));
+	turboInterval->SetEnabledPtr(&g_Config.bTurboUnthrottle);
 
 	graphicsSettings->Add(new ItemHeader(gr->T("Features")));
 	// Hide postprocess option on unsupported backends to avoid confusion.
@@ -337,6 +340,13 @@ void GameSettingsScreen::CreateViews() {
 	});
 	texSecondary_->SetDisabledPtr(&g_Config.bSoftwareRendering);
 
+	CheckBox *listBlockCache = graphicsSettings->Add(new CheckBox(&g_Config.bDisplayListBlockCache, gr->T("Cache display list state", "Cache display list state (experimental)")));
+	listBlockCache->OnClick.Add([=](EventParams &e) {
+		settingInfo_->Show(gr->T("DisplayListBlockCache Tip", "Skips re-reading state commands games send unchanged every frame"), e.v);
+		return UI::EVENT_CONTINUE;
+	});
+	listBlockCache->SetDisabledPtr(&g_Config.bSoftwareRendering);
+
 	CheckBox *framebufferSlowEffects = graphicsSettings->Add(new CheckBox(&g_Config.bDisableSlowFramebufEffects, gr->T("Disable slower effects (speedup)")));
 	framebufferSlowEffects->SetDisabledPtr(&g_Config.bSoftwareRendering);
 
@@ -489,6 +499,8 @@ void GameSettingsScreen::CreateViews() {
 		CheckBox *resampling = audioSettings->Add(new CheckBox(&g_Config.bAudioResampler, a->T("Audio sync", "Audio sync (resampling)")));
 		resampling->SetEnabledPtr(&g_Config.bEnableSound);
 	}
+	CheckBox *sinc = audioSettings->Add(new CheckBox(&g_Config.bSincResampler, a->T("High quality resampling")));
+	sinc->SetEnabledPtr(&g_Config.bEnableSound);
 
 	audioSettings->Add(new ItemHeader(a->T("Audio hacks")));
 	audioSettings->Add(new CheckBox(&g_Config.bSoundSpeedHack, a->T("Sound speed hack (DOA etc.)")));
@@ -670,6 +682,8 @@ void GameSettingsScreen::CreateViews() {
 	lockedMhz->SetZeroLabel(sy->T("Auto"));
 	PopupSliderChoice *rewindFreq = systemSettings->Add(new PopupSliderChoice(&g_Config.iRewindFlipFrequency, 0, 1800, sy->T("Rewind Snapshot Frequency", "Rewind Snapshot Frequency (mem hog)"), screenManager(), sy->T("frames, 0:off")));
 	rewindFreq->SetZeroLabel(sy->T("Off"));
+	PopupSliderChoice *runAhead = systemSettings->Add(new PopupSliderChoice(&g_Config.iRunAheadFrames, 0, 4, sy->T("Run-ahead", "Run-ahead (less input lag, slower)"), screenManager(), sy->T("frames, 0:off")));
+	runAhead->SetZeroLabel(sy->T("Off"));
 
 	systemSettings->Add(new CheckBox(&g_Config.bMemStickInserted, sy->T("Memory Stick inserted")));
 
@@ -1239,6 +1253,7 @@ void DeveloperToolsScreen::CreateViews() {
 	list->Add(new CheckBox(&g_Config.bEnableLogging, dev->T("Enable Logging")))->OnClick.Handle(this, &DeveloperToolsScreen::OnLoggingChanged);
 	list->Add(new CheckBox(&g_Config.bLogFrameDrops, dev->T("Log Dropped Frame Statistics")));
 	list->Add(new Choice(dev->T("Logging Channels")))->OnClick.Handle(this, &DeveloperToolsScreen::OnLogConfig);
+	list->Add(new PopupSliderChoice(&g_Config.iGEDumpFrames, 1, 600, dev->T("GE dump frames", "Frames to record in GE dumps"), screenManager(), dev->T("frames")));
 	list->Add(new ItemHeader(dev->T("Language")));
 	list->Add(new Choice(dev->T("Load language ini")))->OnClick.Handle(this, &DeveloperToolsScreen::OnLoadLanguageIni);
 	list->Add(new Choice(dev->T("Save language ini")))->OnClick.Handle(this, &DeveloperToolsScreen::OnSaveLanguageIni);
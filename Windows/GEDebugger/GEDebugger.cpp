@@ -781,7 +781,13 @@ BOOL CGEDebugger::DlgProc(UINT message, WPARAM wParam, LPARAM lParam) {
 			break;
 
 		case IDC_GEDBG_RECORD:
-			GPURecord::Activate();
+			{
+				std::string frames;
+				if (InputBox_GetString(GetModuleHandle(NULL), m_hDlg, L"Frames to record", std::to_string(g_Config.iGEDumpFrames), frames) && atoi(frames.c_str()) > 0) {
+					g_Config.iGEDumpFrames = atoi(frames.c_str());
+					GPURecord::Activate(g_Config.iGEDumpFrames);
+				}
+			}
 			break;
 
 		case IDC_GEDBG_FORCEOPAQUE:
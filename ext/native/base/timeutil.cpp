@@ -11,6 +11,7 @@
 #include <unistd.h>
 #else
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #endif
 
@@ -48,6 +49,17 @@ uint64_t _frequency = 0;
 uint64_t _starttime = 0;
 
 double real_time_now() {
+#ifdef CLOCK_MONOTONIC
+	// Unlike gettimeofday(), this doesn't jump when the wall clock is set.
+	static time_t start;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	if (start == 0) {
+		start = ts.tv_sec;
+	}
+	ts.tv_sec -= start;
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#else
 	static time_t start;
 	struct timeval tv;
 	gettimeofday(&tv, NULL);
@@ -56,6 +68,7 @@ double real_time_now() {
 	}
 	tv.tv_sec -= start;
 	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+#endif
 }
 
 #endif
@@ -17,7 +17,8 @@ void JsonWriter::end() {
 }
 
 const char *JsonWriter::indent(int n) const {
-	static const char * const whitespace = "															";
+	// indent(n) returns the last n of these, so it must be 32 characters long.
+	static const char * const whitespace = "                                ";
 	return whitespace + (32 - n);
 }
 
@@ -79,6 +80,11 @@ void JsonWriter::writeInt(const char *name, int value) {
 	stack_.back().first = false;
 }
 
+void JsonWriter::writeUint64(const char *name, uint64_t value) {
+	str_ << comma() << "\n" << indent() << "\"" << name << "\": " << value;
+	stack_.back().first = false;
+}
+
 void JsonWriter::writeFloat(double value) {
 	str_ << arrayComma() << arrayIndent() << value;
 	stack_.back().first = false;
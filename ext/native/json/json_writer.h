@@ -10,6 +10,7 @@
 // Zero dependencies apart from stdlib.
 // See json_writer_test.cpp for usage.
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -27,6 +28,8 @@ class JsonWriter {
 	void writeBool(const char *name, bool value);
 	void writeInt(int value);
 	void writeInt(const char *name, int value);
+	// For counters that can pass 2^31.
+	void writeUint64(const char *name, uint64_t value);
 	void writeFloat(double value);
 	void writeFloat(const char *name, double value);
 	void writeString(const char *value);
@@ -0,0 +1,400 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <signal.h>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/resource.h>
+#endif
+
+#include "base/timeutil.h"
+#include "Core/Core.h"
+#include "Core/System.h"
+#include "Core/HLE/proAdhocServer.h"
+
+#include "headless/AdhocServerBench.h"
+
+#ifdef _WIN32
+#define poll WSAPoll
+#endif
+
+// Members of a group chat with each other once joined.
+static const int BENCH_GROUP_SIZE = 4;
+static const int BENCH_CHAT_ROUNDS = 10;
+static const double BENCH_PHASE_TIMEOUT = 10.0;
+
+struct BenchClient {
+	int fd;
+	bool connected;
+	bool joined;
+	double joinSent;
+	uint8_t rx[4096];
+	size_t rxpos;
+};
+
+static void InterruptServer(int sig) {
+	adhocServerRunning = false;
+}
+
+int RunAdhocServer(int port) {
+	if (port <= 0)
+		port = SERVER_PORT;
+	// Nothing is emulated, but the server idles while the core looks paused.
+	coreState = CORE_RUNNING;
+	__AdhocServerInit();
+	signal(SIGINT, &InterruptServer);
+	signal(SIGTERM, &InterruptServer);
+	return proAdhocServerThread(port);
+}
+
+static void RaiseFileLimit(int wanted) {
+#ifndef _WIN32
+	rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)wanted) {
+		limit.rlim_cur = std::min((rlim_t)wanted, limit.rlim_max);
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+#endif
+}
+
+static double Percentile(std::vector<double> &samples, double p) {
+	if (samples.empty())
+		return 0.0;
+	size_t index = std::min(samples.size() - 1, (size_t)(p * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+static void PrintLatency(const char *name, std::vector<double> &samples) {
+	if (samples.empty()) {
+		printf("%s: no samples\n", name);
+		return;
+	}
+	double maxSample = *std::max_element(samples.begin(), samples.end());
+	double p50 = Percentile(samples, 0.50);
+	double p95 = Percentile(samples, 0.95);
+	double p99 = Percentile(samples, 0.99);
+	printf("%s: %d samples, p50 %0.3f ms, p95 %0.3f ms, p99 %0.3f ms, max %0.3f ms\n", name, (int)samples.size(), p50 * 1000.0, p95 * 1000.0, p99 * 1000.0, maxSample * 1000.0);
+}
+
+static size_t PacketSize(uint8_t opcode) {
+	switch (opcode) {
+	case OPCODE_PING:
+	case OPCODE_SCAN_COMPLETE:
+		return 1;
+	case OPCODE_CONNECT:
+		return sizeof(SceNetAdhocctlConnectPacketS2C);
+	case OPCODE_DISCONNECT:
+		return sizeof(SceNetAdhocctlDisconnectPacketS2C);
+	case OPCODE_SCAN:
+		return sizeof(SceNetAdhocctlScanPacketS2C);
+	case OPCODE_CONNECT_BSSID:
+		return sizeof(SceNetAdhocctlConnectBSSIDPacketS2C);
+	case OPCODE_CHAT:
+		return sizeof(SceNetAdhocctlChatPacketS2C);
+	default:
+		return 0;
+	}
+}
+
+class AdhocLoadGenerator {
+public:
+	AdhocLoadGenerator(int clients, int port) : port_(port), chatRound_(-1), chatsReceived_(0), errors_(0) {
+		clients_.resize(clients);
+		chatSent_.resize((clients + BENCH_GROUP_SIZE - 1) / BENCH_GROUP_SIZE);
+	}
+
+	~AdhocLoadGenerator() {
+		for (BenchClient &c : clients_) {
+			if (c.fd != -1)
+				closesocket(c.fd);
+		}
+	}
+
+	bool Connect();
+	bool Login();
+	bool Join();
+	bool Chat();
+
+	void Report(double connectSeconds);
+
+private:
+	void Send(BenchClient &c, const void *data, size_t size);
+	// Polls everything once, returns false on error.
+	bool Pump(int timeoutMs);
+	void HandlePacket(int index, const uint8_t *packet);
+	int CountJoined() const;
+
+	int port_;
+	std::vector<BenchClient> clients_;
+	std::vector<pollfd> fds_;
+	std::vector<double> chatSent_;
+	int chatRound_;
+	int chatsReceived_;
+	int errors_;
+	std::vector<double> joinLatency_;
+	std::vector<double> chatLatency_;
+};
+
+bool AdhocLoadGenerator::Connect() {
+	fds_.resize(clients_.size());
+	for (size_t i = 0; i < clients_.size(); ++i) {
+		BenchClient &c = clients_[i];
+		memset(&c, 0, sizeof(c));
+		c.fd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (c.fd == -1) {
+			fprintf(stderr, "Unable to create socket %d, raise the file limit?\n", (int)i);
+			return false;
+		}
+		changeBlockingMode(c.fd, 1);
+
+		// The server only allows one user per IP, so spread out over 127.1.0.0/16 and up.
+		sockaddr_in local{};
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(0x7F010000 + (uint32_t)i + 1);
+		if (bind(c.fd, (sockaddr *)&local, sizeof(local)) == -1) {
+			fprintf(stderr, "Unable to bind a loopback address for client %d\n", (int)i);
+			return false;
+		}
+
+		sockaddr_in remote{};
+		remote.sin_family = AF_INET;
+		remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		remote.sin_port = htons((uint16_t)port_);
+		connect(c.fd, (sockaddr *)&remote, sizeof(remote));
+
+		fds_[i].fd = c.fd;
+		fds_[i].events = POLLOUT;
+	}
+
+	double deadline = real_time_now() + BENCH_PHASE_TIMEOUT;
+	size_t connected = 0;
+	while (connected < clients_.size() && real_time_now() < deadline) {
+		if (poll(&fds_[0], (unsigned long)fds_.size(), 100) <= 0)
+			continue;
+		for (size_t i = 0; i < fds_.size(); ++i) {
+			if (clients_[i].connected || fds_[i].revents == 0)
+				continue;
+			if (fds_[i].revents & (POLLERR | POLLHUP)) {
+				fprintf(stderr, "Client %d failed to connect\n", (int)i);
+				return false;
+			}
+			clients_[i].connected = true;
+			fds_[i].events = POLLIN;
+			connected++;
+		}
+	}
+	return connected == clients_.size();
+}
+
+void AdhocLoadGenerator::Send(BenchClient &c, const void *data, size_t size) {
+	// Tiny packets, the socket buffer won't be full.
+	if (send(c.fd, (const char *)data, (int)size, 0) != (int)size)
+		errors_++;
+}
+
+bool AdhocLoadGenerator::Login() {
+	for (size_t i = 0; i < clients_.size(); ++i) {
+		SceNetAdhocctlLoginPacketC2S packet;
+		memset(&packet, 0, sizeof(packet));
+		packet.base.opcode = OPCODE_LOGIN;
+		packet.mac.data[0] = 0x02;
+		packet.mac.data[2] = (uint8_t)(i >> 16);
+		packet.mac.data[3] = (uint8_t)(i >> 8);
+		packet.mac.data[4] = (uint8_t)i;
+		packet.mac.data[5] = 0x01;
+		snprintf((char *)packet.name.data, sizeof(packet.name.data), "bench%d", (int)i);
+		memcpy(packet.game.data, "ULUS10511", PRODUCT_CODE_LENGTH);
+		Send(clients_[i], &packet, sizeof(packet));
+	}
+	// No reply to a login, just let the server catch up.
+	return Pump(100);
+}
+
+bool AdhocLoadGenerator::Join() {
+	for (size_t i = 0; i < clients_.size(); ++i) {
+		SceNetAdhocctlConnectPacketC2S packet;
+		memset(&packet, 0, sizeof(packet));
+		packet.base.opcode = OPCODE_CONNECT;
+		char name[ADHOCCTL_GROUPNAME_LEN + 1];
+		snprintf(name, sizeof(name), "B%07d", (int)(i / BENCH_GROUP_SIZE));
+		memcpy(packet.group.data, name, ADHOCCTL_GROUPNAME_LEN);
+		clients_[i].joinSent = real_time_now();
+		Send(clients_[i], &packet, sizeof(packet));
+	}
+
+	double deadline = real_time_now() + BENCH_PHASE_TIMEOUT;
+	while (CountJoined() < (int)clients_.size() && real_time_now() < deadline) {
+		if (!Pump(100))
+			return false;
+	}
+	return CountJoined() == (int)clients_.size();
+}
+
+bool AdhocLoadGenerator::Chat() {
+	const int groups = (int)chatSent_.size();
+	int expected = 0;
+	for (int g = 0; g < groups; ++g) {
+		int members = std::min(BENCH_GROUP_SIZE, (int)clients_.size() - g * BENCH_GROUP_SIZE);
+		expected += members - 1;
+	}
+
+	for (chatRound_ = 0; chatRound_ < BENCH_CHAT_ROUNDS; ++chatRound_) {
+		chatsReceived_ = 0;
+		for (int g = 0; g < groups; ++g) {
+			SceNetAdhocctlChatPacketC2S packet;
+			memset(&packet, 0, sizeof(packet));
+			packet.base.opcode = OPCODE_CHAT;
+			snprintf(packet.message, sizeof(packet.message), "round %d", chatRound_);
+			chatSent_[g] = real_time_now();
+			Send(clients_[g * BENCH_GROUP_SIZE], &packet, sizeof(packet));
+		}
+
+		double deadline = real_time_now() + BENCH_PHASE_TIMEOUT;
+		while (chatsReceived_ < expected && real_time_now() < deadline) {
+			if (!Pump(100))
+				return false;
+		}
+		if (chatsReceived_ < expected) {
+			fprintf(stderr, "Chat round %d: only %d of %d messages arrived\n", chatRound_, chatsReceived_, expected);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AdhocLoadGenerator::Pump(int timeoutMs) {
+	int count = poll(&fds_[0], (unsigned long)fds_.size(), timeoutMs);
+	if (count < 0)
+		return false;
+	for (size_t i = 0; i < fds_.size() && count > 0; ++i) {
+		if (fds_[i].revents == 0)
+			continue;
+		count--;
+
+		BenchClient &c = clients_[i];
+		int received = recv(c.fd, (char *)c.rx + c.rxpos, (int)(sizeof(c.rx) - c.rxpos), 0);
+		if (received <= 0) {
+			fprintf(stderr, "Client %d was disconnected by the server\n", (int)i);
+			return false;
+		}
+		c.rxpos += received;
+
+		size_t pos = 0;
+		while (pos < c.rxpos) {
+			size_t size = PacketSize(c.rx[pos]);
+			if (size == 0) {
+				fprintf(stderr, "Client %d received unknown opcode %d\n", (int)i, c.rx[pos]);
+				return false;
+			}
+			if (c.rxpos - pos < size)
+				break;
+			HandlePacket((int)i, c.rx + pos);
+			pos += size;
+		}
+		memmove(c.rx, c.rx + pos, c.rxpos - pos);
+		c.rxpos -= pos;
+	}
+	return true;
+}
+
+void AdhocLoadGenerator::HandlePacket(int index, const uint8_t *packet) {
+	BenchClient &c = clients_[index];
+	double now = real_time_now();
+	switch (packet[0]) {
+	case OPCODE_CONNECT_BSSID:
+		// Always the last thing sent after joining.
+		if (!c.joined) {
+			c.joined = true;
+			joinLatency_.push_back(now - c.joinSent);
+		}
+		break;
+
+	case OPCODE_CHAT:
+		if (chatRound_ >= 0) {
+			chatLatency_.push_back(now - chatSent_[index / BENCH_GROUP_SIZE]);
+			chatsReceived_++;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+int AdhocLoadGenerator::CountJoined() const {
+	int count = 0;
+	for (const BenchClient &c : clients_) {
+		if (c.joined)
+			count++;
+	}
+	return count;
+}
+
+void AdhocLoadGenerator::Report(double connectSeconds) {
+	printf("Clients: %d\n", (int)clients_.size());
+	printf("Connects: %0.1f/sec (%0.3f s for all)\n", clients_.size() / connectSeconds, connectSeconds);
+	PrintLatency("Group join latency", joinLatency_);
+	PrintLatency("Chat delivery latency", chatLatency_);
+	if (errors_ != 0)
+		printf("Send errors: %d\n", errors_);
+}
+
+int RunAdhocServerBench(int clients, int port) {
+	if (port <= 0)
+		port = SERVER_PORT;
+	coreState = CORE_RUNNING;
+	__AdhocServerInit();
+	// Each client is two sockets, ours and the server's.
+	RaiseFileLimit(clients * 2 + 64);
+
+	std::thread server(&proAdhocServerThread, port);
+	for (int i = 0; i < 100 && !adhocServerRunning; ++i)
+		sleep_ms(10);
+	if (!adhocServerRunning) {
+		fprintf(stderr, "Adhoc server failed to start on port %d\n", port);
+		server.join();
+		return 1;
+	}
+
+	bool success = false;
+	{
+		AdhocLoadGenerator generator(clients, port);
+		double start = real_time_now();
+		if (!generator.Connect()) {
+			fprintf(stderr, "Not all clients connected\n");
+		} else {
+			double connectSeconds = real_time_now() - start;
+			if (!generator.Login() || !generator.Join()) {
+				fprintf(stderr, "Not all clients joined a group\n");
+			} else if (generator.Chat()) {
+				success = true;
+			}
+			generator.Report(connectSeconds);
+		}
+	}
+
+	adhocServerRunning = false;
+	server.join();
+	return success ? 0 : 1;
+}
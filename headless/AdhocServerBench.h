@@ -0,0 +1,27 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+// A port of 0 means the default adhoc server port.
+
+// Runs the adhoc matchmaking server on its own until interrupted (Ctrl+C.)
+int RunAdhocServer(int port);
+
+// Starts the server in-process and hammers it with simulated clients over loopback.
+// Prints connects/sec and join/chat latency.
+int RunAdhocServerBench(int clients, int port);
@@ -0,0 +1,64 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+
+#include "base/timeutil.h"
+#include "Core/Config.h"
+#include "Core/CoreParameter.h"
+#include "Core/Host.h"
+#include "Core/System.h"
+
+#include "headless/BootBench.h"
+
+int RunBootBench(CoreParameter &coreParameter, const std::vector<std::string> &filenames, int loops) {
+	printf("Booting %d files %d times with %d worker threads\n", (int)filenames.size(), loops, g_Config.iNumWorkerThreads);
+
+	int failed = 0;
+	for (const std::string &filename : filenames) {
+		coreParameter.fileToStart = filename;
+
+		double best = 0.0;
+		double total = 0.0;
+		int booted = 0;
+		for (int i = 0; i < loops; ++i) {
+			std::string error_string;
+			double st = real_time_now();
+			bool success = PSP_Init(coreParameter, &error_string);
+			double elapsed = real_time_now() - st;
+			if (!success) {
+				fprintf(stderr, "Failed to start %s. Error: %s\n", filename.c_str(), error_string.c_str());
+				break;
+			}
+			host->BootDone();
+			PSP_Shutdown();
+
+			best = booted == 0 ? elapsed : std::min(best, elapsed);
+			total += elapsed;
+			booted++;
+		}
+
+		if (booted == loops) {
+			printf("%s: best %0.2f ms, average %0.2f ms\n", filename.c_str(), best * 1000.0, total * 1000.0 / booted);
+		} else {
+			failed++;
+		}
+	}
+
+	return failed == 0 ? 0 : 1;
+}
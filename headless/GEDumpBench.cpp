@@ -0,0 +1,277 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+
+#include "base/timeutil.h"
+#include "file/file_util.h"
+#include "json/json_writer.h"
+#include "thin3d/thin3d.h"
+#include "Common/FileUtil.h"
+#include "Core/Config.h"
+#include "Core/Core.h"
+#include "Core/CoreParameter.h"
+#include "Core/CoreTiming.h"
+#include "Core/Host.h"
+#include "Core/System.h"
+#include "GPU/GeDisasm.h"
+#include "GPU/GPU.h"
+#include "GPU/Debugger/Record.h"
+
+#include "headless/GEDumpBench.h"
+#include "headless/StubHost.h"
+
+struct DumpBenchResult {
+	std::string name;
+	// Measured with the timings off, so they don't skew it.  Reloading the dump between loops isn't counted.
+	int frames;
+	double seconds;
+	double loadSeconds;
+	// The same, with the display list block cache on.
+	int cachedFrames;
+	double cachedSeconds;
+	// From one more pass with them on.
+	int timedFrames;
+	GPUTimingStats timings;
+};
+
+static const char *GPUCoreName(GPUCore core) {
+	switch (core) {
+	case GPUCORE_NULL: return "null";
+	case GPUCORE_GLES: return "gles";
+	case GPUCORE_SOFTWARE: return "software";
+	case GPUCORE_DIRECTX9: return "directx9";
+	case GPUCORE_DIRECTX11: return "directx11";
+	case GPUCORE_VULKAN: return "vulkan";
+	default: return "other";
+	}
+}
+
+// Good enough for a label, the disassembly of the command with no data up to the first colon.
+static std::string CommandName(int cmd) {
+	char temp[256];
+	GeDisassembleOp(0, (u32)cmd << 24, 0, temp, sizeof(temp));
+	std::string name = temp;
+	size_t pos = name.find(':');
+	if (pos != name.npos)
+		name.resize(pos);
+	std::replace(name.begin(), name.end(), '"', '\'');
+	return name;
+}
+
+static std::vector<std::string> FindDumps(const std::vector<std::string> &paths) {
+	std::vector<std::string> dumps;
+	for (const std::string &path : paths) {
+		if (!File::IsDirectory(path)) {
+			dumps.push_back(path);
+			continue;
+		}
+
+		std::vector<FileInfo> files;
+		getFilesInDir(path.c_str(), &files, "ppdmp");
+		std::sort(files.begin(), files.end());
+		for (const FileInfo &file : files) {
+			if (!file.isDirectory)
+				dumps.push_back(file.fullName);
+		}
+	}
+	return dumps;
+}
+
+static bool RunDump(HeadlessHost *headlessHost, CoreParameter &coreParameter, const std::string &filename, int loops, DumpBenchResult *result) {
+	coreParameter.fileToStart = filename;
+	std::string error_string;
+	if (!PSP_Init(coreParameter, &error_string)) {
+		fprintf(stderr, "Failed to start %s. Error: %s\n", filename.c_str(), error_string.c_str());
+		return false;
+	}
+	host->BootDone();
+
+	// The first pass warms up the caches, then loops passes for speed with the list block cache on,
+	// loops more with it off, and one more for the breakdown.
+	enum { WARMUP, MEASURE_CACHED, MEASURE, TIMED } phase = WARMUP;
+	int startFrames = 0;
+	double startTime = 0.0;
+	double startLoad = 0.0;
+	gpuCollectTimings = false;
+	const bool listBlockCache = g_Config.bDisplayListBlockCache;
+	g_Config.bDisplayListBlockCache = true;
+
+	PSP_BeginHostFrame();
+	if (coreParameter.thin3d)
+		coreParameter.thin3d->BeginFrame();
+
+	bool success = true;
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING) {
+		PSP_RunLoopFor(usToCycles(1000000 / 60));
+		if (coreState == CORE_NEXTFRAME) {
+			coreState = CORE_RUNNING;
+			headlessHost->SwapBuffers();
+		}
+
+		int frames, played;
+		double load;
+		GPURecord::GetReplayProgress(&frames, &played, &load);
+		const double now = real_time_now();
+		if (phase == WARMUP && played >= 1) {
+			phase = MEASURE_CACHED;
+			startFrames = frames;
+			startTime = now;
+			startLoad = load;
+		} else if (phase == MEASURE_CACHED && played >= 1 + loops) {
+			result->cachedFrames = frames - startFrames;
+			result->cachedSeconds = now - startTime - (load - startLoad);
+
+			phase = MEASURE;
+			g_Config.bDisplayListBlockCache = false;
+			startFrames = frames;
+			startTime = now;
+			startLoad = load;
+		} else if (phase == MEASURE && played >= 1 + 2 * loops) {
+			result->frames = frames - startFrames;
+			result->loadSeconds = load - startLoad;
+			result->seconds = now - startTime - result->loadSeconds;
+
+			phase = TIMED;
+			startFrames = frames;
+			gpuTimings.Reset();
+			gpuCollectTimings = true;
+		} else if (phase == TIMED && played >= 2 + 2 * loops) {
+			gpuCollectTimings = false;
+			result->timedFrames = frames - startFrames;
+			result->timings = gpuTimings;
+			Core_Stop();
+		}
+	}
+	if (phase != TIMED || result->timedFrames == 0) {
+		fprintf(stderr, "%s: replay stopped early\n", filename.c_str());
+		success = false;
+	}
+	gpuCollectTimings = false;
+	g_Config.bDisplayListBlockCache = listBlockCache;
+
+	PSP_EndHostFrame();
+	if (coreParameter.thin3d)
+		coreParameter.thin3d->EndFrame();
+
+	PSP_Shutdown();
+	headlessHost->FlushDebugOutput();
+	return success;
+}
+
+static void PrintResult(const DumpBenchResult &result) {
+	const GPUTimingStats &t = result.timings;
+	const double perFrame = 1000.0 / result.timedFrames;
+	printf("%s: %d frames in %0.3f s, %0.1f fps (%0.3f s loading not counted)\n", result.name.c_str(), result.frames, result.seconds, result.frames / result.seconds, result.loadSeconds);
+	printf("  with display list block cache: %d frames in %0.3f s, %0.1f fps\n", result.cachedFrames, result.cachedSeconds, result.cachedFrames / result.cachedSeconds);
+	printf("  texture decode: %0.3f ms/frame (%llu levels), vertex decode: %0.3f ms/frame (%llu verts)\n",
+		t.textureDecodeSeconds * perFrame, (unsigned long long)t.textureLevelsDecoded, t.vertexDecodeSeconds * perFrame, (unsigned long long)t.vertsDecoded);
+
+	int order[256];
+	for (int i = 0; i < 256; ++i)
+		order[i] = i;
+	std::sort(order, order + 256, [&](int a, int b) {
+		return t.commandSeconds[a] > t.commandSeconds[b];
+	});
+	for (int i = 0; i < 10 && t.commandCount[order[i]] != 0; ++i) {
+		const int cmd = order[i];
+		printf("  %02x %-24s %10llu calls %8.3f ms/frame\n", cmd, CommandName(cmd).c_str(), (unsigned long long)t.commandCount[cmd], t.commandSeconds[cmd] * perFrame);
+	}
+}
+
+static void WriteJson(const char *filename, GPUCore gpuCore, int loops, const std::vector<DumpBenchResult> &results) {
+	JsonWriter json;
+	json.begin();
+	json.writeString("gpu", GPUCoreName(gpuCore));
+	json.writeInt("loops", loops);
+	json.pushDict("dumps");
+	for (const DumpBenchResult &result : results) {
+		const GPUTimingStats &t = result.timings;
+		const double perFrame = 1000.0 / result.timedFrames;
+
+		std::string name = result.name;
+		std::replace(name.begin(), name.end(), '\\', '/');
+		json.pushDict(name.c_str());
+		json.writeInt("frames", result.frames);
+		json.writeFloat("seconds", result.seconds);
+		json.writeFloat("fps", result.frames / result.seconds);
+		json.writeFloat("loadSeconds", result.loadSeconds);
+		json.writeInt("cachedFrames", result.cachedFrames);
+		json.writeFloat("cachedSeconds", result.cachedSeconds);
+		json.writeFloat("cachedFps", result.cachedFrames / result.cachedSeconds);
+		json.writeFloat("textureDecodeMsPerFrame", t.textureDecodeSeconds * perFrame);
+		json.writeUint64("textureLevelsDecoded", t.textureLevelsDecoded);
+		json.writeFloat("vertexDecodeMsPerFrame", t.vertexDecodeSeconds * perFrame);
+		json.writeUint64("vertsDecoded", t.vertsDecoded);
+		json.pushDict("commands");
+		for (int cmd = 0; cmd < 256; ++cmd) {
+			if (t.commandCount[cmd] == 0)
+				continue;
+			char key[8];
+			snprintf(key, sizeof(key), "%02x", cmd);
+			json.pushDict(key);
+			json.writeString("name", CommandName(cmd).c_str());
+			json.writeUint64("count", t.commandCount[cmd]);
+			json.writeFloat("msPerFrame", t.commandSeconds[cmd] * perFrame);
+			json.pop();
+		}
+		json.pop();
+		json.pop();
+	}
+	json.pop();
+	json.end();
+
+	FILE *fp = File::OpenCFile(filename, "wb");
+	if (!fp) {
+		fprintf(stderr, "Unable to write %s\n", filename);
+		return;
+	}
+	const std::string str = json.str();
+	fwrite(str.data(), 1, str.size(), fp);
+	fclose(fp);
+}
+
+int RunGEDumpBench(HeadlessHost *headlessHost, CoreParameter &coreParameter, const std::vector<std::string> &paths, int loops, const char *jsonFilename) {
+	const std::vector<std::string> dumps = FindDumps(paths);
+	if (dumps.empty()) {
+		fprintf(stderr, "No GE dumps found\n");
+		return 1;
+	}
+
+	printf("Replaying %d dumps %d times on the %s GPU\n", (int)dumps.size(), loops, GPUCoreName(coreParameter.gpuCore));
+	if (coreParameter.gpuCore == GPUCORE_NULL || coreParameter.gpuCore == GPUCORE_SOFTWARE)
+		printf("This GPU has its own run loop, so the display list block cache won't make a difference\n");
+
+	std::vector<DumpBenchResult> results;
+	int failed = 0;
+	for (const std::string &filename : dumps) {
+		DumpBenchResult result{};
+		result.name = filename;
+		if (RunDump(headlessHost, coreParameter, filename, loops, &result)) {
+			PrintResult(result);
+			results.push_back(result);
+		} else {
+			failed++;
+		}
+	}
+
+	if (jsonFilename)
+		WriteJson(jsonFilename, coreParameter.gpuCore, loops, results);
+	return failed == 0 ? 0 : 1;
+}
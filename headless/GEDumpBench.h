@@ -0,0 +1,28 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class HeadlessHost;
+struct CoreParameter;
+
+// Replays each GE dump (or every .ppdmp in a directory) as fast as possible, loops times over,
+// and prints frames/sec (with the display list block cache on and off) along with where the GPU time went.  Also writes it all as JSON if asked.
+int RunGEDumpBench(HeadlessHost *headlessHost, CoreParameter &coreParameter, const std::vector<std::string> &paths, int loops, const char *jsonFilename);
@@ -2,12 +2,14 @@
 // See headless.txt.
 // To build on non-windows systems, just run CMake in the SDL directory, it will build both a normal ppsspp and the headless version.
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
 
 #include "file/zip_read.h"
 #include "profiler/profiler.h"
+#include "Common/CPUDetect.h"
 #include "Common/FileUtil.h"
 #include "Common/GraphicsContext.h"
 #include "Core/Config.h"
@@ -17,11 +19,17 @@
 #include "Core/HLE/sceUtility.h"
 #include "Core/Host.h"
 #include "Core/SaveState.h"
+#include "Core/Util/FramePacer.h"
 #include "Log.h"
 #include "LogManager.h"
 #include "base/NativeApp.h"
 #include "base/timeutil.h"
 
+#include "AdhocServerBench.h"
+#include "SchedulerBench.h"
+#include "GEDumpBench.h"
+#include "BootBench.h"
+#include "HugePageBench.h"
 #include "Compare.h"
 #include "StubHost.h"
 #if defined(_WIN32)
@@ -80,6 +88,21 @@ bool System_InputBoxGetWString(const wchar_t *title, const std::wstring &default
 void System_AskForPermission(SystemPermission permission) {}
 PermissionStatus System_GetPermissionStatus(SystemPermission permission) { return PERMISSION_STATUS_GRANTED; }
 
+// Times are in ms, from the first frame of each test.
+static void WriteFrameTiming(FILE *fp, const std::string &testName) {
+	std::vector<FrameTimingSample> samples;
+	FramePacer::GetFrameHistory(&samples);
+	if (samples.empty())
+		return;
+	const double base = samples[0].start;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const FrameTimingSample &s = samples[i];
+		fprintf(fp, "%s,%d,%0.3f,%0.3f,%0.3f,%0.3f,%0.3f,%0.3f\n", testName.c_str(), (int)i,
+			(s.start - base) * 1000.0, (s.end - base) * 1000.0, s.emuSeconds * 1000.0,
+			(s.deadline - base) * 1000.0, s.sleepError * 1000.0, s.spinSeconds * 1000.0);
+	}
+}
+
 int printUsage(const char *progname, const char *reason)
 {
 	if (reason != NULL)
@@ -100,12 +123,20 @@ int printUsage(const char *progname, const char *reason)
 	}
 #endif
 	fprintf(stderr, "  --timeout=SECONDS     abort test it if takes longer than SECONDS\n");
+	fprintf(stderr, "  --frame-timing=FILE   run at normal speed and write the frame pacing telemetry to FILE as CSV\n");
 
 	fprintf(stderr, "  -v, --verbose         show the full passed/failed result\n");
 	fprintf(stderr, "  -i                    use the interpreter\n");
 	fprintf(stderr, "  --ir                  use ir interpreter\n");
 	fprintf(stderr, "  -j                    use jit (default)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
+	fprintf(stderr, "  --adhoc-server[=PORT] run the adhoc matchmaking server instead of a test\n");
+	fprintf(stderr, "  --adhoc-bench=N       load test the adhoc server with N simulated clients\n");
+	fprintf(stderr, "  --bench-scheduler=N   time the thread scheduler's ready queue with N threads\n");
+	fprintf(stderr, "  --bench-gedump=N      replay the GE dumps (or dirs of them) N times and report timings\n");
+	fprintf(stderr, "  --bench-json=FILE     also write the GE dump timings to FILE as JSON\n");
+	fprintf(stderr, "  --bench-boot=N        boot the executables N times each on all cores and report timings\n");
+	fprintf(stderr, "  --bench-hugepages=N   run the executables N frames each, without and with huge pages\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 
 	return 1;
@@ -229,6 +260,15 @@ int main(int argc, const char* argv[])
 	const char *mountRoot = 0;
 	const char *screenshotFilename = 0;
 	float timeout = std::numeric_limits<float>::infinity();
+	bool adhocServer = false;
+	int adhocServerPort = 0;
+	int adhocBenchClients = 0;
+	int schedulerBenchThreads = 0;
+	int geDumpBenchLoops = 0;
+	int bootBenchLoops = 0;
+	int hugePageBenchFrames = 0;
+	const char *benchJsonFilename = nullptr;
+	const char *frameTimingFilename = nullptr;
 
 	for (int i = 1; i < argc; i++)
 	{
@@ -281,10 +321,31 @@ int main(int argc, const char* argv[])
 			screenshotFilename = argv[i] + strlen("--screenshot=");
 		else if (!strncmp(argv[i], "--timeout=", strlen("--timeout=")) && strlen(argv[i]) > strlen("--timeout="))
 			timeout = strtod(argv[i] + strlen("--timeout="), NULL);
+		else if (!strncmp(argv[i], "--frame-timing=", strlen("--frame-timing=")) && strlen(argv[i]) > strlen("--frame-timing="))
+			frameTimingFilename = argv[i] + strlen("--frame-timing=");
 		else if (!strcmp(argv[i], "--teamcity"))
 			teamCityMode = true;
 		else if (!strncmp(argv[i], "--state=", strlen("--state=")) && strlen(argv[i]) > strlen("--state="))
 			stateToLoad = argv[i] + strlen("--state=");
+		else if (!strcmp(argv[i], "--adhoc-server"))
+			adhocServer = true;
+		else if (!strncmp(argv[i], "--adhoc-server=", strlen("--adhoc-server=")) && strlen(argv[i]) > strlen("--adhoc-server="))
+		{
+			adhocServer = true;
+			adhocServerPort = atoi(argv[i] + strlen("--adhoc-server="));
+		}
+		else if (!strncmp(argv[i], "--adhoc-bench=", strlen("--adhoc-bench=")) && strlen(argv[i]) > strlen("--adhoc-bench="))
+			adhocBenchClients = atoi(argv[i] + strlen("--adhoc-bench="));
+		else if (!strncmp(argv[i], "--bench-scheduler=", strlen("--bench-scheduler=")) && strlen(argv[i]) > strlen("--bench-scheduler="))
+			schedulerBenchThreads = atoi(argv[i] + strlen("--bench-scheduler="));
+		else if (!strncmp(argv[i], "--bench-gedump=", strlen("--bench-gedump=")) && strlen(argv[i]) > strlen("--bench-gedump="))
+			geDumpBenchLoops = atoi(argv[i] + strlen("--bench-gedump="));
+		else if (!strncmp(argv[i], "--bench-json=", strlen("--bench-json=")) && strlen(argv[i]) > strlen("--bench-json="))
+			benchJsonFilename = argv[i] + strlen("--bench-json=");
+		else if (!strncmp(argv[i], "--bench-boot=", strlen("--bench-boot=")) && strlen(argv[i]) > strlen("--bench-boot="))
+			bootBenchLoops = atoi(argv[i] + strlen("--bench-boot="));
+		else if (!strncmp(argv[i], "--bench-hugepages=", strlen("--bench-hugepages=")) && strlen(argv[i]) > strlen("--bench-hugepages="))
+			hugePageBenchFrames = atoi(argv[i] + strlen("--bench-hugepages="));
 		else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
 			return printUsage(argv[0], NULL);
 		else
@@ -302,7 +363,8 @@ int main(int argc, const char* argv[])
 			testFilenames.push_back(temp);
 	}
 
-	if (testFilenames.empty())
+	const bool toolMode = adhocServer || adhocBenchClients > 0 || schedulerBenchThreads > 0;
+	if (testFilenames.empty() && !toolMode)
 		return printUsage(argv[0], argc <= 1 ? NULL : "No executables specified");
 
 	HeadlessHost *headlessHost = getHost(gpuCore);
@@ -325,6 +387,13 @@ int main(int argc, const char* argv[])
 	}
 	logman->AddListener(printfLogger);
 
+	if (schedulerBenchThreads > 0)
+		return RunSchedulerBench(schedulerBenchThreads);
+	if (adhocBenchClients > 0)
+		return RunAdhocServerBench(adhocBenchClients, adhocServerPort);
+	if (adhocServer)
+		return RunAdhocServer(adhocServerPort);
+
 	CoreParameter coreParameter;
 	coreParameter.cpuCore = cpuCore;
 	coreParameter.gpuCore = glWorking ? gpuCore : GPUCORE_NULL;
@@ -340,7 +409,8 @@ int main(int argc, const char* argv[])
 	coreParameter.renderHeight = 272;
 	coreParameter.pixelWidth = 480;
 	coreParameter.pixelHeight = 272;
-	coreParameter.unthrottle = true;
+	// Pacing only happens when throttled.
+	coreParameter.unthrottle = frameTimingFilename == nullptr;
 
 	g_Config.bEnableSound = false;
 	g_Config.bFirstRun = false;
@@ -409,6 +479,31 @@ int main(int argc, const char* argv[])
 	if (stateToLoad != NULL)
 		SaveState::Load(stateToLoad);
 
+	int result = 0;
+	if (geDumpBenchLoops > 0) {
+		result = RunGEDumpBench(headlessHost, coreParameter, testFilenames, geDumpBenchLoops, benchJsonFilename);
+		testFilenames.clear();
+	}
+	if (bootBenchLoops > 0) {
+		// The scan and hash phases are split up on the worker threads, so give them some.
+		g_Config.iNumWorkerThreads = std::max(1, cpu_info.num_cores);
+		result = RunBootBench(coreParameter, testFilenames, bootBenchLoops);
+		testFilenames.clear();
+	}
+	if (hugePageBenchFrames > 0) {
+		result = RunHugePageBench(headlessHost, coreParameter, testFilenames, hugePageBenchFrames);
+		testFilenames.clear();
+	}
+
+	FILE *frameTimingFile = nullptr;
+	if (frameTimingFilename) {
+		frameTimingFile = File::OpenCFile(frameTimingFilename, "wb");
+		if (frameTimingFile)
+			fprintf(frameTimingFile, "test,frame,start_ms,end_ms,emu_ms,deadline_ms,sleep_error_ms,spin_ms\n");
+		else
+			fprintf(stderr, "Unable to write %s\n", frameTimingFilename);
+	}
+
 	std::vector<std::string> failedTests;
 	std::vector<std::string> passedTests;
 	for (size_t i = 0; i < testFilenames.size(); ++i)
@@ -417,6 +512,8 @@ int main(int argc, const char* argv[])
 		if (autoCompare)
 			printf("%s:\n", coreParameter.fileToStart.c_str());
 		bool passed = RunAutoTest(headlessHost, coreParameter, autoCompare, verbose, timeout);
+		if (frameTimingFile)
+			WriteFrameTiming(frameTimingFile, GetTestName(coreParameter.fileToStart));
 		if (autoCompare)
 		{
 			std::string testName = GetTestName(coreParameter.fileToStart);
@@ -430,6 +527,9 @@ int main(int argc, const char* argv[])
 		}
 	}
 
+	if (frameTimingFile)
+		fclose(frameTimingFile);
+
 	if (autoCompare)
 	{
 		printf("%d tests passed, %d tests failed.\n", (int)passedTests.size(), (int)failedTests.size());
@@ -455,5 +555,5 @@ int main(int argc, const char* argv[])
 	moncleanup();
 #endif
 
-	return 0;
+	return result;
 }
@@ -0,0 +1,189 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+
+#include "base/timeutil.h"
+#include "thin3d/thin3d.h"
+#include "Core/Config.h"
+#include "Core/Core.h"
+#include "Core/CoreParameter.h"
+#include "Core/CoreTiming.h"
+#include "Core/Host.h"
+#include "Core/System.h"
+
+#include "headless/HugePageBench.h"
+#include "headless/StubHost.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct HugePageBenchResult {
+	int frames;
+	double seconds;
+	// -1 when unavailable.
+	long long dtlbMisses;
+	long long hugePageKB;
+};
+
+// Counts dTLB load misses in user mode, on this thread only, which is the one running the CPU.
+class DTLBMissCounter {
+public:
+	DTLBMissCounter() {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd_ = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+	~DTLBMissCounter() {
+#if defined(__linux__)
+		if (fd_ >= 0)
+			close(fd_);
+#endif
+	}
+
+	void Start() {
+#if defined(__linux__)
+		if (fd_ >= 0) {
+			ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	long long Stop() {
+#if defined(__linux__)
+		long long count = 0;
+		if (fd_ >= 0) {
+			ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd_, &count, sizeof(count)) == sizeof(count))
+				return count;
+		}
+#endif
+		return -1;
+	}
+
+private:
+	int fd_ = -1;
+};
+
+// How much shared memory is mapped with huge pages right now, which is really just the PSP memory.
+static long long GetHugePageKB() {
+#if defined(__linux__)
+	FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+	if (!fp)
+		return -1;
+	long long kb = -1;
+	char line[256];
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "ShmemPmdMapped: %lld kB", &kb) == 1)
+			break;
+	}
+	fclose(fp);
+	return kb;
+#else
+	return -1;
+#endif
+}
+
+static bool RunFrames(HeadlessHost *headlessHost, CoreParameter &coreParameter, int frames, HugePageBenchResult *result) {
+	std::string error_string;
+	if (!PSP_Init(coreParameter, &error_string)) {
+		fprintf(stderr, "Failed to start %s. Error: %s\n", coreParameter.fileToStart.c_str(), error_string.c_str());
+		return false;
+	}
+	host->BootDone();
+
+	PSP_BeginHostFrame();
+	if (coreParameter.thin3d)
+		coreParameter.thin3d->BeginFrame();
+
+	DTLBMissCounter counter;
+	result->frames = 0;
+	const double st = real_time_now();
+	counter.Start();
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING && result->frames < frames) {
+		PSP_RunLoopFor(usToCycles(1000000 / 10));
+		if (coreState == CORE_NEXTFRAME) {
+			coreState = CORE_RUNNING;
+			headlessHost->SwapBuffers();
+			result->frames++;
+		}
+	}
+	result->dtlbMisses = counter.Stop();
+	result->seconds = real_time_now() - st;
+	result->hugePageKB = GetHugePageKB();
+
+	PSP_EndHostFrame();
+	if (coreParameter.thin3d)
+		coreParameter.thin3d->EndFrame();
+
+	PSP_Shutdown();
+	headlessHost->FlushDebugOutput();
+	return result->frames != 0;
+}
+
+static void PrintResult(const char *label, const HugePageBenchResult &result) {
+	printf("  %-12s %6d frames in %0.3f s, %0.1f fps", label, result.frames, result.seconds, result.frames / result.seconds);
+	if (result.dtlbMisses >= 0)
+		printf(", %0.0f dTLB misses/frame", (double)result.dtlbMisses / result.frames);
+	if (result.hugePageKB >= 0)
+		printf(", %lld KB on huge pages", result.hugePageKB);
+	printf("\n");
+}
+
+int RunHugePageBench(HeadlessHost *headlessHost, CoreParameter &coreParameter, const std::vector<std::string> &filenames, int frames) {
+	printf("Running %d files for %d frames each, with normal and huge pages\n", (int)filenames.size(), frames);
+
+	const bool oldHugePages = g_Config.bHugePageMemory;
+	int failed = 0;
+	for (const std::string &filename : filenames) {
+		coreParameter.fileToStart = filename;
+
+		HugePageBenchResult normal{}, huge{};
+		g_Config.bHugePageMemory = false;
+		bool success = RunFrames(headlessHost, coreParameter, frames, &normal);
+		g_Config.bHugePageMemory = true;
+		success = success && RunFrames(headlessHost, coreParameter, frames, &huge);
+		if (!success) {
+			failed++;
+			continue;
+		}
+
+		printf("%s:\n", filename.c_str());
+		PrintResult("normal:", normal);
+		PrintResult("huge pages:", huge);
+		if (normal.frames == huge.frames)
+			printf("  speedup: %0.1f%%\n", (normal.seconds / huge.seconds - 1.0) * 100.0);
+	}
+
+	g_Config.bHugePageMemory = oldHugePages;
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/HLE/ThreadQueueList.h"
+
+#include "headless/SchedulerBench.h"
+
+// Thread ids look like kernel object handles.
+static const SceUID FIRST_THREAD_ID = 0x100;
+static const int RESCHEDULES = 10000000;
+
+struct BenchThread {
+	u32 priority;
+	bool ready;
+};
+
+// Mirrors what sceKernelThread does to threadReadyQueue: pick the best thread, put back a
+// preempted one, take waiting threads out and put woken threads back in.
+static void RunWorkload(const char *name, int threads, int priorities) {
+	ThreadQueueList queue;
+	std::vector<BenchThread> info(threads);
+	for (int i = 0; i < threads; ++i) {
+		info[i].priority = 0x10 + (i % priorities) * (0x60 / priorities);
+		info[i].ready = true;
+		queue.prepare(info[i].priority);
+		queue.push_back(info[i].priority, FIRST_THREAD_ID + i);
+	}
+
+	int current = -1;
+	int waiting = 0;
+	u32 seed = 0x12345678;
+	u64 checksum = 0;
+	double start = real_time_now();
+	for (int r = 0; r < RESCHEDULES; ++r) {
+		seed = seed * 1103515245 + 12345;
+		const int other = (seed >> 8) % threads;
+
+		if (current != -1) {
+			switch ((seed >> 24) & 3) {
+			case 0:
+			case 1:
+				// sceKernelDelayThread/WaitSema: the current thread stops running.
+				info[current].ready = false;
+				waiting++;
+				current = -1;
+				break;
+			case 2:
+				// sceKernelRotateThreadReadyQueue from the current thread.
+				queue.push_back(info[current].priority, FIRST_THREAD_ID + current);
+				current = -1;
+				break;
+			default:
+				// Keeps running unless something better wakes up.
+				break;
+			}
+		}
+
+		// Wake something up, or put a ready thread to sleep (suspend/priority changes.)
+		if (other != current) {
+			BenchThread &t = info[other];
+			if (!t.ready) {
+				t.ready = true;
+				waiting--;
+				queue.push_back(t.priority, FIRST_THREAD_ID + other);
+			} else if (waiting < threads / 2) {
+				t.ready = false;
+				waiting++;
+				queue.remove(t.priority, FIRST_THREAD_ID + other);
+			}
+		}
+
+		// __KernelNextThread.
+		SceUID best;
+		if (current != -1) {
+			best = queue.pop_first_better(info[current].priority);
+			if (best != 0)
+				queue.push_front(info[current].priority, FIRST_THREAD_ID + current);
+		} else {
+			best = queue.pop_first();
+		}
+		if (best != 0)
+			current = best - FIRST_THREAD_ID;
+		checksum += current;
+	}
+	double elapsed = real_time_now() - start;
+
+	printf("%s, %d threads: %0.0f reschedules/sec (checksum %llu)\n", name, threads, RESCHEDULES / elapsed, checksum);
+}
+
+int RunSchedulerBench(int threads) {
+	if (threads < 2)
+		threads = 2;
+
+	// Many games only use a handful of priorities, others spread them all over.
+	RunWorkload("8 priorities", threads, 8);
+	RunWorkload("96 priorities", threads, 96);
+	return 0;
+}
@@ -16,16 +16,21 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "base/timeutil.h"
 #include "base/NativeApp.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitPageProtect.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
 #include "Core/MIPS/MIPSDebugInterface.h"
 #include "Core/MIPS/MIPSAsm.h"
 #include "Core/MIPS/MIPSTables.h"
 #include "Core/MemMap.h"
+#include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/HLE/HLE.h"
@@ -196,3 +201,99 @@ bool TestJit() {
 
 	return jit_speed >= interp_speed;
 }
+
+static u32 RunUntilTerminator(u32 pc) {
+	currentMIPS->pc = pc;
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING) {
+		mipsr4k.RunLoopUntil(1000000);
+	}
+	return currentMIPS->r[MIPS_REG_V0];
+}
+
+bool TestJitWriteProtect() {
+	if (!JitPageProtect::IsSupported()) {
+		printf("Code write protection not supported here, skipping.\n");
+		return true;
+	}
+
+	SetupJitHarness();
+	g_Config.bJitWriteProtect = true;
+
+	// The game's code, which just returns 1.
+	const u32 codeAddr = PSP_GetUserMemoryBase();
+	u32 *p = (u32 *)Memory::GetPointer(codeAddr);
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_V0, MIPS_REG_ZERO, 1);
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	// Somewhere else, far enough to be on another page even with 64 KB pages, it's patched to return 2.
+	// Like many games, it doesn't bother to invalidate the icache afterward.
+	const u32 newOp = MIPS_MAKE_ADDIU(MIPS_REG_V0, MIPS_REG_ZERO, 2);
+	const u32 patchAddr = codeAddr + 0x10000;
+	p = (u32 *)Memory::GetPointer(patchAddr);
+	*p++ = MIPS_MAKE_LUI(MIPS_REG_A0, codeAddr >> 16);
+	*p++ = MIPS_MAKE_ORI(MIPS_REG_A0, MIPS_REG_A0, codeAddr & 0xFFFF);
+	*p++ = MIPS_MAKE_LUI(MIPS_REG_A1, newOp >> 16);
+	*p++ = MIPS_MAKE_ORI(MIPS_REG_A1, MIPS_REG_A1, newOp & 0xFFFF);
+	*p++ = MIPS_MAKE_SW(MIPS_REG_A1, MIPS_REG_A0, 0);
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	mipsr4k.UpdateCore(CPUCore::JIT);
+
+	bool success = true;
+	u32 result = RunUntilTerminator(codeAddr);
+	if (result != 1 || !JitPageProtect::RangeUnwritten(codeAddr, 8)) {
+		printf("Before patching: got %d, protected %d\n", result, JitPageProtect::RangeUnwritten(codeAddr, 8));
+		success = false;
+	}
+
+	const int faultsBefore = JitPageProtect::GetWriteFaultCount();
+	RunUntilTerminator(patchAddr);
+	if (JitPageProtect::GetWriteFaultCount() != faultsBefore + 1) {
+		printf("Patching took %d faults, expected 1\n", JitPageProtect::GetWriteFaultCount() - faultsBefore);
+		success = false;
+	}
+
+	// The stale block must not run.
+	result = RunUntilTerminator(codeAddr);
+	if (result != 2) {
+		printf("After patching: got %d, expected 2\n", result);
+		success = false;
+	}
+	// And it's protected again, now that it's recompiled.
+	if (!JitPageProtect::RangeUnwritten(codeAddr, 8)) {
+		printf("Not protected again after recompiling\n");
+		success = false;
+	}
+
+#ifndef _WIN32
+	// The kernel doesn't fault when a read() lands on the protected page, it fails instead.
+	// Like an overlay load, which is what sceIoRead does with HostWriteScope.
+	int fds[2];
+	if (pipe(fds) == 0) {
+		const u32 loadedOp = MIPS_MAKE_ADDIU(MIPS_REG_V0, MIPS_REG_ZERO, 3);
+		ssize_t bytesRead = -1;
+		if (write(fds[1], &loadedOp, sizeof(loadedOp)) == sizeof(loadedOp)) {
+			JitPageProtect::HostWriteScope hostWrite(Memory::GetPointer(codeAddr), sizeof(loadedOp));
+			bytesRead = read(fds[0], Memory::GetPointer(codeAddr), sizeof(loadedOp));
+		}
+		close(fds[0]);
+		close(fds[1]);
+		if (bytesRead != sizeof(loadedOp)) {
+			printf("Host read into code failed: %d\n", (int)bytesRead);
+			success = false;
+		}
+		result = RunUntilTerminator(codeAddr);
+		if (result != 3) {
+			printf("After host read: got %d, expected 3\n", result);
+			success = false;
+		}
+	}
+#endif
+
+	g_Config.bJitWriteProtect = false;
+	DestroyJitHarness();
+	return success;
+}
@@ -0,0 +1,183 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/Core.h"
+#include "Core/CoreTiming.h"
+#include "Core/FileSystems/MetaFileSystem.h"
+#include "Core/HW/AsyncIOManager.h"
+
+#include "unittest/UnitTest.h"
+
+// Every handle reads the same generated data, tracking its own position.
+class PatternFileSystem : public IFileSystem {
+public:
+	static const int DATA_SIZE = 1024 * 1024;
+
+	PatternFileSystem(IHandleAllocator *hAlloc) : hAlloc_(hAlloc) {
+		data_.resize(DATA_SIZE);
+		for (int i = 0; i < DATA_SIZE; ++i) {
+			data_[i] = (u8)((i * 7) ^ (i >> 9));
+		}
+	}
+
+	const u8 *Data() const {
+		return &data_[0];
+	}
+
+	void DoState(PointerWrap &p) override {}
+	std::vector<PSPFileInfo> GetDirListing(std::string path) override { return std::vector<PSPFileInfo>(); }
+	u32 OpenFile(std::string filename, FileAccess access, const char *devicename = nullptr) override {
+		u32 handle = hAlloc_->GetNewHandle();
+		positions_[handle] = 0;
+		return handle;
+	}
+	void CloseFile(u32 handle) override {
+		positions_.erase(handle);
+	}
+	size_t ReadFile(u32 handle, u8 *pointer, s64 size) override {
+		int usec;
+		return ReadFile(handle, pointer, size, usec);
+	}
+	size_t ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) override {
+		s64 &pos = positions_[handle];
+		if (pos + size > DATA_SIZE)
+			size = DATA_SIZE - pos;
+		memcpy(pointer, &data_[(size_t)pos], (size_t)size);
+		pos += size;
+		// Something predictable, so we can check the timing.
+		usec = 100 + (int)size;
+		return (size_t)size;
+	}
+	size_t WriteFile(u32 handle, const u8 *pointer, s64 size) override { return 0; }
+	size_t WriteFile(u32 handle, const u8 *pointer, s64 size, int &usec) override { return 0; }
+	size_t SeekFile(u32 handle, s32 position, FileMove type) override {
+		positions_[handle] = position;
+		return position;
+	}
+	PSPFileInfo GetFileInfo(std::string filename) override { return PSPFileInfo(); }
+	bool OwnsHandle(u32 handle) override {
+		return positions_.find(handle) != positions_.end();
+	}
+	bool MkDir(const std::string &dirname) override { return false; }
+	bool RmDir(const std::string &dirname) override { return false; }
+	int RenameFile(const std::string &from, const std::string &to) override { return -1; }
+	bool RemoveFile(const std::string &filename) override { return false; }
+	bool GetHostPath(const std::string &inpath, std::string &outpath) override { return false; }
+	int Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 outdataPtr, u32 outlen, int &usec) override { return -1; }
+	int DevType(u32 handle) override { return 0; }
+	int Flags() override { return 0; }
+	u64 FreeSpace(const std::string &path) override { return 0; }
+
+private:
+	IHandleAllocator *hAlloc_;
+	std::vector<u8> data_;
+	std::map<u32, s64> positions_;
+};
+
+static bool RunAsyncIOStress(bool threaded, int workers, int rounds) {
+	static const int HANDLES = 16;
+	static const int CHUNK = 512;
+
+	PatternFileSystem *fs = new PatternFileSystem(&pspFileSystem);
+	pspFileSystem.Mount("pattern0:", fs);
+
+	AsyncIOManager manager;
+	manager.Startup(threaded, workers);
+
+	u32 handles[HANDLES];
+	std::vector<u8> buffers[HANDLES];
+	for (int i = 0; i < HANDLES; ++i) {
+		handles[i] = pspFileSystem.OpenFile("pattern0:/file", FILEACCESS_READ);
+		buffers[i].resize(CHUNK);
+	}
+
+	bool success = true;
+	const u64 startTicks = CoreTiming::GetTicks();
+	double st = real_time_now();
+	for (int r = 0; r < rounds && success; ++r) {
+		for (int i = 0; i < HANDLES; ++i) {
+			// Vary the sizes a bit so the handles drift apart.
+			AsyncIOEvent ev = IO_EVENT_READ;
+			ev.handle = handles[i];
+			ev.buf = &buffers[i][0];
+			ev.bytes = CHUNK - (i * 16);
+			ev.invalidateAddr = 0;
+			manager.ScheduleOperation(ev);
+		}
+
+		for (int i = 0; i < HANDLES && success; ++i) {
+			const size_t bytes = CHUNK - (i * 16);
+			const u64 expectedTicks = startTicks + usToCycles(100 + (int)bytes);
+			if (manager.ResultFinishTicks(handles[i]) != expectedTicks) {
+				printf("Round %d handle %d: finish ticks not deterministic\n", r, i);
+				success = false;
+			}
+
+			AsyncIOResult result;
+			if (!manager.WaitResult(handles[i], result) || result.result != (s64)bytes) {
+				printf("Round %d handle %d: missing or short result\n", r, i);
+				success = false;
+			} else if (memcmp(&buffers[i][0], fs->Data() + r * bytes, bytes) != 0) {
+				printf("Round %d handle %d: data out of order\n", r, i);
+				success = false;
+			}
+			if (manager.HasOperation(handles[i])) {
+				printf("Round %d handle %d: operation still pending after result\n", r, i);
+				success = false;
+			}
+		}
+	}
+	double elapsed = real_time_now() - st;
+	printf("%s, %d workers: %d reads in %0.2f ms\n", threaded ? "Threaded" : "Inline", threaded ? workers : 1, rounds * HANDLES, elapsed * 1000.0);
+
+	manager.SyncThread(true);
+	manager.FinishEventLoop();
+	manager.Shutdown();
+
+	for (int i = 0; i < HANDLES; ++i) {
+		pspFileSystem.CloseFile(handles[i]);
+	}
+	pspFileSystem.Unmount("pattern0:", fs);
+	delete fs;
+	return success;
+}
+
+// Shutdown() right after Startup() must not hang, even if the workers haven't started waiting yet.
+static bool RunAsyncIORestarts(int restarts) {
+	AsyncIOManager manager;
+	for (int i = 0; i < restarts; ++i) {
+		manager.Startup(true, 1 + (i % AsyncIOManager::MAX_WORKERS));
+		if ((i & 1) != 0) {
+			manager.FinishEventLoop();
+		}
+		manager.Shutdown();
+	}
+	return true;
+}
+
+bool TestAsyncIOManager() {
+	RET(RunAsyncIORestarts(200));
+	RET(RunAsyncIOStress(false, 1, 64));
+	RET(RunAsyncIOStress(true, 1, 256));
+	RET(RunAsyncIOStress(true, 4, 256));
+	return true;
+}
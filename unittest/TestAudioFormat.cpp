@@ -0,0 +1,170 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "math/math_util.h"
+#include "Core/Util/AudioFormat.h"
+
+#ifdef USE_FFMPEG
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/samplefmt.h"
+#include "libswresample/swresample.h"
+}
+#endif
+
+#include "unittest/UnitTest.h"
+
+// libswresample's generic conversion, av_clip_int16(lrintf(f * (1 << 15))), interleaving as it goes.
+// Limited first so lrintf() stays defined, and NaN is 0 (FFmpeg gives -32768 on x86, 0 on ARM.)
+static void ReferencePlanarF32ToS16(s16 *out, const float *const *in, int channels, size_t frames) {
+	for (size_t i = 0; i < frames; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			const float f = in[c][i];
+			long v = my_isnan(f) ? 0 : lrintf(std::min(std::max(f, -2.0f), 2.0f) * (1 << 15));
+			out[i * channels + c] = (s16)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+		}
+	}
+}
+
+#ifdef USE_FFMPEG
+// What the decoders did before, swresample with only the format changing.
+static bool FFmpegPlanarF32ToS16(s16 *out, const float *const *in, int channels, size_t frames) {
+	const int64_t layout = channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
+	SwrContext *swr = swr_alloc_set_opts(nullptr, layout, AV_SAMPLE_FMT_S16, 44100, layout, AV_SAMPLE_FMT_FLTP, 44100, 0, nullptr);
+	if (!swr || swr_init(swr) < 0) {
+		swr_free(&swr);
+		printf("Unable to initialize swresample\n");
+		return false;
+	}
+	u8 *outPtr = (u8 *)out;
+	int converted = swr_convert(swr, &outPtr, (int)frames, (const u8 **)in, (int)frames);
+	swr_free(&swr);
+	return converted == (int)frames;
+}
+#endif
+
+static bool CompareSamples(const char *what, const std::vector<s16> &out, const std::vector<s16> &expected, const float *const *in, int channels) {
+	for (size_t i = 0; i < out.size(); ++i) {
+		if (out[i] != expected[i]) {
+			printf("%d channels, %d frames: sample %d from %f: got %d, %s gave %d\n", channels, (int)(out.size() / channels), (int)i, in[i % channels][i / channels], out[i], what, expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static u32 NextRandom(u32 &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static bool RunPlanarConversion(int channels, size_t frames, u32 seed) {
+	std::vector<float> planes[2];
+	for (int c = 0; c < channels; ++c) {
+		planes[c].resize(frames);
+		for (size_t i = 0; i < frames; ++i) {
+			const u32 r = NextRandom(seed);
+			switch (r & 3) {
+			case 0:
+				// Clipping, which the decoders do produce.
+				planes[c][i] = ((int)(NextRandom(seed) & 0xFFFF) - 0x8000) / 8192.0f;
+				break;
+			case 1:
+				// Exactly halfway between two outputs, to check the rounding.
+				planes[c][i] = (((int)(NextRandom(seed) & 0xFFFF) - 0x8000) + 0.5f) / 32768.0f;
+				break;
+			default:
+				planes[c][i] = ((int)(NextRandom(seed) & 0xFFFFF) - 0x80000) / 524288.0f;
+				break;
+			}
+		}
+	}
+	const float *in[2] = { planes[0].data(), channels == 2 ? planes[1].data() : nullptr };
+
+	std::vector<s16> out(frames * channels), expected(frames * channels);
+	ConvertPlanarF32ToS16(out.data(), in, channels, frames);
+	ReferencePlanarF32ToS16(expected.data(), in, channels, frames);
+	if (!CompareSamples("the reference", out, expected, in, channels))
+		return false;
+#ifdef USE_FFMPEG
+	if (!FFmpegPlanarF32ToS16(expected.data(), in, channels, frames))
+		return false;
+	if (!CompareSamples("swresample", out, expected, in, channels))
+		return false;
+#endif
+	return true;
+}
+
+// Decoders shouldn't produce these, but the SIMD and scalar paths must still agree wherever they land.
+static bool RunNonFiniteConversion(int channels, size_t frames) {
+	const float specials[] = { NAN, -NAN, INFINITY, -INFINITY, 1e30f, -1e30f, -0.0f, 0.5f };
+	const int numSpecials = (int)(sizeof(specials) / sizeof(specials[0]));
+	std::vector<float> planes[2];
+	for (int c = 0; c < channels; ++c) {
+		planes[c].resize(frames);
+		for (size_t i = 0; i < frames; ++i)
+			planes[c][i] = specials[(i * 3 + c) % numSpecials];
+	}
+	const float *in[2] = { planes[0].data(), channels == 2 ? planes[1].data() : nullptr };
+
+	std::vector<s16> out(frames * channels), expected(frames * channels);
+	ConvertPlanarF32ToS16(out.data(), in, channels, frames);
+	ReferencePlanarF32ToS16(expected.data(), in, channels, frames);
+	return CompareSamples("the reference", out, expected, in, channels);
+}
+
+bool TestAudioFormat() {
+	SetupAudioFormats();
+
+	// Odd sizes, to hit the remainder loops.
+	for (size_t frames = 1; frames < 40; ++frames) {
+		RET(RunPlanarConversion(2, frames, (u32)frames));
+		RET(RunPlanarConversion(1, frames, (u32)frames * 7));
+		RET(RunNonFiniteConversion(2, frames));
+		RET(RunNonFiniteConversion(1, frames));
+	}
+	RET(RunPlanarConversion(2, 2048, 1234));
+	RET(RunPlanarConversion(1, 1152, 5678));
+
+	// An ATRAC3+ frame is 2048 stereo samples.  Compare against the generic path's speed.
+	static const int FRAMES = 2048;
+	static const int ROUNDS = 2000;
+	std::vector<float> left(FRAMES), right(FRAMES);
+	for (int i = 0; i < FRAMES; ++i) {
+		left[i] = sinf(i * 0.01f);
+		right[i] = cosf(i * 0.013f);
+	}
+	const float *in[2] = { left.data(), right.data() };
+	std::vector<s16> out(FRAMES * 2);
+
+	double st = real_time_now();
+	for (int r = 0; r < ROUNDS; ++r)
+		ConvertPlanarF32ToS16(out.data(), in, 2, FRAMES);
+	double elapsed = real_time_now() - st;
+	st = real_time_now();
+	for (int r = 0; r < ROUNDS; ++r)
+		ReferencePlanarF32ToS16(out.data(), in, 2, FRAMES);
+	double refElapsed = real_time_now() - st;
+	printf("Planar float to s16: %0.1f Msamples/sec, generic %0.1f Msamples/sec\n", FRAMES * ROUNDS / elapsed / 1000000.0, FRAMES * ROUNDS / refElapsed / 1000000.0);
+	return true;
+}
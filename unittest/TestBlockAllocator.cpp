@@ -0,0 +1,295 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/Util/BlockAllocator.h"
+
+#include "unittest/UnitTest.h"
+
+// The straightforward first fit walk over every block, which the indexed allocator must match exactly.
+class ReferenceAllocator {
+public:
+	ReferenceAllocator(u32 grain) : grain_(grain) {}
+
+	void Init(u32 start, u32 size) {
+		blocks_.clear();
+		blocks_.push_back(Block(start, size, false));
+	}
+
+	u32 AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromTop) {
+		if (size == 0 || size > TotalSize())
+			return -1;
+		if (grain < grain_)
+			grain = grain_;
+		if (sizeGrain < grain_)
+			sizeGrain = grain_;
+		size = (size + sizeGrain - 1) & ~(sizeGrain - 1);
+
+		const int count = (int)blocks_.size();
+		for (int n = 0; n < count; ++n) {
+			const int i = fromTop ? count - 1 - n : n;
+			const Block b = blocks_[i];
+			u32 offset;
+			if (!fromTop) {
+				offset = b.start % grain;
+				if (offset != 0)
+					offset = grain - offset;
+			} else {
+				offset = (b.start + b.size - size) % grain;
+			}
+			const u32 needed = offset + size;
+			if (b.taken || b.size < needed)
+				continue;
+
+			// Lay out [before][taken][after].
+			u32 before = fromTop ? b.size - needed : 0;
+			u32 after = fromTop ? 0 : b.size - needed;
+			if (offset >= grain_) {
+				if (fromTop)
+					after += offset;
+				else
+					before += offset;
+			}
+			return Split(i, before, b.size - before - after, after);
+		}
+		return -1;
+	}
+
+	u32 AllocAt(u32 position, u32 size) {
+		if (size > TotalSize())
+			return -1;
+		// Mirrors the real thing exactly, including how it adjusts the size for an unaligned position.
+		u32 alignedPosition = position & ~(grain_ - 1);
+		u32 alignedSize = (size + alignedPosition - position + grain_ - 1) & ~(grain_ - 1);
+		const int i = Find(alignedPosition);
+		if (i < 0 || blocks_[i].taken)
+			return -1;
+		const Block b = blocks_[i];
+		if (b.start + b.size < alignedPosition + alignedSize)
+			return -1;
+		const u32 before = alignedPosition - b.start;
+		Split(i, before, alignedSize, b.size - before - alignedSize);
+		return position;
+	}
+
+	bool Free(u32 position, bool exact) {
+		int i = Find(position);
+		if (i < 0 || !blocks_[i].taken || (exact && blocks_[i].start != position))
+			return false;
+		blocks_[i].taken = false;
+		if (i + 1 < (int)blocks_.size() && !blocks_[i + 1].taken) {
+			blocks_[i].size += blocks_[i + 1].size;
+			blocks_.erase(blocks_.begin() + i + 1);
+		}
+		if (i > 0 && !blocks_[i - 1].taken) {
+			blocks_[i - 1].size += blocks_[i].size;
+			blocks_.erase(blocks_.begin() + i);
+		}
+		return true;
+	}
+
+	u32 GetBlockStartFromAddress(u32 addr) const {
+		int i = Find(addr);
+		return i < 0 ? -1 : blocks_[i].start;
+	}
+
+	u32 GetLargestFreeBlockSize() const {
+		u32 largest = 0;
+		for (const Block &b : blocks_) {
+			if (!b.taken && b.size > largest)
+				largest = b.size;
+		}
+		return largest;
+	}
+
+	u32 GetTotalFreeBytes() const {
+		u32 sum = 0;
+		for (const Block &b : blocks_) {
+			if (!b.taken)
+				sum += b.size;
+		}
+		return sum;
+	}
+
+private:
+	struct Block {
+		Block(u32 s, u32 sz, bool t) : start(s), size(sz), taken(t) {}
+		u32 start;
+		u32 size;
+		bool taken;
+	};
+
+	u32 TotalSize() const {
+		return blocks_.back().start + blocks_.back().size - blocks_.front().start;
+	}
+
+	int Find(u32 addr) const {
+		for (size_t i = 0; i < blocks_.size(); ++i) {
+			if (blocks_[i].start <= addr && blocks_[i].start + blocks_[i].size > addr)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	u32 Split(int i, u32 before, u32 size, u32 after) {
+		const u32 start = blocks_[i].start + before;
+		blocks_[i] = Block(start, size, true);
+		if (after != 0)
+			blocks_.insert(blocks_.begin() + i + 1, Block(start + size, after, false));
+		if (before != 0)
+			blocks_.insert(blocks_.begin() + i, Block(start - before, before, false));
+		return start;
+	}
+
+	u32 grain_;
+	std::vector<Block> blocks_;
+};
+
+static u32 NextRandom(u32 &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static const u32 RANGE_START = 0x08800000;
+static const u32 RANGE_SIZE = 0x01800000;
+
+static bool RunBlockAllocatorEquivalence(u32 seed, int ops) {
+	BlockAllocator alloc(0x100);
+	ReferenceAllocator ref(0x100);
+	alloc.Init(RANGE_START, RANGE_SIZE);
+	ref.Init(RANGE_START, RANGE_SIZE);
+
+	std::vector<u32> live;
+	for (int i = 0; i < ops; ++i) {
+		const u32 r = NextRandom(seed);
+		const int op = (int)(r % 8);
+		// Mostly small sizes, with the occasional huge one.
+		u32 size = (NextRandom(seed) % 8) == 0 ? NextRandom(seed) % 0x400000 : NextRandom(seed) % 0x8000;
+		u32 refSize = size;
+
+		u32 addr, refAddr;
+		bool freed = false, refFreed = false;
+		if (op < 3 || live.empty()) {
+			const bool fromTop = (r & 0x100) != 0;
+			addr = alloc.Alloc(size, fromTop);
+			refAddr = ref.AllocAligned(refSize, 0x100, 0x100, fromTop);
+		} else if (op == 3) {
+			const u32 grain = 0x100 << (NextRandom(seed) % 8);
+			const u32 sizeGrain = 0x100 << (NextRandom(seed) % 3);
+			const bool fromTop = (r & 0x100) != 0;
+			addr = alloc.AllocAligned(size, sizeGrain, grain, fromTop);
+			refAddr = ref.AllocAligned(refSize, sizeGrain, grain, fromTop);
+		} else if (op == 4) {
+			const u32 pos = RANGE_START + NextRandom(seed) % RANGE_SIZE;
+			addr = alloc.AllocAt(pos, size);
+			refAddr = ref.AllocAt(pos, refSize);
+		} else {
+			// Free something live, sometimes from the middle or with a bad address.
+			const size_t which = NextRandom(seed) % live.size();
+			u32 pos = live[which];
+			if (op == 7)
+				pos += NextRandom(seed) % 0x200;
+			const bool exact = op == 6;
+			freed = exact ? alloc.FreeExact(pos) : alloc.Free(pos);
+			refFreed = ref.Free(pos, exact);
+			EXPECT_TRUE(freed == refFreed);
+			if (freed) {
+				live[which] = live.back();
+				live.pop_back();
+			}
+			addr = refAddr = -1;
+		}
+
+		if (addr != refAddr || size != refSize) {
+			printf("Op %d (type %d): got %08x/%08x, expected %08x/%08x\n", i, op, addr, size, refAddr, refSize);
+			return false;
+		}
+		if (addr != (u32)-1)
+			live.push_back(alloc.GetBlockStartFromAddress(addr));
+
+		EXPECT_EQ_HEX(alloc.GetTotalFreeBytes(), ref.GetTotalFreeBytes());
+		EXPECT_EQ_HEX(alloc.GetLargestFreeBlockSize(), ref.GetLargestFreeBlockSize());
+		const u32 probe = RANGE_START + NextRandom(seed) % (RANGE_SIZE + 0x1000);
+		EXPECT_EQ_HEX(alloc.GetBlockStartFromAddress(probe), ref.GetBlockStartFromAddress(probe));
+	}
+
+	alloc.Shutdown();
+	return true;
+}
+
+// Keeps a few thousand blocks live and churns through them, like a game with lots of small allocations.
+template <typename T>
+static double RunBlockAllocatorChurn(T &alloc, u32 &checksum) {
+	static const int LIVE = 4096;
+	static const int ROUNDS = 20000;
+
+	u32 seed = 1234;
+	std::vector<u32> live;
+	live.reserve(LIVE);
+	double st = real_time_now();
+	for (int i = 0; i < LIVE + ROUNDS; ++i) {
+		// Once full, every allocation replaces a random earlier one, fragmenting the range.
+		if (live.size() >= LIVE) {
+			const size_t which = NextRandom(seed) % live.size();
+			alloc.FreeExact(live[which]);
+			live[which] = live.back();
+			live.pop_back();
+		}
+
+		u32 size = 0x100 + NextRandom(seed) % 0x1000;
+		u32 addr = alloc.Alloc(size, (i & 3) == 0);
+		if (addr != (u32)-1)
+			live.push_back(addr);
+		checksum = checksum * 31 + addr;
+	}
+	return real_time_now() - st;
+}
+
+// Thin adapter so both allocators take the same calls in the benchmark.
+struct ReferenceChurnAdapter {
+	ReferenceAllocator ref;
+	ReferenceChurnAdapter() : ref(0x100) {}
+	u32 Alloc(u32 &size, bool fromTop) {
+		return ref.AllocAligned(size, 0x100, 0x100, fromTop);
+	}
+	bool FreeExact(u32 pos) {
+		return ref.Free(pos, true);
+	}
+};
+
+bool TestBlockAllocator() {
+	RET(RunBlockAllocatorEquivalence(1, 20000));
+	RET(RunBlockAllocatorEquivalence(0x1337, 20000));
+	RET(RunBlockAllocatorEquivalence(0xDEADBEEF, 20000));
+
+	u32 checksum = 0, refChecksum = 0;
+	BlockAllocator alloc(0x100);
+	alloc.Init(RANGE_START, RANGE_SIZE);
+	double elapsed = RunBlockAllocatorChurn(alloc, checksum);
+	alloc.Shutdown();
+
+	ReferenceChurnAdapter ref;
+	ref.ref.Init(RANGE_START, RANGE_SIZE);
+	double refElapsed = RunBlockAllocatorChurn(ref, refChecksum);
+
+	printf("BlockAllocator churn: %0.2f ms indexed, %0.2f ms linear walk\n", elapsed * 1000.0, refElapsed * 1000.0);
+	EXPECT_EQ_HEX(checksum, refChecksum);
+	return true;
+}
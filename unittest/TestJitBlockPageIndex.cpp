@@ -0,0 +1,109 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
+
+#include "unittest/UnitTest.h"
+
+struct TestBlock {
+	u32 start;
+	u32 end;
+	bool mapped;
+};
+
+static u32 NextRandom(u32 &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+// Like a game's code: mostly short blocks packed in a few MB of RAM, some long ones.
+static TestBlock RandomBlock(u32 &seed) {
+	TestBlock b;
+	b.start = 0x08800000 + (NextRandom(seed) % 0x00400000) * 4;
+	const u32 instructions = (NextRandom(seed) & 15) == 0 ? 1 + NextRandom(seed) % 2000 : 1 + NextRandom(seed) % 40;
+	b.end = b.start + instructions * 4;
+	b.mapped = true;
+	return b;
+}
+
+static void FindOverlappingReference(const std::vector<TestBlock> &blocks, u32 start, u32 end, std::vector<int> *found) {
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		if (blocks[i].mapped && blocks[i].start < end && blocks[i].end > start)
+			found->push_back((int)i);
+	}
+}
+
+// Populates the index like a full block cache, then invalidates random ranges (unmapping what they
+// hit, and compiling new blocks) and checks against a brute force search.
+bool TestJitBlockPageIndex() {
+	static const int BLOCKS = 60000;
+	static const int INVALIDATIONS = 20000;
+
+	u32 seed = 0x1234;
+	JitBlockPageIndex index;
+	std::vector<TestBlock> blocks;
+	for (int i = 0; i < BLOCKS; ++i) {
+		blocks.push_back(RandomBlock(seed));
+		index.Add(i, blocks[i].start, blocks[i].end);
+	}
+
+	std::vector<int> found, expected;
+	int invalidated = 0;
+	double elapsed = 0.0;
+	for (int i = 0; i < INVALIDATIONS; ++i) {
+		const u32 start = 0x08800000 + (NextRandom(seed) % 0x00400000) * 4;
+		// Mostly small writes, sometimes a whole overlay.
+		const u32 size = (NextRandom(seed) & 63) == 0 ? NextRandom(seed) % 0x40000 : 4 + (NextRandom(seed) % 64) * 4;
+
+		found.clear();
+		double st = real_time_now();
+		index.FindOverlapping(start, start + size, &found);
+		elapsed += real_time_now() - st;
+
+		expected.clear();
+		FindOverlappingReference(blocks, start, start + size, &expected);
+		if (found != expected) {
+			printf("Invalidating %08x-%08x: found %d blocks, expected %d\n", start, start + size, (int)found.size(), (int)expected.size());
+			return false;
+		}
+
+		for (int blockNum : found) {
+			index.Remove(blockNum, blocks[blockNum].start, blocks[blockNum].end);
+			blocks[blockNum].mapped = false;
+			invalidated++;
+		}
+		// The jit will compile something new soon after.
+		blocks.push_back(RandomBlock(seed));
+		index.Add((int)blocks.size() - 1, blocks.back().start, blocks.back().end);
+	}
+
+	// And nothing should be left behind once it's all removed.
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		if (blocks[i].mapped)
+			index.Remove((int)i, blocks[i].start, blocks[i].end);
+	}
+	found.clear();
+	index.FindOverlapping(0, 0x1FFFFFFF, &found);
+	EXPECT_EQ_INT((int)found.size(), 0);
+
+	printf("Jit block index: %d invalidations (%d blocks) in %0.2f ms\n", INVALIDATIONS, invalidated, elapsed * 1000.0);
+	return true;
+}
@@ -0,0 +1,152 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/CommonTypes.h"
+#include "Common/MPSCQueue.h"
+
+#include "unittest/UnitTest.h"
+
+// About the size of a GPU or IO event.
+struct TestQueueItem {
+	u32 producer;
+	u32 seq;
+	u64 payload;
+};
+
+static const int ITEMS_PER_PRODUCER = 200000;
+
+// What ThreadEventQueue used before, for comparison.
+class LockedTestQueue {
+public:
+	bool push(const TestQueueItem &item) {
+		std::lock_guard<std::mutex> guard(lock_);
+		items_.push_back(item);
+		return true;
+	}
+	void push_wait(const TestQueueItem &item) {
+		push(item);
+	}
+	bool pop(TestQueueItem &item) {
+		std::lock_guard<std::mutex> guard(lock_);
+		if (items_.empty())
+			return false;
+		item = items_.front();
+		items_.pop_front();
+		return true;
+	}
+
+private:
+	std::mutex lock_;
+	std::deque<TestQueueItem> items_;
+};
+
+// Every item has to arrive exactly once, and in order for each producer.
+template <typename Q>
+static bool RunQueueContention(Q &queue, int producers, double &elapsed) {
+	std::vector<std::thread> threads;
+	const double st = real_time_now();
+	for (int p = 0; p < producers; ++p) {
+		threads.push_back(std::thread([&queue, p] {
+			for (int i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+				TestQueueItem item;
+				item.producer = p;
+				item.seq = i;
+				item.payload = ((u64)p << 32) | (u32)i;
+				queue.push_wait(item);
+			}
+		}));
+	}
+
+	std::vector<u32> nextSeq(producers, 0);
+	bool success = true;
+	int remaining = producers * ITEMS_PER_PRODUCER;
+	SpinBackoff backoff;
+	while (remaining > 0) {
+		TestQueueItem item;
+		if (!queue.pop(item)) {
+			backoff.Wait();
+			continue;
+		}
+		backoff.Reset();
+		remaining--;
+		if (item.producer >= (u32)producers || item.seq != nextSeq[item.producer] || item.payload != (((u64)item.producer << 32) | item.seq)) {
+			if (success)
+				printf("Producer %d: got item %d, expected %d\n", item.producer, item.seq, item.producer < (u32)producers ? nextSeq[item.producer] : 0);
+			success = false;
+		} else {
+			nextSeq[item.producer]++;
+		}
+	}
+	elapsed = real_time_now() - st;
+
+	for (std::thread &t : threads)
+		t.join();
+	TestQueueItem extra;
+	if (queue.pop(extra)) {
+		printf("Queue had extra items after %d producers\n", producers);
+		success = false;
+	}
+	return success;
+}
+
+static bool TestMPSCQueueBasics() {
+	MPSCQueue<TestQueueItem, 4> queue;
+	TestQueueItem item{};
+	EXPECT_TRUE(queue.empty());
+	EXPECT_FALSE(queue.pop(item));
+	for (u32 i = 0; i < 4; ++i) {
+		item.seq = i;
+		EXPECT_TRUE(queue.push(item));
+	}
+	EXPECT_FALSE(queue.push(item));
+	EXPECT_EQ_INT((int)queue.size(), 4);
+	// Wrap around a few times.
+	for (u32 i = 0; i < 20; ++i) {
+		TestQueueItem out;
+		EXPECT_TRUE(queue.pop(out));
+		EXPECT_EQ_INT(out.seq, i);
+		item.seq = i + 4;
+		EXPECT_TRUE(queue.push(item));
+	}
+	queue.clear();
+	EXPECT_TRUE(queue.empty());
+	return true;
+}
+
+bool TestMPSCQueue() {
+	if (!TestMPSCQueueBasics())
+		return false;
+
+	bool success = true;
+	for (int producers = 1; producers <= 8 && success; producers *= 2) {
+		MPSCQueue<TestQueueItem, 256> queue;
+		LockedTestQueue locked;
+		double elapsed = 0.0, lockedElapsed = 0.0;
+		success = RunQueueContention(queue, producers, elapsed);
+		success = success && RunQueueContention(locked, producers, lockedElapsed);
+		const double items = (double)producers * ITEMS_PER_PRODUCER;
+		printf("MPSC queue, %d producers: %0.1f M items/s, mutex and deque %0.1f M items/s\n", producers, items / elapsed / 1000000.0, items / lockedElapsed / 1000000.0);
+	}
+	return success;
+}
@@ -0,0 +1,576 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/Config.h"
+#include "Core/MemMap.h"
+#include "Core/HW/SasAudio.h"
+#include "Core/HW/SasReverb.h"
+#include "Core/Util/AudioFormat.h"
+
+#include "unittest/UnitTest.h"
+
+static const u32 SAS_TEST_OUT = 0x08800000;
+static const u32 SAS_TEST_DATA = 0x08900000;
+static const int SAS_TEST_VAG_BLOCKS = 600;
+static const int SAS_TEST_PCM_SAMPLES = 9000;
+
+static u32 SasRandom(u32 &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+// The straightforward per sample mixer: resample, envelope, then volume, one sample at a time.
+static void ReferenceMixVoice(SasVoice &voice, int grainSize, int *mix, int *send) {
+	int delay = 0;
+	if (voice.envelope.NeedsKeyOn()) {
+		const bool ignorePitch = voice.type == VOICETYPE_PCM && voice.pitch > PSP_SAS_PITCH_BASE;
+		delay = ignorePitch ? 32 : (32 * (u32)voice.pitch) >> PSP_SAS_PITCH_BASE_SHIFT;
+		if (voice.type == VOICETYPE_VAG)
+			++delay;
+	}
+
+	static s16_le temp[PSP_SAS_MAX_GRAIN * 4 + 2 + 8];
+	temp[0] = voice.resampleHist[0];
+	temp[1] = voice.resampleHist[1];
+
+	u32 sampleFrac = voice.sampleFrac;
+	int samplesToRead = (sampleFrac + voice.pitch * std::max(0, grainSize - delay)) >> PSP_SAS_PITCH_BASE_SHIFT;
+	voice.ReadSamples(&temp[2], samplesToRead);
+	int tempPos = 2 + samplesToRead;
+
+	for (int i = delay; i < grainSize; i++) {
+		const s16_le *s = temp + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+		int f = sampleFrac & PSP_SAS_PITCH_MASK;
+		int sample = (s[0] * (PSP_SAS_PITCH_MASK - f) + s[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
+		sampleFrac += voice.pitch;
+
+		int envelopeValue = voice.envelope.GetHeight();
+		voice.envelope.Step();
+		envelopeValue = (envelopeValue + (1 << 14)) >> 15;
+		sample = ((sample * envelopeValue) + (1 << 14)) >> 15;
+
+		mix[i * 2] += (sample * voice.volumeLeft) >> 12;
+		mix[i * 2 + 1] += (sample * voice.volumeRight) >> 12;
+		send[i * 2] += sample * voice.effectLeft >> 12;
+		send[i * 2 + 1] += sample * voice.effectRight >> 12;
+	}
+
+	voice.resampleHist[0] = temp[tempPos - 2];
+	voice.resampleHist[1] = temp[tempPos - 1];
+	voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;
+
+	if (voice.HaveSamplesEnded())
+		voice.envelope.End();
+	if (voice.envelope.HasEnded()) {
+		voice.playing = false;
+		voice.on = false;
+	}
+}
+
+static void WriteSasTestData(u32 seed) {
+	u8 *vag = Memory::GetPointer(SAS_TEST_DATA);
+	for (int b = 0; b < SAS_TEST_VAG_BLOCKS; ++b) {
+		u8 *block = vag + b * 16;
+		block[0] = (u8)(((SasRandom(seed) % 5) << 4) | (SasRandom(seed) % 13));
+		// Loop over the whole thing.
+		block[1] = b == 0 ? 6 : (b == SAS_TEST_VAG_BLOCKS - 1 ? 3 : 0);
+		for (int i = 2; i < 16; ++i)
+			block[i] = (u8)SasRandom(seed);
+	}
+
+	s16 *pcm = (s16 *)Memory::GetPointer(SAS_TEST_DATA + SAS_TEST_VAG_BLOCKS * 16);
+	for (int i = 0; i < SAS_TEST_PCM_SAMPLES; ++i)
+		pcm[i] = (s16)SasRandom(seed);
+}
+
+static void SetupSasTestVoice(SasVoice &voice, int index, u32 &seed) {
+	static const int pitches[] = { PSP_SAS_PITCH_BASE, PSP_SAS_PITCH_BASE * 2, PSP_SAS_PITCH_BASE / 2, 0 };
+	static const int curves[] = {
+		PSP_SAS_ADSR_CURVE_MODE_LINEAR_INCREASE,
+		PSP_SAS_ADSR_CURVE_MODE_LINEAR_DECREASE,
+		PSP_SAS_ADSR_CURVE_MODE_LINEAR_BENT,
+		PSP_SAS_ADSR_CURVE_MODE_EXPONENT_DECREASE,
+		PSP_SAS_ADSR_CURVE_MODE_EXPONENT_INCREASE,
+		PSP_SAS_ADSR_CURVE_MODE_DIRECT,
+	};
+
+	if (index & 1) {
+		voice.type = VOICETYPE_PCM;
+		voice.pcmAddr = SAS_TEST_DATA + SAS_TEST_VAG_BLOCKS * 16;
+		voice.pcmSize = SAS_TEST_PCM_SAMPLES - (int)(SasRandom(seed) % 1000);
+		voice.pcmLoopPos = (int)(SasRandom(seed) % 100);
+		voice.pcmIndex = 0;
+	} else {
+		voice.type = VOICETYPE_VAG;
+		voice.vagAddr = SAS_TEST_DATA + (SasRandom(seed) % 8) * 16;
+		voice.vagSize = (SAS_TEST_VAG_BLOCKS - 8) * 16;
+	}
+	// A few voices play out without looping.
+	voice.loop = (index % 7) != 0;
+
+	voice.pitch = pitches[index % 4];
+	if (voice.pitch == 0)
+		voice.pitch = 0x100 + SasRandom(seed) % (PSP_SAS_PITCH_MAX - 0x100);
+	voice.volumeLeft = (int)(SasRandom(seed) % 0x2001) - 0x1000;
+	voice.volumeRight = (int)(SasRandom(seed) % 0x2001) - 0x1000;
+	voice.effectLeft = (int)(SasRandom(seed) % 0x1001);
+	voice.effectRight = (int)(SasRandom(seed) % 0x1001);
+
+	ADSREnvelope &env = voice.envelope;
+	env.attackType = index < 20 ? PSP_SAS_ADSR_CURVE_MODE_LINEAR_INCREASE : curves[SasRandom(seed) % 6];
+	env.decayType = index < 12 ? PSP_SAS_ADSR_CURVE_MODE_LINEAR_DECREASE : curves[SasRandom(seed) % 6];
+	env.sustainType = curves[SasRandom(seed) % 6];
+	env.releaseType = index < 24 ? PSP_SAS_ADSR_CURVE_MODE_LINEAR_DECREASE : curves[SasRandom(seed) % 6];
+	// Fast and slow curves, and the occasional crazy one.
+	const int shift = (int)(SasRandom(seed) % 12) + 8;
+	env.attackRate = (int)(SasRandom(seed) & 0x7FFFFFFF) >> shift;
+	env.decayRate = (int)(SasRandom(seed) & 0x7FFFFFFF) >> shift;
+	env.sustainRate = (int)(SasRandom(seed) & 0x7FFFFFFF) >> (shift + 4);
+	env.releaseRate = (int)(SasRandom(seed) & 0x7FFFFFFF) >> shift;
+	env.sustainLevel = (int)(SasRandom(seed) % PSP_SAS_ENVELOPE_HEIGHT_MAX);
+
+	voice.KeyOn();
+}
+
+static bool RunSasMixComparison(int grainSize, bool parallel, int grains) {
+	u32 seed = 0x5A5 + grainSize;
+	const bool oldParallel = g_Config.bParallelSASVoices;
+	g_Config.bParallelSASVoices = parallel;
+
+	SasInstance *sas = new SasInstance();
+	sas->SetGrainSize(grainSize);
+	// Raw output includes the send buffer too.
+	sas->outputMode = PSP_SAS_OUTPUTMODE_RAW;
+
+	SasVoice *refVoices = new SasVoice[PSP_SAS_VOICES_MAX];
+	for (int v = 0; v < PSP_SAS_VOICES_MAX; ++v) {
+		SetupSasTestVoice(sas->voices[v], v, seed);
+		refVoices[v] = sas->voices[v];
+	}
+
+	std::vector<int> mix(grainSize * 2), send(grainSize * 2);
+	bool success = true;
+	double mixTime = 0.0, refTime = 0.0;
+	for (int g = 0; g < grains && success; ++g) {
+		if (g == grains / 2) {
+			for (int v = 0; v < PSP_SAS_VOICES_MAX; v += 3) {
+				sas->voices[v].KeyOff();
+				refVoices[v].KeyOff();
+			}
+		}
+
+		double st = real_time_now();
+		sas->Mix(SAS_TEST_OUT);
+		mixTime += real_time_now() - st;
+
+		st = real_time_now();
+		std::fill(mix.begin(), mix.end(), 0);
+		std::fill(send.begin(), send.end(), 0);
+		for (int v = 0; v < PSP_SAS_VOICES_MAX; ++v) {
+			if (refVoices[v].playing && !refVoices[v].paused)
+				ReferenceMixVoice(refVoices[v], grainSize, &mix[0], &send[0]);
+		}
+		refTime += real_time_now() - st;
+
+		const s16 *out = (const s16 *)Memory::GetPointer(SAS_TEST_OUT);
+		for (int i = 0; i < grainSize && success; ++i) {
+			const int expected[4] = { mix[i * 2], mix[i * 2 + 1], send[i * 2], send[i * 2 + 1] };
+			for (int plane = 0; plane < 4; ++plane) {
+				if (out[plane * grainSize + i] != clamp_s16(expected[plane])) {
+					printf("Grain %d sample %d plane %d: got %d, expected %d\n", g, i, plane, out[plane * grainSize + i], clamp_s16(expected[plane]));
+					success = false;
+					break;
+				}
+			}
+		}
+		for (int v = 0; v < PSP_SAS_VOICES_MAX && success; ++v) {
+			if (sas->voices[v].playing != refVoices[v].playing || sas->voices[v].sampleFrac != refVoices[v].sampleFrac) {
+				printf("Grain %d voice %d: state mismatch\n", g, v);
+				success = false;
+			}
+		}
+	}
+
+	printf("SAS mix, grain %d%s: %0.2f ms, per sample reference %0.2f ms (%d grains)\n", grainSize, parallel ? ", parallel" : "", mixTime * 1000.0, refTime * 1000.0, grains);
+
+	delete[] refVoices;
+	delete sas;
+	g_Config.bParallelSASVoices = oldParallel;
+	return success;
+}
+
+// MixSilent (for turbo) has to leave the voices exactly where Mix would.
+static bool RunSasSilentComparison(int grainSize, int grains) {
+	u32 seed = 0x51E + grainSize;
+	u32 silentSeed = seed;
+
+	SasInstance *sas = new SasInstance();
+	SasInstance *silent = new SasInstance();
+	sas->SetGrainSize(grainSize);
+	silent->SetGrainSize(grainSize);
+	sas->outputMode = PSP_SAS_OUTPUTMODE_RAW;
+	silent->outputMode = PSP_SAS_OUTPUTMODE_RAW;
+	for (int v = 0; v < PSP_SAS_VOICES_MAX; ++v) {
+		SetupSasTestVoice(sas->voices[v], v, seed);
+		SetupSasTestVoice(silent->voices[v], v, silentSeed);
+	}
+
+	bool success = true;
+	for (int g = 0; g < grains && success; ++g) {
+		if (g == grains / 2) {
+			for (int v = 0; v < PSP_SAS_VOICES_MAX; v += 3) {
+				sas->voices[v].KeyOff();
+				silent->voices[v].KeyOff();
+			}
+		}
+
+		sas->Mix(SAS_TEST_OUT);
+		silent->MixSilent(SAS_TEST_OUT);
+
+		const s16 *out = (const s16 *)Memory::GetPointer(SAS_TEST_OUT);
+		for (int i = 0; i < grainSize * 4; ++i) {
+			if (out[i] != 0) {
+				printf("Grain %d sample %d: silent output was %d\n", g, i, out[i]);
+				success = false;
+				break;
+			}
+		}
+		for (int v = 0; v < PSP_SAS_VOICES_MAX && success; ++v) {
+			const SasVoice &a = sas->voices[v];
+			const SasVoice &b = silent->voices[v];
+			if (a.playing != b.playing || a.sampleFrac != b.sampleFrac || a.envelope.GetHeight() != b.envelope.GetHeight()) {
+				printf("Grain %d voice %d: silent state mismatch\n", g, v);
+				success = false;
+			}
+		}
+	}
+
+	delete silent;
+	delete sas;
+	return success;
+}
+
+// The block at a time decoder, copied from before batching.
+class ReferenceVagDecoder {
+public:
+	void Start(u32 data, u32 vagSize, bool loopEnabled) {
+		loopEnabled_ = loopEnabled;
+		loopAtNextBlock_ = false;
+		loopStartBlock_ = -1;
+		numBlocks_ = vagSize / 16;
+		end_ = false;
+		data_ = data;
+		read_ = data;
+		curSample = 28;
+		curBlock_ = -1;
+		s_1 = 0;
+		s_2 = 0;
+	}
+
+	void GetSamples(s16 *outSamples, int numSamples) {
+		if (end_) {
+			memset(outSamples, 0, numSamples * sizeof(s16));
+			return;
+		}
+		u8 *readp = Memory::GetPointerUnchecked(read_);
+		u8 *origp = readp;
+
+		for (int i = 0; i < numSamples; i++) {
+			if (curSample == 28) {
+				if (loopAtNextBlock_) {
+					read_ = data_ + 16 * loopStartBlock_ + 16;
+					readp = Memory::GetPointerUnchecked(read_);
+					origp = readp;
+					curBlock_ = loopStartBlock_;
+					loopAtNextBlock_ = false;
+				}
+				DecodeBlock(readp);
+				if (end_) {
+					memset(&outSamples[i], 0, (numSamples - i) * sizeof(s16));
+					return;
+				}
+			}
+			outSamples[i] = samples[curSample++];
+		}
+
+		if (readp > origp) {
+			read_ += readp - origp;
+		}
+	}
+
+	bool End() const { return end_; }
+	u32 GetReadPtr() const { return read_; }
+
+private:
+	void DecodeBlock(u8 *&read_pointer) {
+		static const u8 f[16][2] = {
+			{ 0, 0 }, { 60, 0 }, { 115, 52 }, { 98, 55 }, { 122, 60 }, { 0, 0 }, { 0, 0 }, { 52, 0 },
+			{ 55, 2 }, { 60, 125 }, { 0, 0 }, { 0, 91 }, { 0, 0 }, { 2, 216 }, { 125, 6 }, { 0, 151 },
+		};
+
+		u8 *readp = read_pointer;
+		int predict_nr = *readp++;
+		int shift_factor = predict_nr & 0xf;
+		predict_nr >>= 4;
+		int flags = *readp++;
+		if (flags == 7) {
+			end_ = true;
+			return;
+		} else if (flags == 6) {
+			loopStartBlock_ = curBlock_;
+		} else if (flags == 3) {
+			if (loopEnabled_) {
+				loopAtNextBlock_ = true;
+			}
+		}
+
+		int s1 = s_1;
+		int s2 = s_2;
+		int coef1 = f[predict_nr][0];
+		int coef2 = -f[predict_nr][1];
+		for (int i = 0; i < 28; i += 2) {
+			u8 d = *readp++;
+			int sample1 = (short)((d & 0xf) << 12) >> shift_factor;
+			int sample2 = (short)((d & 0xf0) << 8) >> shift_factor;
+			s2 = clamp_s16(sample1 + ((s1 * coef1 + s2 * coef2) >> 6));
+			s1 = clamp_s16(sample2 + ((s2 * coef1 + s1 * coef2) >> 6));
+			samples[i] = s2;
+			samples[i + 1] = s1;
+		}
+
+		s_1 = s1;
+		s_2 = s2;
+		curSample = 0;
+		curBlock_++;
+		if (curBlock_ == numBlocks_) {
+			end_ = true;
+		}
+		read_pointer = readp;
+	}
+
+	s16 samples[28];
+	int curSample;
+	u32 data_;
+	u32 read_;
+	int curBlock_;
+	int loopStartBlock_;
+	int numBlocks_;
+	int s_1;
+	int s_2;
+	bool loopEnabled_;
+	bool loopAtNextBlock_;
+	bool end_;
+};
+
+static bool RunVagComparison(int predict, int shift, bool loop, bool endBlock, u32 &seed) {
+	static const int BLOCKS = 40;
+	u8 *vag = Memory::GetPointer(SAS_TEST_DATA);
+	for (int b = 0; b < BLOCKS; ++b) {
+		u8 *block = vag + b * 16;
+		// Mostly the combination under test, with a few others to vary the predictor state.
+		const bool other = (SasRandom(seed) % 4) == 0;
+		block[0] = other ? (u8)SasRandom(seed) : (u8)((predict << 4) | shift);
+		block[1] = 0;
+		for (int i = 2; i < 16; ++i)
+			block[i] = (u8)SasRandom(seed);
+	}
+	vag[5 * 16 + 1] = 6;
+	vag[(BLOCKS - 3) * 16 + 1] = 3;
+	if (endBlock)
+		vag[(BLOCKS - 2) * 16 + 1] = 7;
+
+	VagDecoder decoder;
+	ReferenceVagDecoder ref;
+	decoder.Start(SAS_TEST_DATA, BLOCKS * 16, loop);
+	ref.Start(SAS_TEST_DATA, BLOCKS * 16, loop);
+
+	s16_le out[700];
+	s16 expected[700];
+	for (int call = 0; call < 60; ++call) {
+		// Sizes around and across block boundaries, and some big ones.
+		const int count = call % 5 == 0 ? 300 + SasRandom(seed) % 400 : 1 + SasRandom(seed) % 60;
+		decoder.GetSamples(out, count);
+		ref.GetSamples(expected, count);
+		for (int i = 0; i < count; ++i) {
+			if (out[i] != expected[i]) {
+				printf("VAG predict %d shift %d call %d sample %d: got %d, expected %d\n", predict, shift, call, i, (s16)out[i], expected[i]);
+				return false;
+			}
+		}
+		EXPECT_TRUE(decoder.End() == ref.End());
+		EXPECT_EQ_HEX(decoder.GetReadPtr(), ref.GetReadPtr());
+	}
+	return true;
+}
+
+bool TestVagDecoder() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+
+	bool success = true;
+	u32 seed = 42;
+	for (int predict = 0; predict < 16 && success; ++predict) {
+		for (int shift = 0; shift < 16 && success; ++shift) {
+			success = RunVagComparison(predict, shift, true, false, seed);
+			success = success && RunVagComparison(predict, shift, false, (shift & 1) != 0, seed);
+		}
+	}
+
+	Memory::Shutdown();
+	return success;
+}
+
+// The sample at a time reverb, copied from before the per preset loops.
+class ReferenceReverb {
+public:
+	ReferenceReverb() : workspace_(BUFSIZE), d_(nullptr), pos_(0) {}
+
+	void SetPreset(int preset) {
+		d_ = SasReverb::GetPresetData(preset);
+		pos_ = BUFSIZE - d_->size;
+		std::fill(workspace_.begin(), workspace_.end(), 0);
+	}
+
+	void ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
+		const SasReverbData &d = *d_;
+		for (size_t i = 0; i < inputSize; i++) {
+			int16_t Lin = input[i * 2] >> 1;
+			int16_t Rin = input[i * 2 + 1] >> 1;
+
+			b(d.mLSAME) = clamp_s16(Lin + (b(d.dLSAME) * d.vWALL >> 15) - (b(d.mLSAME - 1)*d.vIIR >> 15) + b(d.mLSAME - 1));
+			b(d.mRSAME) = clamp_s16(Rin + (b(d.dRSAME) * d.vWALL >> 15) - (b(d.mRSAME - 1)*d.vIIR >> 15) + b(d.mRSAME - 1));
+			b(d.mLDIFF) = clamp_s16(Lin + (b(d.dRDIFF) * d.vWALL >> 15) - (b(d.mLDIFF - 1)*d.vIIR >> 15) + b(d.mLDIFF - 1));
+			b(d.mRDIFF) = clamp_s16(Rin + (b(d.dLDIFF) * d.vWALL >> 15) - (b(d.mRDIFF - 1)*d.vIIR >> 15) + b(d.mRDIFF - 1));
+			int32_t Lout = ((d.vCOMB1*b(d.mLCOMB1) + d.vCOMB2*b(d.mLCOMB2) + d.vCOMB3*b(d.mLCOMB3) + d.vCOMB4*b(d.mLCOMB4)) >> 15);
+			int32_t Rout = ((d.vCOMB1*b(d.mRCOMB1) + d.vCOMB2*b(d.mRCOMB2) + d.vCOMB3*b(d.mRCOMB3) + d.vCOMB4*b(d.mRCOMB4)) >> 15);
+			b(d.mLAPF1) = clamp_s16(Lout - (d.vAPF1*b((d.mLAPF1 - d.dAPF1)) >> 15));
+			Lout = b((d.mLAPF1 - d.dAPF1)) + (b(d.mLAPF1) * d.vAPF1 >> 15);
+			b(d.mRAPF1) = clamp_s16(Rout - (d.vAPF1*b((d.mRAPF1 - d.dAPF1)) >> 15));
+			Rout = b((d.mRAPF1 - d.dAPF1)) + (b(d.mRAPF1) * d.vAPF1 >> 15);
+			b(d.mLAPF2) = clamp_s16(Lout - (d.vAPF2*b((d.mLAPF2 - d.dAPF2)) >> 15));
+			Lout = b((d.mLAPF2 - d.dAPF2)) + (b(d.mLAPF2) * d.vAPF2 >> 15);
+			b(d.mRAPF2) = clamp_s16(Rout - (d.vAPF2*b((d.mRAPF2 - d.dAPF2)) >> 15));
+			Rout = b((d.mRAPF2 - d.dAPF2)) + (b(d.mRAPF2) * d.vAPF2 >> 15);
+			output[i * 4 + 0] = clamp_s16(Lout * volLeft >> 15);
+			output[i * 4 + 1] = clamp_s16(Rout * volRight >> 15);
+			output[i * 4 + 2] = 0;
+			output[i * 4 + 3] = 0;
+
+			pos_++;
+			if (pos_ >= BUFSIZE)
+				pos_ -= d.size;
+		}
+	}
+
+private:
+	enum {
+		BUFSIZE = 0x20000,
+	};
+
+	int16_t &b(int index) {
+		int addr = pos_ + index;
+		if (addr >= BUFSIZE)
+			addr -= d_->size;
+		if (addr < BUFSIZE - d_->size)
+			addr += d_->size;
+		return workspace_[addr];
+	}
+
+	std::vector<int16_t> workspace_;
+	const SasReverbData *d_;
+	int pos_;
+};
+
+static bool RunSasReverbComparison(int preset, u32 &seed, double &elapsed, double &refElapsed) {
+	// Enough to go around even the largest preset's buffer a few times.
+	static const int TOTAL_SAMPLES = 320000;
+	static const int MAX_CHUNK = 1024;
+
+	std::vector<int16_t> input(TOTAL_SAMPLES * 2);
+	for (size_t i = 0; i < input.size(); ++i) {
+		// Loud enough to clip now and then, with some quiet stretches.
+		const int section = (int)(i / 20000) % 4;
+		if (section == 3)
+			input[i] = 0;
+		else
+			input[i] = (int16_t)(SasRandom(seed) >> (section * 4));
+	}
+
+	SasReverb reverb;
+	ReferenceReverb ref;
+	reverb.SetPreset(preset);
+	ref.SetPreset(preset);
+
+	std::vector<int16_t> out(MAX_CHUNK * 4), expected(MAX_CHUNK * 4);
+	int pos = 0;
+	while (pos < TOTAL_SAMPLES) {
+		const int count = std::min(TOTAL_SAMPLES - pos, 1 + (int)(SasRandom(seed) % MAX_CHUNK));
+		// The effect volumes are at most 0x1000 << 3.
+		const uint16_t volLeft = (uint16_t)(SasRandom(seed) % 0x8001);
+		const uint16_t volRight = (uint16_t)(SasRandom(seed) % 0x8001);
+
+		double st = real_time_now();
+		reverb.ProcessReverb(&out[0], &input[pos * 2], count, volLeft, volRight);
+		elapsed += real_time_now() - st;
+		st = real_time_now();
+		ref.ProcessReverb(&expected[0], &input[pos * 2], count, volLeft, volRight);
+		refElapsed += real_time_now() - st;
+
+		if (memcmp(&out[0], &expected[0], count * 4 * sizeof(int16_t)) != 0) {
+			for (int i = 0; i < count * 4; ++i) {
+				if (out[i] != expected[i]) {
+					printf("Reverb %s, sample %d: got %d, expected %d\n", SasReverb::GetPresetName(preset), pos + i / 4, out[i], expected[i]);
+					break;
+				}
+			}
+			return false;
+		}
+		pos += count;
+	}
+	return true;
+}
+
+bool TestSasReverb() {
+	u32 seed = 7;
+	for (int preset = 0; preset <= PSP_SAS_EFFECT_TYPE_MAX; ++preset) {
+		double elapsed = 0.0, refElapsed = 0.0;
+		if (!RunSasReverbComparison(preset, seed, elapsed, refElapsed))
+			return false;
+		printf("Reverb %s: %0.2f ms, per sample reference %0.2f ms\n", SasReverb::GetPresetName(preset), elapsed * 1000.0, refElapsed * 1000.0);
+	}
+	return true;
+}
+
+bool TestSasAudio() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	WriteSasTestData(1234);
+
+	bool success = RunSasMixComparison(256, false, 2000);
+	success = success && RunSasMixComparison(2048, false, 250);
+	success = success && RunSasMixComparison(1024, true, 500);
+	success = success && RunSasSilentComparison(256, 2000);
+
+	Memory::Shutdown();
+	return success;
+}
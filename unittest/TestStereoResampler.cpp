@@ -0,0 +1,154 @@
+// Copyright (c) 2018- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/Config.h"
+#include "Core/HLE/__sceAudio.h"
+#include "Core/HW/StereoResampler.h"
+
+#include "unittest/UnitTest.h"
+
+// Pushes numbered blocks from one thread and mixes them on another, like the emulator and the audio backend.
+// Without resampling, every frame of each block that got in must come out exactly once and in order.
+static bool RunResamplerThreaded() {
+	static const int PUSH_FRAMES = 256;
+	static const int MIX_FRAMES = 200;
+	static const int BLOCKS = 800;
+	static const int TOTAL_FRAMES = PUSH_FRAMES * BLOCKS;
+
+	g_Config.bAudioResampler = false;
+	StereoResampler resampler;
+
+	std::atomic<bool> done(false);
+	std::thread producer([&] {
+		std::vector<s32> block(PUSH_FRAMES * 2);
+		for (int b = 0; b < BLOCKS; ++b) {
+			for (int i = 0; i < PUSH_FRAMES; ++i) {
+				block[i * 2] = b;
+				block[i * 2 + 1] = i;
+			}
+			// Just like the emulator, it gets dropped if the buffer's full.  The stats count those.
+			resampler.PushSamples(&block[0], PUSH_FRAMES);
+			std::this_thread::yield();
+		}
+		done = true;
+	});
+
+	bool success = true;
+	short out[MIX_FRAMES * 2];
+	int last = -1;
+	int received = 0;
+	while (success) {
+		const bool finished = done;
+		int frames = resampler.Mix(out, MIX_FRAMES, false, 44100);
+		for (int i = 0; i < frames; ++i) {
+			const int frame = out[i * 2] * PUSH_FRAMES + out[i * 2 + 1];
+			// Anything skipped must be whole dropped blocks.
+			const bool skipped = frame != last + 1;
+			if (frame <= last || (skipped && (frame % PUSH_FRAMES) != 0)) {
+				printf("Frame %d after %d\n", frame, last);
+				success = false;
+				break;
+			}
+			last = frame;
+			received++;
+		}
+		if (finished && frames == 0)
+			break;
+	}
+	producer.join();
+
+	// Only safe to look at now, the producer updates them.
+	AudioDebugStats stats{};
+	resampler.GetAudioDebugStats(&stats);
+	// The last frame is always held back.
+	const int expected = TOTAL_FRAMES - stats.overrunCount * PUSH_FRAMES - 1;
+	if (success && (received != expected || received <= 0)) {
+		printf("Got %d frames, expected %d (%d blocks dropped)\n", received, expected, stats.overrunCount);
+		success = false;
+	}
+	return success;
+}
+
+// Resamples 44100 to 48000 and measures how far off the result is from the ideal sine.
+static bool RunResamplerSine(bool sinc, double freq, double maxError) {
+	static const int FRAMES = 44100 / 4;
+	static const int OUT_FRAMES = 512;
+
+	g_Config.bAudioResampler = true;
+	g_Config.bSincResampler = sinc;
+	StereoResampler resampler;
+
+	std::vector<s32> in(FRAMES * 2);
+	const double pi = 3.14159265358979323846;
+	for (int i = 0; i < FRAMES; ++i) {
+		in[i * 2] = (s32)(16000.0 * sin(2.0 * pi * freq * i / 44100.0));
+		in[i * 2 + 1] = 8000;
+	}
+
+	// Feed it in steps and keep the buffer level steady so the drift control stays out of the way.
+	double error = 0.0;
+	double power = 0.0;
+	int pushed = 0;
+	short out[OUT_FRAMES * 2];
+	double st = real_time_now();
+	int mixed = 0;
+	for (int round = 0; pushed + 512 <= FRAMES; ++round) {
+		resampler.PushSamples(&in[pushed * 2], 512);
+		pushed += 512;
+		if (round < 4)
+			continue;
+		const int frames = resampler.Mix(out, 470, false, 48000);
+		// The first few frames blend in the silence from before the start.
+		if (round == 4)
+			continue;
+		mixed += frames;
+		for (int i = 0; i < frames; ++i) {
+			// Only the level matters, the drift control shifts the phase around a little.
+			power += (double)out[i * 2] * out[i * 2];
+			error = std::max(error, fabs(out[i * 2 + 1] - 8000.0));
+		}
+	}
+	double elapsed = real_time_now() - st;
+	const double rms = sqrt(power / mixed);
+	const double idealRms = 16000.0 / sqrt(2.0);
+	printf("%s resampler, %0.0f Hz: rms %0.1f (ideal %0.1f), dc error %0.1f, %d frames in %0.2f ms\n", sinc ? "Sinc" : "Linear", freq, rms, idealRms, error, mixed, elapsed * 1000.0);
+	EXPECT_TRUE(error <= 1.0);
+	EXPECT_TRUE(fabs(rms - idealRms) <= idealRms * maxError);
+	return true;
+}
+
+bool TestStereoResampler() {
+	g_Config.iGlobalVolume = VOLUME_MAX;
+	g_Config.bExtraAudioBuffering = false;
+
+	RET(RunResamplerThreaded());
+	RET(RunResamplerSine(false, 1000.0, 0.01));
+	RET(RunResamplerSine(true, 1000.0, 0.01));
+	// Linear interpolation audibly dulls the highs, the sinc keeps them.
+	RET(RunResamplerSine(true, 15000.0, 0.03));
+
+	g_Config.bSincResampler = false;
+	g_Config.bAudioResampler = true;
+	return true;
+}
@@ -25,9 +25,11 @@
 // Or just integrate with an existing testing framework.
 
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <deque>
 #include <string>
 #include <sstream>
 
@@ -40,9 +42,11 @@
 
 #include "Common/CPUDetect.h"
 #include "Common/ArmEmitter.h"
+#include "Common/ChunkFile.h"
 #include "Core/Config.h"
 #include "Core/MIPS/MIPSVFPUUtils.h"
 #include "Core/FileSystems/ISOFileSystem.h"
+#include "Core/HLE/ThreadQueueList.h"
 #include "GPU/Common/TextureDecoder.h"
 
 #include "unittest/JitHarness.h"
@@ -402,6 +406,137 @@ bool TestParseLBN() {
 	return true;
 }
 
+struct ChunkFileTestState {
+	int a;
+	std::string name;
+	u8 data[100];
+
+	void DoState(PointerWrap &p) {
+		auto s = p.Section("ChunkFileTest", 1);
+		if (!s)
+			return;
+		p.Do(a);
+		p.Do(name);
+		p.DoArray(data, ARRAY_SIZE(data));
+	}
+};
+
+bool TestChunkFileSaveLimit() {
+	ChunkFileTestState state;
+	state.a = 0x1234;
+	state.name = "run-ahead";
+	for (int i = 0; i < ARRAY_SIZE(state.data); ++i)
+		state.data[i] = (u8)i;
+	const size_t measured = CChunkFileReader::MeasurePtr(state);
+
+	// Too small: nothing past the end is touched, and it still knows the full size.
+	std::vector<u8> buffer(measured + 16, 0xCC);
+	size_t used = 0;
+	EXPECT_TRUE(CChunkFileReader::SavePtr(&buffer[0], state, measured / 2, &used) == CChunkFileReader::ERROR_BAD_ALLOC);
+	EXPECT_EQ_INT((int)used, (int)measured);
+	for (size_t i = measured / 2; i < buffer.size(); ++i)
+		EXPECT_EQ_HEX(buffer[i], 0xCC);
+
+	// Big enough, and it reads back.
+	EXPECT_TRUE(CChunkFileReader::SavePtr(&buffer[0], state, buffer.size(), &used) == CChunkFileReader::ERROR_NONE);
+	EXPECT_EQ_INT((int)used, (int)measured);
+	EXPECT_EQ_HEX(buffer[measured], 0xCC);
+
+	ChunkFileTestState loaded{};
+	EXPECT_TRUE(CChunkFileReader::LoadPtr(&buffer[0], loaded) == CChunkFileReader::ERROR_NONE);
+	EXPECT_EQ_INT(loaded.a, state.a);
+	EXPECT_EQ_STR(loaded.name, state.name);
+	EXPECT_TRUE(memcmp(loaded.data, state.data, sizeof(state.data)) == 0);
+	return true;
+}
+
+bool TestThreadQueueList() {
+	static const int THREADS = 300;
+	static const int PRIORITIES = 8;
+
+	// Same operations against a simple model, checking the order always matches.
+	ThreadQueueList queue;
+	std::deque<SceUID> model[ThreadQueueList::NUM_QUEUES];
+	int prio[THREADS + 1];
+	for (int i = 0; i <= THREADS; ++i)
+		prio[i] = -1;
+	for (int p = 0; p < PRIORITIES; ++p)
+		queue.prepare(p * 16 + 8);
+
+	auto modelFirst = [&]() -> int {
+		for (int p = 0; p < ThreadQueueList::NUM_QUEUES; ++p) {
+			if (!model[p].empty())
+				return p;
+		}
+		return -1;
+	};
+
+	u32 seed = 1234;
+	for (int step = 0; step < 200000; ++step) {
+		seed = seed * 1103515245 + 12345;
+		SceUID id = 0x100 + (seed >> 8) % THREADS;
+		int &tp = prio[id - 0x100 + 1];
+		int p = ((seed >> 20) % PRIORITIES) * 16 + 8;
+		switch ((seed >> 28) % 6) {
+		case 0:
+		case 1:
+			if (tp == -1) {
+				queue.push_back(p, id);
+				model[p].push_back(id);
+				tp = p;
+			}
+			break;
+		case 2:
+			if (tp == -1) {
+				queue.push_front(p, id);
+				model[p].push_front(id);
+				tp = p;
+			}
+			break;
+		case 3:
+			if (tp != -1) {
+				queue.remove(tp, id);
+				model[tp].erase(std::find(model[tp].begin(), model[tp].end(), id));
+				tp = -1;
+			}
+			break;
+		case 4:
+			queue.rotate(p);
+			if (model[p].size() > 1) {
+				model[p].push_back(model[p].front());
+				model[p].pop_front();
+			}
+			break;
+		case 5:
+			{
+				int best = modelFirst();
+				SceUID popped = queue.pop_first_better(p);
+				if (best != -1 && best < p) {
+					EXPECT_EQ_INT(popped, model[best].front());
+					prio[model[best].front() - 0x100 + 1] = -1;
+					model[best].pop_front();
+				} else {
+					EXPECT_EQ_INT(popped, 0);
+				}
+			}
+			break;
+		}
+
+		int best = modelFirst();
+		EXPECT_EQ_INT(queue.peek_first(), best == -1 ? 0 : model[best].front());
+		EXPECT_EQ_INT(queue.contains(id), tp);
+		EXPECT_EQ_INT(queue.empty(p), model[p].empty());
+	}
+
+	while (modelFirst() != -1) {
+		int best = modelFirst();
+		EXPECT_EQ_INT(queue.pop_first(), model[best].front());
+		model[best].pop_front();
+	}
+	EXPECT_EQ_INT(queue.peek_first(), 0);
+	return true;
+}
+
 // So we can use EXPECT_TRUE, etc.
 struct AlignedMem {
 	AlignedMem(size_t sz, size_t alignment = 16) {
@@ -470,6 +605,15 @@ struct TestItem {
 bool TestArmEmitter();
 bool TestArm64Emitter();
 bool TestX64Emitter();
+bool TestAsyncIOManager();
+bool TestBlockAllocator();
+bool TestSasAudio();
+bool TestVagDecoder();
+bool TestSasReverb();
+bool TestStereoResampler();
+bool TestAudioFormat();
+bool TestJitBlockPageIndex();
+bool TestMPSCQueue();
 
 TestItem availableTests[] = {
 #if defined(ARM64) || defined(_M_X64) || defined(_M_IX86)
@@ -488,9 +632,21 @@ TestItem availableTests[] = {
 	TEST_ITEM(MathUtil),
 	TEST_ITEM(Parsers),
 	TEST_ITEM(Jit),
+	TEST_ITEM(JitWriteProtect),
 	TEST_ITEM(MatrixTranspose),
 	TEST_ITEM(ParseLBN),
+	TEST_ITEM(ChunkFileSaveLimit),
 	TEST_ITEM(QuickTexHash),
+	TEST_ITEM(AsyncIOManager),
+	TEST_ITEM(ThreadQueueList),
+	TEST_ITEM(BlockAllocator),
+	TEST_ITEM(SasAudio),
+	TEST_ITEM(VagDecoder),
+	TEST_ITEM(SasReverb),
+	TEST_ITEM(StereoResampler),
+	TEST_ITEM(AudioFormat),
+	TEST_ITEM(JitBlockPageIndex),
+	TEST_ITEM(MPSCQueue),
 };
 
 int main(int argc, const char *argv[]) {